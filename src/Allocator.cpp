@@ -0,0 +1,140 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <new>
+#include "Allocator.hpp"
+
+#if defined(__linux__)
+   #include <sys/mman.h>
+   #include <stdint.h>
+#endif
+
+using namespace kanzi;
+
+namespace kanzi {
+
+   class HeapAllocator : public Allocator {
+   public:
+       void* allocate(size_t size) { return ::operator new(size); }
+
+       void release(void* p, size_t) { ::operator delete(p); }
+   };
+
+#if defined(__linux__)
+   class PageAllocator : public Allocator {
+   public:
+       PageAllocator(bool explicitHugePages) : _explicit(explicitHugePages) {}
+
+       void* allocate(size_t size)
+       {
+           if (size < HUGE_PAGE_SIZE)
+               return ::operator new(size);
+
+           const size_t sz = roundUp(size);
+
+   #ifdef MAP_HUGETLB
+           if (_explicit == true) {
+               void* p = mmap(nullptr, sz, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+               if (p != MAP_FAILED)
+                   return p;
+
+               // No huge page reserved: fall back to transparent huge pages
+           }
+   #endif
+
+           // Map one more huge page to align the table on a huge page
+           uint8* p = static_cast<uint8*>(mmap(nullptr, sz + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+           if (p == MAP_FAILED)
+               throw bad_alloc();
+
+           const size_t head = (HUGE_PAGE_SIZE - (uintptr_t(p) & (HUGE_PAGE_SIZE - 1))) & (HUGE_PAGE_SIZE - 1);
+
+           if (head != 0)
+               munmap(p, head);
+
+           if (head != HUGE_PAGE_SIZE)
+               munmap(p + head + sz, HUGE_PAGE_SIZE - head);
+
+   #ifdef MADV_HUGEPAGE
+           madvise(p + head, sz, MADV_HUGEPAGE);
+   #endif
+           return p + head;
+       }
+
+       void release(void* p, size_t size)
+       {
+           if (size < HUGE_PAGE_SIZE)
+               ::operator delete(p);
+           else
+               munmap(p, roundUp(size));
+       }
+
+   private:
+       static const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+       static size_t roundUp(size_t size) { return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1); }
+
+       const bool _explicit;
+   };
+#endif
+}
+
+Allocator& Allocator::getAllocator(int type)
+{
+   static HeapAllocator heap;
+
+#if defined(__linux__)
+   static PageAllocator transparentPages(false);
+   static PageAllocator hugePages(true);
+
+   if (type == TRANSPARENT_HUGE_PAGES)
+       return transparentPages;
+
+   if (type == HUGE_PAGES)
+       return hugePages;
+#endif
+
+   return heap;
+}
+
+Allocator& Allocator::getAllocator(Context* ctx)
+{
+   if ((ctx == nullptr) || (ctx->has("pages") == false))
+       return getAllocator(NORMAL_PAGES);
+
+   return getAllocator(getType(ctx->getString("pages")));
+}
+
+int Allocator::getType(const string& name)
+{
+   string str = name;
+   transform(str.begin(), str.end(), str.begin(), ::toupper);
+
+   if (str == "NORMAL")
+       return NORMAL_PAGES;
+
+   if (str == "THP")
+       return TRANSPARENT_HUGE_PAGES;
+
+   if (str == "HUGE")
+       return HUGE_PAGES;
+
+   return -1;
+}
@@ -0,0 +1,69 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _Allocator_
+#define _Allocator_
+
+#include <cstddef>
+#include "types.hpp"
+#include "Context.hpp"
+
+namespace kanzi {
+
+   // Allocation of the big tables accessed almost randomly (BWT/BWTS suffix
+   // arrays, TPAQ states, hashes and buffer, ROLZ matches) where TLB misses
+   // dominate. The memory is not initialized. Selected with the context key
+   // 'pages':
+   // - NORMAL (default): heap
+   // - THP: anonymous mapping aligned on 2 MB with transparent huge pages
+   // - HUGE: explicit huge pages (MAP_HUGETLB, requires reserved pages), THP
+   //   if none is available
+   // Mappings are only used on Linux (heap elsewhere) and for tables of 2 MB
+   // or more.
+   // An object keeps the allocator it was created with to release its tables.
+   class Allocator {
+   public:
+       static const int NORMAL_PAGES = 0;
+       static const int TRANSPARENT_HUGE_PAGES = 1;
+       static const int HUGE_PAGES = 2;
+
+       virtual ~Allocator() {}
+
+       virtual void* allocate(size_t size) = 0;
+
+       // 'size' must be the allocated size
+       virtual void release(void* p, size_t size) = 0;
+
+       template <class T>
+       T* newArray(size_t length) { return static_cast<T*>(allocate(length * sizeof(T))); }
+
+       template <class T>
+       void deleteArray(T* p, size_t length)
+       {
+           if (p != nullptr)
+               release(p, length * sizeof(T));
+       }
+
+       // Process wide allocators
+       static Allocator& getAllocator(int type);
+
+       // Allocator selected by the context (heap if ctx is null)
+       static Allocator& getAllocator(Context* ctx);
+
+       // Return the type for a name (NORMAL, THP or HUGE) or -1
+       static int getType(const string& name);
+   };
+}
+#endif
@@ -15,6 +15,7 @@ limitations under the License.
 
 
 #include "Global.hpp"
+#include "Memory.hpp"
 
 using namespace kanzi;
 
@@ -148,22 +149,28 @@ void Global::computeHistogram(byte block[], int length, uint freqs[], bool isOrd
 
     if (isOrder0 == true) {
         memset(freqs, 0, mult * sizeof(uint));
-        const uint8* end4 = (uint8*)&block[length & -4];
 
         if (withTotal == true)
            freqs[256] = length;
 
-        uint f0[256] = { 0 };
-        uint f1[256] = { 0 };
-        uint f2[256] = { 0 };
-        uint f3[256] = { 0 };
+        // Read 8 symbols at a time and count them in 8 sub-histograms so that
+        // consecutive increments (runs) do not depend on each other
+        uint f[8][256];
+        memset(f, 0, sizeof(f));
         uint8* p = (uint8*)&block[0];
-
-        while (p < end4) {
-            f0[*p++]++;
-            f1[*p++]++;
-            f2[*p++]++;
-            f3[*p++]++;
+        const uint8* end8 = (uint8*)&block[length & -8];
+
+        while (p < end8) {
+            const uint64 v = uint64(LittleEndian::readLong64((byte*)p));
+            f[0][v & 0xFF]++;
+            f[1][(v >> 8) & 0xFF]++;
+            f[2][(v >> 16) & 0xFF]++;
+            f[3][(v >> 24) & 0xFF]++;
+            f[4][(v >> 32) & 0xFF]++;
+            f[5][(v >> 40) & 0xFF]++;
+            f[6][(v >> 48) & 0xFF]++;
+            f[7][v >> 56]++;
+            p += 8;
         }
 
         const uint8* end = (uint8*)&block[length];
@@ -172,27 +179,30 @@ void Global::computeHistogram(byte block[], int length, uint freqs[], bool isOrd
             freqs[*p++]++;
 
         for (int i = 0; i < 256; i++)
-            freqs[i] += (f0[i] + f1[i] + f2[i] + f3[i]);
+            freqs[i] += (f[0][i] + f[1][i] + f[2][i] + f[3][i] + f[4][i] + f[5][i] + f[6][i] + f[7][i]);
     }
     else { // Order 1
         memset(freqs, 0, 256 * mult * sizeof(uint));
         uint prv = 0;
         uint8* p = (uint8*)&block[0];
 
+        for (int i = 0; i < length; i++) {
+            freqs[prv + uint(p[i])]++;
+            prv = mult * uint(p[i]);
+        }
+
         if (withTotal == true) {
-           for (int i = 0; i < length; i++) {
-               freqs[prv + uint(p[i])]++;
-               freqs[prv + 256]++;
-               prv = 257 * uint(p[i]);
-           }
-        } else {
-           for (int i = 0; i < length; i++) {
-               freqs[prv + uint(p[i])]++;
-               prv = 256 * uint(p[i]);
+           // Compute the totals once instead of incrementing them in the loop
+           for (int i = 0; i < 256 * 257; i += 257) {
+               uint sum = 0;
+
+               for (int j = 0; j < 256; j++)
+                   sum += freqs[i + j];
+
+               freqs[i + 256] = sum;
            }
         }
     }
-
 }
 
 void Global::computeJobsPerTask(int jobsPerTask[], int jobs, int tasks) THROW
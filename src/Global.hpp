@@ -49,6 +49,9 @@ namespace kanzi {
        
        static void computeJobsPerTask(int jobsPerTask[], int jobs, int tasks) THROW;
 
+       // Histogram shared by the entropy codecs, the entropy estimation and
+       // the transforms. Scalar code: the increments do not vectorize (lanes
+       // updating the same counter conflict).
        static void computeHistogram(byte block[], int end, uint freqs[], bool isOrder0, bool withTotal=false);
 
    private:
@@ -34,10 +34,6 @@ limitations under the License.
 #include "../io/NullOutputStream.hpp"
 #include "../io/NullOutputStream.hpp"
 
-#ifdef CONCURRENCY_ENABLED
-#include <future>
-#endif
-
 using namespace kanzi;
 
 BlockCompressor::BlockCompressor(map<string, string>& args) THROW
@@ -70,6 +66,49 @@ BlockCompressor::BlockCompressor(map<string, string>& args) THROW
         args.erase(it);
     }
 
+    it = args.find("index");
+
+    if (it == args.end()) {
+        _index = false;
+    }
+    else {
+        string str = it->second;
+        transform(str.begin(), str.end(), str.begin(), ::toupper);
+        _index = str == "TRUE";
+        args.erase(it);
+    }
+
+    it = args.find("suffixSort");
+
+    if (it == args.end()) {
+        _suffixSort = "DIVSUFSORT";
+    }
+    else {
+        _suffixSort = it->second;
+        transform(_suffixSort.begin(), _suffixSort.end(), _suffixSort.begin(), ::toupper);
+        args.erase(it);
+    }
+
+    it = args.find("autoPipeline");
+
+    if (it == args.end()) {
+        _autoPipeline = -1;
+    }
+    else {
+        _autoPipeline = atoi(it->second.c_str());
+        args.erase(it);
+    }
+
+    it = args.find("targetSpeed");
+
+    if (it == args.end()) {
+        _targetSpeed = -1;
+    }
+    else {
+        _targetSpeed = atoi(it->second.c_str());
+        args.erase(it);
+    }
+
     it = args.find("inputName");
     _inputName = it->second;
     args.erase(it);
@@ -162,6 +201,26 @@ BlockCompressor::BlockCompressor(map<string, string>& args) THROW
 
     _jobs = (concurrency == 0) ? DEFAULT_CONCURRENCY : concurrency;
     args.erase(it);
+    it = args.find("memoryLimit");
+
+    if (it == args.end()) {
+        _memoryLimit = 0;
+    }
+    else {
+        _memoryLimit = atoll(it->second.c_str());
+        args.erase(it);
+    }
+
+    it = args.find("pages");
+
+    if (it == args.end()) {
+        _pages = "NORMAL";
+    }
+    else {
+        _pages = it->second;
+        args.erase(it);
+    }
+
 
     if ((_verbosity > 0) && (args.size() > 0)) {
         Printer log(&cout);
@@ -234,6 +293,23 @@ int BlockCompressor::compress(uint64& outputSize)
     ss << "Checksum set to " << (_checksum ? "true" : "false");
     log.println(ss.str().c_str(), printFlag);
     ss.str(string());
+    ss << "Block index set to " << (_index ? "true" : "false");
+    log.println(ss.str().c_str(), printFlag);
+    ss.str(string());
+    ss << "Suffix sort set to " << _suffixSort;
+    log.println(ss.str().c_str(), printFlag);
+    ss.str(string());
+
+    if (_targetSpeed > 0) {
+        ss << "Pipeline selected per block (target speed " << _targetSpeed << " MB/s)";
+        log.println(ss.str().c_str(), printFlag);
+        ss.str(string());
+    }
+    else if (_autoPipeline >= 0) {
+        ss << "Pipeline selected per block (minimum speed " << _autoPipeline << " MB/s)";
+        log.println(ss.str().c_str(), printFlag);
+        ss.str(string());
+    }
 
     if (printFlag == true) {
         string etransform = _transform;
@@ -252,6 +328,18 @@ int BlockCompressor::compress(uint64& outputSize)
     log.println(ss.str().c_str(), printFlag);
     ss.str(string());
 
+    if (_memoryLimit > 0) {
+        ss << "Memory limit set to " << (_memoryLimit >> 20) << " MB";
+        log.println(ss.str().c_str(), printFlag);
+        ss.str(string());
+    }
+
+    if (_pages != "NORMAL") {
+        ss << "Memory pages set to " << _pages;
+        log.println(ss.str().c_str(), printFlag);
+        ss.str(string());
+    }
+
     string outputName = _outputName;
     transform(outputName.begin(), outputName.end(), outputName.begin(), ::toupper);
 
@@ -337,15 +425,37 @@ int BlockCompressor::compress(uint64& outputSize)
     ss << _verbosity;
     ctx["verbosity"] = ss.str();
     ctx["overwrite"] = (_overwrite == true) ? "TRUE" : "FALSE";
+
+    if (_memoryLimit > 0) {
+        ss.str(string());
+        ss << _memoryLimit;
+        ctx["memoryLimit"] = ss.str();
+    }
+
+    ctx["pages"] = _pages;
     ss.str(string());
     ss << _blockSize;
     ctx["blockSize"] = ss.str();
     ctx["skipBlocks"] = (_skipBlocks == true) ? "TRUE" : "FALSE";
     ctx["checksum"] = (_checksum == true) ? "TRUE" : "FALSE";
+    ctx["index"] = (_index == true) ? "TRUE" : "FALSE";
+    ctx["suffixSort"] = _suffixSort;
     ctx["codec"] = _codec;
     ctx["transform"] = _transform;
     ctx["extra"] = (_codec == "TPAQX") ? "TRUE" : "FALSE";
 
+    if (_autoPipeline >= 0) {
+        ss.str(string());
+        ss << _autoPipeline;
+        ctx["autoPipeline"] = ss.str();
+    }
+
+    if (_targetSpeed > 0) {
+        ss.str(string());
+        ss << _targetSpeed;
+        ctx["targetSpeed"] = ss.str();
+    }
+
     // Run the task(s)
     if (nbFiles == 1) {
         string oName = formattedOutName;
@@ -404,7 +514,13 @@ int BlockCompressor::compress(uint64& outputSize)
             taskCtx.putLong("fileSize", files[i]._size);
             taskCtx.putString("inputName", iName);
             taskCtx.putString("outputName", oName);
-            taskCtx.putInt("jobs", jobsPerTask[n++]);
+            taskCtx.putInt("jobs", jobsPerTask[n]);
+
+            // Share the memory limit like the jobs
+            if (_memoryLimit > 0)
+                taskCtx.putLong("memoryLimit", _memoryLimit * jobsPerTask[n] / _jobs);
+
+            n++;
             ss.str(string());
             FileCompressTask<FileCompressResult>* task = new FileCompressTask<FileCompressResult>(taskCtx, _listeners);
             tasks.push_back(task);
@@ -415,26 +531,26 @@ int BlockCompressor::compress(uint64& outputSize)
 #ifdef CONCURRENCY_ENABLED
         if (doConcurrent) {
             vector<FileCompressWorker<FileCompressTask<FileCompressResult>*, FileCompressResult>*> workers;
-            vector<future<FileCompressResult> > results;
+            vector<FileCompressResult> results;
             BoundedConcurrentQueue<FileCompressTask<FileCompressResult>*> queue(nbFiles, &tasks[0]);
 
-            // Create one worker per job and run it. A worker calls several tasks sequentially.
-            for (int i = 0; i < _jobs; i++) {
+            // Create one worker per job. A worker calls several tasks sequentially.
+            for (int i = 0; i < _jobs; i++)
                 workers.push_back(new FileCompressWorker<FileCompressTask<FileCompressResult>*, FileCompressResult>(&queue));
-                results.push_back(async(launch::async, &FileCompressWorker<FileCompressTask<FileCompressResult>*, FileCompressResult>::run, workers[i]));
-            }
 
-            // Wait for results
+            // Run the workers in parallel (in the shared thread pool)
+            ThreadPool::instance().reserve(_jobs);
+            ThreadPool::instance().run(workers, results);
+
+            // Check results
             for (int i = 0; i < _jobs; i++) {
-                FileCompressResult fcr = results[i].get();
-                res = fcr._code;
+                FileCompressResult fcr = results[i];
                 read += fcr._read;
                 written += fcr._written;
 
-                if (res != 0) {
+                if (fcr._code != 0) {
+                    res = fcr._code;
                     cerr << fcr._errMsg << endl;
-                    // Exit early by telling the workers that the queue is empty
-                    queue.clear();
                 }
             }
 
@@ -915,6 +1031,8 @@ R FileCompressWorker<T, R>::run()
 
         if (res != 0) {
             errMsg += result._errMsg;
+            // Exit early by telling the other workers that the queue is empty
+            _queue->clear();
         }
     }
 
@@ -111,6 +111,10 @@ namespace kanzi {
        bool _overwrite;
        bool _checksum;
        bool _skipBlocks;
+       bool _index;
+       string _suffixSort; // suffix array construction for BWT/BWTS
+       int _autoPipeline; // min speed (MB/s) of the pipeline selected per block, -1 if none
+       int _targetSpeed; // speed (MB/s) the pipeline selection adapts to, -1 if none
        string _inputName;
        string _outputName;
        string _codec;
@@ -118,6 +122,8 @@ namespace kanzi {
        int _blockSize;
        int _level; // command line compression level
        int _jobs;
+       int64 _memoryLimit; // in bytes, 0 if none
+       string _pages; // memory pages of the big tables (NORMAL, THP or HUGE)
        vector<Listener*> _listeners;
 
        static void notifyListeners(vector<Listener*>& listeners, const Event& evt);
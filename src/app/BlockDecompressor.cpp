@@ -34,10 +34,6 @@ limitations under the License.
 #include "../io/NullOutputStream.hpp"
 #include "../io/NullOutputStream.hpp"
 
-#ifdef CONCURRENCY_ENABLED
-#include <future>
-#endif
-
 using namespace kanzi;
 
 BlockDecompressor::BlockDecompressor(map<string, string>& args)
@@ -82,6 +78,26 @@ BlockDecompressor::BlockDecompressor(map<string, string>& args)
 
     _jobs = (concurrency == 0) ? DEFAULT_CONCURRENCY : concurrency;
     args.erase(it);
+    it = args.find("memoryLimit");
+
+    if (it == args.end()) {
+        _memoryLimit = 0;
+    }
+    else {
+        _memoryLimit = atoll(it->second.c_str());
+        args.erase(it);
+    }
+
+    it = args.find("pages");
+
+    if (it == args.end()) {
+        _pages = "NORMAL";
+    }
+    else {
+        _pages = it->second;
+        args.erase(it);
+    }
+
     _cis = nullptr;
     _os = nullptr;
 
@@ -148,6 +164,18 @@ int BlockDecompressor::decompress(uint64& inputSize)
     log.println(ss.str().c_str(), printFlag);
     ss.str(string());
 
+    if (_memoryLimit > 0) {
+        ss << "Memory limit set to " << (_memoryLimit >> 20) << " MB";
+        log.println(ss.str().c_str(), printFlag);
+        ss.str(string());
+    }
+
+    if (_pages != "NORMAL") {
+        ss << "Memory pages set to " << _pages;
+        log.println(ss.str().c_str(), printFlag);
+        ss.str(string());
+    }
+
     string outputName = _outputName;
     transform(outputName.begin(), outputName.end(), outputName.begin(), ::toupper);
 
@@ -231,6 +259,14 @@ int BlockDecompressor::decompress(uint64& inputSize)
     ctx["verbosity"] = ss.str();
     ctx["overwrite"] = (_overwrite == true) ? "TRUE" : "FALSE";
 
+    if (_memoryLimit > 0) {
+        ss.str(string());
+        ss << _memoryLimit;
+        ctx["memoryLimit"] = ss.str();
+    }
+
+    ctx["pages"] = _pages;
+
     // Run the task(s)
     if (nbFiles == 1) {
         string oName = formattedOutName;
@@ -284,7 +320,13 @@ int BlockDecompressor::decompress(uint64& inputSize)
             taskCtx.putLong("fileSize", files[i]._size);
             taskCtx.putString("inputName", iName);
             taskCtx.putString("outputName", oName);
-            taskCtx.putInt("jobs", jobsPerTask[n++]);
+            taskCtx.putInt("jobs", jobsPerTask[n]);
+
+            // Share the memory limit like the jobs
+            if (_memoryLimit > 0)
+                taskCtx.putLong("memoryLimit", _memoryLimit * jobsPerTask[n] / _jobs);
+
+            n++;
             ss.str(string());
             FileDecompressTask<FileDecompressResult>* task = new FileDecompressTask<FileDecompressResult>(taskCtx, _listeners);
             tasks.push_back(task);
@@ -295,25 +337,25 @@ int BlockDecompressor::decompress(uint64& inputSize)
 #ifdef CONCURRENCY_ENABLED
         if (doConcurrent) {
             vector<FileDecompressWorker<FileDecompressTask<FileDecompressResult>*, FileDecompressResult>*> workers;
-            vector<future<FileDecompressResult> > results;
+            vector<FileDecompressResult> results;
             BoundedConcurrentQueue<FileDecompressTask<FileDecompressResult>*> queue(nbFiles, &tasks[0]);
 
-            // Create one worker per job and run it. A worker calls several tasks sequentially.
-            for (int i = 0; i < _jobs; i++) {
+            // Create one worker per job. A worker calls several tasks sequentially.
+            for (int i = 0; i < _jobs; i++)
                 workers.push_back(new FileDecompressWorker<FileDecompressTask<FileDecompressResult>*, FileDecompressResult>(&queue));
-                results.push_back(async(launch::async, &FileDecompressWorker<FileDecompressTask<FileDecompressResult>*, FileDecompressResult>::run, workers[i]));
-            }
 
-            // Wait for results
+            // Run the workers in parallel (in the shared thread pool)
+            ThreadPool::instance().reserve(_jobs);
+            ThreadPool::instance().run(workers, results);
+
+            // Check results
             for (int i = 0; i < _jobs; i++) {
-                FileDecompressResult fdr = results[i].get();
-                res = fdr._code;
+                FileDecompressResult fdr = results[i];
                 read += fdr._read;
 
-                if (res != 0) {
+                if (fdr._code != 0) {
+                    res = fdr._code;
                     cerr << fdr._errMsg << endl;
-                    // Exit early by telling the workers that the queue is empty
-                    queue.clear();
                 }
             }
 
@@ -743,6 +785,8 @@ R FileDecompressWorker<T, R>::run()
 
         if (res != 0) {
             errMsg += result._errMsg;
+            // Exit early by telling the other workers that the queue is empty
+            _queue->clear();
         }
     }
 
@@ -111,6 +111,8 @@ namespace kanzi {
        string _transform;
        int _blockSize;
        int _jobs;
+       int64 _memoryLimit; // in bytes, 0 if none
+       string _pages; // memory pages of the big tables (NORMAL, THP or HUGE)
        OutputStream* _os;
        CompressedInputStream* _cis;
        vector<Listener*> _listeners;
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "BlockCompressor.hpp"
 #include "BlockDecompressor.hpp"
+#include "../Allocator.hpp"
 #include "../util.hpp"
 #include "../Error.hpp"
 
@@ -58,6 +59,12 @@ int processCommandLine(int argc, const char* argv[], map<string, string>& map)
     string strOverwrite = "false";
     string strChecksum = "false";
     string strSkip = "false";
+    string strIndex = "false";
+    string strSAIS = "false";
+    string strAuto = "";
+    string strSpeed = "";
+    string strMemory = "";
+    string strPages = "";
     string codec;
     string transf;
     int verbose = 1;
@@ -231,7 +238,9 @@ int processCommandLine(int argc, const char* argv[], map<string, string>& map)
                 log.println("        3=TEXT+ROLZX, 4=TEXT+BWT+RANK+ZRLT&ANS0, 5=TEXT+BWT+SRT+ZRLT&FPAQ", true);
                 log.println("        6=BWT&CM, 7=X86+RLT+TEXT&TPAQ, 8=X86+RLT+TEXT&TPAQX\n", true);
                 log.println("   -e, --entropy=<codec>", true);
-                log.println("        entropy codec [None|Huffman|ANS0|ANS1|Range|FPAQ|TPAQ|TPAQX|CM]", true);
+                log.println("        entropy codec [None|Huffman|HuffmanX|ANS0|ANS1|ANS0X|ANS1X|Range]", true);
+                log.println("                      [RangeX|FSE|FPAQ|TPAQ|TPAQX|CM] (HuffmanX/ANS0X/ANS1X/RangeX:", true);
+                log.println("                      multi-stream or interleaved, faster decoding)", true);
                 log.println("        (default is ANS0)\n", true);
                 log.println("   -t, --transform=<codec>", true);
                 log.println("        transform [None|BWT|BWTS|LZ|ROLZ|ROLZX|RLT|ZRLT|MTFT]", true);
@@ -241,11 +250,33 @@ int processCommandLine(int argc, const char* argv[], map<string, string>& map)
                 log.println("        enable block checksum\n", true);
                 log.println("   -s, --skip", true);
                 log.println("        copy blocks with high entropy instead of compressing them.\n", true);
+                log.println("   --index", true);
+                log.println("        append an index of the blocks to the compressed data", true);
+                log.println("        (allows random access to the decompressed data).\n", true);
+                log.println("   --sais", true);
+                log.println("        build the BWT/BWTS suffix arrays by induced sorting (SA-IS)", true);
+                log.println("        (linear time, faster than the default on highly repetitive data).\n", true);
+                log.println("   --auto[=<speed>]", true);
+                log.println("        select the transform and entropy codec of each block from its content", true);
+                log.println("        (best compression with an encoding speed of at least <speed> MB/s", true);
+                log.println("        per job, default is 10).\n", true);
+                log.println("   --speed=<speed>", true);
+                log.println("        same as --auto but the selection adapts to the measured encoding", true);
+                log.println("        speed to keep it above <speed> MB/s per job (faster pipelines when", true);
+                log.println("        too slow, better compression when there is headroom).\n", true);
             }
 
             log.println("   -j, --jobs=<jobs>", true);
             log.println("        maximum number of jobs the program may start concurrently", true);
-            log.println("        (default is 1, maximum is 64).\n", true);
+            log.println("        (default is 1, maximum is 64). The jobs run in a pool of threads", true);
+            log.println("        shared by all the stages (one per core, or one per job if more).\n", true);
+            log.println("   --memory=<limit>", true);
+            log.println("        maximum memory used by the (de)compression, EG: 512m or 2g", true);
+            log.println("        (fewer blocks processed concurrently and smaller TPAQ tables).\n", true);
+            log.println("   --pages=<normal|thp|huge>", true);
+            log.println("        memory pages of the big BWT, ROLZ and TPAQ tables: normal (default),", true);
+            log.println("        thp (transparent huge pages) or huge (reserved huge pages, thp if", true);
+            log.println("        none is available). Huge pages reduce the TLB misses (Linux only).\n", true);
             log.println("", true);
 
             if (mode.compare(0, 1, "d") != 0) {
@@ -298,6 +329,69 @@ int processCommandLine(int argc, const char* argv[], map<string, string>& map)
             continue;
         }
 
+        if (arg == "--index") {
+            if (ctx != -1) {
+                stringstream ss;
+                ss << "Warning: ignoring option [" << CMD_LINE_ARGS[ctx] << "] with no value.";
+                log.println(ss.str().c_str(), verbose > 0);
+            }
+
+            strIndex = "true";
+            ctx = -1;
+            continue;
+        }
+
+        if (arg == "--sais") {
+            if (ctx != -1) {
+                stringstream ss;
+                ss << "Warning: ignoring option [" << CMD_LINE_ARGS[ctx] << "] with no value.";
+                log.println(ss.str().c_str(), verbose > 0);
+            }
+
+            strSAIS = "true";
+            ctx = -1;
+            continue;
+        }
+
+        if ((arg == "--auto") || (arg.compare(0, 7, "--auto=") == 0)) {
+            if (ctx != -1) {
+                stringstream ss;
+                ss << "Warning: ignoring option [" << CMD_LINE_ARGS[ctx] << "] with no value.";
+                log.println(ss.str().c_str(), verbose > 0);
+            }
+
+            strAuto = (arg == "--auto") ? "10" : arg.substr(7);
+            strAuto = trim(strAuto);
+            const int speed = atoi(strAuto.c_str());
+
+            if ((speed < 0) || ((speed == 0) && (strAuto != "0"))) {
+                cerr << "Invalid speed provided on command line: " << arg << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            ctx = -1;
+            continue;
+        }
+
+        if (arg.compare(0, 8, "--speed=") == 0) {
+            if (ctx != -1) {
+                stringstream ss;
+                ss << "Warning: ignoring option [" << CMD_LINE_ARGS[ctx] << "] with no value.";
+                log.println(ss.str().c_str(), verbose > 0);
+            }
+
+            strSpeed = arg.substr(8);
+            strSpeed = trim(strSpeed);
+
+            if (atoi(strSpeed.c_str()) <= 0) {
+                cerr << "Invalid speed provided on command line: " << arg << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            ctx = -1;
+            continue;
+        }
+
         if ((arg == "--checksum") || (arg == "-x")) {
             if (ctx != -1) {
                 stringstream ss;
@@ -498,6 +592,70 @@ int processCommandLine(int argc, const char* argv[], map<string, string>& map)
             continue;
         }
 
+        if (arg.compare(0, 9, "--memory=") == 0) {
+            if (ctx != -1) {
+                stringstream ss;
+                ss << "Warning: ignoring option [" << CMD_LINE_ARGS[ctx] << "] with no value.";
+                log.println(ss.str().c_str(), verbose > 0);
+            }
+
+            string name = arg.substr(9);
+            name = trim(name);
+            transform(name.begin(), name.end(), name.begin(), ::toupper);
+            char lastChar = (name.length() == 0) ? ' ' : name[name.length() - 1];
+            int64 scale = 1;
+
+            // Process K or M or G suffix
+            if ('K' == lastChar)
+                scale = 1024;
+            else if ('M' == lastChar)
+                scale = 1024 * 1024;
+            else if ('G' == lastChar)
+                scale = 1024 * 1024 * 1024;
+
+            if (scale != 1)
+                name = name.substr(0, name.length() - 1);
+
+            bool valid = name.length() > 0;
+
+            for (size_t i = 0; i < name.length(); i++)
+                valid &= (name[i] >= '0') && (name[i] <= '9');
+
+            const int64 limit = (valid == true) ? scale * atoll(name.c_str()) : 0;
+
+            if (limit <= 0) {
+                cerr << "Invalid memory limit provided on command line: " << arg << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            stringstream ss;
+            ss << limit;
+            strMemory = ss.str();
+            ctx = -1;
+            continue;
+        }
+
+        if (arg.compare(0, 8, "--pages=") == 0) {
+            if (ctx != -1) {
+                stringstream ss;
+                ss << "Warning: ignoring option [" << CMD_LINE_ARGS[ctx] << "] with no value.";
+                log.println(ss.str().c_str(), verbose > 0);
+            }
+
+            string name = arg.substr(8);
+            name = trim(name);
+            transform(name.begin(), name.end(), name.begin(), ::toupper);
+
+            if (Allocator::getType(name) < 0) {
+                cerr << "Invalid memory pages provided on command line: " << arg << endl;
+                return Error::ERR_INVALID_PARAM;
+            }
+
+            strPages = name;
+            ctx = -1;
+            continue;
+        }
+
         if ((arg.compare(0, 10, "--verbose=") != 0) && (ctx == -1) && (arg.compare(0, 9, "--output=") != 0)) {
             stringstream ss;
             ss << "Warning: ignoring unknown option [" << arg << "]";
@@ -559,6 +717,24 @@ int processCommandLine(int argc, const char* argv[], map<string, string>& map)
     if (strSkip == "true")
         map["skipBlocks"] = strSkip;
 
+    if (strIndex == "true")
+        map["index"] = strIndex;
+
+    if (strSAIS == "true")
+        map["suffixSort"] = "SAIS";
+
+    if (strAuto.length() > 0)
+        map["autoPipeline"] = strAuto;
+
+    if (strSpeed.length() > 0)
+        map["targetSpeed"] = strSpeed;
+
+    if (strMemory.length() > 0)
+        map["memoryLimit"] = strMemory;
+
+    if (strPages.length() > 0)
+        map["pages"] = strPages;
+
     map["jobs"] = strTasks;
     return 0;
 }
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "DefaultInputBitStream.hpp"
 #include "../io/IOException.hpp"
+#include "../util.hpp"
 
 using namespace kanzi;
 
@@ -114,6 +115,56 @@ uint DefaultInputBitStream::readBits(byte bits[], uint count) THROW
     return count;
 }
 
+void DefaultInputBitStream::skip(uint64 count) THROW
+{
+    if (isClosed() == true)
+        throw BitStreamException("Stream closed", BitStreamException::STREAM_CLOSED);
+
+    if (count <= uint64(_availBits)) {
+        _availBits -= int(count);
+        return;
+    }
+
+    // Empty _current, then skip whole bytes in the buffer and the input stream
+    count -= uint64(_availBits);
+    _availBits = 0;
+    uint64 n = count >> 3;
+    const uint64 buffered = uint64(_maxPosition + 1 - _position);
+
+    if (n <= buffered) {
+        _position += int(n);
+    }
+    else {
+        n -= buffered;
+        _read += (uint64(_maxPosition + 1) << 3);
+        _position = 0;
+        _maxPosition = -1;
+        _is.ignore(streamsize(n));
+        _read += (uint64(_is.gcount()) << 3);
+
+        if (uint64(_is.gcount()) != n)
+            throw BitStreamException("No more data to read in the bitstream",
+                BitStreamException::END_OF_STREAM);
+    }
+
+    if ((count & 7) != 0)
+        readBits(uint(count & 7));
+}
+
+byte* DefaultInputBitStream::data(uint& bitIndex, uint64& size) const
+{
+    istreambuf<char>* buf = dynamic_cast<istreambuf<char>*>(_is.rdbuf());
+
+    if ((isClosed() == true) || (buf == nullptr))
+        return nullptr;
+
+    // The buffer holds the bytes just before the stream cursor
+    char* p = buf->current() - (_maxPosition + 1) + _position - ((_availBits + 7) >> 3);
+    bitIndex = uint(8 - (_availBits & 7)) & 7;
+    size = uint64(buf->current() + buf->available() - p);
+    return reinterpret_cast<byte*>(p);
+}
+
 void DefaultInputBitStream::close() THROW
 {
     if (isClosed() == true)
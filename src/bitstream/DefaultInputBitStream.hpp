@@ -53,6 +53,14 @@ namespace kanzi
 
        void close() THROW;
 
+       // Skip 'count' bits
+       void skip(uint64 count) THROW;
+
+       // Return the unread data when the stream reads from memory (istreambuf),
+       // nullptr otherwise. 'bitIndex' is the number of bits already read in the
+       // first byte and 'size' the number of bytes available.
+       byte* data(uint& bitIndex, uint64& size) const;
+
        // Number of bits read
        uint64 read() const
        {
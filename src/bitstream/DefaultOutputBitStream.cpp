@@ -114,9 +114,12 @@ void DefaultOutputBitStream::close() THROW
 
     try {
         // Push last bytes (the very last byte may be incomplete)
-        int size = ((64 - _availBits) + 7) >> 3;
-        pushCurrent();
-        _position -= (8 - size);
+        // Do not use pushCurrent() which may flush and reset the position
+        const int size = ((64 - _availBits) + 7) >> 3;
+        BigEndian::writeLong64(&_buffer[_position], _current);
+        _position += size;
+        _availBits = 64;
+        _current = 0;
         flush();
     }
     catch (BitStreamException& e) {
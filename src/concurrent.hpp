@@ -47,6 +47,13 @@ public:
 
 
 #ifdef CONCURRENCY_ENABLED
+	#include <algorithm>
+	#include <condition_variable>
+	#include <deque>
+	#include <exception>
+	#include <mutex>
+	#include <thread>
+	#include <vector>
 
 	template<class T>
 	class BoundedConcurrentQueue {
@@ -65,6 +72,270 @@ public:
 		T* _data;
 	};
 
+
+	// Process wide pool of threads shared by all the concurrent stages (files,
+	// blocks, BWT chunks). The threads are created on first use (one less than
+	// the number of cores) or when more jobs are requested (see reserve()), so
+	// that running tasks never requires creating threads.
+	// This is a FIFO pool with caller-runs, not a work stealing pool. Tasks are
+	// submitted in batches to a single queue, and the threads start the tasks of
+	// the oldest batch first, in order (some tasks wait for the previous ones to
+	// complete a step). Instead of blocking, the thread waiting for a batch runs
+	// the tasks of this batch not started yet, never the tasks of other batches:
+	// a thread picking up a later block would wait for a block below it on its
+	// own stack. Hence nested batches cannot deadlock and the number of running
+	// tasks is bounded by the size of the pool, whatever the nesting.
+	class ThreadPool {
+	private:
+		class Batch {
+		public:
+			Batch(int size) { _size = size; _next = 0; _done = 0; }
+
+			virtual ~Batch() {}
+
+			virtual void execute(int idx) = 0;
+
+			int _size;
+			int _next; // protected by the mutex of the pool
+			int _done;
+			mutex _mutex;
+			condition_variable _cond;
+		};
+
+		template <class T, class R>
+		class TaskBatch : public Batch {
+		public:
+			TaskBatch(const vector<T*>& tasks, vector<R>& results)
+				: Batch(int(tasks.size()))
+				, _tasks(tasks)
+				, _results(results)
+				, _errors(tasks.size())
+			{
+			}
+
+			void execute(int idx)
+			{
+				try {
+					_results[idx] = _tasks[idx]->run();
+				}
+				catch (...) {
+					_errors[idx] = current_exception();
+				}
+			}
+
+			const vector<T*>& _tasks;
+			vector<R>& _results;
+			vector<exception_ptr> _errors;
+		};
+
+	public:
+		// Handle on a task scheduled in the pool (see schedule())
+		template <class T, class R>
+		class Future {
+			friend class ThreadPool;
+
+		public:
+			~Future() { _pool->wait(_batch); }
+
+			// Wait for the completion of the task (run it in the calling thread
+			// if it has not been started yet) and return its result. Rethrow the
+			// exception raised by the task (if any).
+			R get()
+			{
+				_pool->wait(_batch);
+
+				if (_batch._errors[0] != nullptr)
+					rethrow_exception(_batch._errors[0]);
+
+				return _results[0];
+			}
+
+		private:
+			ThreadPool* _pool;
+			vector<T*> _tasks;
+			vector<R> _results;
+			TaskBatch<T, R> _batch;
+
+			Future(ThreadPool* pool, T* task)
+				: _pool(pool)
+				, _tasks(1, task)
+				, _results(1)
+				, _batch(_tasks, _results)
+			{
+			}
+
+			Future(const Future&);
+
+			Future& operator=(const Future&);
+		};
+
+		static ThreadPool& instance()
+		{
+			// The calling thread also runs tasks
+			static ThreadPool pool(max(int(thread::hardware_concurrency()), 1) - 1);
+			return pool;
+		}
+
+		~ThreadPool()
+		{
+			{
+				lock_guard<mutex> lock(_mutex);
+				_stop = true;
+			}
+
+			_cond.notify_all();
+
+			for (size_t i = 0; i < _threads.size(); i++)
+				_threads[i].join();
+		}
+
+		// Number of tasks that can run concurrently (the calling thread included)
+		int size()
+		{
+			lock_guard<mutex> lock(_mutex);
+			return int(_threads.size()) + 1;
+		}
+
+		// Grow the pool so that 'jobs' tasks can run concurrently (the pool is
+		// never shrunk). Called with the number of jobs requested by the user,
+		// which may exceed the number of cores.
+		void reserve(int jobs)
+		{
+			lock_guard<mutex> lock(_mutex);
+
+			while (int(_threads.size()) < jobs - 1)
+				_threads.push_back(thread(&ThreadPool::work, this));
+		}
+
+		// Run the tasks and return the results in task order. Once all tasks
+		// have completed, rethrow the first exception raised by a task (if any).
+		template <class T, class R>
+		void run(const vector<T*>& tasks, vector<R>& results)
+		{
+			results.resize(tasks.size());
+			TaskBatch<T, R> batch(tasks, results);
+			submit(batch);
+			wait(batch);
+
+			for (size_t i = 0; i < batch._errors.size(); i++) {
+				if (batch._errors[i] != nullptr)
+					rethrow_exception(batch._errors[i]);
+			}
+		}
+
+		// Start the task asynchronously. Tasks scheduled by a thread are started
+		// in scheduling order as long as their futures are waited for in the same
+		// order (a future waited for runs its task if no thread has started it).
+		// The caller owns the returned future.
+		template <class R, class T>
+		Future<T, R>* schedule(T* task)
+		{
+			Future<T, R>* future = new Future<T, R>(this, task);
+			submit(future->_batch);
+			return future;
+		}
+
+	private:
+		vector<thread> _threads;
+		deque<Batch*> _batches; // batches with tasks not started yet
+		mutex _mutex;
+		condition_variable _cond;
+		bool _stop;
+
+		ThreadPool(int nbThreads)
+		{
+			_stop = false;
+
+			for (int i = 0; i < nbThreads; i++)
+				_threads.push_back(thread(&ThreadPool::work, this));
+		}
+
+		ThreadPool(const ThreadPool&);
+
+		ThreadPool& operator=(const ThreadPool&);
+
+		// Must be called with the mutex of the pool locked
+		int next(Batch* b)
+		{
+			const int idx = b->_next++;
+
+			if (b->_next == b->_size)
+				_batches.erase(find(_batches.begin(), _batches.end(), b));
+
+			return idx;
+		}
+
+		static void complete(Batch* b, int idx)
+		{
+			b->execute(idx);
+			lock_guard<mutex> lock(b->_mutex);
+
+			if (++b->_done == b->_size)
+				b->_cond.notify_all();
+		}
+
+		void submit(Batch& b)
+		{
+			if (b._size == 0)
+				return;
+
+			{
+				lock_guard<mutex> lock(_mutex);
+				_batches.push_back(&b);
+			}
+
+			_cond.notify_all();
+		}
+
+		void wait(Batch& b)
+		{
+			// Run the tasks not picked by the threads of the pool
+			while (true) {
+				int idx;
+
+				{
+					lock_guard<mutex> lock(_mutex);
+
+					if (b._next == b._size)
+						break;
+
+					idx = next(&b);
+				}
+
+				complete(&b, idx);
+			}
+
+			unique_lock<mutex> lock(b._mutex);
+
+			while (b._done != b._size)
+				b._cond.wait(lock);
+		}
+
+		void work()
+		{
+			while (true) {
+				Batch* b;
+				int idx;
+
+				{
+					unique_lock<mutex> lock(_mutex);
+
+					while ((_stop == false) && (_batches.empty() == true))
+						_cond.wait(lock);
+
+					if (_batches.empty() == true)
+						return;
+
+					// Oldest batch first
+					b = _batches.front();
+					idx = next(b);
+				}
+
+				complete(b, idx);
+			}
+		}
+	};
+
 #elif (__cplusplus && __cplusplus < 201103L) || (_MSC_VER && _MSC_VER < 1700)
 	// ! Stubs for NON CONCURRENT USAGE !
 	// Used to compile and provide a non concurrent version AND
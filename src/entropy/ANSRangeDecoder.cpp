@@ -16,13 +16,41 @@ limitations under the License.
 #include <sstream>
 #include "ANSRangeDecoder.hpp"
 #include "EntropyUtils.hpp"
+#include "ParallelChunks.hpp"
+
+#if defined(__SSE4_1__)
+   #include <smmintrin.h>
+#endif
 
 using namespace kanzi;
 
+#if defined(__SSE4_1__)
+// Move the next 16 bit words of the stream (big endian) to the lanes to
+// renormalize (one bit per lane in the index), in lane order
+static const int8 RENORM_SHUFFLES[16][16] = {
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    {  1,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1,  1,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    {  1,  0, -1, -1,  3,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1,  1,  0, -1, -1, -1, -1, -1, -1 },
+    {  1,  0, -1, -1, -1, -1, -1, -1,  3,  2, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1,  1,  0, -1, -1,  3,  2, -1, -1, -1, -1, -1, -1 },
+    {  1,  0, -1, -1,  3,  2, -1, -1,  5,  4, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  0, -1, -1 },
+    {  1,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  3,  2, -1, -1 },
+    { -1, -1, -1, -1,  1,  0, -1, -1, -1, -1, -1, -1,  3,  2, -1, -1 },
+    {  1,  0, -1, -1,  3,  2, -1, -1, -1, -1, -1, -1,  5,  4, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1,  1,  0, -1, -1,  3,  2, -1, -1 },
+    {  1,  0, -1, -1, -1, -1, -1, -1,  3,  2, -1, -1,  5,  4, -1, -1 },
+    { -1, -1, -1, -1,  1,  0, -1, -1,  3,  2, -1, -1,  5,  4, -1, -1 },
+    {  1,  0, -1, -1,  3,  2, -1, -1,  5,  4, -1, -1,  7,  6, -1, -1 }
+};
+#endif
+
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats. 0 means that frequencies calculated at the
 // beginning of the block apply to the whole block.
-ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunkSize) THROW : _bitstream(bitstream)
+ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunkSize, bool interleaved, int jobs) THROW : _bitstream(bitstream)
 {
     if ((order != 0) && (order != 1))
         throw invalid_argument("ANS Codec: The order must be 0 or 1");
@@ -36,11 +64,24 @@ ANSRangeDecoder::ANSRangeDecoder(InputBitStream& bitstream, int order, int chunk
         throw invalid_argument(ss.str());
     }
 
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "ANS Codec: Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
     if (chunkSize == -1)
         chunkSize = DEFAULT_ANS0_CHUNK_SIZE << (8 * order);
 
     _chunkSize = chunkSize;
     _order = order;
+    _interleaved = interleaved;
+    _jobs = jobs;
     const int dim = 255 * order + 1;
     _alphabet = new uint[dim * 256];
     _freqs = new uint[dim * 256];
@@ -173,12 +214,15 @@ int ANSRangeDecoder::decode(byte block[], uint blkptr, uint len)
     if (sz > MAX_CHUNK_SIZE)
         sz = MAX_CHUNK_SIZE;
 
+    if ((_jobs > 0) && (len > uint(sz)) && (ParallelChunks::readLayout(_bitstream) == true))
+        return ParallelChunks::decode(*this, _bitstream, block, blkptr, len, sz, _jobs);
+
     int startChunk = blkptr;
 
     if (_bufferSize < uint(sz + (sz >> 3))) {
         delete[] _buffer;
         _bufferSize = uint(sz + (sz >> 3));
-        _buffer = new byte[_bufferSize];
+        _buffer = new byte[_bufferSize + STREAM_PADDING];
     }
 
     while (startChunk < end) {
@@ -195,6 +239,27 @@ int ANSRangeDecoder::decode(byte block[], uint blkptr, uint len)
 
 void ANSRangeDecoder::decodeChunk(byte block[], int end)
 {
+    if (_interleaved == true) {
+        // Read number of states
+        switch (_bitstream.readBits(2)) {
+        case 0:
+            decodeLanes<4>(block, end);
+            return;
+
+        case 1:
+            decodeLanes<8>(block, end);
+            return;
+
+        case 2:
+            decodeLanes<16>(block, end);
+            return;
+
+        default:
+            decodeLanes<32>(block, end);
+            return;
+        }
+    }
+
     // Read chunk size
     const int sz = int(EntropyUtils::readVarInt(_bitstream) & (MAX_CHUNK_SIZE - 1));
 
@@ -231,3 +296,137 @@ void ANSRangeDecoder::decodeChunk(byte block[], int end)
         }
     }
 }
+
+#if defined(__SSE4_1__)
+// Order 0, 4 lanes at a time: the states of the lanes are updated together
+// and the lanes to renormalize take their 16 bit words from the stream in
+// lane order (with a shuffle), as the scalar code does. Faster than the
+// scalar lanes from 8 lanes on (slower with 4 lanes, and with order 1).
+// Return the number of symbols decoded per lane.
+template <int N>
+int ANSRangeDecoder::decodeLanesSIMD(byte block[], int laneSize, uint8*& p, int st[])
+{
+    const int mask = (1 << _logRange) - 1;
+    const __m128i vmask = _mm_set1_epi32(mask);
+    const __m128i vtop = _mm_set1_epi32(ANS_TOP);
+    const __m128i vone = _mm_set1_epi32(1);
+    const __m128i vlog = _mm_cvtsi32_si128(_logRange);
+
+    for (int i = 0; i < laneSize; i++) {
+        for (int k = 0; k < N; k += 4) {
+            const __m128i vx = _mm_loadu_si128((const __m128i*)&st[k]);
+            const uint8 cur0 = uint8(_f2s[st[k] & mask]);
+            const uint8 cur1 = uint8(_f2s[st[k + 1] & mask]);
+            const uint8 cur2 = uint8(_f2s[st[k + 2] & mask]);
+            const uint8 cur3 = uint8(_f2s[st[k + 3] & mask]);
+            block[k * laneSize + i] = byte(cur0);
+            block[(k + 1) * laneSize + i] = byte(cur1);
+            block[(k + 2) * laneSize + i] = byte(cur2);
+            block[(k + 3) * laneSize + i] = byte(cur3);
+            const __m128i vcum = _mm_setr_epi32(_symbols[cur0]._cumFreq, _symbols[cur1]._cumFreq,
+                _symbols[cur2]._cumFreq, _symbols[cur3]._cumFreq);
+            const __m128i vfreq = _mm_setr_epi32(_symbols[cur0]._freq, _symbols[cur1]._freq,
+                _symbols[cur2]._freq, _symbols[cur3]._freq);
+
+            // Compute next ANS states
+            __m128i vst = _mm_mullo_epi32(vfreq, _mm_srl_epi32(vx, vlog));
+            vst = _mm_sub_epi32(_mm_add_epi32(vst, _mm_and_si128(vx, vmask)), vcum);
+
+            // Normalize
+            const __m128i vlt = _mm_cmpgt_epi32(vtop, vst);
+            const int bits = _mm_movemask_ps(_mm_castsi128_ps(vlt));
+
+            if (bits == 0) {
+                _mm_storeu_si128((__m128i*)&st[k], vst);
+                continue;
+            }
+
+            if (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(vone, vst))) == 0) {
+                // One 16 bit word per lane is enough (state >= 1)
+                const __m128i vw = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)p),
+                    _mm_loadu_si128((const __m128i*)RENORM_SHUFFLES[bits]));
+                vst = _mm_blendv_epi8(vst, _mm_or_si128(_mm_slli_epi32(vst, 16), vw), vlt);
+                _mm_storeu_si128((__m128i*)&st[k], vst);
+                p += 2 * ((bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + (bits >> 3));
+                continue;
+            }
+
+            // A state below 1 (invalid stream) may need more words
+            _mm_storeu_si128((__m128i*)&st[k], vst);
+
+            for (int j = k; j < k + 4; j++) {
+                while (st[j] < ANS_TOP) {
+                    st[j] = (st[j] << 8) | (*p++);
+                    st[j] = (st[j] << 8) | (*p++);
+                }
+            }
+        }
+    }
+
+    return laneSize;
+}
+#endif
+
+// See ANSRangeEncoder::encodeLanes()
+template <int N>
+void ANSRangeDecoder::decodeLanes(byte block[], int end)
+{
+    // Read chunk size
+    const int sz = int(EntropyUtils::readVarInt(_bitstream) & (MAX_CHUNK_SIZE - 1));
+
+    // Read initial ANS states
+    int st[N];
+
+    for (int k = 0; k < N; k++)
+        st[k] = int(_bitstream.readBits(32));
+
+    // Read bit buffer
+    if (sz != 0)
+        _bitstream.readBits(&_buffer[0], 8 * sz);
+
+    uint8* p = (uint8*)&_buffer[0];
+    const int mask = (1 << _logRange) - 1;
+    const int laneSize = end / N;
+
+    if (_order == 0) {
+        int i = 0;
+
+#if defined(__SSE4_1__)
+        if (N >= 8)
+            i = decodeLanesSIMD<N>(block, laneSize, p, st);
+#endif
+
+        for (; i < laneSize; i++) {
+            for (int k = 0; k < N; k++) {
+                const uint8 cur = uint8(_f2s[st[k] & mask]);
+                block[k * laneSize + i] = byte(cur);
+                st[k] = decodeSymbol(p, st[k], _symbols[cur], mask);
+            }
+        }
+
+        for (int i = N * laneSize; i < end; i++) {
+            const uint8 cur = uint8(_f2s[st[N - 1] & mask]);
+            block[i] = byte(cur);
+            st[N - 1] = decodeSymbol(p, st[N - 1], _symbols[cur], mask);
+        }
+    }
+    else {
+        int prv[N] = { 0 };
+
+        for (int i = 0; i < laneSize; i++) {
+            for (int k = 0; k < N; k++) {
+                const uint8 cur = uint8(_f2s[(prv[k] << _logRange) + (st[k] & mask)]);
+                block[k * laneSize + i] = byte(cur);
+                st[k] = decodeSymbol(p, st[k], _symbols[(prv[k] << 8) | cur], mask);
+                prv[k] = cur;
+            }
+        }
+
+        for (int i = N * laneSize; i < end; i++) {
+            const uint8 cur = uint8(_f2s[(prv[N - 1] << _logRange) + (st[N - 1] & mask)]);
+            block[i] = byte(cur);
+            st[N - 1] = decodeSymbol(p, st[N - 1], _symbols[(prv[N - 1] << 8) | cur], mask);
+            prv[N - 1] = cur;
+        }
+    }
+}
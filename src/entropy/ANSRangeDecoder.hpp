@@ -25,6 +25,9 @@ using namespace std;
 // See "Asymmetric Numeral System" by Jarek Duda at http://arxiv.org/abs/0902.0271
 // Some code has been ported from https://github.com/rygorous/ryg_rans
 // For an alternate C implementation example, see https://github.com/Cyan4973/FiniteStateEntropy
+// In interleaved mode, the number of states is read for each chunk.
+// With 'jobs' > 0, the chunks of a block are decoded concurrently (chunked
+// layout, see ParallelChunks). 0 selects the sequential layout.
 
 namespace kanzi
 {
@@ -51,7 +54,9 @@ namespace kanzi
    public:
 	   static const int ANS_TOP = 1 << 15; // max possible for ANS_TOP=1<23
 
-	   ANSRangeDecoder(InputBitStream& bitstream, int order = 0, int chunkSize = -1) THROW;
+	   // 'interleaved' must match the number of states of the encoder (1 or more)
+	   ANSRangeDecoder(InputBitStream& bitstream, int order = 0, int chunkSize = -1, bool interleaved = false,
+	      int jobs = 0) THROW;
 
 	   ~ANSRangeDecoder();
 
@@ -61,10 +66,16 @@ namespace kanzi
 
 	   void dispose() {};
 
+	   // Decoder of the chunks in the chunked layout
+	   ANSRangeDecoder* newChunkDecoder(InputBitStream& bitstream) const
+	   {
+	       return new ANSRangeDecoder(bitstream, _order, _chunkSize, _interleaved);
+	   }
    private:
 	   static const int DEFAULT_ANS0_CHUNK_SIZE = 1 << 15; // 32 KB by default
 	   static const int DEFAULT_LOG_RANGE = 12;
 	   static const int MAX_CHUNK_SIZE = 1 << 27; // 8*MAX_CHUNK_SIZE must not overflow
+	   static const int STREAM_PADDING = 8; // bytes the SIMD lanes may read past the end
 
 	   InputBitStream& _bitstream;
 	   uint* _alphabet;
@@ -77,9 +88,19 @@ namespace kanzi
 	   uint _chunkSize;
 	   uint _order;
 	   uint _logRange;
+	   bool _interleaved;
+	   int _jobs;
 
 	   void decodeChunk(byte block[], int end);
 
+	   template <int N>
+	   void decodeLanes(byte block[], int end);
+
+#if defined(__SSE4_1__)
+	   template <int N>
+	   int decodeLanesSIMD(byte block[], int laneSize, uint8*& p, int st[]);
+#endif
+
 	   int decodeSymbol(uint8*& p, int& st, const ANSDecSymbol& sym, const int mask);
 
 	   int decodeHeader(uint frequencies[]);
@@ -16,6 +16,7 @@ limitations under the License.
 #include <sstream>
 #include "ANSRangeEncoder.hpp"
 #include "EntropyUtils.hpp"
+#include "ParallelChunks.hpp"
 #include "../Global.hpp"
 
 using namespace kanzi;
@@ -23,7 +24,7 @@ using namespace kanzi;
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats. 0 means that frequencies calculated at the
 // beginning of the block apply to the whole block.
-ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chunkSize, int logRange) THROW : _bitstream(bitstream)
+ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chunkSize, int logRange, int nbStates, int jobs) THROW : _bitstream(bitstream)
 {
     if ((order != 0) && (order != 1))
         throw invalid_argument("ANS Codec: The order must be 0 or 1");
@@ -43,10 +44,29 @@ ANSRangeEncoder::ANSRangeEncoder(OutputBitStream& bitstream, int order, int chun
         throw invalid_argument(ss.str());
     }
 
+    if ((nbStates != 1) && (nbStates != 4) && (nbStates != 8) && (nbStates != 16) && (nbStates != 32)) {
+        stringstream ss;
+        ss << "ANS Codec: Invalid number of states: " << nbStates << " (must be 1, 4, 8, 16 or 32)";
+        throw invalid_argument(ss.str());
+    }
+
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "ANS Codec: Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
     if (chunkSize == -1)
         chunkSize = DEFAULT_ANS0_CHUNK_SIZE << (8 * order);
 
     _order = order;
+    _nbStates = nbStates;
+    _jobs = jobs;
     const int32 dim = 255 * order + 1;
     _alphabet = new uint[dim * 256];
     _freqs = new uint[dim * 257]; // freqs[x][256] = total(freqs[x][0..255])
@@ -149,6 +169,9 @@ int ANSRangeEncoder::encode(byte block[], uint blkptr, uint len)
     if (sz > MAX_CHUNK_SIZE)
         sz = MAX_CHUNK_SIZE;
 
+    if ((_jobs > 0) && (len > uint(sz)) && (ParallelChunks::writeLayout(_bitstream, _jobs) == true))
+        return ParallelChunks::encode(*this, _bitstream, block, blkptr, len, sz, _jobs);
+
     int startChunk = blkptr;
 
     if (_bufferSize < uint(sz + (sz >> 3))) {
@@ -175,6 +198,46 @@ int ANSRangeEncoder::encode(byte block[], uint blkptr, uint len)
 
 void ANSRangeEncoder::encodeChunk(byte block[], int end)
 {
+    if (_nbStates > 1) {
+        const uint8* data = (uint8*) &block[0];
+        byte* p0 = &_buffer[_bufferSize - 1];
+        byte* p = p0;
+        int st[32];
+        uint logStates = 2;
+
+        while (uint(1 << logStates) < _nbStates)
+            logStates++;
+
+        switch (_nbStates) {
+        case 4:
+            p = encodeLanes<4>(data, end, p, st);
+            break;
+
+        case 8:
+            p = encodeLanes<8>(data, end, p, st);
+            break;
+
+        case 16:
+            p = encodeLanes<16>(data, end, p, st);
+            break;
+
+        default:
+            p = encodeLanes<32>(data, end, p, st);
+        }
+
+        // Write number of states, chunk size and final ANS states
+        _bitstream.writeBits(logStates - 2, 2);
+        EntropyUtils::writeVarInt(_bitstream, uint32(p0 - p));
+
+        for (uint k = 0; k < _nbStates; k++)
+            _bitstream.writeBits(st[k], 32);
+
+        if (p != p0)
+            _bitstream.writeBits(&p[1], 8 * uint(p0 - p));
+
+        return;
+    }
+
     int st = ANS_TOP;
     const uint8* data = (uint8*) &block[0];
     byte* p0 = &_buffer[_bufferSize - 1];
@@ -210,10 +273,69 @@ void ANSRangeEncoder::encodeChunk(byte block[], int end)
     }
 }
 
+// Encode N lanes of end/N symbols (the last lane also gets the remaining
+// symbols) in reverse order of decoding: the lanes are interleaved symbol
+// by symbol, starting from the end. The first symbol of a lane has context 0.
+template <int N>
+byte* ANSRangeEncoder::encodeLanes(const uint8 data[], int end, byte* p, int st[])
+{
+    const int laneSize = end / N;
+    const int lastStart = (N - 1) * laneSize;
+
+    for (int k = 0; k < N; k++)
+        st[k] = ANS_TOP;
+
+    if (_order == 0) {
+        for (int i = end - 1; i >= N * laneSize; i--)
+            st[N - 1] = encodeSymbol(p, st[N - 1], _symbols[data[i]]);
+
+        for (int i = laneSize - 1; i >= 0; i--) {
+            for (int k = N - 1; k >= 0; k--)
+                st[k] = encodeSymbol(p, st[k], _symbols[data[k * laneSize + i]]);
+        }
+    }
+    else { // order 1
+        for (int i = end - 1; i >= N * laneSize; i--) {
+            const int prv = (i == lastStart) ? 0 : int(data[i - 1]);
+            st[N - 1] = encodeSymbol(p, st[N - 1], _symbols[(prv << 8) | int(data[i])]);
+        }
+
+        for (int i = laneSize - 1; i > 0; i--) {
+            for (int k = N - 1; k >= 0; k--) {
+                const int idx = k * laneSize + i;
+                st[k] = encodeSymbol(p, st[k], _symbols[(int(data[idx - 1]) << 8) | int(data[idx])]);
+            }
+        }
+
+        if (laneSize > 0) {
+            for (int k = N - 1; k >= 0; k--)
+                st[k] = encodeSymbol(p, st[k], _symbols[data[k * laneSize]]);
+        }
+    }
+
+    return p;
+}
+
 // Compute chunk frequencies, cumulated frequencies and encode chunk header
 int ANSRangeEncoder::rebuildStatistics(byte block[], int end, int lr)
 {
     Global::computeHistogram(block, end, _freqs, _order == 0, true);
+
+    if ((_order == 1) && (_nbStates > 1)) {
+        // The first symbol of each lane has context 0 (see encodeLanes())
+        const uint8* data = (uint8*) &block[0];
+        const int laneSize = end / _nbStates;
+
+        for (uint k = 1; (k < _nbStates) && (laneSize > 0); k++) {
+            const int idx = k * laneSize;
+            const uint prv = 257 * uint(data[idx - 1]);
+            _freqs[prv + data[idx]]--;
+            _freqs[prv + 256]--;
+            _freqs[data[idx]]++;
+            _freqs[256]++;
+        }
+    }
+
     return updateFrequencies(_freqs, lr);
 }
 
@@ -24,6 +24,11 @@ using namespace std;
 // See "Asymmetric Numeral System" by Jarek Duda at http://arxiv.org/abs/0902.0271
 // Some code has been ported from https://github.com/rygorous/ryg_rans
 // For an alternate C implementation example, see https://github.com/Cyan4973/FiniteStateEntropy
+// With several states, each chunk is split into as many lanes, each one coded
+// by its own state (interleaved in the output). The decoding of the lanes is
+// independent and can overlap in the CPU.
+// With 'jobs' > 0, the chunks of a block are coded concurrently (chunked layout,
+// see ParallelChunks). 0 selects the sequential layout.
 
 namespace kanzi
 {
@@ -56,11 +61,16 @@ namespace kanzi
    {
    public:
 	   static const int ANS_TOP = 1 << 15; // max possible for ANS_TOP=1<23
+	   static const int DEFAULT_LOG_RANGE = 12;
+	   static const int DEFAULT_INTERLEAVED_STATES = 4;
 
+	   // 'nbStates' is 1 (legacy bitstream) or 4, 8, 16 or 32 (interleaved)
 	   ANSRangeEncoder(OutputBitStream& bitstream,
                       int order = 0,
                       int chunkSize = -1,
-                      int logRange = DEFAULT_LOG_RANGE) THROW;
+                      int logRange = DEFAULT_LOG_RANGE,
+                      int nbStates = 1,
+                      int jobs = 0) THROW;
 
 	   ~ANSRangeEncoder();
 
@@ -72,10 +82,14 @@ namespace kanzi
 
 	   void dispose() {};
 
+	   // Encoder of the chunks in the chunked layout
+	   ANSRangeEncoder* newChunkEncoder(OutputBitStream& bitstream) const
+	   {
+	       return new ANSRangeEncoder(bitstream, _order, _chunkSize, _logRange, _nbStates);
+	   }
 
    private:
 	   static const int DEFAULT_ANS0_CHUNK_SIZE = 1 << 15; // 32 KB by default
-	   static const int DEFAULT_LOG_RANGE = 12;
 	   static const int MAX_CHUNK_SIZE = 1 << 27; // 8*MAX_CHUNK_SIZE must not overflow
 
 	   uint* _alphabet;
@@ -87,12 +101,17 @@ namespace kanzi
 	   uint _chunkSize;
 	   uint _logRange;
 	   uint _order;
+	   uint _nbStates;
+	   int _jobs;
 
 
 	   int rebuildStatistics(byte block[], int end, int lr);
 
 	   void encodeChunk(byte block[], int end);
 
+	   template <int N>
+	   byte* encodeLanes(const uint8 data[], int end, byte* p, int st[]);
+
 	   int encodeSymbol(byte*& p, int& st, const ANSEncSymbol& sym);
 
 	   bool encodeHeader(int alphabetSize, uint alphabet[], uint frequencies[], int lr);
@@ -82,8 +82,12 @@ namespace kanzi {
 
        int get(int bit, int pr, int ctx);
 
+       // Restore the initial state
+       void reset();
+
    private:
        int _index; // last p, context
+       int _size; // number of contexts
        uint16* _data; // [NbCtx][33]:  p, context -> p
    };
 
@@ -91,13 +95,20 @@ namespace kanzi {
    inline LogisticAdaptiveProbMap<RATE>::LogisticAdaptiveProbMap(int n)
    {
        _data = new uint16[33 * n];
+       _size = n;
+       reset();
+   }
+
+   template <int RATE>
+   inline void LogisticAdaptiveProbMap<RATE>::reset()
+   {
        _index = 0;
 
        for (int j = 0; j <= 32; j++) {
            _data[j] = uint16(Global::squash((j - 16) << 7)) << 4;
        }
 
-       for (int i = 1; i < n; i++) {
+       for (int i = 1; i < _size; i++) {
            memcpy(&_data[i * 33], &_data[0], 33 * sizeof(uint16));
        }
    }
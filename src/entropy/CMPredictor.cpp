@@ -20,6 +20,11 @@ limitations under the License.
 using namespace kanzi;
 
 CMPredictor::CMPredictor()
+{
+    reset();
+}
+
+void CMPredictor::reset()
 {
     _ctx = 1;
     _run = 1;
@@ -45,6 +45,9 @@ namespace kanzi
 
        ~CMPredictor(){};
 
+       // Restore the initial state (to reuse the predictor for another block)
+       void reset();
+
        void update(int bit);
 
        int get();
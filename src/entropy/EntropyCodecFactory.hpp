@@ -24,6 +24,8 @@ limitations under the License.
 #include "BinaryEntropyEncoder.hpp"
 #include "ExpGolombDecoder.hpp"
 #include "ExpGolombEncoder.hpp"
+#include "FSEDecoder.hpp"
+#include "FSEEncoder.hpp"
 #include "HuffmanDecoder.hpp"
 #include "HuffmanEncoder.hpp"
 #include "NullEntropyDecoder.hpp"
@@ -52,44 +54,81 @@ namespace kanzi {
        static const short TPAQ_TYPE = 7; // Tangelo PAQ
        static const short ANS1_TYPE = 8; // Asymmetric Numerical System order 1
        static const short TPAQX_TYPE = 9; // Tangelo PAQ Extra
-
-       static EntropyDecoder* newDecoder(InputBitStream& ibs, Context& ctx, short entropyType) THROW;
-
-       static EntropyEncoder* newEncoder(OutputBitStream& obs, Context& ctx, short entropyType) THROW;
+       static const short ANS0X_TYPE = 10; // Interleaved ANS order 0
+       static const short ANS1X_TYPE = 11; // Interleaved ANS order 1
+       static const short HUFFMANX_TYPE = 12; // Multi-stream Huffman
+       static const short FSE_TYPE = 13; // Tabled ANS (Finite State Entropy)
+       static const short RANGEX_TYPE = 14; // Interleaved Range
+
+       // If 'predictor' is provided, the binary entropy codecs reuse (after a reset)
+       // the predictor it points to when it has the right type, saving the
+       // allocation and initialization of the model for each block. The predictor
+       // of the codec is stored in 'predictor' and is owned by the caller.
+       static EntropyDecoder* newDecoder(InputBitStream& ibs, Context& ctx, short entropyType,
+           Predictor** predictor = nullptr) THROW;
+
+       static EntropyEncoder* newEncoder(OutputBitStream& obs, Context& ctx, short entropyType,
+           Predictor** predictor = nullptr) THROW;
+
+       // Return a predictor for the binary entropy codecs (the provided predictor
+       // after a reset if it has the right type, else a new one).
+       static Predictor* newPredictor(Context& ctx, short entropyType, Predictor* predictor = nullptr) THROW;
 
        static const char* getName(short entropyType) THROW;
 
        static short getType(const char* name) THROW;
+
+       // Approximate memory used to encode or decode a block (not including
+       // the block itself). The big model tables are divided by 2^modelShrink.
+       static int64 getMemoryFootprint(short entropyType, int blockSize, int modelShrink = 0);
    };
 
-   inline EntropyDecoder* EntropyCodecFactory::newDecoder(InputBitStream& ibs, Context& ctx, short entropyType) THROW
+   inline EntropyDecoder* EntropyCodecFactory::newDecoder(InputBitStream& ibs, Context& ctx, short entropyType,
+       Predictor** predictor) THROW
    {
+       // The chunks of a block are coded in the chunked layout (see ParallelChunks)
+       // since the bitstream version 12
+       const int jobs = (ctx.getInt("bsVersion", 12) >= 12) ? ctx.getInt("jobs", 1) : 0;
+
        switch (entropyType) {
        // Each block is decoded separately
        // Rebuild the entropy decoder to reset block statistics
        case HUFFMAN_TYPE:
-           return new HuffmanDecoder(ibs);
+           return new HuffmanDecoder(ibs, HuffmanCommon::MAX_CHUNK_SIZE, false, jobs);
+
+       case HUFFMANX_TYPE:
+           return new HuffmanDecoder(ibs, HuffmanCommon::MAX_CHUNK_SIZE, true, jobs);
 
        case ANS0_TYPE:
-           return new ANSRangeDecoder(ibs, 0);
+           return new ANSRangeDecoder(ibs, 0, -1, false, jobs);
 
        case ANS1_TYPE:
-           return new ANSRangeDecoder(ibs, 1);
+           return new ANSRangeDecoder(ibs, 1, -1, false, jobs);
+
+       case ANS0X_TYPE:
+           return new ANSRangeDecoder(ibs, 0, -1, true, jobs);
+
+       case ANS1X_TYPE:
+           return new ANSRangeDecoder(ibs, 1, -1, true, jobs);
 
        case RANGE_TYPE:
-           return new RangeDecoder(ibs);
+           return new RangeDecoder(ibs, RangeDecoder::DEFAULT_CHUNK_SIZE, false, jobs);
 
-       case FPAQ_TYPE:
-           return new BinaryEntropyDecoder(ibs, new FPAQPredictor());
+       case RANGEX_TYPE:
+           return new RangeDecoder(ibs, RangeDecoder::DEFAULT_CHUNK_SIZE, true, jobs);
+
+       case FSE_TYPE:
+           return new FSEDecoder(ibs, -1, jobs);
 
+       case FPAQ_TYPE:
        case CM_TYPE:
-           return new BinaryEntropyDecoder(ibs, new CMPredictor());
+       case TPAQ_TYPE:
+       case TPAQX_TYPE:
+           if (predictor == nullptr)
+               return new BinaryEntropyDecoder(ibs, newPredictor(ctx, entropyType));
 
-       case TPAQ_TYPE: 
-           return new BinaryEntropyDecoder(ibs, new TPAQPredictor<false>(&ctx));
-       
-       case TPAQX_TYPE: 
-           return new BinaryEntropyDecoder(ibs, new TPAQPredictor<true>(&ctx));
+           *predictor = newPredictor(ctx, entropyType, *predictor);
+           return new BinaryEntropyDecoder(ibs, *predictor, false);
 
        case NONE_TYPE:
            return new NullEntropyDecoder(ibs);
@@ -102,32 +141,50 @@ namespace kanzi {
        }
    }
 
-   inline EntropyEncoder* EntropyCodecFactory::newEncoder(OutputBitStream& obs, Context& ctx, short entropyType) THROW
+   inline EntropyEncoder* EntropyCodecFactory::newEncoder(OutputBitStream& obs, Context& ctx, short entropyType,
+       Predictor** predictor) THROW
    {
+       const int jobs = ctx.getInt("jobs", 1);
+
        switch (entropyType) {
        case HUFFMAN_TYPE:
-           return new HuffmanEncoder(obs);
+           return new HuffmanEncoder(obs, HuffmanCommon::MAX_CHUNK_SIZE, false, jobs);
+
+       case HUFFMANX_TYPE:
+           return new HuffmanEncoder(obs, HuffmanCommon::MAX_CHUNK_SIZE, true, jobs);
 
        case ANS0_TYPE:
-           return new ANSRangeEncoder(obs, 0);
+           return new ANSRangeEncoder(obs, 0, -1, ANSRangeEncoder::DEFAULT_LOG_RANGE, 1, jobs);
 
        case ANS1_TYPE:
-           return new ANSRangeEncoder(obs, 1);
+           return new ANSRangeEncoder(obs, 1, -1, ANSRangeEncoder::DEFAULT_LOG_RANGE, 1, jobs);
+
+       case ANS0X_TYPE:
+           return new ANSRangeEncoder(obs, 0, -1, ANSRangeEncoder::DEFAULT_LOG_RANGE,
+               ANSRangeEncoder::DEFAULT_INTERLEAVED_STATES, jobs);
+
+       case ANS1X_TYPE:
+           return new ANSRangeEncoder(obs, 1, -1, ANSRangeEncoder::DEFAULT_LOG_RANGE,
+               ANSRangeEncoder::DEFAULT_INTERLEAVED_STATES, jobs);
 
        case RANGE_TYPE:
-           return new RangeEncoder(obs);
+           return new RangeEncoder(obs, RangeEncoder::DEFAULT_CHUNK_SIZE, RangeEncoder::DEFAULT_LOG_RANGE, false, jobs);
 
-       case FPAQ_TYPE:
-           return new BinaryEntropyEncoder(obs, new FPAQPredictor());
+       case RANGEX_TYPE:
+           return new RangeEncoder(obs, RangeEncoder::DEFAULT_CHUNK_SIZE, RangeEncoder::DEFAULT_LOG_RANGE, true, jobs);
+
+       case FSE_TYPE:
+           return new FSEEncoder(obs, -1, FSEEncoder::DEFAULT_LOG_RANGE, jobs);
 
+       case FPAQ_TYPE:
        case CM_TYPE:
-           return new BinaryEntropyEncoder(obs, new CMPredictor());
+       case TPAQ_TYPE:
+       case TPAQX_TYPE:
+           if (predictor == nullptr)
+               return new BinaryEntropyEncoder(obs, newPredictor(ctx, entropyType));
 
-       case TPAQ_TYPE: 
-           return new BinaryEntropyEncoder(obs, new TPAQPredictor<false>(&ctx));
-       
-       case TPAQX_TYPE: 
-           return new BinaryEntropyEncoder(obs, new TPAQPredictor<true>(&ctx));
+           *predictor = newPredictor(ctx, entropyType, *predictor);
+           return new BinaryEntropyEncoder(obs, *predictor, false);
 
        case NONE_TYPE:
            return new NullEntropyEncoder(obs);
@@ -140,21 +197,134 @@ namespace kanzi {
        }
    }
 
+   inline Predictor* EntropyCodecFactory::newPredictor(Context& ctx, short entropyType, Predictor* predictor) THROW
+   {
+       switch (entropyType) {
+       case FPAQ_TYPE: {
+           FPAQPredictor* p = dynamic_cast<FPAQPredictor*>(predictor);
+
+           if (p != nullptr) {
+               p->reset();
+               return p;
+           }
+
+           delete predictor;
+           return new FPAQPredictor();
+       }
+
+       case CM_TYPE: {
+           CMPredictor* p = dynamic_cast<CMPredictor*>(predictor);
+
+           if (p != nullptr) {
+               p->reset();
+               return p;
+           }
+
+           delete predictor;
+           return new CMPredictor();
+       }
+
+       case TPAQ_TYPE: {
+           TPAQPredictor<false>* p = dynamic_cast<TPAQPredictor<false>*>(predictor);
+
+           if (p != nullptr) {
+               p->reset(&ctx);
+               return p;
+           }
+
+           delete predictor;
+           return new TPAQPredictor<false>(&ctx);
+       }
+
+       case TPAQX_TYPE: {
+           TPAQPredictor<true>* p = dynamic_cast<TPAQPredictor<true>*>(predictor);
+
+           if (p != nullptr) {
+               p->reset(&ctx);
+               return p;
+           }
+
+           delete predictor;
+           return new TPAQPredictor<true>(&ctx);
+       }
+
+       default:
+           string msg = "No predictor for entropy codec type: '";
+           msg += char(entropyType);
+           msg += '\'';
+           throw invalid_argument(msg);
+       }
+   }
+
+   inline int64 EntropyCodecFactory::getMemoryFootprint(short entropyType, int blockSize, int modelShrink)
+   {
+       switch (entropyType) {
+       case NONE_TYPE:
+           return 0;
+
+       // Chunk buffer, frequency tables and coded chunks (chunked layout)
+       case HUFFMAN_TYPE:
+       case HUFFMANX_TYPE:
+       case ANS0_TYPE:
+       case ANS1_TYPE:
+       case ANS0X_TYPE:
+       case ANS1X_TYPE:
+       case RANGE_TYPE:
+       case RANGEX_TYPE:
+       case FSE_TYPE:
+           return 2 * int64(blockSize) + (1 << 20);
+
+       // Binary codecs: chunk buffer and model
+       case FPAQ_TYPE:
+           return int64(blockSize) + int64(sizeof(FPAQPredictor));
+
+       case CM_TYPE:
+           return int64(blockSize) + int64(sizeof(CMPredictor));
+
+       case TPAQ_TYPE:
+           return int64(blockSize) + TPAQPredictor<false>::getMemoryFootprint(blockSize, modelShrink);
+
+       case TPAQX_TYPE:
+           return int64(blockSize) + TPAQPredictor<true>::getMemoryFootprint(blockSize, modelShrink);
+
+       default:
+           string msg = "Unknown entropy codec type: '";
+           msg += char(entropyType);
+           msg += '\'';
+           throw invalid_argument(msg);
+       }
+   }
+
    inline const char* EntropyCodecFactory::getName(short entropyType) THROW
    {
        switch (entropyType) {
        case HUFFMAN_TYPE:
            return "HUFFMAN";
 
+       case HUFFMANX_TYPE:
+           return "HUFFMANX";
+
        case ANS0_TYPE:
            return "ANS0";
 
        case ANS1_TYPE:
            return "ANS1";
 
+       case ANS0X_TYPE:
+           return "ANS0X";
+
+       case ANS1X_TYPE:
+           return "ANS1X";
+
        case RANGE_TYPE:
            return "RANGE";
 
+       case RANGEX_TYPE:
+           return "RANGEX";
+
+       case FSE_TYPE:
+           return "FSE";
+
        case FPAQ_TYPE:
            return "FPAQ";
 
@@ -186,18 +356,33 @@ namespace kanzi {
        if (name == "HUFFMAN")
            return HUFFMAN_TYPE;
 
+       if (name == "HUFFMANX")
+           return HUFFMANX_TYPE;
+
        if (name == "ANS0")
            return ANS0_TYPE;
 
        if (name == "ANS1")
            return ANS1_TYPE;
 
+       if (name == "ANS0X")
+           return ANS0X_TYPE;
+
+       if (name == "ANS1X")
+           return ANS1X_TYPE;
+
        if (name == "FPAQ")
            return FPAQ_TYPE;
 
        if (name == "RANGE")
            return RANGE_TYPE;
 
+       if (name == "RANGEX")
+           return RANGEX_TYPE;
+
+       if (name == "FSE")
+           return FSE_TYPE;
+
        if (name == "CM")
            return CM_TYPE;
 
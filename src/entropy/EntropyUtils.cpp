@@ -18,6 +18,7 @@ limitations under the License.
 #include <sstream>
 #include "EntropyUtils.hpp"
 #include "../Global.hpp"
+#include "../Memory.hpp"
 
 using namespace kanzi;
 
@@ -316,6 +317,13 @@ int EntropyUtils::computeFirstOrderEntropy1024(byte block[], int length, uint hi
         return 0;
 
     Global::computeHistogram(block, length, histo, true);
+    return computeEntropy1024(histo, length);
+}
+
+// Return the first order entropy in the [0..1024] range of the histogram of
+// 'length' symbols
+int EntropyUtils::computeEntropy1024(const uint histo[], int length)
+{
     uint64 sum = 0;
     const int logLength1024 = Global::log2_1024(length);
 
@@ -329,6 +337,77 @@ int EntropyUtils::computeFirstOrderEntropy1024(byte block[], int length, uint hi
     return int(sum / uint64(length));
 }
 
+// Return the class of the block (BLOCK_INCOMPRESSIBLE, BLOCK_ENTROPY_ONLY or
+// BLOCK_COMPRESSIBLE), from samples first:
+// - low order 0 entropy of the samples => compressible
+// - else order 0 entropy of the whole block and density of repeated 4-byte
+// sequences in the samples (found using a hash table, like a LZ match finder).
+// Repetitions can be exploited by the transforms even if the order 0 entropy
+// is high. Without repetitions, the transforms rarely succeed on high entropy
+// data (typically already compressed media): entropy code or copy the block.
+int EntropyUtils::classifyBlock(byte block[], int length)
+{
+    if (length < 4)
+        return BLOCK_COMPRESSIBLE;
+
+    // Sample the block (small blocks are sampled entirely)
+    int nbSamples = SAMPLE_COUNT;
+    int sampleSize = SAMPLE_SIZE;
+    const int step = length / SAMPLE_COUNT;
+
+    if (length < 4 * SAMPLE_COUNT * SAMPLE_SIZE) {
+        nbSamples = 1;
+        sampleSize = length;
+    }
+
+    uint histo[256] = { 0 };
+
+    for (int n = 0; n < nbSamples; n++) {
+        const uint8* p = (const uint8*)&block[n * step];
+
+        for (int i = 0; i < sampleSize; i++)
+            histo[p[i]]++;
+    }
+
+    int entropy = computeEntropy1024(histo, nbSamples * sampleSize);
+
+    if (entropy < HIGH_ENTROPY_THRESHOLD)
+        return BLOCK_COMPRESSIBLE;
+
+    if (nbSamples > 1)
+        entropy = computeFirstOrderEntropy1024(block, length, histo);
+
+    // Count the 4-byte sequences of the samples already seen in the samples
+    int positions[1 << MATCH_HASH_LOG];
+    int probes = 0;
+    int matches = 0;
+
+    for (int i = 0; i < (1 << MATCH_HASH_LOG); i++)
+        positions[i] = -1;
+
+    for (int n = 0; n < nbSamples; n++) {
+        const int start = n * step;
+        const int end = start + sampleSize - 3;
+
+        for (int i = start; i < end; i++) {
+            const int32 val = LittleEndian::readInt32(&block[i]);
+            const uint32 h = (uint32(val) * 0x9E3779B1) >> (32 - MATCH_HASH_LOG);
+            const int ref = positions[h];
+            positions[h] = i;
+
+            if ((ref >= 0) && (LittleEndian::readInt32(&block[ref]) == val))
+                matches++;
+        }
+
+        probes += end - start;
+    }
+
+    if (entropy >= INCOMPRESSIBLE_THRESHOLD)
+        return (matches < (probes >> 4)) ? BLOCK_INCOMPRESSIBLE : BLOCK_COMPRESSIBLE;
+
+    return (matches < (probes >> 6)) ? BLOCK_ENTROPY_ONLY : BLOCK_COMPRESSIBLE;
+}
+
 // Returns the size of the alphabet
 // length is the length of the alphabet array
 // 'totalFreq 'is the sum of frequencies.
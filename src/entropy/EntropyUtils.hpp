@@ -34,10 +34,21 @@ namespace kanzi
        static const int BIT_ENCODED_ALPHABET_256 = 1;
        static const int PRESENT_SYMBOLS_MASK = 0;
        static const int ABSENT_SYMBOLS_MASK = 1;
+       static const int SAMPLE_COUNT = 64;
+       static const int SAMPLE_SIZE = 1024;
+       static const int HIGH_ENTROPY_THRESHOLD = 922; // 0.9*1024
+       static const int MATCH_HASH_LOG = 12;
+
+       static int computeEntropy1024(const uint histo[], int length);
 
    public:
        static const int INCOMPRESSIBLE_THRESHOLD = 973; // 0.95*1024
 
+       // Block classes (see classifyBlock)
+       static const int BLOCK_INCOMPRESSIBLE = 0; // copy block
+       static const int BLOCK_ENTROPY_ONLY = 1; // skip the transforms
+       static const int BLOCK_COMPRESSIBLE = 2; // full pipeline
+
        EntropyUtils() {}
 
        ~EntropyUtils() {}
@@ -50,6 +61,8 @@ namespace kanzi
 
        static int computeFirstOrderEntropy1024(byte block[], int length, uint histo[]);
 
+       static int classifyBlock(byte block[], int length);
+
        static int writeVarInt(OutputBitStream& obs, uint32 val);
 
        static uint32 readVarInt(InputBitStream& ibs);
@@ -18,6 +18,11 @@ limitations under the License.
 using namespace kanzi;
 
 FPAQPredictor::FPAQPredictor()
+{
+    reset();
+}
+
+void FPAQPredictor::reset()
 {
     _ctxIdx = 1;
 
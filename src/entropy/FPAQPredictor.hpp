@@ -38,6 +38,9 @@ namespace kanzi
 
        ~FPAQPredictor() {}
 
+       // Restore the initial state (to reuse the predictor for another block)
+       void reset();
+
        void update(int bit);
 
        int get() { return int(_probs[_ctxIdx] >> 4); }
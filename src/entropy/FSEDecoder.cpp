@@ -0,0 +1,247 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include "FSEDecoder.hpp"
+#include "EntropyUtils.hpp"
+#include "ParallelChunks.hpp"
+#include "../BitStreamException.hpp"
+#include "../Global.hpp"
+#include "../Memory.hpp"
+
+using namespace kanzi;
+
+// The chunk size indicates how many bytes are encoded (per block) before
+// resetting the frequency stats. 0 means that frequencies calculated at the
+// beginning of the block apply to the whole block.
+FSEDecoder::FSEDecoder(InputBitStream& bitstream, int chunkSize, int jobs) THROW : _bitstream(bitstream)
+{
+    if ((chunkSize != 0) && (chunkSize != -1) && (chunkSize < 1024))
+        throw invalid_argument("FSE Codec: The chunk size must be at least 1024");
+
+    if (chunkSize > MAX_CHUNK_SIZE) {
+        stringstream ss;
+        ss << "FSE Codec: The chunk size must be at most " << MAX_CHUNK_SIZE;
+        throw invalid_argument(ss.str());
+    }
+
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "FSE Codec: Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
+    _chunkSize = (chunkSize == -1) ? DEFAULT_CHUNK_SIZE : chunkSize;
+    _jobs = jobs;
+    _table = new uint32[1 << MAX_LOG_RANGE];
+    _buffer = new byte[0];
+    _bufferSize = 0;
+    _logRange = 8;
+}
+
+FSEDecoder::~FSEDecoder()
+{
+    dispose();
+    delete[] _buffer;
+    delete[] _table;
+}
+
+// Decode the frequencies and build the decoding table
+int FSEDecoder::decodeHeader(uint frequencies[])
+{
+    _logRange = int(8 + _bitstream.readBits(3));
+    const int alphabetSize = EntropyUtils::decodeAlphabet(_bitstream, _alphabet);
+
+    if (alphabetSize == 0)
+        return 0;
+
+    const int scale = 1 << _logRange;
+
+    if (alphabetSize != 256)
+        memset(frequencies, 0, sizeof(uint) * 256);
+
+    const int chkSize = (alphabetSize >= 64) ? 12 : 6;
+    int sum = 0;
+    int llr = 3;
+
+    while (uint(1 << llr) <= _logRange)
+        llr++;
+
+    // Decode all frequencies (but the first one) by chunks
+    for (int i = 1; i < alphabetSize; i += chkSize) {
+        // Read frequencies size for current chunk
+        const int logMax = int(1 + _bitstream.readBits(llr));
+
+        if (1 << logMax > scale) {
+            stringstream ss;
+            ss << "Invalid bitstream: incorrect frequency size ";
+            ss << logMax << " in FSE decoder";
+            throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+        }
+
+        const int endj = (i + chkSize < alphabetSize) ? i + chkSize : alphabetSize;
+
+        // Read frequencies
+        for (int j = i; j < endj; j++) {
+            const int freq = int(_bitstream.readBits(logMax));
+
+            if ((freq <= 0) || (freq >= scale)) {
+                stringstream ss;
+                ss << "Invalid bitstream: incorrect frequency " << freq;
+                ss << " for symbol '" << _alphabet[j] << "' in FSE decoder";
+                throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+            }
+
+            frequencies[_alphabet[j]] = uint(freq);
+            sum += freq;
+        }
+    }
+
+    // Infer first frequency
+    if (scale <= sum) {
+        stringstream ss;
+        ss << "Invalid bitstream: incorrect frequency " << scale - sum;
+        ss << " for symbol '" << _alphabet[0] << "' in FSE decoder";
+        throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+    }
+
+    frequencies[_alphabet[0]] = uint(scale - sum);
+
+    // Spread the symbols over the table (same as encoder)
+    const int mask = scale - 1;
+    const int step = (scale >> 1) + (scale >> 3) + 3;
+    byte spread[1 << MAX_LOG_RANGE];
+    uint next[256];
+
+    for (int i = 0, pos = 0; i < 256; i++) {
+        next[i] = frequencies[i];
+
+        for (uint j = 0; j < frequencies[i]; j++) {
+            spread[pos] = byte(i);
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // For each state: symbol, number of bits to read and base of next state
+    for (int i = 0; i < scale; i++) {
+        const uint8 s = uint8(spread[i]);
+        const uint x = next[s]++;
+        const int nbBits = _logRange - Global::_log2(x);
+        _table[i] = (((x << nbBits) - scale) << 16) | (nbBits << 8) | s;
+    }
+
+    return alphabetSize;
+}
+
+int FSEDecoder::decode(byte block[], uint blkptr, uint len)
+{
+    if (len == 0)
+        return 0;
+
+    const int end = blkptr + len;
+    int sz = (_chunkSize == 0) ? len : _chunkSize;
+
+    if (sz > MAX_CHUNK_SIZE)
+        sz = MAX_CHUNK_SIZE;
+
+    if ((_jobs > 0) && (len > uint(sz)) && (ParallelChunks::readLayout(_bitstream) == true))
+        return ParallelChunks::decode(*this, _bitstream, block, blkptr, len, sz, _jobs);
+
+    // At most MAX_LOG_RANGE bits per symbol, plus the final states and padding
+    const uint bufferSize = uint((int64(sz) * MAX_LOG_RANGE) >> 3) + 64;
+
+    if (_bufferSize < bufferSize) {
+        delete[] _buffer;
+        _bufferSize = bufferSize;
+        _buffer = new byte[_bufferSize];
+    }
+
+    int startChunk = blkptr;
+
+    while (startChunk < end) {
+        if (decodeHeader(_freqs) == 0)
+            return startChunk - blkptr;
+
+        const int sizeChunk = (startChunk + sz < end) ? sz : end - startChunk;
+        decodeChunk(&block[startChunk], sizeChunk);
+        startChunk += sizeChunk;
+    }
+
+    return len;
+}
+
+// Decode the symbols with 2 alternating states, reading the bits backward
+void FSEDecoder::decodeChunk(byte block[], int end)
+{
+    const int lr = _logRange;
+    const uint32 totalBits = EntropyUtils::readVarInt(_bitstream);
+    const uint sz = (totalBits + 7) >> 3;
+
+    if ((totalBits < uint32(2 * lr)) || (sz > _bufferSize - 8)) {
+        stringstream ss;
+        ss << "Invalid bitstream: incorrect chunk size " << totalBits << " in FSE decoder";
+        throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+    }
+
+    _bitstream.readBits(&_buffer[0], 8 * sz);
+    memset(&_buffer[sz], 0, 8);
+    const byte* buf = &_buffer[0];
+    const uint32* table = &_table[0];
+    int pos = int(totalBits);
+
+    // Read initial states
+    pos -= lr;
+    uint st0 = uint(LittleEndian::readLong64(&buf[pos >> 3]) >> (pos & 7)) & ((1 << lr) - 1);
+    pos -= lr;
+    uint st1 = uint(LittleEndian::readLong64(&buf[pos >> 3]) >> (pos & 7)) & ((1 << lr) - 1);
+    int i = 0;
+
+    // At most lr bits per symbol
+    for (; (i + 2 <= end) && (pos >= 2 * lr); i += 2) {
+        const uint32 val0 = table[st0];
+        const int nbBits0 = (val0 >> 8) & 0xFF;
+        pos -= nbBits0;
+        st0 = (val0 >> 16) + (uint(LittleEndian::readLong64(&buf[pos >> 3]) >> (pos & 7)) & ((1 << nbBits0) - 1));
+        const uint32 val1 = table[st1];
+        const int nbBits1 = (val1 >> 8) & 0xFF;
+        pos -= nbBits1;
+        st1 = (val1 >> 16) + (uint(LittleEndian::readLong64(&buf[pos >> 3]) >> (pos & 7)) & ((1 << nbBits1) - 1));
+        block[i] = byte(val0);
+        block[i + 1] = byte(val1);
+    }
+
+    for (; i < end; i++) {
+        uint& st = ((i & 1) == 0) ? st0 : st1;
+        const uint32 val = table[st];
+        const int nbBits = (val >> 8) & 0xFF;
+
+        if (pos < nbBits)
+            break;
+
+        pos -= nbBits;
+        st = (val >> 16) + (uint(LittleEndian::readLong64(&buf[pos >> 3]) >> (pos & 7)) & ((1 << nbBits) - 1));
+        block[i] = byte(val);
+    }
+
+    if ((i != end) || (pos != 0)) {
+        throw BitStreamException("Invalid bitstream: incorrect code in FSE decoder",
+            BitStreamException::INVALID_STREAM);
+    }
+}
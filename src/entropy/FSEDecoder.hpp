@@ -0,0 +1,69 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _FSEDecoder_
+#define _FSEDecoder_
+
+#include "../EntropyDecoder.hpp"
+
+using namespace std;
+
+// Implementation of a tabled Asymmetric Numeral System (tANS) decoder.
+// See FSEEncoder.
+// With 'jobs' > 0, the chunks of a block are decoded concurrently (chunked
+// layout, see ParallelChunks). 0 selects the sequential layout.
+
+namespace kanzi
+{
+
+   class FSEDecoder : public EntropyDecoder {
+   public:
+       FSEDecoder(InputBitStream& bitstream, int chunkSize = -1, int jobs = 0) THROW;
+
+       ~FSEDecoder();
+
+       int decode(byte block[], uint blkptr, uint len);
+
+       InputBitStream& getBitStream() const { return _bitstream; }
+
+       void dispose() {};
+
+       // Decoder of the chunks in the chunked layout
+       FSEDecoder* newChunkDecoder(InputBitStream& bitstream) const
+       {
+           return new FSEDecoder(bitstream, _chunkSize);
+       }
+
+   private:
+       static const int DEFAULT_CHUNK_SIZE = 1 << 15; // 32 KB by default
+       static const int MAX_CHUNK_SIZE = 1 << 27;
+       static const int MAX_LOG_RANGE = 15;
+
+       InputBitStream& _bitstream;
+       uint _alphabet[256];
+       uint _freqs[256];
+       uint32* _table; // state -> next state base (16 bits), bits to read (8 bits), symbol (8 bits)
+       byte* _buffer;
+       uint _bufferSize;
+       uint _chunkSize;
+       uint _logRange;
+       int _jobs;
+
+       int decodeHeader(uint frequencies[]);
+
+       void decodeChunk(byte block[], int end);
+   };
+}
+#endif
@@ -0,0 +1,246 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include "FSEEncoder.hpp"
+#include "EntropyUtils.hpp"
+#include "ParallelChunks.hpp"
+#include "../Global.hpp"
+#include "../Memory.hpp"
+
+using namespace kanzi;
+
+// The chunk size indicates how many bytes are encoded (per block) before
+// resetting the frequency stats. 0 means that frequencies calculated at the
+// beginning of the block apply to the whole block.
+FSEEncoder::FSEEncoder(OutputBitStream& bitstream, int chunkSize, int logRange, int jobs) THROW : _bitstream(bitstream)
+{
+    if ((chunkSize != 0) && (chunkSize != -1) && (chunkSize < 1024))
+        throw invalid_argument("FSE Codec: The chunk size must be at least 1024");
+
+    if (chunkSize > MAX_CHUNK_SIZE) {
+        stringstream ss;
+        ss << "FSE Codec: The chunk size must be at most " << MAX_CHUNK_SIZE;
+        throw invalid_argument(ss.str());
+    }
+
+    if ((logRange < 8) || (logRange > 15)) {
+        stringstream ss;
+        ss << "FSE Codec: Invalid range: " << logRange << " (must be in [8..15])";
+        throw invalid_argument(ss.str());
+    }
+
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "FSE Codec: Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
+    _chunkSize = (chunkSize == -1) ? DEFAULT_CHUNK_SIZE : chunkSize;
+    _logRange = logRange;
+    _jobs = jobs;
+    _states = new uint16[1 << logRange];
+    _buffer = new byte[0];
+    _bufferSize = 0;
+}
+
+FSEEncoder::~FSEEncoder()
+{
+    dispose();
+    delete[] _buffer;
+    delete[] _states;
+}
+
+// Normalize frequencies, build the encoding tables and encode the header
+int FSEEncoder::updateFrequencies(uint frequencies[], int lr)
+{
+    _bitstream.writeBits(lr - 8, 3); // logRange
+    const int alphabetSize = EntropyUtils::normalizeFrequencies(frequencies, _alphabet, 256, frequencies[256], 1 << lr);
+
+    if (alphabetSize > 0) {
+        // Spread the symbols over the table (same as decoder)
+        const int size = 1 << lr;
+        const int mask = size - 1;
+        const int step = (size >> 1) + (size >> 3) + 3;
+        uint cumFreqs[256];
+        byte spread[1 << 15];
+
+        for (int i = 0, pos = 0, sum = 0; i < 256; i++) {
+            cumFreqs[i] = sum;
+
+            if (frequencies[i] == 0)
+                continue;
+
+            _symbols[i].reset(sum, frequencies[i], lr);
+            sum += frequencies[i];
+
+            for (uint j = 0; j < frequencies[i]; j++) {
+                spread[pos] = byte(i);
+                pos = (pos + step) & mask;
+            }
+        }
+
+        // States of each symbol in spread order
+        for (int i = 0; i < size; i++)
+            _states[cumFreqs[uint8(spread[i])]++] = uint16(size + i);
+    }
+
+    encodeHeader(alphabetSize, _alphabet, frequencies, lr);
+    return alphabetSize;
+}
+
+// Encode alphabet and frequencies
+bool FSEEncoder::encodeHeader(int alphabetSize, uint alphabet[], uint frequencies[], int lr)
+{
+    EntropyUtils::encodeAlphabet(_bitstream, alphabet, 256, alphabetSize);
+
+    if (alphabetSize == 0)
+        return true;
+
+    const int chkSize = (alphabetSize >= 64) ? 12 : 6;
+    int llr = 3;
+
+    while (1 << llr <= lr)
+        llr++;
+
+    // Encode all frequencies (but the first one) by chunks
+    for (int i = 1; i < alphabetSize; i += chkSize) {
+        uint max = 0;
+        uint logMax = 1;
+        const int endj = (i + chkSize < alphabetSize) ? i + chkSize : alphabetSize;
+
+        // Search for max frequency log size in next chunk
+        for (int j = i; j < endj; j++) {
+            if (frequencies[alphabet[j]] > max)
+                max = frequencies[alphabet[j]];
+        }
+
+        while (uint(1 << logMax) <= max)
+            logMax++;
+
+        _bitstream.writeBits(logMax - 1, llr);
+
+        // Write frequencies
+        for (int j = i; j < endj; j++)
+            _bitstream.writeBits(frequencies[alphabet[j]], logMax);
+    }
+
+    return true;
+}
+
+// Dynamically compute the frequencies for every chunk of data in the block
+int FSEEncoder::encode(byte block[], uint blkptr, uint len)
+{
+    if (len == 0)
+        return 0;
+
+    const int end = blkptr + len;
+    int sz = (_chunkSize == 0) ? len : _chunkSize;
+
+    if (sz > MAX_CHUNK_SIZE)
+        sz = MAX_CHUNK_SIZE;
+
+    if ((_jobs > 0) && (len > uint(sz)) && (ParallelChunks::writeLayout(_bitstream, _jobs) == true))
+        return ParallelChunks::encode(*this, _bitstream, block, blkptr, len, sz, _jobs);
+
+    // At most logRange bits per symbol, plus the final states
+    const uint bufferSize = uint((int64(sz) * _logRange) >> 3) + 64;
+
+    if (_bufferSize < bufferSize) {
+        delete[] _buffer;
+        _bufferSize = bufferSize;
+        _buffer = new byte[_bufferSize];
+    }
+
+    int startChunk = blkptr;
+
+    while (startChunk < end) {
+        const int sizeChunk = (startChunk + sz < end) ? sz : end - startChunk;
+        int lr = _logRange;
+
+        // Lower log range if the size of the data chunk is small
+        while ((lr > 8) && (1 << lr > sizeChunk))
+            lr--;
+
+        Global::computeHistogram(&block[startChunk], sizeChunk, _freqs, true, true);
+        updateFrequencies(_freqs, lr);
+        encodeChunk(&block[startChunk], sizeChunk, lr);
+        startChunk += sizeChunk;
+    }
+
+    return len;
+}
+
+// The symbols are encoded from the end with 2 alternating states. The bits are
+// written forward and read backward by the decoder.
+void FSEEncoder::encodeChunk(byte block[], int end, int lr)
+{
+    const uint8* data = (uint8*) &block[0];
+    const uint size = 1 << lr;
+    uint st[2] = { size, size };
+    byte* p = &_buffer[0];
+    uint64 bits = 0; // pending bits
+    int nbBits = 0;
+
+    for (int i = end - 1; i >= 0; i--) {
+        const FSEEncSymbol& sym = _symbols[data[i]];
+        uint& x = st[i & 1];
+        const int n = int((x + sym._deltaNbBits) >> 16);
+        bits |= (uint64(x & ((1 << n) - 1)) << nbBits);
+        nbBits += n;
+        x = _states[int(x >> n) + sym._deltaFindState];
+
+        if (nbBits >= 32) {
+            LittleEndian::writeInt32(p, int32(bits));
+            p += 4;
+            bits >>= 32;
+            nbBits -= 32;
+        }
+    }
+
+    // Final states (read first by the decoder)
+    bits |= (uint64(st[1] - size) << nbBits);
+    nbBits += lr;
+    bits |= (uint64(st[0] - size) << nbBits);
+    nbBits += lr;
+    const uint64 totalBits = 8 * uint64(p - &_buffer[0]) + nbBits;
+
+    while (nbBits > 0) {
+        *p++ = byte(bits);
+        bits >>= 8;
+        nbBits -= 8;
+    }
+
+    EntropyUtils::writeVarInt(_bitstream, uint32(totalBits));
+    _bitstream.writeBits(&_buffer[0], 8 * uint(p - &_buffer[0]));
+}
+
+void FSEEncSymbol::reset(int cumFreq, int freq, int logRange)
+{
+    if (freq == 1) {
+        _deltaNbBits = (logRange << 16) - (1 << logRange);
+    }
+    else {
+        const int maxBitsOut = logRange - Global::_log2(freq - 1);
+        _deltaNbBits = (maxBitsOut << 16) - (freq << maxBitsOut);
+    }
+
+    _deltaFindState = cumFreq - freq;
+}
@@ -0,0 +1,98 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _FSEEncoder_
+#define _FSEEncoder_
+
+#include "../EntropyEncoder.hpp"
+
+using namespace std;
+
+// Implementation of a tabled Asymmetric Numeral System (tANS) encoder, in the
+// manner of Finite State Entropy.
+// See "Asymmetric Numeral System" by Jarek Duda at http://arxiv.org/abs/0902.0271
+// and https://github.com/Cyan4973/FiniteStateEntropy
+// The frequencies are normalized to the size of the table (2^logRange) and
+// spread over the table. Encoding and decoding are table lookups and bit
+// transfers (no multiplication or division). Two states are interleaved.
+// With 'jobs' > 0, the chunks of a block are encoded concurrently (chunked
+// layout, see ParallelChunks). 0 selects the sequential layout.
+
+namespace kanzi
+{
+
+   class FSEEncSymbol
+   {
+   public:
+      FSEEncSymbol()
+      {
+         _deltaNbBits = 0;
+         _deltaFindState = 0;
+      }
+
+      ~FSEEncSymbol() { }
+
+      void reset(int cumFreq, int freq, int logRange);
+
+      uint _deltaNbBits; // (max bits out << 16) - min state requiring them
+      int _deltaFindState; // offset of the symbol in the state table
+   };
+
+
+   class FSEEncoder : public EntropyEncoder
+   {
+   public:
+       static const int DEFAULT_LOG_RANGE = 12;
+
+       FSEEncoder(OutputBitStream& bitstream, int chunkSize = -1, int logRange = DEFAULT_LOG_RANGE,
+          int jobs = 0) THROW;
+
+       ~FSEEncoder();
+
+       int updateFrequencies(uint frequencies[], int lr);
+
+       int encode(byte block[], uint blkptr, uint len);
+
+       OutputBitStream& getBitStream() const { return _bitstream; }
+
+       void dispose() {};
+
+       // Encoder of the chunks in the chunked layout
+       FSEEncoder* newChunkEncoder(OutputBitStream& bitstream) const
+       {
+           return new FSEEncoder(bitstream, _chunkSize, _logRange);
+       }
+
+   private:
+       static const int DEFAULT_CHUNK_SIZE = 1 << 15; // 32 KB by default
+       static const int MAX_CHUNK_SIZE = 1 << 27;
+
+       uint _alphabet[256];
+       uint _freqs[257];
+       FSEEncSymbol _symbols[256];
+       uint16* _states; // next state, by symbol and previous state
+       byte* _buffer;
+       uint _bufferSize;
+       OutputBitStream& _bitstream;
+       uint _chunkSize;
+       uint _logRange;
+       int _jobs;
+
+       void encodeChunk(byte block[], int end, int lr);
+
+       bool encodeHeader(int alphabetSize, uint alphabet[], uint frequencies[], int lr);
+   };
+}
+#endif
@@ -28,6 +28,11 @@ namespace kanzi
    public:
        static const int MAX_CHUNK_SIZE = 1 << 15; 
        static const int MAX_SYMBOL_SIZE = 18;
+       static const int NB_STREAMS = 4; // in multi-stream mode
+
+       // Max size of the encoded streams of a chunk (whole bytes, 8 bytes of
+       // padding after each stream)
+       static int getMaxStreamsSize(int chunkSize) { return (chunkSize * MAX_SYMBOL_SIZE) / 8 + 16 * NB_STREAMS; }
 
        static int generateCanonicalCodes(short sizes[], uint codes[], uint ranks[], int count);
 
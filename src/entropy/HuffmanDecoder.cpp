@@ -21,6 +21,7 @@ limitations under the License.
 #include "HuffmanDecoder.hpp"
 #include "EntropyUtils.hpp"
 #include "ExpGolombDecoder.hpp"
+#include "ParallelChunks.hpp"
 #include "../BitStreamException.hpp"
 
 using namespace kanzi;
@@ -28,7 +29,7 @@ using namespace kanzi;
 
 // The chunk size indicates how many bytes are encoded (per block) before
 // resetting the frequency stats. 
-HuffmanDecoder::HuffmanDecoder(InputBitStream& bitstream, int chunkSize) THROW : _bitstream(bitstream)
+HuffmanDecoder::HuffmanDecoder(InputBitStream& bitstream, int chunkSize, bool multiStream, int jobs) THROW : _bitstream(bitstream)
 {
     if (chunkSize < 1024)
        throw invalid_argument("Huffman codec: The chunk size must be at least 1024");
@@ -39,11 +40,32 @@ HuffmanDecoder::HuffmanDecoder(InputBitStream& bitstream, int chunkSize) THROW :
         throw invalid_argument(ss.str());
     }
 
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "Huffman codec: Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
     _chunkSize = chunkSize;
+    _jobs = jobs;
     _minCodeLen = 8;
     _state = 0;
     _bits = 0;
     _table1 = new uint16[TABLE1_MASK + 1];
+    _table2 = nullptr;
+    _buffer = nullptr;
+    _bufferSize = 0;
+
+    if (multiStream == true) {
+        _table2 = new uint32[TABLE0_MASK + 1];
+        _bufferSize = HuffmanCommon::getMaxStreamsSize(chunkSize);
+        _buffer = new byte[_bufferSize];
+    }
 
     // Default lengths & canonical codes
     for (int i = 0; i < 256; i++) {
@@ -139,6 +161,29 @@ void HuffmanDecoder::buildDecodingTables(int count)
                _table1[idx++] = val;
         }
     }
+
+    if (_table2 == nullptr)
+        return;
+
+    // Pairs of codes fitting in DECODING_BATCH_SIZE bits:
+    // code -> count (bits 24-31), size (bits 16-23), symbols (bits 0-15)
+    for (int idx = 0; idx <= TABLE0_MASK; idx++) {
+        const uint val1 = _table0[idx];
+
+        if (val1 == 0) {
+            _table2[idx] = 0;
+            continue;
+        }
+
+        const int size1 = val1 >> 8;
+        const uint val2 = _table0[(idx << size1) & TABLE0_MASK];
+        const int size2 = val2 >> 8;
+
+        if ((val2 != 0) && (size1 + size2 <= DECODING_BATCH_SIZE))
+            _table2[idx] = (2 << 24) | ((size1 + size2) << 16) | ((val2 & 0xFF) << 8) | (val1 & 0xFF);
+        else
+            _table2[idx] = (1 << 24) | (size1 << 16) | (val1 & 0xFF);
+    }
 }
 
 // Use fastDecodeByte until the near end of chunk or block.
@@ -150,6 +195,9 @@ int HuffmanDecoder::decode(byte block[], uint blkptr, uint count)
     if (_minCodeLen == 0)
         return -1;
 
+    if ((_jobs > 0) && (count > uint(_chunkSize)) && (ParallelChunks::readLayout(_bitstream) == true))
+        return ParallelChunks::decode(*this, _bitstream, block, blkptr, count, _chunkSize, _jobs);
+
     int startChunk = blkptr;
     const int end = blkptr + count;
 
@@ -165,6 +213,13 @@ int HuffmanDecoder::decode(byte block[], uint blkptr, uint count)
             endPaddingSize++;
 
         const int endChunk = (startChunk + _chunkSize < end) ? startChunk + _chunkSize : end;
+
+        if (_buffer != nullptr) {
+            decodeStreams(&block[startChunk], endChunk - startChunk);
+            startChunk = endChunk;
+            continue;
+        }
+
         const int endChunk8 = startChunk + max((endChunk - startChunk - endPaddingSize) & -8, 0);
         int i = startChunk;
 
@@ -216,3 +271,111 @@ byte HuffmanDecoder::slowDecodeByte() THROW
         BitStreamException::INVALID_STREAM);
 }
 
+
+// Decode the streams of a chunk (see HuffmanEncoder::encodeStreams())
+void HuffmanDecoder::decodeStreams(byte block[], int count) THROW
+{
+    const int nbStreams = HuffmanCommon::NB_STREAMS;
+    const int partSize = count / nbStreams;
+    const uint8* bufs[nbStreams];
+    uint limits[nbStreams]; // size of the streams in bits
+    uint pos[nbStreams]; // bit position in the streams
+    int idx[nbStreams]; // position in the block
+    int ends[nbStreams];
+    int offset = 0;
+
+    for (int n = 0; n < nbStreams; n++) {
+        const uint size = EntropyUtils::readVarInt(_bitstream);
+
+        if (size > uint(_bufferSize - offset - 16)) {
+            stringstream ss;
+            ss << "Invalid bitstream: incorrect Huffman stream size " << size;
+            throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+        }
+
+        bufs[n] = (const uint8*)&_buffer[offset];
+        limits[n] = 8 * size;
+        pos[n] = 0;
+        idx[n] = n * partSize;
+        ends[n] = (n == nbStreams - 1) ? count : idx[n] + partSize;
+        offset += int(size) + 8;
+    }
+
+    // Read the streams, each one followed by 8 bytes of padding
+    for (int n = 0; n < nbStreams; n++) {
+        byte* buf = (byte*)bufs[n];
+
+        if (limits[n] != 0)
+            _bitstream.readBits(buf, limits[n]);
+
+        memset(&buf[limits[n] >> 3], 0, 8);
+    }
+
+    const uint8* buf0 = bufs[0];
+    const uint8* buf1 = bufs[1];
+    const uint8* buf2 = bufs[2];
+    const uint8* buf3 = bufs[3];
+    uint pos0 = 0, pos1 = 0, pos2 = 0, pos3 = 0;
+    int idx0 = idx[0], idx1 = idx[1], idx2 = idx[2], idx3 = idx[3];
+
+    // Decode 1 or 2 symbols per stream and iteration while all streams have 2
+    // symbols left at least
+    while ((idx0 + 2 <= ends[0]) && (idx1 + 2 <= ends[1]) && (idx2 + 2 <= ends[2]) && (idx3 + 2 <= ends[3])
+        && (pos0 <= limits[0]) && (pos1 <= limits[1]) && (pos2 <= limits[2]) && (pos3 <= limits[3])) {
+        const uint64 st0 = uint64(BigEndian::readLong64((const byte*)&buf0[pos0 >> 3])) << (pos0 & 7);
+        const uint64 st1 = uint64(BigEndian::readLong64((const byte*)&buf1[pos1 >> 3])) << (pos1 & 7);
+        const uint64 st2 = uint64(BigEndian::readLong64((const byte*)&buf2[pos2 >> 3])) << (pos2 & 7);
+        const uint64 st3 = uint64(BigEndian::readLong64((const byte*)&buf3[pos3 >> 3])) << (pos3 & 7);
+        const uint val0 = _table2[int(st0 >> (64 - DECODING_BATCH_SIZE))];
+        const uint val1 = _table2[int(st1 >> (64 - DECODING_BATCH_SIZE))];
+        const uint val2 = _table2[int(st2 >> (64 - DECODING_BATCH_SIZE))];
+        const uint val3 = _table2[int(st3 >> (64 - DECODING_BATCH_SIZE))];
+
+        if ((val0 == 0) || (val1 == 0) || (val2 == 0) || (val3 == 0)) {
+            // At least one long code: decode one symbol per stream
+            block[idx0++] = byte(decodeStreamSymbol(buf0, pos0));
+            block[idx1++] = byte(decodeStreamSymbol(buf1, pos1));
+            block[idx2++] = byte(decodeStreamSymbol(buf2, pos2));
+            block[idx3++] = byte(decodeStreamSymbol(buf3, pos3));
+            continue;
+        }
+
+        block[idx0] = byte(val0);
+        block[idx0 + 1] = byte(val0 >> 8);
+        block[idx1] = byte(val1);
+        block[idx1 + 1] = byte(val1 >> 8);
+        block[idx2] = byte(val2);
+        block[idx2 + 1] = byte(val2 >> 8);
+        block[idx3] = byte(val3);
+        block[idx3 + 1] = byte(val3 >> 8);
+        idx0 += (val0 >> 24);
+        idx1 += (val1 >> 24);
+        idx2 += (val2 >> 24);
+        idx3 += (val3 >> 24);
+        pos0 += ((val0 >> 16) & 0xFF);
+        pos1 += ((val1 >> 16) & 0xFF);
+        pos2 += ((val2 >> 16) & 0xFF);
+        pos3 += ((val3 >> 16) & 0xFF);
+    }
+
+    idx[0] = idx0;
+    idx[1] = idx1;
+    idx[2] = idx2;
+    idx[3] = idx3;
+    pos[0] = pos0;
+    pos[1] = pos1;
+    pos[2] = pos2;
+    pos[3] = pos3;
+
+    // Remaining symbols, one stream at a time
+    for (int n = 0; n < nbStreams; n++) {
+        for (int i = idx[n]; (i < ends[n]) && (pos[n] <= limits[n]); i++)
+            block[i] = byte(decodeStreamSymbol(bufs[n], pos[n]));
+
+        // The padding of the last byte is not part of the stream
+        if ((pos[n] > limits[n]) || (pos[n] + 8 <= limits[n])) {
+            throw BitStreamException("Invalid bitstream: incorrect Huffman code",
+                BitStreamException::INVALID_STREAM);
+        }
+    }
+}
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "HuffmanCommon.hpp"
 #include "../EntropyDecoder.hpp"
+#include "../Memory.hpp"
 
 using namespace std;
 
@@ -26,12 +27,17 @@ namespace kanzi
 
    // Implementation of a static Huffman encoder.
    // Uses in place generation of canonical codes instead of a tree
+   // In multi-stream mode, the streams of a chunk are decoded in lockstep from
+   // memory and each table hit may decode 2 short codes.
+   // With 'jobs' > 0, the chunks of a block are decoded concurrently (chunked
+   // layout, see ParallelChunks). 0 selects the sequential layout.
    class HuffmanDecoder : public EntropyDecoder 
    {
    public:
-       HuffmanDecoder(InputBitStream& bitstream, int chunkSize=HuffmanCommon::MAX_CHUNK_SIZE) THROW;
+       HuffmanDecoder(InputBitStream& bitstream, int chunkSize=HuffmanCommon::MAX_CHUNK_SIZE,
+          bool multiStream=false, int jobs=0) THROW;
 
-       ~HuffmanDecoder() { dispose(); delete[] _table1; };
+       ~HuffmanDecoder() { dispose(); delete[] _table1; delete[] _table2; delete[] _buffer; };
 
        int readLengths() THROW;
 
@@ -41,6 +47,12 @@ namespace kanzi
 
        virtual void dispose() {};
 
+       // Decoder of the chunks in the chunked layout
+       HuffmanDecoder* newChunkDecoder(InputBitStream& bitstream) const
+       {
+           return new HuffmanDecoder(bitstream, _chunkSize, _buffer != nullptr);
+       }
+
    private:
        static const int DECODING_BATCH_SIZE = 12; // in bits
        static const int TABLE0_MASK = (1 << DECODING_BATCH_SIZE) - 1;
@@ -51,14 +63,22 @@ namespace kanzi
        uint _alphabet[256];
        uint16 _table0[TABLE0_MASK + 1]; // small decoding table: code -> size, symbol
        uint16* _table1; // big decoding table: code -> size, symbol
+       uint32* _table2; // code -> count, size, 1 or 2 symbols (multi-stream mode)
+       byte* _buffer; // streams of a chunk (multi-stream mode)
+       int _bufferSize;
        short _sizes[256];
        int _chunkSize;
        uint64 _state; // holds bits read from bitstream
        uint _bits; // hold number of unused bits in 'state'
        int _minCodeLen;
+       int _jobs;
 
        void buildDecodingTables(int count);
 
+       void decodeStreams(byte block[], int count) THROW;
+
+       inline uint decodeStreamSymbol(const uint8 buf[], uint& pos);
+
        byte slowDecodeByte() THROW;
 
        inline byte fastDecodeByte();
@@ -87,6 +107,19 @@ namespace kanzi
       return byte(val);
    }
 
+   // Decode one symbol from a stream in memory at bit position 'pos'
+   inline uint HuffmanDecoder::decodeStreamSymbol(const uint8 buf[], uint& pos)
+   {
+      const uint64 st = uint64(BigEndian::readLong64((const byte*)&buf[pos >> 3])) << (pos & 7);
+      uint val = _table0[int(st >> (64 - DECODING_BATCH_SIZE))];
+
+      if (val == 0)
+         val = _table1[int(st >> (64 - (HuffmanCommon::MAX_SYMBOL_SIZE + 1)))];
+
+      pos += (val >> 8);
+      return val & 0xFF;
+   }
+
    inline void HuffmanDecoder::fetchBits()
    {
       const uint64 mask = (uint64(1) << _bits) - 1; // for _bits = 0
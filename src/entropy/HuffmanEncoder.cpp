@@ -20,8 +20,10 @@ limitations under the License.
 #include "HuffmanEncoder.hpp"
 #include "EntropyUtils.hpp"
 #include "ExpGolombEncoder.hpp"
+#include "ParallelChunks.hpp"
 #include "../BitStreamException.hpp"
 #include "../Global.hpp"
+#include "../Memory.hpp"
 
 using namespace kanzi;
 
@@ -29,7 +31,7 @@ using namespace kanzi;
 // resetting the frequency stats. 0 means that frequencies calculated at the
 // beginning of the block apply to the whole block.
 // The default chunk size is 65536 bytes.
-HuffmanEncoder::HuffmanEncoder(OutputBitStream& bitstream, int chunkSize) THROW : _bitstream(bitstream)
+HuffmanEncoder::HuffmanEncoder(OutputBitStream& bitstream, int chunkSize, bool multiStream, int jobs) THROW : _bitstream(bitstream)
 {
     if (chunkSize < 1024)
         throw invalid_argument("Huffman codec: The chunk size must be at least 1024");
@@ -40,8 +42,21 @@ HuffmanEncoder::HuffmanEncoder(OutputBitStream& bitstream, int chunkSize) THROW
         throw invalid_argument(ss.str());
     }
 
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "Huffman codec: Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
     _chunkSize = chunkSize;
+    _jobs = jobs;
     _maxCodeLength = 0;
+    _buffer = (multiStream == true) ? new byte[HuffmanCommon::getMaxStreamsSize(chunkSize)] : nullptr;
 
     // Default frequencies, sizes and codes
     for (int i = 0; i < 256; i++) {
@@ -135,7 +150,7 @@ void HuffmanEncoder::computeCodeLengths(uint frequencies[], short sizes[], int c
             throw invalid_argument(ss.str());
         }
 
-        if (_maxCodeLength > codeLen)
+        if (_maxCodeLength < codeLen)
             _maxCodeLength = codeLen;
 
         sizes[_sranks[i]] = codeLen;
@@ -198,6 +213,9 @@ int HuffmanEncoder::encode(byte block[], uint blkptr, uint count)
     if (count == 0)
         return 0;
 
+    if ((_jobs > 0) && (count > uint(_chunkSize)) && (ParallelChunks::writeLayout(_bitstream, _jobs) == true))
+        return ParallelChunks::encode(*this, _bitstream, block, blkptr, count, _chunkSize, _jobs);
+
     const int end = blkptr + count;
     int startChunk = blkptr;
     uint8* data = (uint8*)&block[0];
@@ -209,7 +227,10 @@ int HuffmanEncoder::encode(byte block[], uint blkptr, uint count)
         // Rebuild Huffman codes
         updateFrequencies(_freqs);
 
-        if (_maxCodeLength <= 16) {
+        if (_buffer != nullptr) {
+            encodeStreams(&data[startChunk], endChunk - startChunk);
+        }
+        else if (_maxCodeLength <= 16) {
             const int endChunk4 = 4 * ((endChunk - startChunk) / 4) + startChunk;
 
             for (int i = startChunk; i < endChunk4; i += 4) {
@@ -262,3 +283,49 @@ int HuffmanEncoder::encode(byte block[], uint blkptr, uint count)
 
     return count;
 }
+
+// Encode each part of the chunk into a separate byte stream, then write the
+// sizes of the streams and the streams
+void HuffmanEncoder::encodeStreams(const uint8 data[], int count)
+{
+    const int partSize = count / HuffmanCommon::NB_STREAMS;
+    uint sizes[HuffmanCommon::NB_STREAMS];
+    byte* p = &_buffer[0];
+
+    for (int n = 0; n < HuffmanCommon::NB_STREAMS; n++) {
+        const int start = n * partSize;
+        const int end = (n == HuffmanCommon::NB_STREAMS - 1) ? count : start + partSize;
+        byte* p0 = p;
+        uint64 st = 0;
+        int bits = 0; // number of pending bits in 'st'
+
+        for (int i = start; i < end; i++) {
+            const uint code = _codes[data[i]];
+            const int codeLen = int(code >> 24);
+            st = (st << codeLen) | (code & 0xFFFFFF);
+            bits += codeLen;
+
+            if (bits >= 32) {
+                bits -= 32;
+                BigEndian::writeInt32(p, int32(st >> bits));
+                p += 4;
+            }
+        }
+
+        while (bits >= 8) {
+            bits -= 8;
+            *p++ = byte(st >> bits);
+        }
+
+        if (bits > 0)
+            *p++ = byte(st << (8 - bits));
+
+        sizes[n] = uint(p - p0);
+    }
+
+    for (int n = 0; n < HuffmanCommon::NB_STREAMS; n++)
+        EntropyUtils::writeVarInt(_bitstream, sizes[n]);
+
+    if (p != &_buffer[0])
+        _bitstream.writeBits(&_buffer[0], 8 * uint(p - &_buffer[0]));
+}
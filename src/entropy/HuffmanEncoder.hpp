@@ -25,6 +25,11 @@ namespace kanzi
 {
 
    // Implementation of a static Huffman encoder.
+   // In multi-stream mode, each chunk is split into NB_STREAMS parts encoded
+   // into separate byte streams (preceded by their sizes) that can be decoded
+   // concurrently.
+   // With 'jobs' > 0, the chunks of a block are encoded concurrently (chunked
+   // layout, see ParallelChunks). 0 selects the sequential layout.
    class HuffmanEncoder : public EntropyEncoder 
    {
    private:
@@ -35,6 +40,8 @@ namespace kanzi
        uint _sranks[256]; // sorted ranks
        int _chunkSize;
        int _maxCodeLength;
+       byte* _buffer; // encoded streams (multi-stream mode)
+       int _jobs;
 
        void computeCodeLengths(uint frequencies[], short sizes[], int count) THROW;
 
@@ -42,10 +49,13 @@ namespace kanzi
 
        static void computeInPlaceSizesPhase2(uint data[], int n);
 
+       void encodeStreams(const uint8 data[], int count);
+
    public:
-       HuffmanEncoder(OutputBitStream& bitstream, int chunkSize=HuffmanCommon::MAX_CHUNK_SIZE) THROW;
+       HuffmanEncoder(OutputBitStream& bitstream, int chunkSize=HuffmanCommon::MAX_CHUNK_SIZE,
+          bool multiStream=false, int jobs=0) THROW;
 
-       ~HuffmanEncoder() { dispose(); }
+       ~HuffmanEncoder() { dispose(); delete[] _buffer; }
 
        int updateFrequencies(uint frequencies[]) THROW;
 
@@ -54,6 +64,12 @@ namespace kanzi
        OutputBitStream& getBitStream() const { return _bitstream; }
 
        void dispose(){};
+
+       // Encoder of the chunks in the chunked layout
+       HuffmanEncoder* newChunkEncoder(OutputBitStream& bitstream) const
+       {
+           return new HuffmanEncoder(bitstream, _chunkSize, _buffer != nullptr);
+       }
    };
 
 }
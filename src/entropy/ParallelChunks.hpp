@@ -0,0 +1,360 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _ParallelChunks_
+#define _ParallelChunks_
+
+#include <sstream>
+#include <vector>
+#include "EntropyUtils.hpp"
+#include "../BitStreamException.hpp"
+#include "../concurrent.hpp"
+#include "../EntropyDecoder.hpp"
+#include "../EntropyEncoder.hpp"
+#include "../Global.hpp"
+#include "../util.hpp"
+#include "../bitstream/DefaultInputBitStream.hpp"
+#include "../bitstream/DefaultOutputBitStream.hpp"
+
+using namespace std;
+
+namespace kanzi
+{
+
+   // Chunked layout of the entropy codecs splitting a block into chunks with
+   // their own statistics (Huffman, ANS, range and FSE).
+   // When the block has several chunks, a flag (1 bit) selects the layout: 0
+   // for the sequential layout (single job), 1 for the chunked layout. Then, in
+   // the chunked layout, the size in bits of each chunk (varint) comes first,
+   // then the chunks, each one coded as in the sequential layout.
+   // The chunks do not depend on each other: ranges of chunks are encoded
+   // concurrently into private bitstreams (then concatenated) and decoded
+   // concurrently by up to 'jobs' tasks, in place when the input bitstream
+   // reads from memory. Beyond the flag, the layout does not depend on the
+   // number of jobs.
+   // The codec (T) provides newChunkEncoder() or newChunkDecoder(), returning a
+   // codec with the same parameters and the sequential layout.
+   class ParallelChunks
+   {
+   public:
+       // Write the layout flag of a block with several chunks, return true for
+       // the chunked layout
+       static bool writeLayout(OutputBitStream& obs, int jobs) THROW
+       {
+           obs.writeBit((jobs > 1) ? 1 : 0);
+           return jobs > 1;
+       }
+
+       // Read the layout flag of a block with several chunks, return true for
+       // the chunked layout
+       static bool readLayout(InputBitStream& ibs) THROW
+       {
+           return ibs.readBit() == 1;
+       }
+
+       // Return the number of bytes encoded ('len' on success)
+       template <class T>
+       static int encode(const T& codec, OutputBitStream& obs, byte block[], uint blkptr, uint len,
+           uint chunkSize, int jobs) THROW;
+
+       // Return the number of bytes decoded ('len' on success)
+       template <class T>
+       static int decode(const T& codec, InputBitStream& ibs, byte block[], uint blkptr, uint len,
+           uint chunkSize, int jobs) THROW;
+
+   private:
+       template <class Task>
+       static void run(vector<Task*>& tasks) THROW;
+   };
+
+
+   // Encode the chunks in [start, end) of a block to a private bitstream
+   template <class T>
+   class ChunkEncodingTask : public Task<int> {
+   public:
+       ChunkEncodingTask(const T& codec, byte block[], uint start, uint end, uint chunkSize, uint sizes[])
+           : _codec(codec)
+           , _block(block)
+           , _start(start)
+           , _end(end)
+           , _chunkSize(chunkSize)
+           , _sizes(sizes)
+           , _written(0)
+           , _encoded(0)
+       {
+       }
+
+       ~ChunkEncodingTask() {}
+
+       int run() THROW;
+
+       const T& _codec;
+       byte* _block;
+       const uint _start;
+       const uint _end;
+       const uint _chunkSize;
+       uint* _sizes; // size in bits of each chunk
+       string _data; // content of the private bitstream
+       uint64 _written; // size of the private bitstream in bits
+       uint _encoded; // number of bytes encoded
+   };
+
+
+   // Decode the chunks in [start, end) of a block from the concatenated data of
+   // the chunks, at bit offset 'offset' (in the input data or in a copy)
+   template <class T>
+   class ChunkDecodingTask : public Task<int> {
+   public:
+       ChunkDecodingTask(const T& codec, byte data[], uint64 offset, uint64 size, byte block[], uint start, uint end)
+           : _codec(codec)
+           , _data(data)
+           , _offset(offset)
+           , _size(size)
+           , _block(block)
+           , _start(start)
+           , _end(end)
+       {
+       }
+
+       ~ChunkDecodingTask() {}
+
+       int run() THROW;
+
+   private:
+       const T& _codec;
+       byte* _data;
+       const uint64 _offset;
+       const uint64 _size; // in bits
+       byte* _block;
+       const uint _start;
+       const uint _end;
+   };
+
+
+   template <class T>
+   int ChunkEncodingTask<T>::run() THROW
+   {
+       stringbuf buf;
+       ostream os(&buf);
+       DefaultOutputBitStream obs(os, 65536);
+       EntropyEncoder* ee = _codec.newChunkEncoder(obs);
+       uint start = _start;
+
+       try {
+           for (int n = 0; start < _end; n++) {
+               const uint length = (start + _chunkSize < _end) ? _chunkSize : _end - start;
+
+               if (ee->encode(_block, start, length) != int(length))
+                   break;
+
+               _sizes[n] = uint(obs.written() - _written);
+               _written = obs.written();
+               start += length;
+           }
+       }
+       catch (exception&) {
+           delete ee;
+           throw;
+       }
+
+       delete ee;
+       obs.close();
+       _data = buf.str();
+       _encoded = start - _start;
+       return int(_encoded);
+   }
+
+
+   template <class T>
+   int ChunkDecodingTask<T>::run() THROW
+   {
+       const uint64 first = _offset >> 3;
+       const uint skip = uint(_offset & 7);
+       istreambuf<char> buf(reinterpret_cast<char*>(&_data[first]), streamsize(((_offset + _size + 7) >> 3) - first));
+       istream is(&buf);
+       DefaultInputBitStream ibs(is, 16384);
+       EntropyDecoder* ed = _codec.newChunkDecoder(ibs);
+       int res;
+
+       try {
+           if (skip != 0)
+               ibs.readBits(skip);
+
+           res = ed->decode(_block, _start, _end - _start);
+       }
+       catch (exception&) {
+           delete ed;
+           throw;
+       }
+
+       delete ed;
+
+       // All the bits of the chunks must have been consumed
+       if ((res != int(_end - _start)) || (ibs.read() != _size + skip))
+           throw BitStreamException("Invalid bitstream: incorrect entropy chunk size", BitStreamException::INVALID_STREAM);
+
+       return res;
+   }
+
+
+   template <class Task>
+   void ParallelChunks::run(vector<Task*>& tasks) THROW
+   {
+       try {
+           if (tasks.size() == 1) {
+               // Synchronous call
+               tasks[0]->run();
+           }
+#ifdef CONCURRENCY_ENABLED
+           else {
+               // Run the tasks in parallel (in the shared thread pool)
+               vector<int> results;
+               ThreadPool::instance().run(tasks, results);
+           }
+#endif
+       }
+       catch (exception&) {
+           for (Task* task : tasks)
+               delete task;
+
+           throw;
+       }
+   }
+
+
+   template <class T>
+   int ParallelChunks::encode(const T& codec, OutputBitStream& obs, byte block[], uint blkptr, uint len,
+       uint chunkSize, int jobs) THROW
+   {
+       const int nbChunks = int((len + chunkSize - 1) / chunkSize);
+       const int nbTasks = (jobs < nbChunks) ? jobs : nbChunks;
+       vector<int> chunksPerTask(nbTasks);
+       vector<uint> sizes(nbChunks);
+       vector<ChunkEncodingTask<T>*> tasks;
+       Global::computeJobsPerTask(&chunksPerTask[0], nbChunks, nbTasks);
+
+       for (int j = 0, c = 0; j < nbTasks; j++) {
+           const uint start = blkptr + uint(c) * chunkSize;
+           const uint end = (j == nbTasks - 1) ? blkptr + len : start + uint(chunksPerTask[j]) * chunkSize;
+           tasks.push_back(new ChunkEncodingTask<T>(codec, block, start, end, chunkSize, &sizes[c]));
+           c += chunksPerTask[j];
+       }
+
+       ParallelChunks::run(tasks);
+       int res = 0;
+
+       for (ChunkEncodingTask<T>* task : tasks) {
+           res += int(task->_encoded);
+
+           if (task->_encoded != task->_end - task->_start)
+               break;
+       }
+
+       if (res == int(len)) {
+           for (int c = 0; c < nbChunks; c++)
+               EntropyUtils::writeVarInt(obs, sizes[c]);
+
+           // Concatenate the private bitstreams
+           for (ChunkEncodingTask<T>* task : tasks) {
+               byte* data = reinterpret_cast<byte*>(&task->_data[0]);
+
+               for (uint64 n = 0, written = task->_written; written > 0; ) {
+                   const uint chkSize = uint(min(written, uint64(1) << 30));
+                   obs.writeBits(&data[n], chkSize);
+                   n += uint64((chkSize + 7) >> 3);
+                   written -= uint64(chkSize);
+               }
+           }
+       }
+
+       for (ChunkEncodingTask<T>* task : tasks)
+           delete task;
+
+       return res;
+   }
+
+
+   template <class T>
+   int ParallelChunks::decode(const T& codec, InputBitStream& ibs, byte block[], uint blkptr, uint len,
+       uint chunkSize, int jobs) THROW
+   {
+       const int nbChunks = int((len + chunkSize - 1) / chunkSize);
+       vector<uint64> offsets(nbChunks + 1); // bit offsets of the chunks
+       offsets[0] = 0;
+
+       for (int c = 0; c < nbChunks; c++) {
+           const uint size = EntropyUtils::readVarInt(ibs);
+
+           // At most twice the chunk plus headers
+           if (uint64(size) > 16 * uint64(chunkSize) + (1 << 23)) {
+               stringstream ss;
+               ss << "Invalid bitstream: incorrect entropy chunk size " << size;
+               throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+           }
+
+           offsets[c + 1] = offsets[c] + size;
+       }
+
+       // Decode the chunks in place when the bitstream reads from memory,
+       // otherwise from a copy (followed by 8 bytes of padding)
+       DefaultInputBitStream* dibs = dynamic_cast<DefaultInputBitStream*>(&ibs);
+       uint bitIndex = 0;
+       uint64 available = 0;
+       byte* mem = (dibs == nullptr) ? nullptr : dibs->data(bitIndex, available);
+       vector<byte> data;
+
+       if (mem != nullptr) {
+           if (offsets[nbChunks] + bitIndex > (available << 3))
+               throw BitStreamException("No more data to read in the bitstream", BitStreamException::END_OF_STREAM);
+       }
+       else {
+           data.resize(size_t((offsets[nbChunks] + 7) >> 3) + 8);
+           mem = &data[0];
+
+           for (uint64 n = 0, remaining = offsets[nbChunks]; remaining > 0; ) {
+               const uint chkSize = uint(min(remaining, uint64(1) << 30));
+               ibs.readBits(&data[n], chkSize);
+               n += uint64((chkSize + 7) >> 3);
+               remaining -= uint64(chkSize);
+           }
+       }
+
+       const int nbTasks = (jobs < nbChunks) ? jobs : nbChunks;
+       vector<int> chunksPerTask(nbTasks);
+       vector<ChunkDecodingTask<T>*> tasks;
+       Global::computeJobsPerTask(&chunksPerTask[0], nbChunks, nbTasks);
+
+       for (int j = 0, c = 0; j < nbTasks; j++) {
+           const int c2 = c + chunksPerTask[j];
+           const uint start = blkptr + uint(c) * chunkSize;
+           const uint end = (j == nbTasks - 1) ? blkptr + len : blkptr + uint(c2) * chunkSize;
+           tasks.push_back(new ChunkDecodingTask<T>(codec, mem, offsets[c] + bitIndex, offsets[c2] - offsets[c],
+               block, start, end));
+           c = c2;
+       }
+
+       ParallelChunks::run(tasks);
+
+       for (ChunkDecodingTask<T>* task : tasks)
+           delete task;
+
+       // Move the cursor past the chunks decoded in place
+       if (data.size() == 0)
+           dibs->skip(offsets[nbChunks]);
+
+       return int(len);
+   }
+}
+#endif
@@ -16,6 +16,7 @@ limitations under the License.
 #include <sstream>
 #include "RangeDecoder.hpp"
 #include "EntropyUtils.hpp"
+#include "ParallelChunks.hpp"
 
 using namespace kanzi;
 
@@ -23,7 +24,7 @@ using namespace kanzi;
 // resetting the frequency stats. 0 means that frequencies calculated at the
 // beginning of the block apply to the whole block.
 // The default chunk size is 65536 bytes.
-RangeDecoder::RangeDecoder(InputBitStream& bitstream, int chunkSize) THROW : _bitstream(bitstream)
+RangeDecoder::RangeDecoder(InputBitStream& bitstream, int chunkSize, bool interleaved, int jobs) THROW : _bitstream(bitstream)
 {
     if ((chunkSize != 0) && (chunkSize < 1024))
         throw invalid_argument("The chunk size must be at least 1024");
@@ -31,12 +32,27 @@ RangeDecoder::RangeDecoder(InputBitStream& bitstream, int chunkSize) THROW : _bi
     if (chunkSize > 1 << 30)
         throw invalid_argument("The chunk size must be at most 2^30");
 
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
     _range = TOP_RANGE;
     _low = 0;
     _code = 0;
     _f2s_length = 0;
-    _f2s = new short[_f2s_length];
+    _f2s = new uint8[_f2s_length];
     _chunkSize = chunkSize;
+    _interleaved = interleaved;
+    _jobs = jobs;
+    _buffer = new byte[0];
+    _bufferSize = 0;
     _shift = 0;
     memset(_alphabet, 0, sizeof(uint) * 256);
     memset(_freqs, 0, sizeof(uint) * 256);
@@ -101,7 +117,7 @@ int RangeDecoder::decodeHeader(uint frequencies[])
     if (_f2s_length < scale) {
         delete[] _f2s;
         _f2s_length = scale;
-        _f2s = new short[_f2s_length];
+        _f2s = new uint8[_f2s_length];
     }
 
     // Create histogram of frequencies scaled to 'range' and reverse mapping
@@ -110,7 +126,7 @@ int RangeDecoder::decodeHeader(uint frequencies[])
         const int base = int(_cumFreqs[i]);
 
         for (int j = frequencies[i] - 1; j >= 0; j--)
-            _f2s[base + j] = short(i);
+            _f2s[base + j] = uint8(i);
     }
 
     return alphabetSize;
@@ -125,16 +141,27 @@ int RangeDecoder::decode(byte block[], uint blkptr, uint len)
 
     const int end = blkptr + len;
     const int sz = (_chunkSize == 0) ? len : _chunkSize;
+
+    if ((_jobs > 0) && (len > uint(sz)) && (ParallelChunks::readLayout(_bitstream) == true))
+        return ParallelChunks::decode(*this, _bitstream, block, blkptr, len, sz, _jobs);
+
     int startChunk = blkptr;
 
     while (startChunk < end) {
         if (decodeHeader(_freqs) == 0)
             return startChunk - blkptr;
 
+        const int endChunk = (startChunk + sz < end) ? startChunk + sz : end;
+
+        if (_interleaved) {
+            decodeLanes(&block[startChunk], endChunk - startChunk);
+            startChunk = endChunk;
+            continue;
+        }
+
         _range = TOP_RANGE;
         _low = 0;
         _code = _bitstream.readBits(60);
-        const int endChunk = (startChunk + sz < end) ? startChunk + sz : end;
 
         for (int i = startChunk; i < endChunk; i++)
             block[i] = decodeByte();
@@ -149,7 +176,7 @@ byte RangeDecoder::decodeByte()
 {
     // Compute next low and range
     _range >>= _shift;
-    const int symbol = _f2s[int((_code - _low) / _range)];
+    const int symbol = int(_f2s[locate(_code - _low, _range)]);
     const uint64 cumFreq = _cumFreqs[symbol];
     const uint64 freq = _cumFreqs[symbol + 1] - cumFreq;
     _low += (cumFreq * _range);
@@ -163,6 +190,10 @@ byte RangeDecoder::decodeByte()
 
             // Normalize
             _range = ~(_low-1) & BOTTOM_RANGE;
+
+            if (_range == 0)
+                throw BitStreamException("Invalid bitstream: incorrect range in range decoder",
+                    BitStreamException::INVALID_STREAM);
         }
 
         _code = (_code << 28) | _bitstream.readBits(28);
@@ -172,3 +203,57 @@ byte RangeDecoder::decodeByte()
 
     return byte(symbol);
 }
+
+// Decode the 2 lanes of a chunk ([0, n/2) and [n/2, n)) symbol by symbol
+void RangeDecoder::decodeLanes(byte block[], int count)
+{
+    const int half = count >> 1;
+    uint sizes[2];
+    uint64 total = 0;
+
+    for (int k = 0; k < 2; k++) {
+        // Lane size in bytes. At most 64 bits per symbol (plus final 'low')
+        const int n = (k == 0) ? half : count - half;
+        sizes[k] = EntropyUtils::readVarInt(_bitstream);
+
+        if ((sizes[k] < 8) || (sizes[k] > 8 * uint(n) + 16)) {
+            stringstream ss;
+            ss << "Invalid bitstream: incorrect lane size " << sizes[k] << " in range decoder";
+            throw BitStreamException(ss.str(), BitStreamException::INVALID_STREAM);
+        }
+
+        if (_bufferSize < uint(total + sizes[k] + 8)) {
+            byte* buf = new byte[total + sizes[k] + 8];
+            memcpy(&buf[0], &_buffer[0], size_t(total));
+            delete[] _buffer;
+            _buffer = buf;
+            _bufferSize = uint(total + sizes[k] + 8);
+        }
+
+        _bitstream.readBits(&_buffer[total], 8 * sizes[k]);
+        total += sizes[k];
+    }
+
+    memset(&_buffer[total], 0, 8);
+    Lane lanes[2];
+
+    for (int k = 0; k < 2; k++) {
+        lanes[k]._data = &_buffer[(k == 0) ? 0 : sizes[0]];
+        lanes[k]._range = TOP_RANGE;
+        lanes[k]._low = 0;
+        lanes[k]._code = uint64(BigEndian::readLong64(lanes[k]._data)) >> 4;
+        lanes[k]._position = 60;
+        lanes[k]._end = 8 * uint64(sizes[k]);
+    }
+
+    Lane lane0 = lanes[0];
+    Lane lane1 = lanes[1];
+
+    for (int i = 0; i < half; i++) {
+        block[i] = decodeSymbol(lane0);
+        block[half + i] = decodeSymbol(lane1);
+    }
+
+    if ((count & 1) != 0)
+        block[count - 1] = decodeSymbol(lane1);
+}
@@ -17,7 +17,9 @@ limitations under the License.
 #ifndef _RangeDecoder_
 #define _RangeDecoder_
 
+#include "../BitStreamException.hpp"
 #include "../EntropyDecoder.hpp"
+#include "../Memory.hpp"
 
 using namespace std;
 
@@ -28,15 +30,22 @@ namespace kanzi
    // described by G.N.N Martin in his seminal article in 1979.
    // [G.N.N. Martin on the Data Recording Conference, Southampton, 1979]
    // Optimized for speed.
+   // In interleaved mode, each chunk is split into 2 lanes, each one coded by its
+   // own state into its own stream. The 2 lanes are decoded in the same loop so
+   // that the divisions and table lookups of both lanes overlap in the CPU.
+   // With 'jobs' > 0, the chunks of a block are decoded concurrently (chunked
+   // layout, see ParallelChunks). 0 selects the sequential layout.
 
    class RangeDecoder : public EntropyDecoder {
    public:
+       static const int DEFAULT_CHUNK_SIZE = 1 << 16; // 64 KB by default
        static const int DECODING_BATCH_SIZE = 12; // in bits
        static const int DECODING_MASK = (1 << DECODING_BATCH_SIZE) - 1;
 
-       RangeDecoder(InputBitStream& bitstream, int chunkSize=DEFAULT_CHUNK_SIZE) THROW;
+       RangeDecoder(InputBitStream& bitstream, int chunkSize=DEFAULT_CHUNK_SIZE, bool interleaved=false,
+          int jobs=0) THROW;
 
-       ~RangeDecoder() { delete[] _f2s; dispose(); }
+       ~RangeDecoder() { delete[] _buffer; delete[] _f2s; dispose(); }
 
        int decode(byte block[], uint blkptr, uint len);
 
@@ -44,12 +53,26 @@ namespace kanzi
 
        void dispose(){};
 
+       // Decoder of the chunks in the chunked layout
+       RangeDecoder* newChunkDecoder(InputBitStream& bitstream) const
+       {
+           return new RangeDecoder(bitstream, _chunkSize, _interleaved);
+       }
+
    private:
+       // State of a lane (interleaved mode): range coder and stream in memory
+       struct Lane {
+           uint64 _code;
+           uint64 _low;
+           uint64 _range;
+           const byte* _data;
+           uint64 _position; // in bits
+           uint64 _end; // in bits
+       };
+
        static const uint64 TOP_RANGE    = 0x0FFFFFFFFFFFFFFF;
        static const uint64 BOTTOM_RANGE = 0x000000000000FFFF;
        static const uint64 RANGE_MASK   = 0x0FFFFFFF00000000;
-       static const int DEFAULT_CHUNK_SIZE = 1 << 16; // 64 KB by default
-       static const int DEFAULT_LOG_RANGE = 13;
 
        uint64 _code;
        uint64 _low;
@@ -57,16 +80,74 @@ namespace kanzi
        uint _alphabet[256];
        uint _freqs[256];
        uint64 _cumFreqs[257];
-       short* _f2s;
+       uint8* _f2s; // cumulated frequency -> symbol
        int _f2s_length;
+       byte* _buffer;
+       uint _bufferSize;
        InputBitStream& _bitstream;
        uint _chunkSize;
        uint _shift;
+       bool _interleaved;
+       int _jobs;
 
        int decodeHeader(uint frequencies[]);
 
        inline byte decodeByte();
+
+       void decodeLanes(byte block[], int count);
+
+       inline byte decodeSymbol(Lane& lane) THROW;
+
+       inline uint locate(uint64 x, uint64 r) const;
    };
 
+
+   // Return x / r, the position in the cumulated frequencies. The position is
+   // masked (no branch) since an invalid bitstream could make the decoder read
+   // outside of the table: the symbol is then garbage but the decoder stays in
+   // bounds and corrupted ranges are still rejected during normalization.
+   inline uint RangeDecoder::locate(uint64 x, uint64 r) const
+   {
+      return uint(x / r) & ((uint(1) << _shift) - 1);
+   }
+
+
+   // Same as decodeByte with the state and the stream of a lane
+   inline byte RangeDecoder::decodeSymbol(Lane& lane) THROW
+   {
+      lane._range >>= _shift;
+      const int symbol = int(_f2s[locate(lane._code - lane._low, lane._range)]);
+      const uint64 cumFreq = _cumFreqs[symbol];
+      lane._low += (cumFreq * lane._range);
+      lane._range *= (_cumFreqs[symbol + 1] - cumFreq);
+
+      while (true) {
+         if (((lane._low ^ (lane._low + lane._range)) & RANGE_MASK) != 0) {
+            if (lane._range > BOTTOM_RANGE)
+               break;
+
+            // Normalize
+            lane._range = ~(lane._low-1) & BOTTOM_RANGE;
+
+            if (lane._range == 0)
+               throw BitStreamException("Invalid bitstream: incorrect range in range decoder",
+                  BitStreamException::INVALID_STREAM);
+         }
+
+         if (lane._position + 28 > lane._end)
+            throw BitStreamException("Invalid bitstream: incorrect lane size in range decoder",
+               BitStreamException::INVALID_STREAM);
+
+         // Read 28 bits at the bit position (the buffer is padded)
+         const uint64 bits = uint64(BigEndian::readLong64(&lane._data[lane._position >> 3]));
+         lane._code = (lane._code << 28) | ((bits << (lane._position & 7)) >> 36);
+         lane._position += 28;
+         lane._range <<= 28;
+         lane._low <<= 28;
+      }
+
+      return byte(symbol);
+   }
+
 }
 #endif
@@ -16,6 +16,7 @@ limitations under the License.
 #include <sstream>
 #include "RangeEncoder.hpp"
 #include "EntropyUtils.hpp"
+#include "ParallelChunks.hpp"
 #include "../Global.hpp"
 
 using namespace kanzi;
@@ -24,7 +25,7 @@ using namespace kanzi;
 // resetting the frequency stats. 0 means that frequencies calculated at the
 // beginning of the block apply to the whole block.
 // The default chunk size is 65536 bytes.
-RangeEncoder::RangeEncoder(OutputBitStream& bitstream, int chunkSize, int logRange) THROW : _bitstream(bitstream)
+RangeEncoder::RangeEncoder(OutputBitStream& bitstream, int chunkSize, int logRange, bool interleaved, int jobs) THROW : _bitstream(bitstream)
 {
     if ((chunkSize != 0) && (chunkSize < 1024))
         throw invalid_argument("The chunk size must be at least 1024");
@@ -38,8 +39,23 @@ RangeEncoder::RangeEncoder(OutputBitStream& bitstream, int chunkSize, int logRan
         throw invalid_argument(ss.str());
     }
 
+    if (jobs < 0) {
+        stringstream ss;
+        ss << "Invalid number of jobs: " << jobs;
+        throw invalid_argument(ss.str());
+    }
+
+#ifndef CONCURRENCY_ENABLED
+    if (jobs > 1)
+        throw invalid_argument("The number of jobs is limited to 1 in this version");
+#endif
+
     _logRange = logRange;
     _chunkSize = chunkSize;
+    _interleaved = interleaved;
+    _jobs = jobs;
+    _buffer = new byte[0];
+    _bufferSize = 0;
     _low = 0;
     _range = TOP_RANGE;
     _shift = 0;
@@ -108,6 +124,10 @@ int RangeEncoder::encode(byte block[], uint blkptr, uint len)
 
     const int end = blkptr + len;
     const int sz = (_chunkSize == 0) ? len : _chunkSize;
+
+    if ((_jobs > 0) && (len > uint(sz)) && (ParallelChunks::writeLayout(_bitstream, _jobs) == true))
+        return ParallelChunks::encode(*this, _bitstream, block, blkptr, len, sz, _jobs);
+
     int startChunk = blkptr;
 
     while (startChunk < end) {
@@ -125,6 +145,20 @@ int RangeEncoder::encode(byte block[], uint blkptr, uint len)
 
         _shift = lr;
 
+        if (_interleaved) {
+            // Lanes [0, n/2) and [n/2, n), each one preceded by its size in bytes
+            const uint8* data = (const uint8*) &block[startChunk];
+            const int half = (endChunk - startChunk) >> 1;
+            const uint size0 = encodeLane(&data[0], half);
+            EntropyUtils::writeVarInt(_bitstream, size0);
+            _bitstream.writeBits(_buffer, 8 * size0);
+            const uint size1 = encodeLane(&data[half], endChunk - startChunk - half);
+            EntropyUtils::writeVarInt(_bitstream, size1);
+            _bitstream.writeBits(_buffer, 8 * size1);
+            startChunk = endChunk;
+            continue;
+        }
+
         for (int i = startChunk; i < endChunk; i++)
             encodeByte(block[i]);
 
@@ -162,6 +196,83 @@ void RangeEncoder::encodeByte(byte b)
     }
 }
 
+// Encode the symbols of a lane (same arithmetic as encodeByte) into the buffer,
+// most significant bits first. Return the size of the lane in bytes.
+uint RangeEncoder::encodeLane(const uint8 data[], int count)
+{
+    if (_bufferSize < uint(2 * count + 64)) {
+        delete[] _buffer;
+        _bufferSize = uint(2 * count + 64);
+        _buffer = new byte[_bufferSize];
+    }
+
+    uint64 low = 0;
+    uint64 range = TOP_RANGE;
+    uint64 bits = 0; // pending bits
+    uint nbBits = 0;
+    uint n = 0;
+
+    for (int i = 0; i < count; i++) {
+        const uint64 cumFreq = _cumFreqs[data[i]];
+        const uint64 freq = _cumFreqs[data[i] + 1] - cumFreq;
+        range >>= _shift;
+        low += (cumFreq * range);
+        range *= freq;
+
+        while (true) {
+            if (((low ^ (low + range)) & RANGE_MASK) != 0) {
+                if (range > BOTTOM_RANGE)
+                    break;
+
+                // Normalize
+                range = ~(low-1) & BOTTOM_RANGE;
+            }
+
+            if (n + 16 > _bufferSize) {
+                // Very unlikely (more than 16 bits per symbol so far)
+                byte* buf = new byte[2 * _bufferSize];
+                memcpy(&buf[0], &_buffer[0], n);
+                delete[] _buffer;
+                _buffer = buf;
+                _bufferSize *= 2;
+            }
+
+            bits = (bits << 28) | ((low >> 32) & 0x0FFFFFFF);
+            nbBits += 28;
+
+            while (nbBits >= 8) {
+                nbBits -= 8;
+                _buffer[n++] = byte(bits >> nbBits);
+            }
+
+            range <<= 28;
+            low <<= 28;
+        }
+    }
+
+    // Flush 'low' (60 bits) and the pending bits
+    bits = (bits << 28) | ((low >> 32) & 0x0FFFFFFF);
+    nbBits += 28;
+
+    while (nbBits >= 8) {
+        nbBits -= 8;
+        _buffer[n++] = byte(bits >> nbBits);
+    }
+
+    bits = (bits << 32) | (low & 0xFFFFFFFF);
+    nbBits += 32;
+
+    while (nbBits >= 8) {
+        nbBits -= 8;
+        _buffer[n++] = byte(bits >> nbBits);
+    }
+
+    if (nbBits > 0)
+        _buffer[n++] = byte(bits << (8 - nbBits));
+
+    return n;
+}
+
 // Compute chunk frequencies, cumulated frequencies and encode chunk header
 int RangeEncoder::rebuildStatistics(byte block[], int start, int end, int lr)
 {
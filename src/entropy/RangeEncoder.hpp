@@ -27,13 +27,21 @@ namespace kanzi
    // described by G.N.N Martin in his seminal article in 1979.
    // [G.N.N. Martin on the Data Recording Conference, Southampton, 1979]
    // Optimized for speed.
+   // In interleaved mode, each chunk is split into 2 lanes, each one coded by its
+   // own state into its own stream. The decoding of the lanes can overlap in the CPU.
+   // With 'jobs' > 0, the chunks of a block are encoded concurrently (chunked
+   // layout, see ParallelChunks). 0 selects the sequential layout.
 
    class RangeEncoder : public EntropyEncoder
    {
    public:
-       RangeEncoder(OutputBitStream& bitstream, int chunkSize=DEFAULT_CHUNK_SIZE, int logRange=DEFAULT_LOG_RANGE) THROW;
+       static const int DEFAULT_CHUNK_SIZE = 1 << 16; // 64 KB by default
+       static const int DEFAULT_LOG_RANGE = 13;
 
-       ~RangeEncoder() { dispose(); };
+       RangeEncoder(OutputBitStream& bitstream, int chunkSize=DEFAULT_CHUNK_SIZE, int logRange=DEFAULT_LOG_RANGE,
+          bool interleaved=false, int jobs=0) THROW;
+
+       ~RangeEncoder() { delete[] _buffer; dispose(); };
 
        int encode(byte block[], uint blkptr, uint len);
 
@@ -41,22 +49,30 @@ namespace kanzi
 
        void dispose(){};
 
+       // Encoder of the chunks in the chunked layout
+       RangeEncoder* newChunkEncoder(OutputBitStream& bitstream) const
+       {
+           return new RangeEncoder(bitstream, _chunkSize, _logRange, _interleaved);
+       }
+
    private:
        static const uint64 TOP_RANGE    = 0x0FFFFFFFFFFFFFFF;
        static const uint64 BOTTOM_RANGE = 0x000000000000FFFF;
        static const uint64 RANGE_MASK   = 0x0FFFFFFF00000000;
-       static const int DEFAULT_CHUNK_SIZE = 1 << 16; // 64 KB by default
-       static const int DEFAULT_LOG_RANGE = 13;
 
        uint64 _low;
        uint64 _range;
        uint _alphabet[256];
        uint _freqs[256];
        uint64 _cumFreqs[257];
+       byte* _buffer;
+       uint _bufferSize;
        OutputBitStream& _bitstream;
        uint _chunkSize;
        uint _logRange;
        uint _shift;
+       bool _interleaved;
+       int _jobs;
 
        int rebuildStatistics(byte block[], int start, int end, int lr);
 
@@ -64,6 +80,8 @@ namespace kanzi
 
        inline void encodeByte(byte b);
 
+       uint encodeLane(const uint8 data[], int count);
+
        bool encodeHeader(int alphabetSize, uint alphabet[], uint frequencies[], int lr);
    };
 
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef _TPAQPredictor_
 #define _TPAQPredictor_
 
+#include "../Allocator.hpp"
 #include "../Context.hpp"
 #include "../Global.hpp"
 #include "../Predictor.hpp"
@@ -62,16 +63,32 @@ namespace kanzi
 
        ~TPAQPredictor();
 
+       // Restore the initial state to reuse the predictor for another block.
+       // The tables are reallocated only if the sizes derived from the context
+       // change and only the part of the buffer written to is cleared. The hash
+       // table of positions is not cleared (see _hashBase). The states tables
+       // are cleared.
+       void reset(Context* ctx = nullptr);
+
        void update(int bit);
 
        // Return the split value representing the probability of 1 in the [0..4095] range.
        int get() { return _pr; }
 
+       // Maximum reduction of the big tables (context 'modelShrink'). Each step
+       // divides the states and hash tables by 4 and the order 2 table by 2.
+       static const int MAX_MODEL_SHRINK = 3;
+
+       // Approximate memory used by a predictor for the requested block size
+       // (context 'blockSize') with the tables reduced by modelShrink.
+       static int64 getMemoryFootprint(int blockSize, int modelShrink);
+
    private:
        static const int MAX_LENGTH = 88;
        static const int BUFFER_SIZE = 64 * 1024 * 1024;
        static const int HASH_SIZE = 16 * 1024 * 1024;
-       static const int MASK_BUFFER = BUFFER_SIZE - 1;
+       static const int SMALL_STATES_SIZE = 1 << 24;
+       static const uint32 MAX_HASH_BASE = 1 << 30;
        static const int MASK_80808080 = 0x80808080;
        static const int MASK_F0F0F000 = 0xF0F0F000;
        static const int MASK_4F4FFFFF = 0x4F4FFFFF;
@@ -79,6 +96,12 @@ namespace kanzi
 
        #define SSE0_RATE(T) ((T == true) ? 6 : 7)
 
+       static int getStatesSize(int blockSize);
+
+       static int getBufferSize(int blockSize);
+
+       static int getMixersSize(int size);
+
        int _pr; // next predicted value (0-4095)
        int32 _c0; // bitwise context: last 0-7 bits with a leading 1 (1-255)
        int32 _c4; // last 4 whole bytes, last is in low 8 bits
@@ -101,6 +124,10 @@ namespace kanzi
        int32 _statesMask;
        int32 _mixersMask;
        int32 _hashMask;
+       int32 _smallStatesMask;
+       int32 _bufferMask;
+       uint32 _hashBase; // added to the positions in _hashes, entries from previous blocks are too far to match
+       Allocator* _allocator; // big tables
        uint8* _cp0; // context pointers
        uint8* _cp1;
        uint8* _cp2;
@@ -277,10 +304,32 @@ namespace kanzi
    TPAQPredictor<T>::TPAQPredictor(Context* ctx)
        : _sse0(256)
        , _sse1(65536)
+   {
+       _pos = 0;
+       _mixers = nullptr;
+       _buffer = nullptr;
+       _hashes = nullptr;
+       _bigStatesMap = nullptr;
+       _smallStatesMap0 = nullptr;
+       _smallStatesMap1 = nullptr;
+       _statesMask = -1;
+       _mixersMask = -1;
+       _hashMask = -1;
+       _smallStatesMask = -1;
+       _bufferMask = -1;
+       _hashBase = 0;
+       _allocator = &Allocator::getAllocator(ctx);
+       reset(ctx);
+   }
+
+   template <bool T>
+   void TPAQPredictor<T>::reset(Context* ctx)
    {
        int statesSize = 1 << 28;
        int mixersSize = 1 << 12;
        int hashSize = HASH_SIZE;
+       int smallStatesSize = SMALL_STATES_SIZE;
+       int bufferSize = BUFFER_SIZE;
        uint extraMem = 0;
 
        if (ctx != nullptr) {
@@ -288,37 +337,96 @@ namespace kanzi
 
            // Block size requested by the user
            // The user can request a big block size to force more states
-           const int rbsz = ctx->getInt("blockSize");
-
-           if (rbsz >= 64 * 1024 * 1024)
-               statesSize = 1 << 29;
-           else if (rbsz >= 16 * 1024 * 1024)
-               statesSize = 1 << 28;
-           else
-               statesSize = (rbsz >= 1024 * 1024) ? 1 << 27 : 1 << 26;
+           statesSize = getStatesSize(ctx->getInt("blockSize"));
 
            // Actual size of the current block
-           // Too many mixers hurts compression for small blocks.
-           // Too few mixers hurts compression for big blocks.
-           const int absz = ctx->getInt("size");
-
-
-           if (absz >= 32 * 1024 * 1024)
-               mixersSize = 1 << 17;
-           else if (absz >= 16 * 1024 * 1024)
-               mixersSize = 1 << 16;
-           else if (absz >= 8 * 1024 * 1024)
-               mixersSize = 1 << 14;
-           else if (absz >= 4 * 1024 * 1024)
-               mixersSize = 1 << 12;
-           else
-               mixersSize = (absz >= 1 * 1024 * 1024) ? 1 << 10 : 1 << 9;
+           mixersSize = getMixersSize(ctx->getInt("size"));
 
+           // Smaller tables to fit a memory budget (same value when decoding)
+           const int shrink = ctx->getInt("modelShrink", 0);
+
+           if ((shrink < 0) || (shrink > MAX_MODEL_SHRINK))
+               throw invalid_argument("TPAQ predictor: invalid model shrink parameter");
+
+           statesSize >>= (2 * shrink);
+           hashSize >>= (2 * shrink);
+           smallStatesSize >>= shrink;
+
+           if (ctx->has("blockSize"))
+               bufferSize = getBufferSize(ctx->getInt("blockSize"));
        }
 
        mixersSize <<= extraMem;
        statesSize <<= extraMem;
        hashSize <<= (2 * extraMem);
+
+       if (mixersSize != _mixersMask + 1) {
+           delete[] _mixers;
+           _mixers = new TPAQMixer[mixersSize];
+       }
+       else {
+           for (int i = 0; i < mixersSize; i++)
+               _mixers[i] = TPAQMixer();
+       }
+
+       if (statesSize != _statesMask + 1) {
+           _allocator->deleteArray(_bigStatesMap, _statesMask + 1);
+           _bigStatesMap = nullptr;
+           _statesMask = -1;
+           _bigStatesMap = _allocator->newArray<uint8>(statesSize);
+           _statesMask = statesSize - 1;
+       }
+
+       if (hashSize != _hashMask + 1) {
+           _allocator->deleteArray(_hashes, _hashMask + 1);
+           _hashes = nullptr;
+           _hashMask = -1;
+           _hashes = _allocator->newArray<int32>(hashSize);
+           _hashMask = hashSize - 1;
+           _hashBase = MAX_HASH_BASE;
+       }
+
+       if (smallStatesSize != _smallStatesMask + 1) {
+           _allocator->deleteArray(_smallStatesMap1, _smallStatesMask + 1);
+           _smallStatesMap1 = nullptr;
+           _smallStatesMask = -1;
+           _smallStatesMap1 = _allocator->newArray<uint8>(smallStatesSize);
+           _smallStatesMask = smallStatesSize - 1;
+       }
+
+       if (bufferSize != _bufferMask + 1) {
+           _allocator->deleteArray(_buffer, _bufferMask + 1);
+           _buffer = nullptr;
+           _bufferMask = -1;
+           _buffer = _allocator->newArray<byte>(bufferSize);
+           _bufferMask = bufferSize - 1;
+           memset(_buffer, 0, bufferSize);
+           _hashBase = MAX_HASH_BASE;
+       }
+       else {
+           // The buffer is written sequentially from the start
+           memset(_buffer, 0, (_pos < bufferSize) ? _pos : bufferSize);
+       }
+
+       // Start the positions of the block at least one buffer size after the
+       // last position of the previous block so that no entry of the previous
+       // blocks passes the match distance test (as with a cleared table). The
+       // table is only cleared when the positions may overflow (< 2^30 in a block).
+       _hashBase = (_hashBase + uint32(_pos) + 2 * uint32(bufferSize) - 1) & ~uint32(_bufferMask);
+
+       if (_hashBase >= MAX_HASH_BASE) {
+           memset(_hashes, 0, sizeof(int32) * hashSize);
+           _hashBase = 0;
+       }
+
+       if (_smallStatesMap0 == nullptr)
+           _smallStatesMap0 = new uint8[1 << 16];
+
+       memset(_bigStatesMap, 0, statesSize);
+       memset(_smallStatesMap0, 0, 1 << 16);
+       memset(_smallStatesMap1, 0, smallStatesSize);
+       _sse0.reset();
+       _sse1.reset();
        _pr = 2048;
        _c0 = 1;
        _c4 = 0;
@@ -329,18 +437,7 @@ namespace kanzi
        _matchLen = 0;
        _matchPos = 0;
        _hash = 0;
-       _mixers = new TPAQMixer[mixersSize];
        _mixer = &_mixers[0];
-       _bigStatesMap = new uint8[statesSize];
-       memset(_bigStatesMap, 0, statesSize);
-       _smallStatesMap0 = new uint8[1 << 16];
-       memset(_smallStatesMap0, 0, 1 << 16);
-       _smallStatesMap1 = new uint8[1 << 24];
-       memset(_smallStatesMap1, 0, 1 << 24);
-       _hashes = new int32[hashSize];
-       memset(_hashes, 0, sizeof(int32) * hashSize);
-       _buffer = new byte[BUFFER_SIZE];
-       memset(_buffer, 0, BUFFER_SIZE);
        _statesMask = statesSize - 1;
        _mixersMask = mixersSize - 1;
        _hashMask = hashSize - 1;
@@ -355,14 +452,72 @@ namespace kanzi
        _ctx4 = _ctx5 = _ctx6 = 0;
    }
 
+   template <bool T>
+   int TPAQPredictor<T>::getStatesSize(int blockSize)
+   {
+       if (blockSize >= 64 * 1024 * 1024)
+           return 1 << 29;
+
+       if (blockSize >= 16 * 1024 * 1024)
+           return 1 << 28;
+
+       return (blockSize >= 1024 * 1024) ? 1 << 27 : 1 << 26;
+   }
+
+   // The buffer holds the whole block and the bytes read before its start
+   // when a match is checked (never written), so that the predictions are the
+   // same as with a buffer of BUFFER_SIZE.
+   template <bool T>
+   int TPAQPredictor<T>::getBufferSize(int blockSize)
+   {
+       int size = 1 << 16;
+
+       while ((size < BUFFER_SIZE) && (size < blockSize + MAX_LENGTH + 2))
+           size <<= 1;
+
+       return size;
+   }
+
+   // Too many mixers hurts compression for small blocks.
+   // Too few mixers hurts compression for big blocks.
+   template <bool T>
+   int TPAQPredictor<T>::getMixersSize(int size)
+   {
+       if (size >= 32 * 1024 * 1024)
+           return 1 << 17;
+
+       if (size >= 16 * 1024 * 1024)
+           return 1 << 16;
+
+       if (size >= 8 * 1024 * 1024)
+           return 1 << 14;
+
+       if (size >= 4 * 1024 * 1024)
+           return 1 << 12;
+
+       return (size >= 1 * 1024 * 1024) ? 1 << 10 : 1 << 9;
+   }
+
+   template <bool T>
+   int64 TPAQPredictor<T>::getMemoryFootprint(int blockSize, int modelShrink)
+   {
+       const uint extraMem = (T == true) ? 1 : 0;
+       int64 res = int64(sizeof(TPAQPredictor<T>)) + getBufferSize(blockSize) + (1 << 16);
+       res += int64(SMALL_STATES_SIZE >> modelShrink);
+       res += int64(getMixersSize(blockSize) << extraMem) * int64(sizeof(TPAQMixer));
+       res += int64((getStatesSize(blockSize) << extraMem) >> (2 * modelShrink));
+       res += int64((HASH_SIZE << (2 * extraMem)) >> (2 * modelShrink)) * 4;
+       return res;
+   }
+
    template <bool T>
    TPAQPredictor<T>::~TPAQPredictor()
    {
-       delete[] _bigStatesMap;
+       _allocator->deleteArray(_bigStatesMap, _statesMask + 1);
        delete[] _smallStatesMap0;
-       delete[] _smallStatesMap1;
-       delete[] _hashes;
-       delete[] _buffer;
+       _allocator->deleteArray(_smallStatesMap1, _smallStatesMask + 1);
+       _allocator->deleteArray(_hashes, _hashMask + 1);
+       _allocator->deleteArray(_buffer, _bufferMask + 1);
        delete[] _mixers;
    }
 
@@ -375,7 +530,7 @@ namespace kanzi
        _c0 = (_c0 << 1) | bit;
 
        if (_c0 > 255) {
-           _buffer[_pos & MASK_BUFFER] = byte(_c0);
+           _buffer[_pos & _bufferMask] = byte(_c0);
            _pos++;
            _c8 = (_c8 << 8) | ((_c4 >> 24) & 0xFF);
            _c4 = (_c4 << 8) | (_c0 & 0xFF);
@@ -418,7 +573,7 @@ namespace kanzi
            findMatch();
 
            // Keep track current position
-           _hashes[_hash] = _pos;
+           _hashes[_hash] = int32(_hashBase + uint32(_pos));
        }
 
        // Get initial predictions
@@ -441,7 +596,7 @@ namespace kanzi
        *_cp5 = table[*_cp5];
        _cp0 = &_smallStatesMap0[_ctx0 + _c0];
        const int p0 = STATE_MAP[*_cp0];
-       _cp1 = &_smallStatesMap1[_ctx1 + _c0];
+       _cp1 = &_smallStatesMap1[(_ctx1 + _c0) & _smallStatesMask];
        const int p1 = STATE_MAP[*_cp1];
        _cp2 = &_bigStatesMap[(_ctx2 + _c0) & _statesMask];
        const int p2 = STATE_MAP[*_cp2];
@@ -498,18 +653,18 @@ namespace kanzi
            _matchPos++;
        }
        else {
-           // Retrieve match position
+           // Retrieve match position (the base is a multiple of the buffer size)
            _matchPos = _hashes[_hash];
 
            // Detect match
-           if ((_matchPos != 0) && (_pos - _matchPos <= MASK_BUFFER)) {
+           if ((_matchPos != 0) && (_hashBase + uint32(_pos) - uint32(_matchPos) <= uint32(_bufferMask))) {
                int r = _matchLen + 2;
 
                while (r <= MAX_LENGTH) {
-                   if ((_buffer[(_pos - r) & MASK_BUFFER]) != (_buffer[(_matchPos - r) & MASK_BUFFER]))
+                   if ((_buffer[(_pos - r) & _bufferMask]) != (_buffer[(_matchPos - r) & _bufferMask]))
                        break;
 
-                   if ((_buffer[(_pos - r - 1) & MASK_BUFFER]) != (_buffer[(_matchPos - r - 1) & MASK_BUFFER]))
+                   if ((_buffer[(_pos - r - 1) & _bufferMask]) != (_buffer[(_matchPos - r - 1) & _bufferMask]))
                        break;
 
                    r += 2;
@@ -539,10 +694,10 @@ namespace kanzi
    template <bool T>
    inline int TPAQPredictor<T>::getMatchContextPred()
    {
-       if (_c0 == ((int(_buffer[_matchPos & MASK_BUFFER]) & 0xFF) | 256) >> _bpos) {
+       if (_c0 == ((int(_buffer[_matchPos & _bufferMask]) & 0xFF) | 256) >> _bpos) {
            int p = (_matchLen <= 24) ? _matchLen : 24 + ((_matchLen - 24) >> 3);
 
-           if ((int(_buffer[_matchPos & MASK_BUFFER] >> (_bpos - 1)) & 1) == 0)
+           if ((int(_buffer[_matchPos & _bufferMask] >> (_bpos - 1)) & 1) == 0)
                p = -p;
 
            return p << 6;
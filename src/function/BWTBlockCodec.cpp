@@ -21,7 +21,9 @@ using namespace kanzi;
 BWTBlockCodec::BWTBlockCodec(Context& ctx)
 { 
 	int jobs = ctx.getInt("jobs", 1);
-	_pBWT = new BWT(jobs);
+	string suffixSort = ctx.getString("suffixSort", "DIVSUFSORT");
+	_maxChunks = ctx.getInt("bwtChunks", BWT::DEFAULT_MAX_CHUNKS);
+	_pBWT = new BWT(jobs, suffixSort == "SAIS", _maxChunks, &Allocator::getAllocator(&ctx));
 }
 
 // Return true if the compression chain succeeded. In this case, the input data
@@ -44,7 +46,7 @@ bool BWTBlockCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, i
         return false;
 
     byte* p0 = &output._array[output._index];
-    const int chunks = BWT::getBWTChunks(blockSize);
+    const int chunks = BWT::getBWTChunks(blockSize, _maxChunks);
     int log = 1;
 
     while (1 << log <= blockSize)
@@ -118,7 +120,7 @@ bool BWTBlockCodec::inverse(SliceArray<byte>& input, SliceArray<byte>& output, i
     if (input._array == output._array)
         return false;
 
-    const int chunks = BWT::getBWTChunks(blockSize);
+    const int chunks = BWT::getBWTChunks(blockSize, _maxChunks);
 
     for (int i = 0; i < chunks; i++) {
         // Read block header (mode + primary index). See top of file for format
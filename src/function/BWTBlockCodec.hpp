@@ -28,6 +28,8 @@ namespace kanzi {
    // Utility class to en/de-code a BWT data block and its associated primary index(es)
 
    // BWT stream format: Header (m bytes) Data (n bytes)
+   // The number of primary indexes depends on the block size and on the max
+   // number of chunks (context key 'bwtChunks', stored in the stream header).
    // Header: For each primary index,
    //   mode (8 bits) + primary index (8,16 or 24 bits)
    //   mode: bits 7-6 contain the size in bits of the primary index :
@@ -51,13 +53,14 @@ namespace kanzi {
        // Required encoding output buffer size
        int getMaxEncodedLength(int srcLen) const
        {
-           return srcLen + BWT_MAX_HEADER_SIZE;
+           return srcLen + BWT_MAX_HEADER_SIZE * BWT::getBWTChunks(srcLen, _maxChunks);
        }
 
    private:
-       static const int BWT_MAX_HEADER_SIZE = 8 * 4;
+       static const int BWT_MAX_HEADER_SIZE = 4; // per primary index
 
        BWT* _pBWT;
+       int _maxChunks;
    };
 }
 #endif
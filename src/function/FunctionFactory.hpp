@@ -7,6 +7,7 @@
 #include <cstring>
 #include "../types.hpp"
 #include "../Context.hpp"
+#include "../entropy/EntropyCodecFactory.hpp"
 #include "../transform/BWT.hpp"
 #include "../transform/BWTS.hpp"
 #include "../transform/SBRT.hpp"
@@ -16,6 +17,7 @@
 #include "NullFunction.hpp"
 #include "ROLZCodec.hpp"
 #include "RLT.hpp"
+#include "SBRTZRLT.hpp"
 #include "TextCodec.hpp"
 #include "TransformSequence.hpp"
 #include "X86Codec.hpp"
@@ -50,7 +52,13 @@ namespace kanzi {
 
 		static string getName(uint64 functionType) THROW;
 
-		static TransformSequence<T>* newFunction(Context& ctx, uint64 functionType) THROW;
+		// Create the transforms of a block. Some transforms depend on the entropy
+		// codec of the block (EG. the text codec variant).
+		static TransformSequence<T>* newFunction(Context& ctx, uint64 functionType, short entropyType) THROW;
+
+		// Approximate memory used by the transforms to process a block (not
+		// including the input and output buffers)
+		static int64 getMemoryFootprint(uint64 functionType, int blockSize) THROW;
 
 	private:
 		FunctionFactory() {}
@@ -61,11 +69,47 @@ namespace kanzi {
 		static const int MAX_SHIFT = (8 - 1) * ONE_SHIFT; // 8 transforms
 		static const int MASK = (1 << ONE_SHIFT) - 1;
 
-		static Transform<T>* newFunctionToken(Context& ctx, uint64 functionType) THROW;
+		static Transform<T>* newFunctionToken(Context& ctx, uint64 functionType,
+			uint64 sequenceType, short entropyType) THROW;
 
 		static const char* getNameToken(uint64 functionType) THROW;
 	};
 
+	// Transform sequence kept by a job from block to block. The transforms
+	// do not carry data from one block to the next, so reusing them only saves
+	// the allocation (and first touch) of their buffers for each block.
+	// The transforms depend on the entropy codec of the block and read some
+	// parameters from the context when they are created, so the codec and
+	// these parameters are part of the key of the cache.
+	template <class T>
+	class FunctionCache {
+	public:
+		FunctionCache() { _function = nullptr; _type = 0; _entropyType = -1; }
+
+		~FunctionCache() { clear(); }
+
+		// Return the cached transform sequence if it was created for the same
+		// types and context parameters, else a new one (replacing the cached one).
+		// The returned sequence is owned by the cache.
+		TransformSequence<T>* get(Context& ctx, uint64 functionType, short entropyType) THROW;
+
+		void clear() { delete _function; _function = nullptr; }
+
+	private:
+		static const int NB_PARAMS = 6;
+		static const char* const PARAMS[NB_PARAMS]; // context keys read by the transforms
+
+		TransformSequence<T>* _function;
+		uint64 _type;
+		short _entropyType;
+		string _params[NB_PARAMS];
+	};
+
+	template <class T>
+	const char* const FunctionCache<T>::PARAMS[FunctionCache<T>::NB_PARAMS] = {
+		"jobs", "blockSize", "extra", "suffixSort", "bwtChunks", "pages"
+	};
+
 	// The returned type contains 8 transform values
 	template <class T>
 	uint64 FunctionFactory<T>::getType(const char* cname) THROW
@@ -158,54 +202,135 @@ namespace kanzi {
 	}
 
 	template <class T>
-	TransformSequence<T>* FunctionFactory<T>::newFunction(Context& ctx, uint64 functionType) THROW
+	TransformSequence<T>* FunctionFactory<T>::newFunction(Context& ctx, uint64 functionType, short entropyType) THROW
 	{
 		Transform<T>* transforms[8];
+		uint64 types[8];
 		int nbtr = 0;
 
 		for (int i = 0; i < 8; i++) {
 			transforms[i] = nullptr;
 			const uint64 t = (functionType >> (MAX_SHIFT - ONE_SHIFT * i)) & MASK;
 
-			if ((t != NONE_TYPE) || (i == 0))
-				transforms[nbtr++] = newFunctionToken(ctx, t);
+			if ((t != NONE_TYPE) || (i == 0)) {
+				types[nbtr] = t;
+				transforms[nbtr++] = newFunctionToken(ctx, t, functionType, entropyType);
+			}
+		}
+
+		TransformSequence<T>* seq = new TransformSequence<T>(transforms, true);
+
+		// MTFT/RANK followed by ZRLT (typical post BWT stages) run in one pass
+		for (int i = 0; i + 1 < nbtr; i++) {
+			if ((types[i] == MTFT_TYPE) && (types[i + 1] == ZRLT_TYPE))
+				seq->fuse(i, new SBRTZRLT(SBRT::MODE_MTF));
+			else if ((types[i] == RANK_TYPE) && (types[i + 1] == ZRLT_TYPE))
+				seq->fuse(i, new SBRTZRLT(SBRT::MODE_RANK));
+		}
+
+		return seq;
+	}
+
+	template <class T>
+	int64 FunctionFactory<T>::getMemoryFootprint(uint64 functionType, int blockSize) THROW
+	{
+		// The transforms of a sequence are kept from block to block
+		const int64 n = int64(blockSize);
+		int64 res = 0;
+
+		for (int i = 0; i < 8; i++) {
+			switch ((functionType >> (MAX_SHIFT - ONE_SHIFT * i)) & MASK) {
+			case BWT_TYPE:
+				res += 4 * n; // suffix array or inverse buffer
+				break;
+
+			case BWTS_TYPE:
+				res += 8 * n;
+				break;
+
+			case DICT_TYPE:
+				res += n + (8 << 20); // word map and dictionary
+				break;
+
+			case ROLZ_TYPE:
+			case ROLZX_TYPE:
+				res += 2 * min(n, int64(1 << 26)) + (8 << 20); // chunk buffers and matches
+				break;
+
+			case LZ_TYPE:
+				res += 1 << 18; // hash table
+				break;
+
+			default:
+				break;
+			}
 		}
 
-		return new TransformSequence<T>(transforms, true);
+		return res;
 	}
 
 	template <class T>
-	Transform<T>* FunctionFactory<T>::newFunctionToken(Context& ctx, uint64 functionType) THROW
+	TransformSequence<T>* FunctionCache<T>::get(Context& ctx, uint64 functionType, short entropyType) THROW
+	{
+		bool hit = (_function != nullptr) && (_type == functionType) && (_entropyType == entropyType);
+
+		for (int i = 0; i < NB_PARAMS; i++) {
+			const string value = ctx.getString(PARAMS[i]);
+
+			if (_params[i] != value) {
+				_params[i] = value;
+				hit = false;
+			}
+		}
+
+		if (hit == true)
+			return _function;
+
+		clear();
+		_function = FunctionFactory<T>::newFunction(ctx, functionType, entropyType);
+		_type = functionType;
+		_entropyType = entropyType;
+		return _function;
+	}
+
+	template <class T>
+	Transform<T>* FunctionFactory<T>::newFunctionToken(Context& ctx, uint64 functionType,
+		uint64 sequenceType, short entropyType) THROW
 	{
 		switch (functionType) {
 		case DICT_TYPE: {
 			string textCodecType = "1";
-         
-			if (ctx.has("codec")) {			
-				string entropyType = ctx.getString("codec");
-				transform(entropyType.begin(), entropyType.end(), entropyType.begin(), ::toupper);
-            
-				// Select text encoding based on entropy codec.
-				if ((entropyType.compare(0, 4, "NONE") == 0) || (entropyType.compare(0, 4, "ANS0") == 0) ||
-				   (entropyType.compare(0, 7, "HUFFMAN") == 0) || (entropyType.compare(0, 5, "RANGE") == 0))
-				    textCodecType = "2";
-			}
-         
+			string codec = EntropyCodecFactory::getName(entropyType);
+
+			// Select text encoding based on entropy codec.
+			if ((codec.compare(0, 4, "NONE") == 0) || (codec.compare(0, 4, "ANS0") == 0) ||
+			   (codec.compare(0, 7, "HUFFMAN") == 0) || (codec.compare(0, 5, "RANGE") == 0))
+			    textCodecType = "2";
+
 			ctx.putString("textcodec", textCodecType);
 			return new TextCodec(ctx);
 		}
 
-      case ROLZ_TYPE:
-			return new ROLZCodec(ctx);
+		case ROLZ_TYPE: {
+			// ROLZ is ROLZX in a sequence containing ROLZX (bitstream compatibility)
+			bool extra = false;
+
+			for (int i = 0; i < 8; i++)
+				extra |= ((sequenceType >> (MAX_SHIFT - ONE_SHIFT * i)) & MASK) == ROLZX_TYPE;
+
+			return new ROLZCodec(ctx, extra);
+		}
 
 		case ROLZX_TYPE:
-			return new ROLZCodec(ctx);
+			return new ROLZCodec(ctx, true);
 
 		case BWT_TYPE:
 			return new BWTBlockCodec(ctx);
 
-		case BWTS_TYPE:
-			return new BWTS();
+		case BWTS_TYPE: {
+			string suffixSort = ctx.getString("suffixSort", "DIVSUFSORT");
+			return new BWTS(suffixSort == "SAIS", &Allocator::getAllocator(&ctx));
+		}
 
 		case RANK_TYPE:
 			return new SBRT(SBRT::MODE_RANK);
@@ -32,11 +32,16 @@ ROLZCodec::ROLZCodec(uint logPosChecks) THROW
 }
 
 ROLZCodec::ROLZCodec(Context& ctx) THROW
+    : ROLZCodec(ctx, string(ctx.getString("transform", "NONE")).find("ROLZX") != string::npos)
 {
-    string transform = ctx.getString("transform", "NONE");
+}
+
+ROLZCodec::ROLZCodec(Context& ctx, bool extra) THROW
+{
+    Allocator* allocator = &Allocator::getAllocator(&ctx);
 
-    _delegate = (transform.find("ROLZX") != string::npos) ? (Function<byte>*) new ROLZCodec2(LOG_POS_CHECKS2) :
-       (Function<byte>*) new ROLZCodec1(LOG_POS_CHECKS1);
+    _delegate = (extra == true) ? (Function<byte>*) new ROLZCodec2(LOG_POS_CHECKS2, allocator) :
+       (Function<byte>*) new ROLZCodec1(LOG_POS_CHECKS1, allocator);
 }
 
 bool ROLZCodec::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count) THROW
@@ -89,7 +94,7 @@ bool ROLZCodec::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int c
     return _delegate->inverse(input, output, count);
 }
 
-ROLZCodec1::ROLZCodec1(uint logPosChecks) THROW
+ROLZCodec1::ROLZCodec1(uint logPosChecks, Allocator* allocator) THROW
 {
     if ((logPosChecks < 2) || (logPosChecks > 8)) {
         stringstream ss;
@@ -100,7 +105,13 @@ ROLZCodec1::ROLZCodec1(uint logPosChecks) THROW
     _logPosChecks = logPosChecks;
     _posChecks = 1 << logPosChecks;
     _maskChecks = _posChecks - 1;
-    _matches = new int32[ROLZCodec::HASH_SIZE << logPosChecks];
+    _allocator = (allocator == nullptr) ? &Allocator::getAllocator(Allocator::NORMAL_PAGES) : allocator;
+    _matches = _allocator->newArray<int32>(ROLZCodec::HASH_SIZE << logPosChecks);
+}
+
+ROLZCodec1::~ROLZCodec1()
+{
+    _allocator->deleteArray(_matches, ROLZCodec::HASH_SIZE << _logPosChecks);
 }
 
 // return position index (_logPosChecks bits) + length (16 bits) or -1
@@ -553,7 +564,7 @@ byte ROLZDecoder::decodeByte()
 
 
 
-ROLZCodec2::ROLZCodec2(uint logPosChecks) THROW
+ROLZCodec2::ROLZCodec2(uint logPosChecks, Allocator* allocator) THROW
     : _litPredictor(9)
     , _matchPredictor(logPosChecks)
 {
@@ -566,7 +577,13 @@ ROLZCodec2::ROLZCodec2(uint logPosChecks) THROW
     _logPosChecks = logPosChecks;
     _posChecks = 1 << logPosChecks;
     _maskChecks = _posChecks - 1;
-    _matches = new int32[ROLZCodec::HASH_SIZE << logPosChecks];
+    _allocator = (allocator == nullptr) ? &Allocator::getAllocator(Allocator::NORMAL_PAGES) : allocator;
+    _matches = _allocator->newArray<int32>(ROLZCodec::HASH_SIZE << logPosChecks);
+}
+
+ROLZCodec2::~ROLZCodec2()
+{
+    _allocator->deleteArray(_matches, ROLZCodec::HASH_SIZE << _logPosChecks);
 }
 
 // return position index (_logPosChecks bits) + length (16 bits) or -1
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef _ROLZCodec_
 #define _ROLZCodec_
 
+#include "../Allocator.hpp"
 #include "../Context.hpp"
 #include "../Function.hpp"
 #include "../Memory.hpp"
@@ -110,9 +111,9 @@ namespace kanzi {
 	// Use ANS to encode/decode literals and matches
 	class ROLZCodec1 : public Function<byte> {
 	public:
-		ROLZCodec1(uint logPosChecks) THROW;
+		ROLZCodec1(uint logPosChecks, Allocator* allocator = nullptr) THROW;
 
-		~ROLZCodec1() { delete[] _matches; }
+		~ROLZCodec1();
 
 		bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length) THROW;
 
@@ -129,6 +130,7 @@ namespace kanzi {
 		static const int MAX_MATCH = MIN_MATCH + 255 + 7;
 
 		int32* _matches;
+		Allocator* _allocator;
 		int32 _counters[65536];
 		int _logPosChecks;
 		int _maskChecks;
@@ -147,9 +149,9 @@ namespace kanzi {
 	// Code loosely based on 'balz' by Ilya Muravyov
 	class ROLZCodec2 : public Function<byte> {
 	public:
-		ROLZCodec2(uint logPosChecks) THROW;
+		ROLZCodec2(uint logPosChecks, Allocator* allocator = nullptr) THROW;
 
-		~ROLZCodec2() { delete[] _matches; }
+		~ROLZCodec2();
 
 		bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length) THROW;
 
@@ -165,6 +167,7 @@ namespace kanzi {
 		static const int MAX_MATCH = MIN_MATCH + 255;
 
 		int32* _matches;
+		Allocator* _allocator;
 		int32 _counters[65536];
 		int _logPosChecks;
 		int _maskChecks;
@@ -182,8 +185,12 @@ namespace kanzi {
 	public:
 		ROLZCodec(uint logPosChecks = LOG_POS_CHECKS2) THROW;
 
+		// ROLZX if the transform in the context contains ROLZX, else ROLZ
 		ROLZCodec(Context& ctx) THROW;
 
+		// ROLZX (ROLZCodec2) if 'extra' is true, else ROLZ (ROLZCodec1)
+		ROLZCodec(Context& ctx, bool extra) THROW;
+
 		virtual ~ROLZCodec() { delete _delegate; }
 
 		bool forward(SliceArray<byte>& src, SliceArray<byte>& dst, int length) THROW;
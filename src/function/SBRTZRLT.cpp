@@ -0,0 +1,202 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+#include <stdexcept>
+#include "SBRTZRLT.hpp"
+#include "../Global.hpp"
+#include "../transform/SBRT.hpp"
+
+using namespace kanzi;
+
+SBRTZRLT::SBRTZRLT(int mode) :
+	  _mask1((mode == SBRT::MODE_TIMESTAMP) ? 0 : -1)
+	, _mask2((mode == SBRT::MODE_MTF) ? 0 : -1)
+	, _shift((mode == SBRT::MODE_RANK) ? 1 : 0)
+{
+    if ((mode != SBRT::MODE_MTF) && (mode != SBRT::MODE_RANK) && (mode != SBRT::MODE_TIMESTAMP))
+        throw invalid_argument("Invalid mode parameter");
+}
+
+bool SBRTZRLT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count) THROW
+{
+    if (count == 0)
+        return true;
+
+    if (!SliceArray<byte>::isValid(input))
+        throw invalid_argument("Invalid input block");
+
+    if (!SliceArray<byte>::isValid(output))
+        throw invalid_argument("Invalid output block");
+
+    if (output._length - output._index < getMaxEncodedLength(count))
+        return false;
+
+    uint8* src = (uint8*)&input._array[input._index];
+    byte* dst = &output._array[output._index];
+    const int dstEnd = output._length;
+    int dstIdx = 0;
+    int runLength = 0;
+    int p[256] = { 0 };
+    SBRTRankList ranks;
+    const bool mtf = _mask2 == 0;
+
+    for (int i = 0; i <= count; i++) {
+        int rank = 0;
+
+        if (i < count) {
+            // SBRT
+            const uint8 c = src[i];
+            rank = ranks.rankOf(c);
+            const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
+            p[c] = i;
+
+            // Move up symbol to correct rank
+            if (rank == 0)
+                ranks.setFirstKey(qc);
+            else
+                ranks.move(rank, (mtf == true) ? 0 : ranks.newRank(rank, qc), qc);
+
+            if (rank == 0) {
+                runLength++;
+                continue;
+            }
+        }
+
+        // ZRLT
+        if (runLength != 0) {
+            // Encode length
+            runLength++;
+            int log = Global::_log2(runLength);
+
+            if (dstIdx >= dstEnd - log)
+                return false;
+
+            // Write every bit as a byte except the most significant one
+            while (log > 0) {
+                log--;
+                dst[dstIdx++] = byte((runLength >> log) & 1);
+            }
+
+            runLength = 0;
+        }
+
+        if (i == count)
+            break;
+
+        if (rank >= 0xFE) {
+            if (dstIdx >= dstEnd - 1)
+                return false;
+
+            dst[dstIdx++] = byte(0xFF);
+            dst[dstIdx++] = byte(rank - 0xFE);
+        }
+        else {
+            if (dstIdx >= dstEnd)
+                return false;
+
+            dst[dstIdx++] = byte(rank + 1);
+        }
+    }
+
+    input._index += count;
+    output._index += dstIdx;
+    return true;
+}
+
+bool SBRTZRLT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int length) THROW
+{
+    if (length == 0)
+        return true;
+
+    if (!SliceArray<byte>::isValid(input))
+        throw invalid_argument("Invalid input block");
+
+    if (!SliceArray<byte>::isValid(output))
+        throw invalid_argument("Invalid output block");
+
+    uint8* src = (uint8*)&input._array[input._index];
+    byte* dst = &output._array[output._index];
+    const int srcEnd = length;
+    const int dstEnd = output._length;
+    int srcIdx = 0;
+    int dstIdx = 0;
+    int p[256] = { 0 };
+    SBRTRankList ranks;
+    const bool mtf = _mask2 == 0;
+
+    while ((srcIdx < srcEnd) && (dstIdx < dstEnd)) {
+        uint8 val = src[srcIdx];
+
+        if (val <= 1) {
+            // Generate the run length bit by bit (but force MSB)
+            int runLength = 1;
+
+            do {
+                runLength = (runLength << 1) | val;
+                srcIdx++;
+
+                if (srcIdx >= srcEnd)
+                    break;
+
+                val = src[srcIdx];
+            } while (val <= 1);
+
+            runLength--;
+
+            if (dstIdx + runLength > dstEnd)
+                return false;
+
+            // A run of rank 0 repeats the first symbol and leaves the ranks
+            // unchanged. Only the last access to the symbol matters.
+            const uint8 c = ranks.symbolAt(0);
+            memset(&dst[dstIdx], c, runLength);
+            dstIdx += runLength;
+            const int last = dstIdx - 1;
+            const int prev = (runLength > 1) ? last - 1 : p[c];
+            ranks.setFirstKey(((last & _mask1) + (prev & _mask2)) >> _shift);
+            p[c] = last;
+            continue;
+        }
+
+        if (val == 0xFF) {
+            srcIdx++;
+
+            if (srcIdx >= srcEnd)
+                break;
+
+            val = uint8(0xFE + src[srcIdx]);
+        }
+        else {
+            val--;
+        }
+
+        // Inverse SBRT
+        const int r = int(val);
+        const uint8 c = ranks.symbolAt(r);
+        dst[dstIdx] = byte(c);
+        const int qc = ((dstIdx & _mask1) + (p[c] & _mask2)) >> _shift;
+        p[c] = dstIdx;
+
+        // Move up symbol to correct rank
+        ranks.move(r, (mtf == true) ? 0 : ranks.newRank(r, qc), qc);
+        srcIdx++;
+        dstIdx++;
+    }
+
+    input._index += srcIdx;
+    output._index += dstIdx;
+    return srcIdx == srcEnd;
+}
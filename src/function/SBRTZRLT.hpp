@@ -0,0 +1,50 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _SBRTZRLT_
+#define _SBRTZRLT_
+
+#include "../Function.hpp"
+
+namespace kanzi
+{
+   // SBRT (MTFT or RANK) followed by ZRLT in one pass over the block: the ranks
+   // are zero run length coded as soon as they are produced (and decoded ranks
+   // are fed directly to the inverse SBRT). The output is the same as the one
+   // of the 2 transforms applied in sequence.
+   // The transform sequence uses it in place of SBRT+ZRLT (see TransformSequence::fuse).
+   // forward() returns false if ZRLT does not apply, inverse() expects the
+   // output of both transforms.
+   class SBRTZRLT : public Function<byte>
+   {
+   public:
+       SBRTZRLT(int mode);
+
+       ~SBRTZRLT() {}
+
+       bool forward(SliceArray<byte>& input, SliceArray<byte>& output, int length) THROW;
+
+       bool inverse(SliceArray<byte>& input, SliceArray<byte>& output, int length) THROW;
+
+       int getMaxEncodedLength(int srcLen) const { return srcLen; }
+
+   private:
+       const int _mask1;
+       const int _mask2;
+       const int _shift;
+   };
+
+}
+#endif
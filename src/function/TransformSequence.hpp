@@ -44,10 +44,17 @@ namespace kanzi
 
        int getNbFunctions() { return _length; }
 
+       // Use 'fused' to apply the transforms at index and index+1 in one pass
+       // (when neither is skipped). The output of fused must be the same as the
+       // output of the 2 transforms and fused->forward() must return false when
+       // the second transform does not apply. The sequence owns 'fused'.
+       void fuse(int index, Transform<T>* fused);
+
    private:
        static const byte SKIP_MASK = byte(0xFF);
 
        Transform<T>* _transforms[8]; // transforms or functions
+       Transform<T>* _fused[8]; // fused transforms (index of the first one)
        bool _deallocate; // deallocate memory for transforms ?
        int _length; // number of transforms
        byte _skipFlags; // skip transforms
@@ -62,6 +69,7 @@ namespace kanzi
 
        for (int i = 7; i >= 0; i--) {
            _transforms[i] = transforms[i];
+           _fused[i] = nullptr;
 
            if (_transforms[i] == nullptr)
                _length = i;
@@ -80,6 +88,23 @@ namespace kanzi
                    delete _transforms[i];
            }
        }
+
+       for (int i = 0; i < 8; i++) {
+           if (_fused[i] != nullptr)
+               delete _fused[i];
+       }
+   }
+
+   template <class T>
+   void TransformSequence<T>::fuse(int index, Transform<T>* fused)
+   {
+       if ((index < 0) || (index + 1 >= _length))
+           throw invalid_argument("Invalid index of fused transforms");
+
+       if (_fused[index] != nullptr)
+           delete _fused[index];
+
+       _fused[index] = fused;
    }
 
    template <class T>
@@ -120,6 +145,33 @@ namespace kanzi
            const int savedOIdx = sa2->_index;
            Transform<T>* transform = _transforms[i];
 
+           // The transforms may write requiredSize bytes whatever the capacity
+           // of the buffers (kept from block to block by the caller), so that
+           // the output does not depend on previous blocks.
+           const int length = sa2->_length;
+           sa2->_length = (savedOIdx + requiredSize < length) ? savedOIdx + requiredSize : length;
+
+           // Apply the transforms i and i+1 in one pass. The fused transform
+           // writes to sa2 what transform i+1 would write to sa1, with the same
+           // limit, so it fails in the same cases.
+           if (_fused[i] != nullptr) {
+               const bool res = _fused[i]->forward(*sa1, *sa2, count);
+
+               if (res == true) {
+                   sa2->_length = length;
+                   count = sa2->_index - savedOIdx;
+                   sa1->_index = savedIIdx;
+                   sa2->_index = savedOIdx;
+                   i++;
+                   continue;
+               }
+
+               // Transform i+1 does not apply: apply transform i alone
+               sa1->_index = savedIIdx;
+               sa2->_index = savedOIdx;
+               _skipFlags |= byte(1 << (6 - i));
+           }
+
            // Apply forward transform
            if (transform->forward(*sa1, *sa2, count) == false) {
                // Transform failed. Either it does not apply to this type
@@ -131,9 +183,13 @@ namespace kanzi
                _skipFlags |= byte(1 << (7 - i));
            }
 
+           sa2->_length = length;
            count = sa2->_index - savedOIdx;
            sa1->_index = savedIIdx;
            sa2->_index = savedOIdx;
+
+           if ((_fused[i] != nullptr) && ((_skipFlags & byte(1 << (6 - i))) != byte(0)))
+               i++;
        }
 
        for (int i = _length; i < 8; i++)
@@ -172,7 +228,8 @@ namespace kanzi
        }
 
        const int blockSize = length;
-       const int count = output._length;
+       // The intermediate results may be larger than the output (headers)
+       const int count = getMaxEncodedLength(output._length);
        bool res = true;
        SliceArray<T>* sa[2] = { &input, &output };
        int saIdx = 0;
@@ -189,10 +246,16 @@ namespace kanzi
            const int savedOIdx = sa2->_index;
            Transform<T>* transform = _transforms[i];
 
+           // Apply the transforms i and i-1 in one pass if possible
+           if ((i > 0) && (_fused[i - 1] != nullptr) && ((_skipFlags & byte(1 << (8 - i))) == byte(0))) {
+               transform = _fused[i - 1];
+               i--;
+           }
+
            // Apply inverse transform
-           if (sa2->_length < output._length) {
+           if (sa2->_length < count) {
               delete[] sa2->_array;
-              sa2->_array = new byte[output._length];
+              sa2->_array = new byte[count];
            }
 
            sa1->_length = length;
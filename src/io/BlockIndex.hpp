@@ -0,0 +1,53 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _BlockIndex_
+#define _BlockIndex_
+
+#include "../types.hpp"
+
+namespace kanzi
+{
+
+   // Optional block index written after the end block of the bitstream.
+   // Byte aligned, all values big endian:
+   // number of entries (32 bits)
+   // for each entry: offset in the original data (64 bits), position in the
+   // bitstream in bits (64 bits), size in the bitstream in bits (64 bits)
+   // position of the index in the bitstream in bytes (64 bits)
+   // "KIDX" (32 bits)
+   // There is one entry per block plus a last entry for the end block (with
+   // the size of the original data as offset). The position and size of a
+   // block include the prefix with the block size.
+   class BlockIndexEntry
+   {
+   public:
+       static const int TYPE = 0x4B494458; // "KIDX"
+       static const int ENTRY_SIZE = 24;
+       static const int TRAILER_SIZE = 12;
+
+       int64 _offset;
+       uint64 _position;
+       uint64 _size;
+
+       BlockIndexEntry(int64 offset = 0, uint64 position = 0, uint64 size = 0)
+       {
+           _offset = offset;
+           _position = position;
+           _size = size;
+       }
+   };
+}
+#endif
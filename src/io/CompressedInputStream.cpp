@@ -17,15 +17,14 @@ limitations under the License.
 #include <iomanip>
 #include "CompressedInputStream.hpp"
 #include "IOException.hpp"
+#include "MemoryBudget.hpp"
 #include "../Error.hpp"
+#include "../Memory.hpp"
+#include "../util.hpp"
 #include "../bitstream/DefaultInputBitStream.hpp"
 #include "../entropy/EntropyCodecFactory.hpp"
 #include "../function/FunctionFactory.hpp"
 
-#ifdef CONCURRENCY_ENABLED
-#include <future>
-#endif
-
 using namespace kanzi;
 
 CompressedInputStream::CompressedInputStream(InputStream& is, int tasks)
@@ -38,6 +37,8 @@ CompressedInputStream::CompressedInputStream(InputStream& is, int tasks)
         ss << "The number of jobs must be in [1.." << MAX_CONCURRENCY << "]";
         throw invalid_argument(ss.str());
     }
+
+    ThreadPool::instance().reserve(tasks);
 #else
     if ((tasks <= 0) || (tasks > 1))
         throw invalid_argument("The number of jobs is limited to 1 in this version");
@@ -53,13 +54,24 @@ CompressedInputStream::CompressedInputStream(InputStream& is, int tasks)
     _gcount = 0;
     _ibs = new DefaultInputBitStream(is, DEFAULT_BUFFER_SIZE);
     _jobs = tasks;
+    _slots = tasks;
     _sa = new SliceArray<byte>(new byte[0], 0, 0);
     _hasher = nullptr;
     _nbInputBlocks = 0;
+    _hasIndex = false;
+    _offset = 0;
+    _start = is.rdbuf()->pubseekoff(0, ios::cur, ios::in); // -1 if not seekable
     _buffers = new SliceArray<byte>*[2 * _jobs];
 
     for (int i = 0; i < 2 * _jobs; i++)
         _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
+
+    _predictors = new Predictor*[_jobs];
+
+    for (int i = 0; i < _jobs; i++)
+        _predictors[i] = nullptr;
+
+    _transforms = new FunctionCache<byte>[_jobs];
 }
 
 CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx)
@@ -75,6 +87,8 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx)
         ss << "The number of jobs must be in [1.." << MAX_CONCURRENCY << "]";
         throw invalid_argument(ss.str());
     }
+
+    ThreadPool::instance().reserve(tasks);
 #else
     if ((tasks <= 0) || (tasks > 1))
         throw invalid_argument("The number of jobs is limited to 1 in this version");
@@ -90,13 +104,24 @@ CompressedInputStream::CompressedInputStream(InputStream& is, Context& ctx)
     _gcount = 0;
     _ibs = new DefaultInputBitStream(is, DEFAULT_BUFFER_SIZE);
     _jobs = tasks;
+    _slots = tasks;
     _sa = new SliceArray<byte>(new byte[0], 0, 0);
     _hasher = nullptr;
     _nbInputBlocks = 0;
+    _hasIndex = false;
+    _offset = 0;
+    _start = is.rdbuf()->pubseekoff(0, ios::cur, ios::in); // -1 if not seekable
     _buffers = new SliceArray<byte>*[2 * _jobs];
 
     for (int i = 0; i < 2 * _jobs; i++)
         _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
+
+    _predictors = new Predictor*[_jobs];
+
+    for (int i = 0; i < _jobs; i++)
+        _predictors[i] = nullptr;
+
+    _transforms = new FunctionCache<byte>[_jobs];
 }
 
 CompressedInputStream::~CompressedInputStream()
@@ -111,7 +136,12 @@ CompressedInputStream::~CompressedInputStream()
     for (int i = 0; i < 2 * _jobs; i++)
         delete[] _buffers[i]->_array;
 
+    for (int i = 0; i < _jobs; i++)
+        delete _predictors[i];
+
     delete[] _buffers;
+    delete[] _predictors;
+    delete[] _transforms;
     delete _ibs;
     delete[] _sa->_array;
     delete _sa;
@@ -137,12 +167,14 @@ void CompressedInputStream::readHeader() THROW
     int version = int(_ibs->readBits(5));
 
     // Sanity check
-    if (version != BITSTREAM_FORMAT_VERSION) {
+    if ((version < MIN_BITSTREAM_FORMAT_VERSION) || (version > BITSTREAM_FORMAT_VERSION)) {
         stringstream ss;
         ss << "Invalid bitstream, cannot read this version of the stream: " << version;
         throw IOException(ss.str(), Error::ERR_STREAM_VERSION);
     }
 
+    _ctx.putInt("bsVersion", version);
+
     // Read block checksum
     if (_ibs->readBit() == 1)
         _hasher = new XXHash32(BITSTREAM_TYPE);
@@ -171,11 +203,50 @@ void CompressedInputStream::readHeader() THROW
         _jobs = (1 << 31) / _blockSize;
 #endif
 
+    _slots = _jobs;
+
     // Read number of blocks in input. 0 means 'unknown' and 63 means 63 or more.
     _nbInputBlocks = uint8(_ibs->readBits(6));
+    int modelShrink = 0;
 
-    // Read reserved bits
-    _ibs->readBits(3);
+    if (version >= 9) {
+        // Read block index flag
+        _hasIndex = _ibs->readBit() == 1;
+
+        // Read max number of BWT chunks per block
+        _ctx.putInt("bwtChunks", 8 << (3 * int(_ibs->readBits(2))));
+
+        // Read block pipeline flag (transforms and entropy codec per block)
+        if ((version >= 10) && (_ibs->readBit() == 1))
+            _ctx.putInt("autoPipeline", 0);
+
+        // Read log2 of the reduction of the model tables
+        if (version >= 11)
+            modelShrink = int(_ibs->readBits(2));
+    }
+    else {
+        // Read reserved bits
+        _ibs->readBits(3);
+    }
+
+    _ctx.putInt("modelShrink", modelShrink);
+
+    // Fit the memory limit (in bytes) with fewer blocks decoded concurrently
+    const int64 memoryLimit = _ctx.getLong("memoryLimit", 0);
+
+    if (memoryLimit > 0) {
+        _slots = MemoryBudget::getMaxTasks(memoryLimit, DEFAULT_BUFFER_SIZE, _blockSize, _transformType,
+            _entropyType, _ctx.has("autoPipeline"), modelShrink, _jobs);
+
+        if (_slots == 0) {
+            stringstream ss;
+            ss << "The memory limit (" << memoryLimit << " bytes) is too low to decode this stream (minimum "
+               << MemoryBudget::getMinMemory(DEFAULT_BUFFER_SIZE, _blockSize, _transformType,
+                      _entropyType, _ctx.has("autoPipeline"), modelShrink)
+               << " bytes)";
+            throw IOException(ss.str(), Error::ERR_INVALID_PARAM);
+        }
+    }
 
     if (_listeners.size() > 0) {
         stringstream ss;
@@ -238,7 +309,8 @@ int CompressedInputStream::peek() THROW
 {
     try {
         if (_sa->_index >= _maxIdx) {
-            _maxIdx = processBlock();
+            _offset += _maxIdx;
+            _maxIdx = processBlock(_slots);
 
             if (_maxIdx == 0) {
                 // Reached end of stream
@@ -329,24 +401,219 @@ istream& CompressedInputStream::read(char* data, streamsize length) THROW
     return *this;
 }
 
+streamsize CompressedInputStream::readAt(int64 offset, char* data, streamsize length) THROW
+{
+    if ((offset < 0) || (length < 0))
+        throw ios_base::failure("Invalid offset or buffer size");
+
+    if (_closed.load() == true) {
+        setstate(ios::badbit);
+        throw ios_base::failure("Stream closed");
+    }
+
+    try {
+        if (!_initialized.exchange(true, memory_order_acquire))
+            readHeader();
+
+        if (_index.size() == 0)
+            readIndex();
+
+        if ((offset < _offset) || (offset >= _offset + _maxIdx))
+            moveToBlock(findBlock(offset));
+
+        const int last = findBlock(offset + length - 1);
+        streamsize n = 0;
+
+        while (n < length) {
+            const int64 pos = offset + n;
+
+            if (pos >= _offset + _maxIdx) {
+                // Decode the next blocks overlapping the range (at most _slots)
+                const int nbBlocks = last - _blockId.load() + 1;
+                _offset += _maxIdx;
+                _sa->_index = 0;
+                _maxIdx = processBlock(max(min(nbBlocks, _slots), 1));
+
+                if (_maxIdx == 0)
+                    break;
+
+                continue;
+            }
+
+            _sa->_index = int(pos - _offset);
+            const int lenChunk = int(min(length - n, streamsize(_maxIdx - _sa->_index)));
+            memcpy(&data[n], &_sa->_array[_sa->_index], lenChunk);
+            _sa->_index += lenChunk;
+            n += lenChunk;
+        }
+
+        return n;
+    }
+    catch (exception& e) {
+        setstate(ios::badbit);
+        throw ios_base::failure(e.what());
+    }
+}
+
 streampos CompressedInputStream::tellg()
 {
-    return _is.tellg();
+    return std::streampos(_offset + _sa->_index);
+}
+
+istream& CompressedInputStream::seekg(std::streampos pos) THROW
+{
+    const int64 offset = int64(pos);
+
+    if (offset < 0)
+        throw ios_base::failure("Invalid position");
+
+    if (_closed.load() == true) {
+        setstate(ios::badbit);
+        throw ios_base::failure("Stream closed");
+    }
+
+    try {
+        if (!_initialized.exchange(true, memory_order_acquire))
+            readHeader();
+
+        if (_index.size() == 0)
+            readIndex();
+
+        if ((offset < _offset) || (offset >= _offset + _maxIdx)) {
+            moveToBlock(findBlock(offset));
+            _maxIdx = processBlock(_slots);
+        }
+
+        // Past the end of the data: the next read returns EOF
+        _sa->_index = int(min(offset - _offset, int64(_maxIdx)));
+        clear(rdstate() & ~ios::eofbit);
+        return *this;
+    }
+    catch (exception& e) {
+        setstate(ios::badbit);
+        throw ios_base::failure(e.what());
+    }
 }
 
-istream& CompressedInputStream::seekp(streampos) THROW
+istream& CompressedInputStream::seekp(std::streampos) THROW
 {
     setstate(ios::badbit);
     throw ios_base::failure("Not supported");
 }
 
-int CompressedInputStream::processBlock() THROW
+// Read the block index located at the end of the input stream (see BlockIndex.hpp)
+void CompressedInputStream::readIndex() THROW
+{
+    if (_hasIndex == false)
+        throw IOException("Not supported: no block index in the bitstream", Error::ERR_INVALID_FILE);
+
+    if (_start == std::streampos(-1))
+        throw IOException("Not supported: the input stream is not seekable", Error::ERR_READ_FILE);
+
+    // Access the stream buffer directly to leave the state of the stream unchanged
+    streambuf* sb = _is.rdbuf();
+    const std::streampos current = sb->pubseekoff(0, ios::cur, ios::in);
+    const std::streampos end = sb->pubseekoff(0, ios::end, ios::in);
+    byte buf[BlockIndexEntry::TRAILER_SIZE];
+
+    if ((end - _start < BlockIndexEntry::TRAILER_SIZE)
+        || (sb->pubseekpos(end - std::streamoff(BlockIndexEntry::TRAILER_SIZE), ios::in) == std::streampos(-1))
+        || (sb->sgetn(reinterpret_cast<char*>(buf), BlockIndexEntry::TRAILER_SIZE) != BlockIndexEntry::TRAILER_SIZE)
+        || (BigEndian::readInt32(&buf[8]) != BlockIndexEntry::TYPE))
+        throw IOException("Invalid bitstream, cannot find the block index", Error::ERR_INVALID_FILE);
+
+    const int64 indexPos = BigEndian::readLong64(&buf[0]);
+    const int64 maxEntries = (int64(end - _start) - indexPos - 4 - BlockIndexEntry::TRAILER_SIZE) / BlockIndexEntry::ENTRY_SIZE;
+
+    if ((indexPos <= 0) || (maxEntries <= 0)
+        || (sb->pubseekpos(_start + std::streamoff(indexPos), ios::in) == std::streampos(-1))
+        || (sb->sgetn(reinterpret_cast<char*>(buf), 4) != 4))
+        throw IOException("Invalid bitstream, cannot read the block index", Error::ERR_INVALID_FILE);
+
+    const int64 nbEntries = int64(uint32(BigEndian::readInt32(&buf[0])));
+
+    if ((nbEntries == 0) || (nbEntries > maxEntries))
+        throw IOException("Invalid bitstream, incorrect block index size", Error::ERR_INVALID_FILE);
+
+    vector<byte> entries(size_t(nbEntries * BlockIndexEntry::ENTRY_SIZE));
+    const streamsize sz = streamsize(entries.size());
+
+    if (sb->sgetn(reinterpret_cast<char*>(&entries[0]), sz) != sz)
+        throw IOException("Invalid bitstream, cannot read the block index", Error::ERR_INVALID_FILE);
+
+    vector<BlockIndexEntry> index;
+
+    for (int64 i = 0; i < nbEntries; i++) {
+        const byte* p = &entries[size_t(i * BlockIndexEntry::ENTRY_SIZE)];
+        BlockIndexEntry entry(BigEndian::readLong64(&p[0]), uint64(BigEndian::readLong64(&p[8])),
+            uint64(BigEndian::readLong64(&p[16])));
+
+        if ((i > 0) && ((entry._offset <= index.back()._offset) || (entry._position <= index.back()._position)))
+            throw IOException("Invalid bitstream, incorrect block index", Error::ERR_INVALID_FILE);
+
+        index.push_back(entry);
+    }
+
+    // Restore the position of the input stream (the bitstream may not have read it all)
+    sb->pubseekpos(current, ios::in);
+    _index.swap(index);
+}
+
+// Return the index of the block containing the offset (in the decompressed data)
+// The last entry of the index is the end block (offset = size of the data).
+int CompressedInputStream::findBlock(int64 offset) const
+{
+    int lo = 0;
+    int hi = int(_index.size()) - 1;
+
+    while (lo < hi) {
+        const int mid = (lo + hi + 1) >> 1;
+
+        if (_index[mid]._offset <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+// Reposition the input stream at the beginning of the block
+void CompressedInputStream::moveToBlock(int block) THROW
+{
+    const BlockIndexEntry& entry = _index[block];
+    const std::streampos pos = _start + std::streamoff(entry._position >> 3);
+
+    if (_is.rdbuf()->pubseekpos(pos, ios::in) != pos)
+        throw IOException("Cannot seek in the input stream", Error::ERR_READ_FILE);
+
+    _is.clear();
+    delete _ibs;
+    _ibs = new DefaultInputBitStream(_is, DEFAULT_BUFFER_SIZE);
+
+    if ((entry._position & 7) != 0)
+        _ibs->readBits(uint(entry._position & 7));
+
+    // Id of the last block processed (block ids start at 1)
+    _blockId = block;
+    _offset = entry._offset;
+    _sa->_index = 0;
+    _maxIdx = 0;
+}
+
+// Decode up to nbBlocks blocks (one per task) into _sa
+// Return the number of bytes decoded
+int CompressedInputStream::processBlock(int nbBlocks) THROW
 {
     vector<DecodingTask<DecodingTaskResult>*> tasks;
 
-    if (!_initialized.exchange(true, memory_order_acquire))
+    if (!_initialized.exchange(true, memory_order_acquire)) {
         readHeader();
 
+        // The header may limit the number of blocks decoded concurrently
+        nbBlocks = max(min(nbBlocks, _slots), 1);
+    }
+
     try {
         // Add a padding area to manage any block with header or temporarily expanded
         const int blkSize = max(_blockSize + EXTRA_BUFFER_SIZE, _blockSize + (_blockSize >> 4));
@@ -356,7 +623,7 @@ int CompressedInputStream::processBlock() THROW
         int decoded = 0;
         _sa->_index = 0;
         const int firstBlockId = _blockId.load();
-        int nbTasks = _jobs;
+        int nbTasks = nbBlocks;
         int* jobsPerTask;
 
         // Assign optimal number of tasks and jobs per task
@@ -399,7 +666,7 @@ int CompressedInputStream::processBlock() THROW
             DecodingTask<DecodingTaskResult>* task = new DecodingTask<DecodingTaskResult>(_buffers[2 * jobId],
                 _buffers[2 * jobId + 1], blkSize, _transformType,
                 _entropyType, firstBlockId + jobId + 1, _ibs, _hasher, &_blockId,
-                blockListeners, copyCtx);
+                blockListeners, copyCtx, &_predictors[jobId], &_transforms[jobId]);
             tasks.push_back(task);
         }
 
@@ -440,22 +707,17 @@ int CompressedInputStream::processBlock() THROW
         }
 #ifdef CONCURRENCY_ENABLED
         else {
-            vector<future<DecodingTaskResult> > futures;
             vector<DecodingTaskResult> results;
 
-            // Register task futures and launch tasks in parallel
-            for (uint i = 0; i < tasks.size(); i++) {
-                futures.push_back(async(&DecodingTask<DecodingTaskResult>::run, tasks[i]));
-            }
+            // Run the tasks in parallel (in the shared thread pool)
+            ThreadPool::instance().run(tasks, results);
 
-            // Wait for tasks completion and check results
-            for (uint i = 0; i < futures.size(); i++) {
-                DecodingTaskResult status = futures[i].get();
-                results.push_back(status);
-                decoded += status._decoded;
+            // Check results
+            for (uint i = 0; i < results.size(); i++) {
+                decoded += results[i]._decoded;
 
-                if (status._error != 0)
-                    throw IOException(status._msg, status._error); // deallocate in catch block
+                if (results[i]._error != 0)
+                    throw IOException(results[i]._msg, results[i]._error); // deallocate in catch block
             }
 
             const int size = _sa->_index + decoded;
@@ -532,6 +794,12 @@ void CompressedInputStream::close() THROW
         _buffers[i]->_array = new byte[0];
         _buffers[i]->_length = 0;
     }
+
+    for (int i = 0; i < _jobs; i++) {
+        delete _predictors[i];
+        _predictors[i] = nullptr;
+        _transforms[i].clear();
+    }
 }
 
 // Return the number of bytes read so far
@@ -553,7 +821,7 @@ DecodingTask<T>::DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
     uint64 transformType, uint32 entropyType, int blockId,
     InputBitStream* ibs, XXHash32* hasher,
     atomic_int* processedBlockId, vector<Listener*>& listeners,
-    Context& ctx)
+    Context& ctx, Predictor** predictor, FunctionCache<byte>* transforms)
     : _ctx(ctx)
 {
     _blockLength = blockSize;
@@ -566,6 +834,8 @@ DecodingTask<T>::DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
     _hasher = hasher;
     _listeners = listeners;
     _processedBlockId = processedBlockId;
+    _predictor = predictor;
+    _transforms = transforms;
 }
 
 // Decode mode + transformed entropy coded data
@@ -577,6 +847,9 @@ DecodingTask<T>::DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
 //  case more than 4 transforms
 //      | 0b00000000
 //      then 0byyyyyyyy => transform sequence skip flags (1 means skip)
+// Since version 9 of the bitstream, each block is prefixed with its size in bits.
+// Only the copy of the block from the shared bitstream is sequential, the
+// entropy decoding and inverse transform of the blocks run concurrently.
 template <class T>
 T DecodingTask<T>::run() THROW
 {
@@ -584,6 +857,10 @@ T DecodingTask<T>::run() THROW
 
     // Lock free synchronization
     while ((taskId != CompressedInputStream::CANCEL_TASKS_ID) && (taskId != _blockId - 1)) {
+#ifdef CONCURRENCY_ENABLED
+        // Other tasks may still be decoding, do not hog the CPU
+        this_thread::yield();
+#endif
         taskId = _processedBlockId->load();
     }
 
@@ -592,13 +869,66 @@ T DecodingTask<T>::run() THROW
         return T(*_data, _blockId, 0, 0, 0, "");
     }
 
+    const bool shared = _ctx.getInt("bsVersion") < 9;
     int checksum1 = 0;
     EntropyDecoder* ed = nullptr;
 
+    // Bitstream local to the task (unused with legacy bitstreams)
+    istreambuf<char> buf;
+    istream is(&buf);
+    DefaultInputBitStream lbs(is, 16384);
+    InputBitStream* ibs = _ibs;
+
     try {
-        // Extract block header directly from bitstream
-        uint64 read = _ibs->read();
-        byte mode = byte(_ibs->readBits(8));
+        uint64 read = 0;
+
+        if (shared == false) {
+            // Read block size in bits from the shared bitstream (aka 'block header')
+            const uint lw = uint(_ibs->readBits(5)) + 3;
+            read = _ibs->readBits(lw);
+
+            if (read == 0) {
+                // Last block is empty, return success and cancel pending tasks
+                _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID);
+                return T(*_data, _blockId, 0, checksum1, 0, "");
+            }
+
+            if (read > (uint64(1) << 34)) {
+                // Error => cancel concurrent decoding tasks
+                _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID);
+                stringstream ss;
+                ss << "Invalid block size in bitstream: " << read;
+                return T(*_data, _blockId, 0, checksum1, Error::ERR_READ_FILE, ss.str());
+            }
+
+            const int r = int((read + 7) >> 3);
+
+            if (_data->_length < max(_blockLength, r)) {
+                _data->_length = max(_blockLength, r);
+                delete[] _data->_array;
+                _data->_array = new byte[_data->_length];
+            }
+
+            // Copy block data from the shared bitstream
+            for (uint n = 0; read > 0; ) {
+                const uint chkSize = uint(min(read, uint64(1) << 30));
+                _ibs->readBits(&_data->_array[n], chkSize);
+                n += ((chkSize + 7) >> 3);
+                read -= uint64(chkSize);
+            }
+
+            // After completion of the bitstream reading, increment the block id.
+            // It unfreezes the task processing the next block (if any)
+            (*_processedBlockId)++;
+
+            // All the code below is concurrent
+            buf.pubsetbuf(reinterpret_cast<char*>(&_data->_array[0]), streamsize(r));
+            ibs = &lbs;
+        }
+
+        // Extract block header from bitstream
+        read = ibs->read();
+        byte mode = byte(ibs->readBits(8));
         byte skipFlags = byte(0);
 
         if ((mode & CompressedInputStream::COPY_BLOCK_MASK) != byte(0)) {
@@ -607,25 +937,33 @@ T DecodingTask<T>::run() THROW
         }
         else {
             if ((mode & CompressedInputStream::TRANSFORMS_MASK) != byte(0))
-                skipFlags = byte(_ibs->readBits(8));
+                skipFlags = byte(ibs->readBits(8));
             else
                 skipFlags = (mode << 4) | byte(0x0F);
+
+            if (_ctx.has("autoPipeline")) {
+                // Transforms and entropy codec of the block
+                _entropyType = uint32(ibs->readBits(5));
+                _transformType = ibs->readBits(48);
+            }
         }
 
         int dataSize = 1 + (int(mode >> 5) & 0x03);
         int length = dataSize << 3;
         uint64 mask = (uint64(1) << length) - 1;
-        int preTransformLength = int(_ibs->readBits(length) & mask);
+        int preTransformLength = int(ibs->readBits(length) & mask);
 
-        if (preTransformLength == 0) {
+        if ((preTransformLength == 0) && (shared == true)) {
             // Last block is empty, return success and cancel pending tasks
             _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID);
             return T(*_data, _blockId, 0, checksum1, 0, "");
         }
 
-        if ((preTransformLength < 0) || (preTransformLength > CompressedInputStream::MAX_BITSTREAM_BLOCK_SIZE)) {
+        if ((preTransformLength <= 0) || (preTransformLength > CompressedInputStream::MAX_BITSTREAM_BLOCK_SIZE)) {
             // Error => cancel concurrent decoding tasks
-            _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID);
+            if (shared == true)
+                _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID);
+
             stringstream ss;
             ss << "Invalid compressed block length: " << preTransformLength;
             return T(*_data, _blockId, 0, checksum1, Error::ERR_READ_FILE, ss.str());
@@ -633,7 +971,7 @@ T DecodingTask<T>::run() THROW
 
         // Extract checksum from bit stream (if any)
         if (_hasher != nullptr)
-            checksum1 = int(_ibs->readBits(32));
+            checksum1 = int(ibs->readBits(32));
 
         if (_listeners.size() > 0) {
             // Notify before entropy (block size in bitstream is unknown)
@@ -654,12 +992,16 @@ T DecodingTask<T>::run() THROW
 
         // Each block is decoded separately
         // Rebuild the entropy decoder to reset block statistics
-        ed = EntropyCodecFactory::newDecoder(*_ibs, _ctx, _entropyType);
+        // (the model of the binary entropy decoders is reset, not reallocated)
+        ed = EntropyCodecFactory::newDecoder(*ibs, _ctx, _entropyType, _predictor);
 
         // Block entropy decode
         if (ed->decode(_buffer->_array, 0, preTransformLength) != preTransformLength) {
             // Error => cancel concurrent decoding tasks
-            _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID);
+            if (shared == true)
+                _processedBlockId->store(CompressedInputStream::CANCEL_TASKS_ID);
+
+            delete ed;
             return T(*_data, _blockId, 0, checksum1, Error::ERR_PROCESS_BLOCK,
                 "Entropy decoding failed");
         }
@@ -670,14 +1012,15 @@ T DecodingTask<T>::run() THROW
         if (_listeners.size() > 0) {
             // Notify after entropy (block size set to size in bitstream)
             Event evt(Event::AFTER_ENTROPY, _blockId,
-                int64((_ibs->read() - read) / 8), checksum1, _hasher != nullptr, clock());
+                int64((ibs->read() - read) / 8), checksum1, _hasher != nullptr, clock());
 
             CompressedInputStream::notifyListeners(_listeners, evt);
         }
 
         // After completion of the entropy decoding, increment the block id.
         // It unfreezes the task processing the next block (if any)
-        (*_processedBlockId)++;
+        if (shared == true)
+            (*_processedBlockId)++;
 
         if (_listeners.size() > 0) {
             // Notify before transform (block size after entropy decoding)
@@ -687,14 +1030,14 @@ T DecodingTask<T>::run() THROW
             CompressedInputStream::notifyListeners(_listeners, evt);
         }
 
-        TransformSequence<byte>* transform = FunctionFactory<byte>::newFunction(_ctx, _transformType);
+        // The transform sequence (and its buffers) is reused from block to block
+        TransformSequence<byte>* transform = _transforms->get(_ctx, _transformType, short(_entropyType));
         transform->setSkipFlags(skipFlags);
         _buffer->_index = 0;
 
         // Inverse transform
         _buffer->_length = preTransformLength;
         bool res = transform->inverse(*_buffer, *_data, _buffer->_length);
-        delete transform;
 
         if (res == false) {
             return T(*_data, _blockId, 0, checksum1, Error::ERR_PROCESS_BLOCK,
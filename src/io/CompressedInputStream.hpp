@@ -24,12 +24,16 @@ limitations under the License.
 #include "../InputStream.hpp"
 #include "../OutputStream.hpp"
 #include "../InputBitStream.hpp"
+#include "../Predictor.hpp"
 #include "../SliceArray.hpp"
 #include "../util/XXHash32.hpp"
+#include "BlockIndex.hpp"
 
 namespace kanzi
 {
 
+   template <class T> class FunctionCache;
+
    class DecodingTaskResult {
    public:
        int _blockId;
@@ -73,12 +77,26 @@ namespace kanzi
            _completionTime = result._completionTime;
        }
 
+       DecodingTaskResult& operator=(const DecodingTaskResult& result)
+       {
+           _msg = result._msg;
+           _data = result._data;
+           _blockId = result._blockId;
+           _error = result._error;
+           _decoded = result._decoded;
+           _checksum = result._checksum;
+           _completionTime = result._completionTime;
+           return *this;
+       }
+
        ~DecodingTaskResult() {}
    };
 
    // A task used to decode a block
-   // Several tasks may run in parallel. The transforms can be computed concurrently
-   // but the entropy decoding is sequential since all tasks share the same bitstream.
+   // Several tasks may run in parallel. Since version 9 of the bitstream, only the
+   // extraction of the block from the shared bitstream is sequential, both entropy
+   // decoding and inverse transform are computed concurrently. With older bitstreams,
+   // the entropy decoding is sequential since all tasks share the same bitstream.
    template <class T>
    class DecodingTask : public Task<T> {
    private:
@@ -93,13 +111,15 @@ namespace kanzi
        atomic_int* _processedBlockId;
        vector<Listener*> _listeners;
        Context _ctx;
+       Predictor** _predictor; // predictor reused from block to block
+       FunctionCache<byte>* _transforms; // transforms reused from block to block
 
    public:
        DecodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuffer, int blockSize,
            uint64 transformType, uint32 entropyType, int blockId,
            InputBitStream* ibs, XXHash32* hasher,
            atomic_int* processedBlockId, vector<Listener*>& listeners,
-           Context& ctx);
+           Context& ctx, Predictor** predictor, FunctionCache<byte>* transforms);
 
        ~DecodingTask(){};
 
@@ -111,7 +131,8 @@ namespace kanzi
 
    private:
        static const int BITSTREAM_TYPE = 0x4B414E5A; // "KANZ"
-       static const int BITSTREAM_FORMAT_VERSION = 8;
+       static const int BITSTREAM_FORMAT_VERSION = 12;
+       static const int MIN_BITSTREAM_FORMAT_VERSION = 8;
        static const int DEFAULT_BUFFER_SIZE = 256 * 1024;
        static const int EXTRA_BUFFER_SIZE = 256;
        static const byte COPY_BLOCK_MASK = byte(0x80);
@@ -123,9 +144,15 @@ namespace kanzi
 
        int _blockSize;
        uint8 _nbInputBlocks;
+       bool _hasIndex;
+       vector<BlockIndexEntry> _index; // loaded on first random access
+       std::streampos _start; // position of the bitstream in the input stream
+       int64 _offset; // offset in the decompressed data of the first byte in _sa
        XXHash32* _hasher;
        SliceArray<byte>* _sa; // for all blocks
        SliceArray<byte>** _buffers; // per block
+       Predictor** _predictors; // entropy predictor per job (kept between blocks)
+       FunctionCache<byte>* _transforms; // transform sequence per job (kept between blocks)
        uint32 _entropyType;
        uint64 _transformType;
        InputBitStream* _ibs;
@@ -135,13 +162,20 @@ namespace kanzi
        atomic_int _blockId;
        int _maxIdx;
        int _jobs;
+       int _slots; // max number of blocks decoded concurrently (memory budget)
        vector<Listener*> _listeners;
        streamsize _gcount;
        Context _ctx;
 
        void readHeader() THROW;
 
-       int processBlock() THROW;
+       void readIndex() THROW;
+
+       int findBlock(int64 offset) const;
+
+       void moveToBlock(int block) THROW;
+
+       int processBlock(int nbBlocks) THROW;
 
        int _get();
 
@@ -158,12 +192,22 @@ namespace kanzi
 
        bool removeListener(Listener& bl);
 
-       streampos tellg();
+       // Position in the decompressed data
+       std::streampos tellg();
+
+       // Move to a position in the decompressed data. Requires a bitstream with
+       // a block index and a seekable input stream.
+       istream& seekg(std::streampos pos) THROW;
 
-       istream& seekp(streampos pos) THROW;
+       istream& seekp(std::streampos pos) THROW;
 
        istream& read(char* s, streamsize n) THROW;
 
+       // Read n bytes at the provided offset in the decompressed data. Only the
+       // blocks overlapping the range are decoded. Same requirements as seekg.
+       // Return the number of bytes read (less than n at the end of the data).
+       streamsize readAt(int64 offset, char* s, streamsize n) THROW;
+
        int get() THROW;
 
        int peek() THROW;
@@ -16,16 +16,16 @@ limitations under the License.
 #include <sstream>
 #include "CompressedOutputStream.hpp"
 #include "IOException.hpp"
+#include "MemoryBudget.hpp"
+#include "PipelineSelector.hpp"
 #include "../Error.hpp"
+#include "../Global.hpp"
+#include "../util.hpp"
 #include "../bitstream/DefaultOutputBitStream.hpp"
 #include "../entropy/EntropyCodecFactory.hpp"
 #include "../entropy/EntropyUtils.hpp"
 #include "../function/FunctionFactory.hpp"
 
-#ifdef CONCURRENCY_ENABLED
-#include <future>
-#endif
-
 using namespace kanzi;
 
 CompressedOutputStream::CompressedOutputStream(OutputStream& os, const string& entropyCodec, const string& transform, int bSize, int tasks, bool checksum)
@@ -38,6 +38,8 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, const string& e
         ss << "The number of jobs must be in [1.." << MAX_CONCURRENCY << "]";
         throw invalid_argument(ss.str());
     }
+
+    ThreadPool::instance().reserve(tasks);
 #else
     if ((tasks <= 0) || (tasks > 1))
         throw invalid_argument("The number of jobs is limited to 1 in this version");
@@ -64,6 +66,7 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, const string& e
 #endif
 
     _blockId = 0;
+    _lastBlockId = 0;
     _blockSize = bSize;
     _nbInputBlocks = 0;
     _initialized = false;
@@ -73,11 +76,32 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, const string& e
     _transformType = FunctionFactory<byte>::getType(transform.c_str());
     _hasher = (checksum == true) ? new XXHash32(BITSTREAM_TYPE) : nullptr;
     _jobs = tasks;
-    _sa = new SliceArray<byte>(new byte[_blockSize], _blockSize, 0); // initially 1 blockSize
-    _buffers = new SliceArray<byte>*[2 * _jobs];
-
-    for (int i = 0; i < 2 * _jobs; i++)
+    _slots = tasks;
+    _modelShrink = 0;
+    _writeIndex = false;
+    _bwtChunksLog = 0;
+    _autoPipeline = false;
+    _controller = nullptr;
+    _sa = new SliceArray<byte>(new byte[_blockSize], _blockSize, 0);
+    _buffers = new SliceArray<byte>*[2 * _slots];
+
+    for (int i = 0; i < 2 * _slots; i++)
         _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
+
+    _tasks = new EncodingTask<EncodingTaskResult>*[_slots];
+    _predictors = new Predictor*[_slots];
+    _transforms = new FunctionCache<byte>[_slots];
+#ifdef CONCURRENCY_ENABLED
+    _futures = new ThreadPool::Future<EncodingTask<EncodingTaskResult>, EncodingTaskResult>*[_slots];
+#endif
+
+    for (int i = 0; i < _slots; i++) {
+        _tasks[i] = nullptr;
+        _predictors[i] = nullptr;
+#ifdef CONCURRENCY_ENABLED
+        _futures[i] = nullptr;
+#endif
+    }
 }
 
 CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx)
@@ -93,6 +117,8 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx)
         ss << "The number of jobs must be in [1.." << MAX_CONCURRENCY << "]";
         throw invalid_argument(ss.str());
     }
+
+    ThreadPool::instance().reserve(tasks);
 #else
     if ((tasks <= 0) || (tasks > 1))
         throw invalid_argument("The number of jobs is limited to 1 in this version");
@@ -123,6 +149,7 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx)
 #endif
 
     _blockId = 0;
+    _lastBlockId = 0;
     _blockSize = bSize;
 
     // If input size has been provided, calculate the number of blocks
@@ -142,12 +169,80 @@ CompressedOutputStream::CompressedOutputStream(OutputStream& os, Context& ctx)
     string str = ctx.getString("checksum");
     bool checksum = str == "TRUE";
     _hasher = (checksum == true) ? new XXHash32(BITSTREAM_TYPE) : nullptr;
+    str = ctx.getString("index");
+    _writeIndex = str == "TRUE";
+
+    // Max number of BWT chunks per block: 8 << (3*_bwtChunksLog). More chunks
+    // (thus more primary indexes) let the decoder invert big BWT blocks with
+    // more jobs. By default, scale with the number of jobs.
+    const int bwtChunks = ctx.getInt("bwtChunks", tasks);
+    _bwtChunksLog = 0;
+
+    while ((_bwtChunksLog < 3) && ((8 << (3 * _bwtChunksLog)) < bwtChunks))
+        _bwtChunksLog++;
+
+    _ctx.putInt("bwtChunks", 8 << (3 * _bwtChunksLog));
+
+    // Select the transforms and entropy codec of each block (minimum speed in MB/s)
+    _autoPipeline = ctx.has("autoPipeline");
+    _controller = nullptr;
+
+    // Or adapt the selection to keep the measured speed above the target
+    if (ctx.has("targetSpeed")) {
+        const int targetSpeed = ctx.getInt("targetSpeed");
+
+        if (targetSpeed <= 0)
+            throw invalid_argument("The target speed must be positive");
+
+        _controller = new SpeedController(targetSpeed);
+        _autoPipeline = true;
+        _ctx.putInt("autoPipeline", targetSpeed);
+    }
+
     _jobs = tasks;
-    _sa = new SliceArray<byte>(new byte[_blockSize], _blockSize, 0); // initially 1 blockSize
-    _buffers = new SliceArray<byte>*[2 * _jobs];
+    _slots = tasks;
+    _modelShrink = 0;
+
+    // Fit the memory limit (in bytes): fewer blocks in flight, then smaller
+    // model tables if one block does not fit
+    const int64 memoryLimit = ctx.getLong("memoryLimit", 0);
+
+    if (memoryLimit > 0) {
+        _slots = MemoryBudget::fit(memoryLimit, int64(_blockSize) + DEFAULT_BUFFER_SIZE, _blockSize,
+            _transformType, _entropyType, _autoPipeline, _jobs, _modelShrink);
+
+        if (_slots == 0) {
+            stringstream ss;
+            ss << "The memory limit (" << memoryLimit << " bytes) is too low for the block size and codecs (minimum "
+               << MemoryBudget::getMinMemory(int64(_blockSize) + DEFAULT_BUFFER_SIZE, _blockSize,
+                      _transformType, _entropyType, _autoPipeline, MemoryBudget::MAX_MODEL_SHRINK)
+               << " bytes)";
+            throw invalid_argument(ss.str());
+        }
+
+        _ctx.putInt("modelShrink", _modelShrink);
+    }
+
+    _sa = new SliceArray<byte>(new byte[_blockSize], _blockSize, 0);
+    _buffers = new SliceArray<byte>*[2 * _slots];
 
-    for (int i = 0; i < 2 * _jobs; i++)
+    for (int i = 0; i < 2 * _slots; i++)
         _buffers[i] = new SliceArray<byte>(new byte[0], 0, 0);
+
+    _tasks = new EncodingTask<EncodingTaskResult>*[_slots];
+    _predictors = new Predictor*[_slots];
+    _transforms = new FunctionCache<byte>[_slots];
+#ifdef CONCURRENCY_ENABLED
+    _futures = new ThreadPool::Future<EncodingTask<EncodingTaskResult>, EncodingTaskResult>*[_slots];
+#endif
+
+    for (int i = 0; i < _slots; i++) {
+        _tasks[i] = nullptr;
+        _predictors[i] = nullptr;
+#ifdef CONCURRENCY_ENABLED
+        _futures[i] = nullptr;
+#endif
+    }
 }
 
 CompressedOutputStream::~CompressedOutputStream()
@@ -159,11 +254,24 @@ CompressedOutputStream::~CompressedOutputStream()
         // Ignore and continue
     }
 
-    for (int i = 0; i < 2 * _jobs; i++)
+    // Wait for the blocks still in flight (if close failed)
+    cancelBlocks();
+
+    for (int i = 0; i < 2 * _slots; i++)
         delete[] _buffers[i]->_array;
 
+    for (int i = 0; i < _slots; i++)
+        delete _predictors[i];
+
     delete[] _buffers;
+    delete[] _tasks;
+    delete[] _predictors;
+    delete[] _transforms;
+#ifdef CONCURRENCY_ENABLED
+    delete[] _futures;
+#endif
     delete _obs;
+    delete _controller;
     delete[] _sa->_array;
     delete _sa;
 
@@ -196,8 +304,45 @@ void CompressedOutputStream::writeHeader() THROW
     if (_obs->writeBits(_nbInputBlocks, 6) != 6)
         throw IOException("Cannot write number of blocks to header", Error::ERR_WRITE_FILE);
 
-    if (_obs->writeBits(uint64(0), 3) != 3)
-        throw IOException("Cannot write reserved bits to header", Error::ERR_WRITE_FILE);
+    if (_obs->writeBits((_writeIndex == true) ? 1 : 0, 1) != 1)
+        throw IOException("Cannot write block index flag to header", Error::ERR_WRITE_FILE);
+
+    if (_obs->writeBits(_bwtChunksLog, 2) != 2)
+        throw IOException("Cannot write max number of BWT chunks to header", Error::ERR_WRITE_FILE);
+
+    if (_obs->writeBits((_autoPipeline == true) ? 1 : 0, 1) != 1)
+        throw IOException("Cannot write block pipeline flag to header", Error::ERR_WRITE_FILE);
+
+    if (_obs->writeBits(_modelShrink, 2) != 2)
+        throw IOException("Cannot write model shrink to header", Error::ERR_WRITE_FILE);
+}
+
+// Write the block index after the end block (see BlockIndex.hpp)
+void CompressedOutputStream::writeIndex() THROW
+{
+    // Align to byte so that the index can be located from the end of the stream
+    _obs->writeBits(uint64(0), uint((8 - (_obs->written() & 7)) & 7));
+    const uint64 indexPos = _obs->written() >> 3;
+    _obs->writeBits(uint64(_index.size()), 32);
+
+    for (uint i = 0; i < _index.size(); i++) {
+        _obs->writeBits(uint64(_index[i]._offset), 64);
+        _obs->writeBits(_index[i]._position, 64);
+        _obs->writeBits(_index[i]._size, 64);
+    }
+
+    _obs->writeBits(indexPos, 64);
+    _obs->writeBits(BlockIndexEntry::TYPE, 32);
+}
+
+void CompressedOutputStream::addIndexEntry(const EncodingTaskResult& res)
+{
+    if (_writeIndex == false)
+        return;
+
+    // All blocks but the last one have a size of _blockSize
+    const int64 offset = int64(_index.size()) * int64(_blockSize);
+    _index.push_back(BlockIndexEntry(offset, res._position, res._size));
 }
 
 bool CompressedOutputStream::addListener(Listener& bl)
@@ -258,7 +403,7 @@ ostream& CompressedOutputStream::put(char c) THROW
     try {
         // If the buffer is full, time to encode
         if (_sa->_index >= _sa->_length)
-            processBlock(false);
+            processBlock();
 
         _sa->_array[_sa->_index++] = (byte)c;
         return *this;
@@ -280,13 +425,41 @@ void CompressedOutputStream::close() THROW
     if (_closed.exchange(true, memory_order_acquire))
         return;
 
-    if (_sa->_index > 0)
-        processBlock(true);
-
     try {
+        // Size of the data (all blocks but the last one have a size of _blockSize)
+        const int64 size = int64(_lastBlockId) * int64(_blockSize) + int64(_sa->_index);
+
+        if (_sa->_index > 0)
+            processBlock();
+
+        // Wait for the blocks in flight, oldest first
+        for (int i = 1; i <= _slots; i++) {
+            EncodingTaskResult res = completeBlock((_lastBlockId + i) % _slots);
+
+            if (res._error != 0) {
+                cancelBlocks();
+                throw IOException(res._msg, res._error);
+            }
+
+            if (res._blockId > 0)
+                addIndexEntry(res);
+        }
+
+        // Empty input: no block has been processed
+        if (!_initialized.exchange(true, memory_order_acquire))
+            writeHeader();
+
+        // The last entry of the index is the end block
+        if (_writeIndex == true)
+            _index.push_back(BlockIndexEntry(size, _obs->written(), 8));
+
         // Write end block of size 0
-        _obs->writeBits(uint64(COPY_BLOCK_MASK), 8);
-        _obs->writeBits(uint64(0), 8);
+        _obs->writeBits(uint64(0), 5); // write length-3 (5 bits max)
+        _obs->writeBits(uint64(0), 3);
+
+        if (_writeIndex == true)
+            writeIndex();
+
         _obs->close();
     }
     catch (exception& e) {
@@ -303,11 +476,17 @@ void CompressedOutputStream::close() THROW
     _sa->_length = 0;
     _sa->_index = -1;
 
-    for (int i = 0; i < 2 * _jobs; i++) {
+    for (int i = 0; i < 2 * _slots; i++) {
         delete[] _buffers[i]->_array;
         _buffers[i]->_array = new byte[0];
         _buffers[i]->_length = 0;
     }
+
+    for (int i = 0; i < _slots; i++) {
+        delete _predictors[i];
+        _predictors[i] = nullptr;
+        _transforms[i].clear();
+    }
 }
 
 streampos CompressedOutputStream::tellp()
@@ -315,128 +494,136 @@ streampos CompressedOutputStream::tellp()
     return _os.tellp();
 }
 
-ostream& CompressedOutputStream::seekp(streampos) THROW
+ostream& CompressedOutputStream::seekp(std::streampos) THROW
 {
     setstate(ios::badbit);
     throw ios_base::failure("Not supported");
 }
 
-void CompressedOutputStream::processBlock(bool force) THROW
+// Blocks are encoded concurrently in a sliding window of _slots blocks: the
+// next block is filled while the previous ones are encoded, and the tasks emit
+// their block to the bitstream in order as soon as it is ready. The slot of
+// the oldest block in flight is reused once this block has been emitted.
+void CompressedOutputStream::processBlock() THROW
 {
     if (_sa->_index == 0)
         return;
 
-    if (!force && (_sa->_length < _jobs * _blockSize)) {
-        // Grow byte array until max allowed
-        byte* buf = new byte[_sa->_length + _blockSize];
-        memcpy(buf, _sa->_array, _sa->_length);
-        delete[] _sa->_array;
-        _sa->_array = buf;
-        _sa->_length = _sa->_length + _blockSize;
-        return;
-    }
-
     if (!_initialized.exchange(true, memory_order_acquire))
         writeHeader();
 
-    vector<EncodingTask<EncodingTaskResult>*> tasks;
+    const int blockId = _lastBlockId + 1;
+    const int slot = blockId % _slots;
+    EncodingTaskResult res = completeBlock(slot);
 
-    try {
+    if (res._error != 0) {
+        cancelBlocks();
+        throw IOException(res._msg, res._error);
+    }
 
+    if (res._blockId > 0)
+        addIndexEntry(res);
+
+    try {
         // Protect against future concurrent modification of the list of block listeners
         vector<Listener*> blockListeners(_listeners);
-        const int dataLength = _sa->_index;
-        _sa->_index = 0;
-        int firstBlockId = _blockId.load();
-
-        // Create as many tasks as required
-        for (int jobId = 0; jobId < _jobs; jobId++) {
-            const int sz = (_sa->_index + _blockSize > dataLength) ? dataLength - _sa->_index : _blockSize;
-
-            if (sz == 0)
-                break;
 
-            Context copyCtx(_ctx);
-            _buffers[2 * jobId]->_index = 0;
-            _buffers[2 * jobId + 1]->_index = 0;
-
-            // Grow encoding buffer if required
-            if (_buffers[2 * jobId]->_length < sz) {
-                delete[] _buffers[2 * jobId]->_array;
-                _buffers[2 * jobId]->_array = new byte[sz];
-                _buffers[2 * jobId]->_length = sz;
-            }
-
-            memcpy(&_buffers[2 * jobId]->_array[0], &_sa->_array[_sa->_index], sz);
-
-            EncodingTask<EncodingTaskResult>* task = new EncodingTask<EncodingTaskResult>(_buffers[2 * jobId],
-                _buffers[2 * jobId + 1], sz, _transformType,
-                _entropyType, firstBlockId + jobId + 1,
-                _obs, _hasher, &_blockId,
-                blockListeners, copyCtx);
-            tasks.push_back(task);
-            _sa->_index += sz;
+        if (_controller != nullptr)
+            blockListeners.push_back(_controller);
+
+        const int sz = _sa->_index;
+        SliceArray<byte>* iBuffer = _buffers[2 * slot];
+        SliceArray<byte>* oBuffer = _buffers[2 * slot + 1];
+        Context copyCtx(_ctx);
+        iBuffer->_index = 0;
+        oBuffer->_index = 0;
+
+        // Share the jobs among the blocks in flight. If there are fewer blocks
+        // in flight than jobs (few input blocks or memory limit), each block
+        // gets several jobs (used by the BWT).
+        const int nbTasks = ((_nbInputBlocks != 0) && (int(_nbInputBlocks) < _slots)) ? int(_nbInputBlocks) : _slots;
+        int jobsPerTask[MAX_CONCURRENCY];
+        Global::computeJobsPerTask(jobsPerTask, _jobs, nbTasks);
+        copyCtx.putInt("jobs", jobsPerTask[slot % nbTasks]);
+
+        // Grow encoding buffer if required
+        if (iBuffer->_length < sz) {
+            delete[] iBuffer->_array;
+            iBuffer->_array = new byte[sz];
+            iBuffer->_length = sz;
         }
 
-        if (tasks.size() == 1) {
-            // Synchronous call
-            EncodingTask<EncodingTaskResult>* task = tasks.back();
-            tasks.pop_back();
-            EncodingTaskResult res = task->run();
-
-            if (res._error != 0)
-                throw IOException(res._msg, res._error); // deallocate in catch block
+        memcpy(&iBuffer->_array[0], &_sa->_array[0], sz);
+        _sa->_index = 0;
+        _lastBlockId = blockId;
+        EncodingTask<EncodingTaskResult>* task = new EncodingTask<EncodingTaskResult>(iBuffer,
+            oBuffer, sz, _transformType, _entropyType, blockId,
+            _obs, _hasher, &_blockId, blockListeners, copyCtx, &_predictors[slot], &_transforms[slot],
+            _controller);
 
+        if (_slots == 1) {
+            // Synchronous call
+            res = task->run();
             delete task;
-        }
-#ifdef CONCURRENCY_ENABLED
-        else {
-            vector<future<EncodingTaskResult> > futures;
 
-            // Register task futures and launch tasks in parallel
-            for (uint i = 0; i < tasks.size(); i++) {
-                futures.push_back(async(launch::async, &EncodingTask<EncodingTaskResult>::run, tasks[i]));
-            }
-
-            // Wait for tasks completion and check results
-            for (uint i = 0; i < tasks.size(); i++) {
-                EncodingTaskResult status = futures[i].get();
+            if (res._error != 0)
+                throw IOException(res._msg, res._error);
 
-                if (status._error != 0)
-                    throw IOException(status._msg, status._error); // deallocate in catch block
-            }
+            addIndexEntry(res);
+            return;
         }
 
-        for (EncodingTask<EncodingTaskResult>* task : tasks)
-            delete task;
-
-        tasks.clear();
+        _tasks[slot] = task;
+#ifdef CONCURRENCY_ENABLED
+        _futures[slot] = ThreadPool::instance().schedule<EncodingTaskResult>(task);
 #endif
-        _sa->_index = 0;
     }
     catch (IOException& e) {
-        for (vector<EncodingTask<EncodingTaskResult>*>::iterator it = tasks.begin(); it != tasks.end(); it++)
-            delete *it;
-
-        tasks.clear();
+        cancelBlocks();
         throw e;
     }
     catch (BitStreamException& e) {
-        for (vector<EncodingTask<EncodingTaskResult>*>::iterator it = tasks.begin(); it != tasks.end(); it++)
-            delete *it;
-
-        tasks.clear();
+        cancelBlocks();
         throw IOException(e.what(), e.error());
     }
     catch (exception& e) {
-        for (vector<EncodingTask<EncodingTaskResult>*>::iterator it = tasks.begin(); it != tasks.end(); it++)
-            delete *it;
-
-        tasks.clear();
+        cancelBlocks();
         throw IOException(e.what(), Error::ERR_UNKNOWN);
     }
 }
 
+// Wait for the completion of the block in flight in the slot (if any)
+EncodingTaskResult CompressedOutputStream::completeBlock(int slot)
+{
+    EncodingTaskResult res;
+
+    if (_tasks[slot] == nullptr)
+        return res;
+
+#ifdef CONCURRENCY_ENABLED
+    try {
+        res = _futures[slot]->get();
+    }
+    catch (exception& e) {
+        res = EncodingTaskResult(_tasks[slot]->getBlockId(), Error::ERR_UNKNOWN, e.what());
+    }
+
+    delete _futures[slot];
+    _futures[slot] = nullptr;
+#endif
+    delete _tasks[slot];
+    _tasks[slot] = nullptr;
+    return res;
+}
+
+// Wait for the completion of all the blocks in flight. The blocks following
+// a failed block are skipped by the tasks.
+void CompressedOutputStream::cancelBlocks()
+{
+    for (int i = 1; i <= _slots; i++)
+        completeBlock((_lastBlockId + i) % _slots);
+}
+
 // Return the number of bytes written so far
 uint64 CompressedOutputStream::getWritten()
 {
@@ -456,7 +643,8 @@ EncodingTask<T>::EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
     uint64 transformType, uint32 entropyType, int blockId,
     OutputBitStream* obs, XXHash32* hasher,
     atomic_int* processedBlockId, vector<Listener*>& listeners,
-    Context& ctx)
+    Context& ctx, Predictor** predictor, FunctionCache<byte>* transforms,
+    SpeedController* controller)
     : _ctx(ctx)
 {
     _data = iBuffer;
@@ -469,6 +657,9 @@ EncodingTask<T>::EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
     _hasher = hasher;
     _listeners = listeners;
     _processedBlockId = processedBlockId;
+    _predictor = predictor;
+    _transforms = transforms;
+    _controller = controller;
 }
 
 // Encode mode + transformed entropy coded data
@@ -480,15 +671,29 @@ EncodingTask<T>::EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuff
 //  case more than 4 transforms
 //      | 0b00000000
 //      then 0byyyyyyyy => transform sequence skip flags (1 means skip)
+// If the pipeline is selected per block (and the block is not copied), the
+// entropy type (5 bits) and the transform types (48 bits) follow.
+// The block (mode, lengths, checksum and entropy coded data) is written to a
+// bitstream private to the task. The shared bitstream receives the size of the
+// block in bits (5 bits for the length of the size minus 3, then the size)
+// followed by the content of the private bitstream.
 template <class T>
 T EncodingTask<T>::run() THROW
 {
     EntropyEncoder* ee = nullptr;
 
+    // Bitstream local to the task. The memory is provided after the transform
+    // (the input buffer is not needed anymore at that point).
+    ostreambuf<char> buf;
+    ostream os(&buf);
+    DefaultOutputBitStream obs(os, 16384);
+
     try {
         byte mode = byte(0);
         int postTransformLength = _blockLength;
         int checksum = 0;
+        bool skipTransforms = false;
+        const bool autoPipeline = _ctx.has("autoPipeline");
 
         // Compute block checksum
         if (_hasher != nullptr)
@@ -507,27 +712,44 @@ T EncodingTask<T>::run() THROW
             _entropyType = EntropyCodecFactory::NONE_TYPE;
             mode |= CompressedOutputStream::COPY_BLOCK_MASK;
         }
+        else if (autoPipeline == true) {
+            // Classify the block and select its transforms and entropy codec
+            const int minSpeed = (_controller != nullptr) ? _controller->getMinSpeed() : _ctx.getInt("autoPipeline");
+            PipelineSelector selector(minSpeed);
+
+            if (selector.select(&_data->_array[_data->_index], _blockLength, _transformType, _entropyType) == false) {
+                _transformType = FunctionFactory<byte>::NONE_TYPE;
+                _entropyType = EntropyCodecFactory::NONE_TYPE;
+                mode |= CompressedOutputStream::COPY_BLOCK_MASK;
+            }
+        }
         else {
             if (_ctx.has("skipBlocks")) {
                 string str = _ctx.getString("skipBlocks");
                 transform(str.begin(), str.end(), str.begin(), ::toupper);
 
                 if (str == "TRUE") {
-                   uint histo[256];
-                   const int entropy = EntropyUtils::computeFirstOrderEntropy1024(&_data->_array[_data->_index], _blockLength, histo);
-                   //_ctx.putString("histo0", toString(histo, 256));
+                   // Detect incompressible blocks (from samples first) before
+                   // running transforms that would fail on them
+                   const int blockClass = EntropyUtils::classifyBlock(&_data->_array[_data->_index], _blockLength);
 
-                   if (entropy >= EntropyUtils::INCOMPRESSIBLE_THRESHOLD) {
+                   if (blockClass == EntropyUtils::BLOCK_INCOMPRESSIBLE) {
                        _transformType = FunctionFactory<byte>::NONE_TYPE;
                        _entropyType = EntropyCodecFactory::NONE_TYPE;
                        mode |= CompressedOutputStream::COPY_BLOCK_MASK;
                    }
+                   else if (blockClass == EntropyUtils::BLOCK_ENTROPY_ONLY) {
+                       // Without entropy codec, the transforms (EG. ROLZ) may
+                       // be the only stage compressing the block
+                       skipTransforms = _entropyType != EntropyCodecFactory::NONE_TYPE;
+                   }
                 }
             }
         }
 
         _ctx.putInt("size", _blockLength);
-        TransformSequence<byte>* transform = FunctionFactory<byte>::newFunction(_ctx, _transformType);
+        // The transform sequence (and its buffers) is reused from block to block
+        TransformSequence<byte>* transform = _transforms->get(_ctx, _transformType, short(_entropyType));
         int requiredSize = transform->getMaxEncodedLength(_blockLength);
 
         if (_buffer->_length < requiredSize) {
@@ -537,13 +759,25 @@ T EncodingTask<T>::run() THROW
         }
 
         // Forward transform (ignore error, encode skipFlags)
+        // The length of the input buffer is its capacity. The transform sequence
+        // reallocates it (with a length of requiredSize) if it is too small to
+        // hold intermediate results.
         _buffer->_index = 0;
-        _data->_length = _blockLength;
-        transform->forward(*_data, *_buffer, _data->_length);
+
+        if (skipTransforms == true) {
+            // Skip all transforms (the skip flags are written in the block header)
+            memcpy(&_buffer->_array[0], &_data->_array[_data->_index], _blockLength);
+            _buffer->_index = _blockLength;
+            transform->setSkipFlags(byte(0xFF));
+        }
+        else {
+            transform->forward(*_data, *_buffer, _blockLength);
+        }
+
         postTransformLength = _buffer->_index;
 
         if (postTransformLength < 0)
-            return T(_blockId, Error::ERR_WRITE_FILE, "Invalid transform size");
+            return cancel(Error::ERR_WRITE_FILE, "Invalid transform size");
 
         _ctx.putInt("size", postTransformLength);
         int dataSize = 0;
@@ -552,7 +786,7 @@ T EncodingTask<T>::run() THROW
             dataSize++;
 
         if (dataSize > 3)
-            return T(_blockId, Error::ERR_WRITE_FILE, "Invalid block data length");
+            return cancel(Error::ERR_WRITE_FILE, "Invalid block data length");
 
         // Record size of 'block size' - 1 in bytes
         mode |= byte((dataSize & 0x03) << 5);
@@ -566,30 +800,39 @@ T EncodingTask<T>::run() THROW
             CompressedOutputStream::notifyListeners(_listeners, evt);
         }
 
-        // Lock free synchronization
-        while (_processedBlockId->load() != _blockId - 1) {
-            // Busy loop
+        // Provide memory to the private bitstream: the input buffer, large enough
+        // to hold the entropy coded block (worst case expansion of the codecs)
+        const int bufferSize = max(postTransformLength + (postTransformLength >> 2), 65536);
+
+        if (_data->_length < bufferSize) {
+            delete[] _data->_array;
+            _data->_length = bufferSize;
+            _data->_array = new byte[_data->_length];
         }
 
-        // Write block 'header' (mode + compressed length);
-        uint64 written = _obs->written();
+        buf.pubsetbuf(reinterpret_cast<char*>(&_data->_array[0]), streamsize(_data->_length));
 
+        // Write block 'header' (mode + compressed length);
         if (((mode & CompressedOutputStream::COPY_BLOCK_MASK) != byte(0)) || (transform->getNbFunctions() <= 4)) {
             mode |= byte(uint8(transform->getSkipFlags()) >> 4);
-            _obs->writeBits(uint64(mode), 8);
+            obs.writeBits(uint64(mode), 8);
         }
         else {
             mode |= CompressedOutputStream::TRANSFORMS_MASK;
-            _obs->writeBits(uint64(mode), 8);
-            _obs->writeBits(uint64(transform->getSkipFlags()), 8);
+            obs.writeBits(uint64(mode), 8);
+            obs.writeBits(uint64(transform->getSkipFlags()), 8);
         }
 
-        delete transform;
-        _obs->writeBits(postTransformLength, 8 * dataSize);
+        if ((autoPipeline == true) && ((mode & CompressedOutputStream::COPY_BLOCK_MASK) == byte(0))) {
+            obs.writeBits(_entropyType, 5);
+            obs.writeBits(_transformType, 48);
+        }
+
+        obs.writeBits(postTransformLength, 8 * dataSize);
 
         // Write checksum
         if (_hasher != nullptr)
-            _obs->writeBits(checksum, 32);
+            obs.writeBits(checksum, 32);
 
         if (_listeners.size() > 0) {
             // Notify before entropy
@@ -601,23 +844,61 @@ T EncodingTask<T>::run() THROW
 
         // Each block is encoded separately
         // Rebuild the entropy encoder to reset block statistics
-        ee = EntropyCodecFactory::newEncoder(*_obs, _ctx, _entropyType);
+        // (the model of the binary entropy coders is reset, not reallocated)
+        ee = EntropyCodecFactory::newEncoder(obs, _ctx, _entropyType, _predictor);
 
         // Entropy encode block
-        if (ee->encode(_buffer->_array, 0, postTransformLength) != postTransformLength)
-            return T(_blockId, Error::ERR_PROCESS_BLOCK, "Entropy coding failed");
+        if (ee->encode(_buffer->_array, 0, postTransformLength) != postTransformLength) {
+            delete ee;
+            ee = nullptr;
+            return cancel(Error::ERR_PROCESS_BLOCK, "Entropy coding failed");
+        }
 
         // Dispose before processing statistics. Dispose may write to the bitstream
         delete ee;
         ee = nullptr;
+        uint64 written = obs.written();
+        obs.close();
 
-        // After completion of the entropy coding, increment the block id.
+        // Only the emission of the block to the shared bitstream is sequential
+        // Lock free synchronization
+        int taskId = _processedBlockId->load();
+
+        while ((taskId != CompressedOutputStream::CANCEL_TASKS_ID) && (taskId != _blockId - 1)) {
+#ifdef CONCURRENCY_ENABLED
+            // Other tasks may still be encoding, do not hog the CPU
+            this_thread::yield();
+#endif
+            taskId = _processedBlockId->load();
+        }
+
+        // Skip, an error occurred in a previous block
+        if (taskId == CompressedOutputStream::CANCEL_TASKS_ID)
+            return T(_blockId, Error::ERR_PROCESS_BLOCK, "Block skipped");
+
+        // Emit block size in bits (max size pre-entropy is 1 GB = 1 << 30 bytes)
+        const uint64 position = _obs->written();
+        const uint lw = (written < 8) ? 3 : uint(Global::log2(uint32(written >> 3)) + 4);
+        _obs->writeBits(lw - 3, 5); // write length-3 (5 bits max)
+        _obs->writeBits(written, lw);
+
+        // Emit block data to the shared bitstream
+        for (uint n = 0; written > 0; ) {
+            const uint chkSize = uint(min(written, uint64(1) << 30));
+            _obs->writeBits(&_data->_array[n], chkSize);
+            n += ((chkSize + 7) >> 3);
+            written -= uint64(chkSize);
+        }
+
+        const uint64 size = _obs->written() - position;
+
+        // After emission of the block, increment the block id.
         // It unfreezes the task processing the next block (if any)
         (*_processedBlockId)++;
 
         if (_listeners.size() > 0) {
             // Notify after entropy
-            const int w = int((_obs->written() - written) / 8);
+            const int w = int((obs.written() + 7) >> 3);
 
             Event evt(Event::AFTER_ENTROPY,
                 int64(_blockId), w, checksum, _hasher != nullptr, clock());
@@ -625,16 +906,30 @@ T EncodingTask<T>::run() THROW
             CompressedOutputStream::notifyListeners(_listeners, evt);
         }
 
-        return T(_blockId, 0, "Success");
+        return T(_blockId, 0, "Success", position, size);
     }
     catch (exception& e) {
-        // Make sure to unfreeze next block
-        if (_processedBlockId->load() == _blockId - 1)
-            (*_processedBlockId)++;
-
         if (ee != nullptr)
             delete ee;
 
-        return T(_blockId, Error::ERR_PROCESS_BLOCK, e.what());
+        return cancel(Error::ERR_PROCESS_BLOCK, e.what());
     }
 }
+
+// Wait for the previous blocks to be emitted (so that errors are reported in
+// block order), then cancel the tasks waiting to emit the next blocks.
+template <class T>
+T EncodingTask<T>::cancel(int error, const string& msg)
+{
+    int taskId = _processedBlockId->load();
+
+    while ((taskId != CompressedOutputStream::CANCEL_TASKS_ID) && (taskId < _blockId - 1)) {
+#ifdef CONCURRENCY_ENABLED
+        this_thread::yield();
+#endif
+        taskId = _processedBlockId->load();
+    }
+
+    _processedBlockId->store(CompressedOutputStream::CANCEL_TASKS_ID);
+    return T(_blockId, error, msg);
+}
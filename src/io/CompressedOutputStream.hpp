@@ -24,29 +24,41 @@ limitations under the License.
 #include "../Listener.hpp"
 #include "../OutputStream.hpp"
 #include "../OutputBitStream.hpp"
+#include "../Predictor.hpp"
 #include "../SliceArray.hpp"
 #include "../util/XXHash32.hpp"
+#include "BlockIndex.hpp"
+#include "SpeedController.hpp"
 
 namespace kanzi {
 
+   template <class T> class FunctionCache;
+
    class EncodingTaskResult {
    public:
        int _blockId;
        int _error; // 0 = OK
        string _msg;
+       uint64 _position; // position of the block in the bitstream (in bits)
+       uint64 _size; // size of the block in the bitstream (in bits)
 
        EncodingTaskResult()
            : _msg("")
        {
            _blockId = -1;
            _error = 0;
+           _position = 0;
+           _size = 0;
        }
 
-       EncodingTaskResult(int blockId, int error, const string& msg)
+       EncodingTaskResult(int blockId, int error, const string& msg,
+           uint64 position = 0, uint64 size = 0)
            : _msg(msg)
        {
            _blockId = blockId;
            _error = error;
+           _position = position;
+           _size = size;
        }
 
        EncodingTaskResult(const EncodingTaskResult& result)
@@ -54,14 +66,29 @@ namespace kanzi {
        {
            _blockId = result._blockId;
            _error = result._error;
+           _position = result._position;
+           _size = result._size;
+       }
+
+       EncodingTaskResult& operator=(const EncodingTaskResult& result)
+       {
+           _msg = result._msg;
+           _blockId = result._blockId;
+           _error = result._error;
+           _position = result._position;
+           _size = result._size;
+           return *this;
        }
 
        ~EncodingTaskResult() {}
    };
 
    // A task used to encode a block
-   // Several tasks may run in parallel. The transforms can be computed concurrently
-   // but the entropy encoding is sequential since all tasks share the same bitstream.
+   // Several tasks may run in parallel. The transform and the entropy encoding
+   // are computed concurrently, each task writing to its own bitstream. Only the
+   // emission of the blocks to the shared bitstream is sequential (in block order).
+   // Each block is emitted with its size in bits so that the decoder can extract
+   // it from the shared bitstream without decoding it.
    template <class T>
    class EncodingTask : public Task<T> {
    private:
@@ -76,17 +103,25 @@ namespace kanzi {
        atomic_int* _processedBlockId;
        vector<Listener*> _listeners;
        Context _ctx;
+       Predictor** _predictor; // predictor reused from block to block
+       FunctionCache<byte>* _transforms; // transforms reused from block to block
+       SpeedController* _controller; // speed of the pipelines selected per block (or null)
+
+       T cancel(int error, const string& msg);
 
    public:
        EncodingTask(SliceArray<byte>* iBuffer, SliceArray<byte>* oBuffer, int length,
            uint64 transformType, uint32 entropyType, int blockId,
            OutputBitStream* obs, XXHash32* hasher,
            atomic_int* processedBlockId, vector<Listener*>& listeners,
-           Context& ctx);
+           Context& ctx, Predictor** predictor, FunctionCache<byte>* transforms,
+           SpeedController* controller);
 
        ~EncodingTask(){};
 
        T run() THROW;
+
+       int getBlockId() const { return _blockId; }
    };
 
    class CompressedOutputStream : public OutputStream {
@@ -94,7 +129,7 @@ namespace kanzi {
 
    private:
        static const int BITSTREAM_TYPE = 0x4B414E5A; // "KANZ"
-       static const int BITSTREAM_FORMAT_VERSION = 8;
+       static const int BITSTREAM_FORMAT_VERSION = 12;
        static const int DEFAULT_BUFFER_SIZE = 256 * 1024;
        static const byte COPY_BLOCK_MASK = byte(0x80);
        static const byte TRANSFORMS_MASK = byte(0x10);
@@ -102,26 +137,49 @@ namespace kanzi {
        static const int MAX_BITSTREAM_BLOCK_SIZE = 1024 * 1024 * 1024;
        static const int SMALL_BLOCK_SIZE = 15;
        static const int MAX_CONCURRENCY = 64;
+       static const int CANCEL_TASKS_ID = -1;
 
        int _blockSize;
        uint8 _nbInputBlocks;
        XXHash32* _hasher;
-       SliceArray<byte>* _sa; // for all blocks
-       SliceArray<byte>** _buffers; // input & output per block
+       SliceArray<byte>* _sa; // block being filled
+       SliceArray<byte>** _buffers; // input & output per block in flight
+       EncodingTask<EncodingTaskResult>** _tasks; // block in flight per slot
+       Predictor** _predictors; // entropy predictor per slot (kept between blocks)
+       FunctionCache<byte>* _transforms; // transform sequence per slot (kept between blocks)
+#ifdef CONCURRENCY_ENABLED
+       ThreadPool::Future<EncodingTask<EncodingTaskResult>, EncodingTaskResult>** _futures;
+#endif
        uint32 _entropyType;
        uint64 _transformType;
        OutputBitStream* _obs;
        OutputStream& _os;
        atomic_bool _initialized;
        atomic_bool _closed;
-       atomic_int _blockId;
+       atomic_int _blockId; // last block emitted
+       int _lastBlockId; // last block submitted
        int _jobs;
+       int _slots; // max number of blocks in flight (memory budget)
+       int _modelShrink; // log2 of the reduction of the model tables (memory budget)
+       bool _writeIndex;
+       int _bwtChunksLog; // log8 of (max number of BWT chunks / 8)
+       bool _autoPipeline; // transforms and entropy codec selected per block
+       SpeedController* _controller; // adjusts the selection to a target speed (or null)
+       vector<BlockIndexEntry> _index;
        vector<Listener*> _listeners;
        Context _ctx;
 
        void writeHeader() THROW;
 
-       void processBlock(bool force) THROW;
+       void writeIndex() THROW;
+
+       void addIndexEntry(const EncodingTaskResult& res);
+
+       void processBlock() THROW;
+
+       EncodingTaskResult completeBlock(int slot);
+
+       void cancelBlocks();
 
        static void notifyListeners(vector<Listener*>& listeners, const Event& evt);
 
@@ -142,9 +200,9 @@ namespace kanzi {
 
        ostream& flush();
 
-       streampos tellp();
+       std::streampos tellp();
 
-       ostream& seekp(streampos pos) THROW;
+       ostream& seekp(std::streampos pos) THROW;
 
        void close() THROW;
 
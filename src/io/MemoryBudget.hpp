@@ -0,0 +1,92 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _MemoryBudget_
+#define _MemoryBudget_
+
+#include "../types.hpp"
+#include "../entropy/EntropyCodecFactory.hpp"
+#include "../function/FunctionFactory.hpp"
+#include "PipelineSelector.hpp"
+
+namespace kanzi
+{
+
+   // Fit the processing of a stream in a memory limit (context 'memoryLimit').
+   // The peak memory of a task is estimated from the block size, the transforms
+   // and the entropy codec. The number of blocks processed concurrently is
+   // reduced first. If one block does not fit, the big model tables (TPAQ) are
+   // shrunk. The shrink is written to the bitstream since the decoder must use
+   // the same tables.
+   class MemoryBudget
+   {
+   public:
+       static const int MAX_MODEL_SHRINK = TPAQPredictor<false>::MAX_MODEL_SHRINK;
+
+       // Approximate peak memory of a task processing a block: copy of the block,
+       // output of the transforms, output of the entropy codec, transforms and
+       // entropy codec.
+       static int64 getTaskFootprint(int blockSize, uint64 transformType, uint32 entropyType, int modelShrink)
+       {
+           return 3 * int64(blockSize)
+               + FunctionFactory<byte>::getMemoryFootprint(transformType, blockSize)
+               + EntropyCodecFactory::getMemoryFootprint(short(entropyType), blockSize, modelShrink);
+       }
+
+       // Memory needed to process one block at a time. In auto mode, assume the
+       // most demanding pipeline. 'sharedSize' is the memory used by the stream itself.
+       static int64 getMinMemory(int64 sharedSize, int blockSize, uint64 transformType,
+           uint32 entropyType, bool autoPipeline, int modelShrink)
+       {
+           const int64 footprint = (autoPipeline == true) ?
+               PipelineSelector::getMemoryFootprint(blockSize, modelShrink) :
+               getTaskFootprint(blockSize, transformType, entropyType, modelShrink);
+           return sharedSize + footprint;
+       }
+
+       // Return the number of blocks that can be processed concurrently (at most
+       // 'jobs', 0 if none). See getMinMemory().
+       static int getMaxTasks(int64 limit, int64 sharedSize, int blockSize, uint64 transformType,
+           uint32 entropyType, bool autoPipeline, int modelShrink, int jobs)
+       {
+           const int64 footprint = getMinMemory(0, blockSize, transformType, entropyType,
+               autoPipeline, modelShrink);
+           const int64 n = (limit - sharedSize) / footprint;
+
+           if (n <= 0)
+               return 0;
+
+           return (n < int64(jobs)) ? int(n) : jobs;
+       }
+
+       // Same as getMaxTasks() but also set the smallest model shrink allowing
+       // one block at least (when encoding).
+       static int fit(int64 limit, int64 sharedSize, int blockSize, uint64 transformType,
+           uint32 entropyType, bool autoPipeline, int jobs, int& modelShrink)
+       {
+           for (modelShrink = 0; modelShrink <= MAX_MODEL_SHRINK; modelShrink++) {
+               const int n = getMaxTasks(limit, sharedSize, blockSize, transformType,
+                   entropyType, autoPipeline, modelShrink, jobs);
+
+               if (n > 0)
+                   return n;
+           }
+
+           modelShrink = 0;
+           return 0;
+       }
+   };
+}
+#endif
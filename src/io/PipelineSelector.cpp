@@ -0,0 +1,187 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "PipelineSelector.hpp"
+#include "MemoryBudget.hpp"
+#include "../entropy/EntropyCodecFactory.hpp"
+#include "../entropy/EntropyUtils.hpp"
+#include "../function/FunctionFactory.hpp"
+
+using namespace kanzi;
+
+// Speeds and ratios measured on text, x86 binaries, tables of integers and
+// mixed data. Empty entries (null transform) end the lists.
+const PipelineSelector::Pipeline PipelineSelector::PIPELINES[5][6] = {
+    // DATA_TEXT
+    {
+        { "LZ", "HUFFMANX", 200 },
+        { "ROLZ", "NONE", 135 },
+        { "TEXT+ROLZ", "NONE", 80 },
+        { "TEXT+ROLZX", "NONE", 60 },
+        { "TEXT+BWT+SRT+ZRLT", "FPAQ", 19 },
+        { "RLT", "TPAQ", 3 }
+    },
+    // DATA_X86
+    {
+        { "NONE", "HUFFMANX", 160 },
+        { "X86+LZ", "HUFFMANX", 93 },
+        { "X86+ROLZ", "NONE", 31 },
+        { "X86+BWT+RANK+ZRLT", "ANS0X", 11 },
+        { "X86+BWT", "CM", 7 },
+        { "X86+RLT", "TPAQ", 2 }
+    },
+    // DATA_NUMERIC
+    {
+        { "NONE", "HUFFMANX", 190 },
+        { "LZ", "HUFFMANX", 112 },
+        { "ROLZX", "NONE", 12 },
+        { "BWT", "CM", 9 },
+        { "RLT", "TPAQ", 2 },
+        { nullptr, nullptr, 0 }
+    },
+    // DATA_GENERIC
+    {
+        { "LZ", "HUFFMANX", 229 },
+        { "ROLZ", "NONE", 41 },
+        { "ROLZX", "NONE", 18 },
+        { "BWT", "CM", 6 },
+        { "RLT", "TPAQ", 2 },
+        { nullptr, nullptr, 0 }
+    },
+    // DATA_ENTROPY_ONLY
+    {
+        { "NONE", "HUFFMANX", 200 },
+        { "NONE", "ANS0X", 130 },
+        { nullptr, nullptr, 0 },
+        { nullptr, nullptr, 0 },
+        { nullptr, nullptr, 0 },
+        { nullptr, nullptr, 0 }
+    }
+};
+
+PipelineSelector::PipelineSelector(int minSpeed)
+{
+    _minSpeed = minSpeed;
+}
+
+bool PipelineSelector::select(byte block[], int length, uint64& transformType, uint32& entropyType) const
+{
+    int dataType;
+
+    switch (EntropyUtils::classifyBlock(block, length)) {
+    case EntropyUtils::BLOCK_INCOMPRESSIBLE:
+        return false;
+
+    case EntropyUtils::BLOCK_ENTROPY_ONLY:
+        dataType = DATA_ENTROPY_ONLY;
+        break;
+
+    default:
+        dataType = getDataType(block, length);
+    }
+
+    // Slowest pipeline fast enough (or fastest pipeline)
+    const Pipeline* pipelines = PIPELINES[dataType];
+    int n = 0;
+
+    while ((n < 5) && (pipelines[n + 1]._transform != nullptr) && (pipelines[n + 1]._speed >= _minSpeed))
+        n++;
+
+    transformType = FunctionFactory<byte>::getType(pipelines[n]._transform);
+    entropyType = uint32(EntropyCodecFactory::getType(pipelines[n]._codec));
+    return true;
+}
+
+int64 PipelineSelector::getMemoryFootprint(int blockSize, int modelShrink)
+{
+    int64 res = 0;
+
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; (j < 6) && (PIPELINES[i][j]._transform != nullptr); j++) {
+            const int64 footprint = MemoryBudget::getTaskFootprint(blockSize,
+                FunctionFactory<byte>::getType(PIPELINES[i][j]._transform),
+                uint32(EntropyCodecFactory::getType(PIPELINES[i][j]._codec)), modelShrink);
+
+            if (footprint > res)
+                res = footprint;
+        }
+    }
+
+    return res;
+}
+
+// Classify the data from samples:
+// - text: almost only printable ASCII characters
+// - x86: enough relative jumps/calls (same test as X86Codec)
+// - numeric: symbols repeated at a fixed distance (records of integers, ...)
+//   much more often than at distance 1
+int PipelineSelector::getDataType(byte block[], int length)
+{
+    int nbSamples = SAMPLE_COUNT;
+    int sampleSize = SAMPLE_SIZE;
+    const int step = length / SAMPLE_COUNT;
+
+    if (length < 4 * SAMPLE_COUNT * SAMPLE_SIZE) {
+        nbSamples = 1;
+        sampleSize = length;
+    }
+
+    const uint8* buf = (const uint8*)&block[0];
+    int count = 0;
+    int text = 0;
+    int jumps = 0;
+    int repeats[5] = { 0 }; // distances 1, 2, 4, 8 and 16
+
+    for (int n = 0; n < nbSamples; n++) {
+        const int start = (n == 0) ? 16 : n * step;
+        const int end = (n * step + sampleSize < length - 4) ? n * step + sampleSize : length - 4;
+
+        for (int i = start; i < end; i++) {
+            const uint8 c = buf[i];
+
+            if (((c >= 0x20) && (c < 0x7F)) || (c == '\n') || (c == '\r') || (c == '\t'))
+                text++;
+
+            if (((c & 0xFE) == 0xE8) && ((buf[i + 4] == 0) || (buf[i + 4] == 0xFF)))
+                jumps++;
+
+            repeats[0] += (c == buf[i - 1]) ? 1 : 0;
+            repeats[1] += (c == buf[i - 2]) ? 1 : 0;
+            repeats[2] += (c == buf[i - 4]) ? 1 : 0;
+            repeats[3] += (c == buf[i - 8]) ? 1 : 0;
+            repeats[4] += (c == buf[i - 16]) ? 1 : 0;
+        }
+
+        if (end > start)
+            count += end - start;
+    }
+
+    if (count == 0)
+        return DATA_GENERIC;
+
+    if (text >= count - (count >> 5))
+        return DATA_TEXT;
+
+    if (jumps >= (count >> 7))
+        return DATA_X86;
+
+    for (int i = 1; i < 5; i++) {
+        // More than 1/4 and 1.5 times the repeats at distance 1
+        if ((4 * repeats[i] > count) && (2 * repeats[i] > 3 * repeats[0]))
+            return DATA_NUMERIC;
+    }
+
+    return DATA_GENERIC;
+}
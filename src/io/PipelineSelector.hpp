@@ -0,0 +1,69 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _PipelineSelector_
+#define _PipelineSelector_
+
+#include "../types.hpp"
+
+namespace kanzi
+{
+
+   // Selection of the transforms and entropy codec of each block (auto mode).
+   // The block is classified from samples (incompressible, entropy coding only,
+   // text, x86 code, numeric records or generic data) and the pipeline is picked
+   // from a table of pipelines per class, ranked by speed and compression ratio:
+   // the best compressing pipeline with a speed not lower than the minimum speed.
+   class PipelineSelector
+   {
+   public:
+       static const int DATA_TEXT = 0;
+       static const int DATA_X86 = 1;
+       static const int DATA_NUMERIC = 2;
+       static const int DATA_GENERIC = 3;
+       static const int DATA_ENTROPY_ONLY = 4;
+
+       // Minimum speed in MB/s (per job)
+       PipelineSelector(int minSpeed);
+
+       ~PipelineSelector() {}
+
+       // Return false if the block should be copied, else set the types of the
+       // transforms and entropy codec to use.
+       bool select(byte block[], int length, uint64& transformType, uint32& entropyType) const;
+
+       // Return the class of the data, except entropy only (see EntropyUtils::classifyBlock)
+       static int getDataType(byte block[], int length);
+
+       // Return the memory needed by the most demanding pipeline (see MemoryBudget)
+       static int64 getMemoryFootprint(int blockSize, int modelShrink);
+
+   private:
+       static const int SAMPLE_COUNT = 64;
+       static const int SAMPLE_SIZE = 1024;
+
+       struct Pipeline {
+           const char* _transform;
+           const char* _codec;
+           int _speed; // encoding MB/s (1 job, 4 MB blocks)
+       };
+
+       // Pipelines per class, by decreasing speed (and increasing compression)
+       static const Pipeline PIPELINES[5][6];
+
+       int _minSpeed;
+   };
+}
+#endif
@@ -0,0 +1,70 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include "SpeedController.hpp"
+
+using namespace kanzi;
+
+SpeedController::SpeedController(int targetSpeed)
+    : _targetSpeed(targetSpeed)
+{
+    _minSpeed = targetSpeed;
+    _windowStart = clock_t(-1);
+    _windowSize = 0;
+}
+
+void SpeedController::processEvent(const Event& evt)
+{
+    if ((evt.getType() != Event::BEFORE_TRANSFORM) && (evt.getType() != Event::AFTER_ENTROPY))
+        return;
+
+#ifdef CONCURRENCY_ENABLED
+    unique_lock<mutex> lock(_mutex);
+#endif
+
+    if (evt.getType() == Event::BEFORE_TRANSFORM) {
+        if (_windowStart == clock_t(-1))
+            _windowStart = evt.getTime();
+
+        _sizes[evt.getId()] = evt.getSize();
+        return;
+    }
+
+    map<int, int64>::iterator it = _sizes.find(evt.getId());
+
+    if (it == _sizes.end())
+        return;
+
+    _windowSize += it->second;
+    _sizes.erase(it);
+    const clock_t elapsed = evt.getTime() - _windowStart;
+
+    if (elapsed < WINDOW_DURATION)
+        return;
+
+    // Speed in MB/s of CPU time. Speed up at once when too slow, slow down
+    // (better compression) only with a good margin to avoid oscillations.
+    const double speed = double(_windowSize) / (1024.0 * 1024.0) * CLOCKS_PER_SEC / double(elapsed);
+    const int minSpeed = _minSpeed.load();
+
+    if (speed < double(_targetSpeed))
+        _minSpeed = min(minSpeed + (minSpeed >> 2) + 1, MAX_MIN_SPEED);
+    else if (speed > 1.5 * double(_targetSpeed))
+        _minSpeed = max(minSpeed - (minSpeed >> 3) - 1, 1);
+
+    _windowStart = evt.getTime();
+    _windowSize = 0;
+}
@@ -0,0 +1,62 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _SpeedController_
+#define _SpeedController_
+
+#include <map>
+#include "../concurrent.hpp"
+#include "../Listener.hpp"
+#ifdef CONCURRENCY_ENABLED
+#include <mutex>
+#endif
+
+namespace kanzi
+{
+
+   // Control of the encoding speed in auto mode (see PipelineSelector).
+   // The controller listens to the block events of the compressed stream and
+   // measures the encoding speed (bytes per second of CPU time, thus per job)
+   // over windows of a few blocks. It adjusts the minimum speed given to the
+   // pipeline selector: higher (faster pipelines) when the measured speed is
+   // below the target, lower (better compression) when there is headroom.
+   class SpeedController : public Listener
+   {
+   public:
+       // Target speed in MB/s (per job)
+       SpeedController(int targetSpeed);
+
+       ~SpeedController() {}
+
+       void processEvent(const Event& evt);
+
+       // Minimum speed (MB/s) of the pipelines selected for the next blocks
+       int getMinSpeed() const { return _minSpeed.load(); }
+
+   private:
+       static const int MAX_MIN_SPEED = 1024;
+       static const int WINDOW_DURATION = CLOCKS_PER_SEC / 20;
+
+       map<int, int64> _sizes; // size of the blocks in flight
+   #ifdef CONCURRENCY_ENABLED
+       mutex _mutex;
+   #endif
+       atomic_int _minSpeed;
+       const int _targetSpeed;
+       clock_t _windowStart;
+       int64 _windowSize; // bytes encoded in the window
+   };
+}
+#endif
@@ -38,8 +38,11 @@ int testBWTCorrectness(bool isBWT)
     byte* pBuf = new byte[8 * 1024 * 1024];
     byte* buf1 = pBuf;
 
-    for (int ii = 1; ii <= 20; ii++) {
+    for (int ii = 1; ii <= 22; ii++) {
         int size = 128;
+        int jobs = 1;
+        int maxChunks = BWT::DEFAULT_MAX_CHUNKS;
+        bool sais = false;
 
         if (ii == 1) {
             string str("mississippi");
@@ -64,20 +67,40 @@ int testBWTCorrectness(bool isBWT)
             for (int i = 0; i < size; i++)
                 buf1[i] = byte(65 + (rand() % (4 * ii)));
         }
-        else {
+        else if (ii == 20) {
             size = 8*1024*1024;
 
             for (int i = 0; i < size; i++)
                 buf1[i] = byte(i);
         }
+        else if (ii == 21) {
+            // Big block, suffixes sorted and chunks inverted concurrently
+            size = 8*1024*1024;
+            jobs = 4;
+            maxChunks = 64;
+
+            for (int i = 0; i < size; i++)
+                buf1[i] = byte(65 + (rand() % 8));
+        }
+        else {
+            // Big repetitive block, suffix array built by SA-IS
+            size = 8*1024*1024;
+            sais = true;
+
+            for (int i = 0; i < 1000; i++)
+                buf1[i] = byte(65 + (rand() % 4));
+
+            for (int i = 1000; i < size; i++)
+                buf1[i] = ((rand() & 0xFFFF) == 0) ? byte(65 + (rand() % 4)) : buf1[i - 1000];
+        }
 
         Transform<byte>* tf;
 
         if (isBWT) {
-            tf = new BWT();
+            tf = new BWT(jobs, sais, maxChunks);
         }
         else {
-            tf = new BWTS();
+            tf = new BWTS(sais);
         }
 
         byte* input = &buf1[0];
@@ -109,7 +132,7 @@ int testBWTCorrectness(bool isBWT)
 
         if (isBWT) {
             BWT* bwt = (BWT*) tf;
-            int chunks = BWT::getBWTChunks(size);
+            int chunks = BWT::getBWTChunks(size, maxChunks);
             int* pi = new int[chunks];
 
             for (int i=0; i<chunks; i++) {
@@ -118,7 +141,7 @@ int testBWTCorrectness(bool isBWT)
             }
 
             delete tf;
-            tf = new BWT();
+            tf = new BWT(jobs, false, maxChunks);
             bwt = (BWT*) tf;
 
             for (int i=0; i<chunks; i++) {
@@ -170,6 +193,168 @@ int testBWTCorrectness(bool isBWT)
     return res;
 }
 
+// Fill 'buf' with data of the given kind (0 random, 1 small alphabet, 2 long
+// repeats, 3 text like)
+static void generateData(byte buf[], int size, int kind)
+{
+    const char* words[] = { "block ", "sorting ", "of ", "the ", "suffix ", "array ", "\n", "chunk " };
+
+    for (int i = 0; i < size; ) {
+        if (kind == 3) {
+            const char* w = words[rand() & 7];
+
+            for (int j = 0; (w[j] != 0) && (i < size); j++)
+                buf[i++] = byte(w[j]);
+
+            continue;
+        }
+
+        if (kind == 0)
+            buf[i] = byte(rand());
+        else if ((kind == 1) || (i < 1000))
+            buf[i] = byte(65 + (rand() % 4));
+        else
+            buf[i] = ((rand() & 0xFFFF) == 0) ? byte(65 + (rand() % 4)) : buf[i - 1000];
+
+        i++;
+    }
+}
+
+// Reference BWT: gather the symbols preceding the suffixes from the full
+// suffix array and look for the suffixes starting a chunk.
+void gatherBWT(byte input[], byte output[], int indexes[], int size, int chunks)
+{
+    int* sa = new int[size];
+    DivSufSort dss;
+    dss.computeSuffixArray(input, sa, 0, size);
+    const int st = size / chunks;
+    const int step = (chunks * st == size) ? st : st + 1;
+
+    for (int i = 0; i < size; i++) {
+        if ((sa[i] % step) == 0)
+            indexes[sa[i] / step] = i + 1;
+    }
+
+    output[0] = input[size - 1];
+
+    for (int i = 0; i < indexes[0] - 1; i++)
+        output[i + 1] = input[sa[i] - 1];
+
+    for (int i = indexes[0]; i < size; i++)
+        output[i] = input[sa[i] - 1];
+
+    delete[] sa;
+}
+
+// The BWT written directly by DivSufSort (default) and by SA-IS must be the
+// same as the BWT gathered from the suffix array, primary indexes included
+int testBWTDirect()
+{
+    cout << endl
+         << endl
+         << "BWT direct construction test" << endl;
+    const int sizes[] = { 2, 3, 17, 1000, 65536, 4 * 1024 * 1024 + 3, 9 * 1024 * 1024 + 7 };
+    byte* input = new byte[sizes[6]];
+    byte* output1 = new byte[sizes[6]];
+    byte* output2 = new byte[sizes[6]];
+    byte* output3 = new byte[sizes[6]];
+    int indexes[BWT::MAX_CHUNKS];
+    srand(13579);
+    int res = 0;
+
+    for (int n = 0; n < 7; n++) {
+        const int size = sizes[n];
+
+        for (int kind = 0; kind < 4; kind++) {
+            // Big blocks: default and max number of chunks
+            for (int m = 0; m < ((size >= 4 * 1024 * 1024) ? 2 : 1); m++) {
+                const int maxChunks = (m == 0) ? BWT::DEFAULT_MAX_CHUNKS : BWT::MAX_CHUNKS;
+                const int chunks = BWT::getBWTChunks(size, maxChunks);
+                generateData(input, size, kind);
+                BWT bwt1(1, false, maxChunks);
+                BWT bwt2(1, true, maxChunks);
+                SliceArray<byte> ia1(input, size, 0);
+                SliceArray<byte> ia2(output1, size, 0);
+                bwt1.forward(ia1, ia2, size);
+                SliceArray<byte> ia3(input, size, 0);
+                SliceArray<byte> ia4(output2, size, 0);
+                bwt2.forward(ia3, ia4, size);
+                gatherBWT(input, output3, indexes, size, chunks);
+                bool ok = (memcmp(output1, output3, size) == 0) && (memcmp(output2, output3, size) == 0);
+
+                for (int i = 0; i < chunks; i++) {
+                    ok &= bwt1.getPrimaryIndex(i) == indexes[i];
+                    ok &= bwt2.getPrimaryIndex(i) == indexes[i];
+                }
+
+                cout << "Size " << size << ", data " << kind << ", " << chunks << " chunk(s): "
+                     << ((ok == true) ? "Identical" : "Different") << endl;
+
+                if (ok == false)
+                    res = 1;
+            }
+        }
+    }
+
+    delete[] input;
+    delete[] output1;
+    delete[] output2;
+    delete[] output3;
+    return res;
+}
+
+// Big blocks: each task inverts its chunks in lockstep (up to 8 at a time).
+// Check chunk counts above and below this window with 1 and several jobs.
+int testBWTLockstep()
+{
+    cout << endl
+         << endl
+         << "BWT inverse of chunks in lockstep test" << endl;
+    const int size = 11 * 1024 * 1024 + 5;
+    byte* input = new byte[size];
+    byte* output = new byte[size];
+    byte* reverse = new byte[size];
+    srand(97531);
+    int res = 0;
+
+    for (int kind = 0; kind < 4; kind += 3) {
+        generateData(input, size, kind);
+
+        for (int m = 0; m < 2; m++) {
+            const int maxChunks = (m == 0) ? BWT::DEFAULT_MAX_CHUNKS : BWT::MAX_CHUNKS;
+            const int chunks = BWT::getBWTChunks(size, maxChunks);
+            BWT bwt1(1, false, maxChunks);
+            SliceArray<byte> ia1(input, size, 0);
+            SliceArray<byte> ia2(output, size, 0);
+            bwt1.forward(ia1, ia2, size);
+
+            const int jobs[] = { 1, 3, 16 };
+
+            for (int j = 0; j < 3; j++) {
+                BWT bwt2(jobs[j], false, maxChunks);
+
+                for (int i = 0; i < chunks; i++)
+                    bwt2.setPrimaryIndex(i, bwt1.getPrimaryIndex(i));
+
+                memset(reverse, 0, size);
+                SliceArray<byte> ia3(output, size, 0);
+                SliceArray<byte> ia4(reverse, size, 0);
+                const bool ok = (bwt2.inverse(ia3, ia4, size) == true) && (memcmp(input, reverse, size) == 0);
+                cout << "Data " << kind << ", " << chunks << " chunk(s), " << jobs[j] << " job(s): "
+                     << ((ok == true) ? "Identical" : "Different") << endl;
+
+                if (ok == false)
+                    res = 1;
+            }
+        }
+    }
+
+    delete[] input;
+    delete[] output;
+    delete[] reverse;
+    return res;
+}
+
 int testBWTSpeed(bool isBWT)
 {
     // Test speed
@@ -261,6 +446,8 @@ int TestBWT_main()
     int res = 0;
     res |= testBWTCorrectness(true);
     res |= testBWTCorrectness(false);
+    res |= testBWTDirect();
+    res |= testBWTLockstep();
     res |= testBWTSpeed(true);
     res |= testBWTSpeed(false);
     return res;
@@ -0,0 +1,1635 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <vector>
+#include "../types.hpp"
+#include "../Allocator.hpp"
+#include "../concurrent.hpp"
+#include "../io/CompressedInputStream.hpp"
+#include "../io/CompressedOutputStream.hpp"
+#include "../io/MemoryBudget.hpp"
+#include "../io/PipelineSelector.hpp"
+#include "../io/SpeedController.hpp"
+#include "../bitstream/DefaultInputBitStream.hpp"
+#include "../entropy/EntropyCodecFactory.hpp"
+#include "../function/FunctionFactory.hpp"
+
+using namespace std;
+using namespace kanzi;
+
+static const char* WORDS[] = {
+    "the", "block", "compressor", "of", "data", "and", "a", "transform", "entropy",
+    "stream", "is", "to", "with", "in", "for", "each", "codec", "that", "order",
+    "speed", "ratio", "memory", "which", "when", "sequence", "predictor", "index"
+};
+
+// Generate test data: 0 = text, 1 = runs, 2 = records of integers, 3 = random,
+// 4 = text mixed with binary data
+static void generateData(vector<byte>& data, int size, int kind, uint seed)
+{
+    data.resize(size);
+    uint n = seed * 2654435761U + 1;
+
+    for (int i = 0; i < size; ) {
+        n = n * 1103515245U + 12345U;
+        const uint r = n >> 8;
+
+        if (kind == 0) {
+            const char* w = WORDS[r % (sizeof(WORDS) / sizeof(WORDS[0]))];
+
+            for (int j = 0; (w[j] != 0) && (i < size); j++)
+                data[i++] = byte(w[j]);
+
+            if (i < size)
+                data[i++] = byte(((r & 0x3F) == 0) ? '\n' : ' ');
+        }
+        else if (kind == 1) {
+            const int len = 1 + int(r % 40);
+
+            for (int j = 0; (j < len) && (i < size); j++)
+                data[i++] = byte((r >> 16) & 0x0F);
+        }
+        else if (kind == 2) {
+            // Little endian 32 bit values, slowly increasing
+            const uint v = uint(i >> 2) * 3 + (r & 0x07);
+
+            for (int j = 0; (j < 4) && (i < size); j++)
+                data[i++] = byte(v >> (8 * j));
+        }
+        else if (kind == 4) {
+            const char* w = WORDS[r % (sizeof(WORDS) / sizeof(WORDS[0]))];
+
+            for (int j = 0; (w[j] != 0) && (i < size); j++)
+                data[i++] = byte(w[j]);
+
+            for (int j = 0; (j < int((r >> 12) & 3)) && (i < size); j++)
+                data[i++] = byte(0x80 | (r >> (4 * j)));
+        }
+        else {
+            data[i++] = byte(r);
+        }
+    }
+}
+
+static void initParameters(map<string, string>& params, const string& transform, const string& codec,
+    int blockSize, int jobs)
+{
+    stringstream ss;
+    params["transform"] = transform;
+    params["codec"] = codec;
+    ss << blockSize;
+    params["blockSize"] = ss.str();
+    ss.str(string());
+    ss << jobs;
+    params["jobs"] = ss.str();
+    params["checksum"] = "TRUE";
+    params["index"] = "FALSE";
+    params["extra"] = (codec == "TPAQX") ? "TRUE" : "FALSE";
+    // Same header whatever the number of jobs
+    params["bwtChunks"] = "8";
+}
+
+// Compress the data, written in pieces of 'step' bytes
+static string compress(const vector<byte>& data, map<string, string>& params, int step = 1 << 30)
+{
+    stringbuf buffer;
+    ostream os(&buffer);
+
+    {
+        Context ctx(params);
+        CompressedOutputStream cos(os, ctx);
+
+        for (int i = 0; i < int(data.size()); i += step) {
+            const int len = min(step, int(data.size()) - i);
+            cos.write(reinterpret_cast<const char*>(&data[i]), len);
+        }
+
+        cos.close();
+    }
+
+    return buffer.str();
+}
+
+static void decompress(const string& cdata, map<string, string>& params, vector<byte>& data)
+{
+    stringbuf buffer(cdata);
+    istream is(&buffer);
+    Context ctx(params);
+    CompressedInputStream cis(is, ctx);
+    char buf[65536];
+    data.clear();
+
+    while (true) {
+        cis.read(buf, sizeof(buf));
+        const int n = int(cis.gcount());
+
+        if (n <= 0)
+            break;
+
+        data.insert(data.end(), reinterpret_cast<byte*>(&buf[0]), reinterpret_cast<byte*>(&buf[n]));
+    }
+
+    cis.close();
+}
+
+// Return 0 if the data decompresses to the original
+static int checkRoundTrip(const string& cdata, const vector<byte>& data, int jobs)
+{
+    map<string, string> params;
+    stringstream ss;
+    ss << jobs;
+    params["jobs"] = ss.str();
+    vector<byte> data2;
+    decompress(cdata, params, data2);
+
+    if (data2.size() != data.size()) {
+        cout << "Different sizes: " << data.size() << " - " << data2.size() << endl;
+        return 1;
+    }
+
+    for (size_t i = 0; i < data.size(); i++) {
+        if (data[i] != data2[i]) {
+            cout << "Different (index " << i << ": " << (int(data[i]) & 0xFF);
+            cout << " - " << (int(data2[i]) & 0xFF) << ")" << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Size in bits of the blocks in a compressed stream. The end of stream block
+struct BlockInfo {
+    uint64 _bits; // size of the block data in the bitstream
+    byte _mode;
+    uint32 _entropyType;
+    uint64 _transformType;
+};
+
+// Read the size, mode and pipeline of the blocks in a compressed stream.
+// Return false if more than the padding of the last byte follows.
+static bool parseBlocks(const string& cdata, vector<BlockInfo>& blocks)
+{
+    stringbuf buffer(cdata);
+    istream is(&buffer);
+    DefaultInputBitStream ibs(is);
+    ibs.readBits(32 + 5 + 1); // type, version, checksum
+    const uint32 entropyType = uint32(ibs.readBits(5));
+    const uint64 transformType = ibs.readBits(48);
+    ibs.readBits(28 + 6 + 1 + 2); // block size, number of blocks, index, BWT chunks
+    const bool autoPipeline = ibs.readBit() == 1;
+    ibs.readBits(2); // model shrink
+    blocks.clear();
+
+    while (true) {
+        const uint lw = uint(ibs.readBits(5)) + 3;
+        BlockInfo info;
+        info._bits = ibs.readBits(lw);
+
+        if (info._bits == 0)
+            break;
+
+        info._mode = byte(ibs.readBits(8));
+        info._entropyType = entropyType;
+        info._transformType = transformType;
+        uint64 read = 8;
+
+        if ((info._mode & byte(0x80)) == byte(0)) {
+            if ((info._mode & byte(0x10)) != byte(0)) {
+                ibs.readBits(8);
+                read += 8;
+            }
+
+            if (autoPipeline == true) {
+                info._entropyType = uint32(ibs.readBits(5));
+                info._transformType = ibs.readBits(48);
+                read += 53;
+            }
+        }
+
+        for (; read + 64 <= info._bits; read += 64)
+            ibs.readBits(64);
+
+        if (read < info._bits)
+            ibs.readBits(uint(info._bits - read));
+
+        blocks.push_back(info);
+    }
+
+    // Only the padding of the last byte may follow
+    return ibs.read() + 8 > uint64(cdata.size()) * 8;
+}
+
+// Each block is prefixed with its size in bits: walking the stream from size to
+// size must find all the blocks, then the end of stream block.
+int testBlockSizes()
+{
+    cout << endl
+         << "Correctness for the size prefix of the blocks" << endl;
+    const int blockSize = 4096;
+    const int sizes[] = { 10, blockSize, 3 * blockSize, 20 * blockSize + 777 };
+    const char* pipelines[][2] = {
+        { "NONE", "NONE" },
+        { "LZ", "HUFFMAN" },
+        { "BWT+RANK+ZRLT", "ANS0" },
+        { "TEXT+ROLZ", "FPAQ" }
+    };
+    int res = 0;
+
+    for (int p = 0; p < 4; p++) {
+        for (int s = 0; s < 4; s++) {
+            vector<byte> data;
+            generateData(data, sizes[s], p, uint(s + 1));
+            cout << pipelines[p][0] << " & " << pipelines[p][1] << ", size " << sizes[s] << ": ";
+
+            for (int jobs = 1; jobs <= 4; jobs += 3) {
+                map<string, string> params;
+                initParameters(params, pipelines[p][0], pipelines[p][1], blockSize, jobs);
+                const string cdata = compress(data, params, 5000);
+                vector<BlockInfo> blocks;
+                const int nbBlocks = (sizes[s] + blockSize - 1) / blockSize;
+
+                if ((parseBlocks(cdata, blocks) == false) || (int(blocks.size()) != nbBlocks)) {
+                    cout << "Incorrect blocks with " << jobs << " job(s): " << blocks.size() << " instead of " << nbBlocks << endl;
+                    res = 1;
+                }
+
+                if (checkRoundTrip(cdata, data, 5 - jobs) != 0)
+                    res = 1;
+
+                if (jobs == 1)
+                    cout << cdata.size() << " bytes" << endl;
+            }
+        }
+    }
+
+    return res;
+}
+
+// Streams written by kanzi 1.6 (bitstream version 8, no block size prefix)
+static const uint8 V8_TEXT_BWT_ANS0[] = {
+    0x4B, 0x41, 0x4E, 0x5A, 0x44, 0xA5, 0x02, 0x40, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x18,
+    0x20, 0x01, 0x4F, 0x54, 0x7F, 0x6E, 0xE8, 0x18, 0x80, 0xEF, 0xFF, 0xDB, 0xFF, 0xFF, 0xFF, 0xFC,
+    0xCC, 0x98, 0x01, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x09, 0xEF, 0xF8,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x41, 0xC5, 0xF4, 0x6C, 0x5A, 0xD2, 0xC2, 0x92, 0xB6,
+    0xDB, 0x95, 0x73, 0x11, 0x49, 0x12, 0xA2, 0x45, 0x0C, 0xAB, 0x2C, 0xB8, 0xCA, 0xAB, 0x52, 0x8A,
+    0xB3, 0x52, 0xA8, 0xCA, 0xB5, 0xD0, 0x02, 0x00, 0x39, 0xC1, 0x65, 0xFD, 0xB6, 0x40, 0x2E, 0x9A,
+    0x1D, 0x76, 0x4D, 0x27, 0xFE, 0x50, 0x2F, 0xF3, 0x9B, 0x8D, 0xDF, 0xA0, 0xAA, 0xF5, 0x31, 0xC6,
+    0xC6, 0xA9, 0xEE, 0xAB, 0xEB, 0x67, 0x3E, 0x5A, 0xF0, 0x4B, 0x5A, 0xDD, 0xD5, 0x10, 0x0A, 0xA4,
+    0x05, 0x14, 0x03, 0xC1, 0xD6, 0x7C, 0x00, 0xFB, 0xF5, 0x7E, 0x27, 0xE0, 0x1A, 0x68, 0xFF, 0xDA,
+    0x10, 0x4E, 0x07, 0x3E, 0xC5, 0xDE, 0xB9, 0xB8, 0x2A, 0x51, 0xF8, 0x20, 0x6B, 0x6C, 0x96, 0xB4,
+    0x40, 0x00, 0x08, 0x1B, 0x5C, 0xBA, 0x53, 0x29, 0xE4, 0x00, 0x0A, 0x7C, 0x8F, 0x1D, 0xCE, 0x9A,
+    0x98, 0x00, 0x9B, 0xEA, 0x22, 0x6C, 0x0C, 0x69, 0xD8, 0xCA, 0x17, 0x2B, 0x3B, 0x3D, 0x4F, 0xCE,
+    0x96, 0x78, 0xC8, 0xAF, 0x2B, 0x50, 0x47, 0x4C, 0xB5, 0x4E, 0x34, 0x36, 0x32, 0xD5, 0x2E, 0xC4,
+    0x28, 0xBA, 0x3C, 0xA8, 0x8B, 0xB7, 0x89, 0xE9, 0x74, 0xA5, 0x9F, 0xBB, 0x97, 0xAB, 0x93, 0xAF,
+    0xB5, 0x98, 0x45, 0xED, 0x26, 0xA7, 0x72, 0xD5, 0xA1, 0xF6, 0x89, 0xAD, 0x3B, 0x95, 0x7C, 0x5E,
+    0x9C, 0xB5, 0x7E, 0xCB, 0x7E, 0x79, 0x90, 0x3D, 0x6B, 0xB7, 0x71, 0x81, 0xA4, 0xA6, 0x79, 0x01,
+    0xA8, 0x7A, 0xED, 0x9C, 0x5B, 0x5F, 0x0C, 0x4C, 0xE7, 0xE0, 0x78, 0xE8, 0x39, 0xCA, 0x9C, 0x65,
+    0x8C, 0x40, 0x4A, 0x8C, 0xE0, 0x17, 0x3D, 0x1D, 0x16, 0x4E, 0xBF, 0x11, 0x49, 0x3D, 0x5D, 0x7C,
+    0x39, 0xA7, 0x37, 0x1E, 0xDB, 0x51, 0x3F, 0x51, 0x51, 0x39, 0x5F, 0x98, 0x7B, 0x78, 0xD5, 0x3F,
+    0x22, 0x7F, 0x55, 0x83, 0x8A, 0x94, 0x8E, 0x57, 0x62, 0xE6, 0xED, 0xE0, 0xB2, 0x38, 0xB2, 0x8A,
+    0x6D, 0xBD, 0x2A, 0x40, 0x02, 0xA4, 0xE8, 0xFD, 0xE9, 0xA4, 0x30, 0x43, 0xFB, 0xF9, 0xFF, 0xBF,
+    0xFF, 0xFF, 0xFF, 0x68, 0x02, 0x01, 0x00, 0x00, 0x04, 0x40, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00,
+    0x11, 0xFF, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x84, 0x6D, 0x1A, 0xC2, 0x28, 0xAE,
+    0x32, 0x90, 0x63, 0x83, 0x5A, 0x52, 0x12, 0x24, 0x32, 0x1A, 0x99, 0x6A, 0x51, 0xA5, 0x55, 0x69,
+    0x15, 0x65, 0x56, 0x91, 0xA6, 0x99, 0x55, 0x19, 0x56, 0xB9, 0x00, 0x52, 0x5F, 0xFB, 0x6A, 0x69,
+    0x40, 0x0E, 0xC5, 0x3C, 0xC7, 0x4D, 0xC2, 0x22, 0x0B, 0xE0, 0xFC, 0xE5, 0xFC, 0xB2, 0xB6, 0x7F,
+    0xA7, 0x90, 0x76, 0x12, 0x3D, 0x52, 0xC6, 0x0C, 0x2B, 0x93, 0x2C, 0xE7, 0xD2, 0xFC, 0xFA, 0x8D,
+    0xAD, 0x5C, 0x78, 0xFA, 0xDD, 0x1F, 0x26, 0x4A, 0x06, 0xA9, 0xC9, 0x4D, 0x0A, 0xAF, 0xC9, 0x85,
+    0x03, 0xE0, 0x20, 0x53, 0x84, 0xAE, 0xC1, 0xE8, 0x22, 0x32, 0x00, 0x55, 0xD0, 0x68, 0x94, 0x7B,
+    0x0C, 0x6A, 0x88, 0x2F, 0x3F, 0x2E, 0x80, 0xE5, 0x93, 0x48, 0x62, 0x8D, 0x03, 0xE5, 0x3B, 0x72,
+    0x64, 0xC5, 0x44, 0x71, 0x3C, 0x14, 0x39, 0xEC, 0xA8, 0xAD, 0xD6, 0xB1, 0xE9, 0x93, 0xC0, 0x1F,
+    0x69, 0x59, 0xD7, 0x20, 0x3A, 0x48, 0xAB, 0x74, 0x0E, 0x74, 0x17, 0x73, 0x6A, 0xEE, 0x0F, 0x59,
+    0x93, 0x84, 0x97, 0x71, 0xE0, 0xA1, 0xFB, 0xD9, 0xC8, 0xC7, 0x55, 0xC2, 0xBE, 0x71, 0xAE, 0x79,
+    0xB2, 0x4D, 0x43, 0x2C, 0xB3, 0xD7, 0xCC, 0x84, 0x6E, 0xC7, 0xB5, 0x41, 0x73, 0x17, 0xEE, 0x25,
+    0xEC, 0x89, 0xD8, 0x8D, 0xED, 0x18, 0xAF, 0xE3, 0x71, 0xEC, 0xD7, 0xB7, 0xAD, 0xC3, 0x01, 0x9E,
+    0x96, 0x92, 0xE1, 0xF0, 0x88, 0x10, 0xF4, 0x4F, 0x73, 0x86, 0x1D, 0x24, 0xC5, 0xA6, 0x0D, 0xE0,
+    0x19, 0xC7, 0xDA, 0x88, 0xCE, 0x28, 0xE5, 0x7E, 0x1A, 0x5C, 0xEF, 0x73, 0x14, 0x96, 0x23, 0x4C,
+    0xD6, 0x68, 0xA5, 0x5F, 0x82, 0x6C, 0x8B, 0x16, 0x91, 0x6C, 0xDC, 0x19, 0x4F, 0x67, 0xE9, 0xE1,
+    0x00, 0x25, 0x42, 0x91, 0xAA, 0x68, 0xB5, 0x96, 0x10, 0xBA, 0x5A, 0xD4, 0xAB, 0x03, 0x4E, 0x5D,
+    0x4E, 0x8B, 0xA8, 0xC0, 0x31, 0x93, 0x19, 0x92, 0x47, 0x06, 0x01, 0x23, 0xEA, 0x43, 0x9B, 0xFF,
+    0xFF, 0xFF, 0x6E, 0x64, 0x03, 0x00, 0x00, 0x00, 0x50, 0x10, 0x00, 0x00, 0x00, 0x08, 0x00, 0x02,
+    0xCD, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x10, 0x86, 0x8C, 0xE0, 0x44, 0x99, 0x2C,
+    0x60, 0xC6, 0x4E, 0x46, 0xDB, 0xB8, 0x98, 0x2E, 0xAE, 0xFE, 0xE1, 0xFF, 0xE5, 0x0C, 0x65, 0xB2,
+    0x49, 0x22, 0xFA, 0xBF, 0x0C, 0x02, 0x01, 0x2F, 0xE5, 0x12, 0x05, 0xFF, 0x16, 0x21, 0xFB, 0xDF,
+    0xA5, 0xEF, 0xDD, 0xDA, 0xB9, 0xBF, 0xCF, 0x48, 0x09, 0xBA, 0xED, 0xB2, 0x3F, 0x5D, 0x31, 0xB9,
+    0x74, 0x6A, 0x15, 0xB4, 0x86, 0xC1, 0xFB, 0xCC, 0x70, 0xCC, 0x96, 0x25, 0x2D, 0x01, 0xD9, 0x0A,
+    0xCE, 0xE3, 0x10, 0x7B, 0x77, 0x3E, 0x06, 0x1C, 0x6B, 0xF6, 0x19, 0x27, 0x59, 0x19, 0x40, 0x72,
+    0xF7, 0x1F, 0x86, 0x2D, 0xA5, 0x7B, 0xC1, 0xC3, 0x3E, 0xE6, 0xD4, 0x34, 0xF1, 0xCD, 0x6C, 0x89,
+    0x13, 0xC8, 0x0B, 0x00, 0x1C, 0x05, 0x76, 0x6F, 0xEA, 0x81, 0x8E, 0xE7, 0x24, 0xBF, 0x72, 0xCD,
+    0x0F, 0xD7, 0x8A, 0x3C, 0x8D, 0xE4, 0xA3, 0x89, 0x2F, 0x36, 0x37, 0x59, 0x14, 0x9D, 0x5F, 0xA2,
+    0x7B, 0x99, 0xBD, 0xEA, 0x35, 0x96, 0x99, 0x7C, 0x90, 0x36, 0xCF, 0x9F, 0x58, 0x5C, 0xB8, 0xB3,
+    0x34, 0x98, 0xAE, 0xAC, 0xB5, 0x6D, 0x21, 0x84, 0x48, 0x57, 0x0D, 0x73, 0x7A, 0x0B, 0xDF, 0x93,
+    0x00, 0x00
+};
+
+static const uint8 V8_RUNS_RLT_FPAQ[] = {
+    0x4B, 0x41, 0x4E, 0x5A, 0x44, 0x42, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x18,
+    0x07, 0x94, 0x2E, 0xC4, 0x08, 0x54, 0x68, 0xEF, 0xF9, 0xC8, 0x4F, 0x08, 0x48, 0x02, 0x3B, 0x93,
+    0xC4, 0x02, 0xB0, 0xF2, 0x4F, 0x6C, 0x7E, 0x85, 0xCB, 0xB4, 0x9B, 0x91, 0x36, 0x11, 0x40, 0xBF,
+    0xAB, 0xCD, 0xF6, 0xE3, 0x36, 0x48, 0xD4, 0x71, 0x48, 0xF4, 0x99, 0xAF, 0x61, 0xEF, 0xAD, 0x3B,
+    0xD2, 0x44, 0xD9, 0x75, 0xA7, 0x3E, 0x6E, 0x5E, 0x04, 0x02, 0x93, 0xCC, 0x1D, 0x3B, 0xB4, 0x3A,
+    0x9C, 0x93, 0x8B, 0x1F, 0x11, 0x89, 0xCD, 0xF3, 0x0B, 0x5E, 0x6F, 0x44, 0xE4, 0xA4, 0x11, 0xC9,
+    0x31, 0x52, 0xC2, 0xDA, 0x77, 0x47, 0x4E, 0x7F, 0x49, 0x27, 0x86, 0x3D, 0x94, 0x2F, 0x33, 0x09,
+    0x25, 0x95, 0x5C, 0xA6, 0x6F, 0x32, 0x6B, 0x97, 0x80, 0x74, 0xEE, 0xCE, 0xDF, 0xC0, 0x04, 0x42,
+    0x75, 0x4C, 0xD0, 0xFF, 0xFF, 0xFF, 0x07, 0x7B, 0x73, 0x56, 0xC2, 0x2D, 0x5C, 0xEF, 0xF9, 0xC8,
+    0x4F, 0x4C, 0x53, 0xD8, 0x86, 0x47, 0xB3, 0x3B, 0x23, 0xFC, 0x5E, 0x3E, 0xAB, 0x74, 0xDA, 0xAB,
+    0x1C, 0xA0, 0x48, 0x23, 0x5F, 0x1D, 0x0D, 0x6B, 0xEC, 0x99, 0x4E, 0x8A, 0xD0, 0x07, 0xEB, 0x03,
+    0x4A, 0xA2, 0xED, 0xCF, 0xC4, 0x91, 0xCA, 0x91, 0xC8, 0x67, 0x81, 0xAC, 0x09, 0xA1, 0xA8, 0x75,
+    0xD6, 0x9E, 0x16, 0xE1, 0x36, 0x33, 0xB1, 0xB0, 0xD6, 0x4E, 0x3D, 0x40, 0x48, 0x51, 0x75, 0xCB,
+    0xF9, 0x22, 0x96, 0x7C, 0xE7, 0xF0, 0xBF, 0x08, 0x88, 0xA5, 0x5F, 0x5A, 0x35, 0x8C, 0xA5, 0x20,
+    0x18, 0x87, 0x65, 0x13, 0x09, 0xDF, 0x58, 0x12, 0x2C, 0x0E, 0x4A, 0xCE, 0x00, 0xFF, 0xFF, 0xFF,
+    0x07, 0x42, 0x6E, 0x0A, 0x88, 0x4E, 0x34, 0xFF, 0xF4, 0x29, 0x80, 0xBC, 0x98, 0x8D, 0xF0, 0x80,
+    0xCC, 0x99, 0x53, 0xD9, 0xD0, 0xF4, 0xF1, 0x83, 0x30, 0x5A, 0x7A, 0x2E, 0xF6, 0x12, 0x57, 0x61,
+    0xCE, 0x9D, 0x9B, 0xD3, 0xF0, 0xCF, 0x34, 0x19, 0x3F, 0x9E, 0x57, 0xC6, 0xD8, 0xE6, 0x4F, 0x4A,
+    0xE5, 0x64, 0xF3, 0x00, 0x3E, 0x74, 0x30, 0xD6, 0xED, 0x5E, 0x14, 0xC9, 0xED, 0x30, 0xD8, 0xFF,
+    0xFF, 0xFF, 0x80, 0x00
+};
+
+static const uint8 V8_TEXT_LZ_RANGE[] = {
+    0x4B, 0x41, 0x4E, 0x5A, 0x40, 0x85, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x10,
+    0x23, 0x02, 0xA4, 0xE0, 0x3A, 0x5C, 0xAF, 0x59, 0x17, 0xED, 0xFF, 0xC0, 0xEF, 0xFF, 0xDF, 0xC0,
+    0x81, 0xC1, 0x52, 0xC0, 0x12, 0x02, 0x01, 0x21, 0x60, 0x40, 0xDF, 0x40, 0x07, 0xC2, 0x01, 0x00,
+    0x0A, 0x40, 0x6F, 0x49, 0xFC, 0xBC, 0x54, 0x32, 0x22, 0x09, 0x20, 0x48, 0x21, 0x04, 0x41, 0x48,
+    0x43, 0xC1, 0x18, 0x89, 0x48, 0x88, 0x89, 0x08, 0x89, 0x8B, 0x88, 0x8F, 0x08, 0x90, 0x89, 0x1A,
+    0x41, 0x2C, 0x40, 0x89, 0x08, 0x91, 0x29, 0xD9, 0xF2, 0x72, 0x4A, 0x41, 0x25, 0x32, 0xD6, 0xB4,
+    0x04, 0x21, 0x0A, 0x94, 0x10, 0x20, 0x84, 0x70, 0x23, 0x0E, 0x59, 0x15, 0x8A, 0xAB, 0x4C, 0xFE,
+    0x61, 0x89, 0x54, 0xC5, 0xF1, 0x11, 0xA9, 0xEE, 0xBB, 0xF3, 0x11, 0x0B, 0xFE, 0xFA, 0xD9, 0x04,
+    0x4E, 0x6C, 0xB4, 0x49, 0x59, 0x78, 0xE3, 0x73, 0x45, 0x21, 0x23, 0x8D, 0xA0, 0x4F, 0xB2, 0xC9,
+    0x4B, 0xA3, 0xCF, 0x27, 0x33, 0xBD, 0xD0, 0x12, 0x08, 0x01, 0x46, 0xDD, 0xCD, 0xD5, 0xA6, 0xD8,
+    0x22, 0x75, 0x98, 0x2F, 0xF2, 0x0F, 0xD0, 0x02, 0xDA, 0xC6, 0x69, 0x5E, 0x58, 0x74, 0x89, 0x9A,
+    0x36, 0xA7, 0x92, 0xEC, 0xE3, 0x62, 0x7B, 0xEA, 0xB0, 0x78, 0x99, 0x30, 0xD6, 0x4C, 0xBC, 0x03,
+    0x3E, 0xD3, 0xA8, 0x57, 0x8F, 0xEB, 0x61, 0xEC, 0xD6, 0x04, 0x16, 0x23, 0xE8, 0xE8, 0x5C, 0x7E,
+    0x24, 0xB6, 0xE5, 0x63, 0xFE, 0x27, 0x7B, 0x19, 0x8A, 0x34, 0x2F, 0x00, 0xCA, 0xBD, 0xD0, 0x78,
+    0x7E, 0x5B, 0xBC, 0x08, 0x68, 0x63, 0xAF, 0x10, 0x34, 0xBD, 0xD3, 0x29, 0x5F, 0x9A, 0x61, 0x45,
+    0x48, 0x41, 0xDA, 0x3F, 0xCF, 0x62, 0xBF, 0xBD, 0x87, 0xB3, 0xB6, 0x2D, 0xF7, 0xC0, 0x66, 0x64,
+    0xBF, 0x05, 0x93, 0x56, 0xA1, 0x92, 0x5E, 0x3B, 0x3F, 0x0A, 0x81, 0xB6, 0x50, 0xE2, 0x14, 0x94,
+    0xB4, 0xAD, 0x3A, 0xB4, 0xFF, 0xD2, 0xD0, 0xC6, 0x2B, 0xAF, 0x1E, 0x27, 0xF0, 0xBB, 0x1A, 0x19,
+    0x98, 0xE3, 0xB0, 0xCB, 0x8C, 0x2C, 0xEC, 0x47, 0xB2, 0x4C, 0xCB, 0xC9, 0xF4, 0x7F, 0x2B, 0x72,
+    0x47, 0x8D, 0xD4, 0xF6, 0xEB, 0x6D, 0x59, 0x61, 0x91, 0xEA, 0x2B, 0x99, 0x7F, 0x23, 0xEB, 0x0A,
+    0x3E, 0x61, 0xC8, 0x76, 0x6D, 0xE2, 0xA3, 0x8B, 0x0B, 0x37, 0x98, 0x03, 0x3D, 0x19, 0xE8, 0x67,
+    0x17, 0xB9, 0x27, 0xA2, 0x22, 0xCE, 0x02, 0x61, 0xC1, 0x6E, 0x55, 0x4E, 0xE7, 0x32, 0xBB, 0x84,
+    0x9F, 0x32, 0xB1, 0xD2, 0xF2, 0x5A, 0x31, 0xE2, 0x55, 0x25, 0xAD, 0xF3, 0x41, 0xFC, 0x5B, 0xAB,
+    0x1E, 0xA4, 0xE3, 0x93, 0x18, 0x67, 0x13, 0xC5, 0x94, 0x08, 0x8B, 0x33, 0xF9, 0x97, 0x3E, 0x67,
+    0x45, 0x0E, 0x42, 0x29, 0xCF, 0x3D, 0x78, 0x63, 0xE6, 0x1A, 0xEE, 0xDA, 0x89, 0x26, 0xF0, 0xE4,
+    0x2A, 0x0C, 0x83, 0x91, 0x43, 0xA7, 0xF6, 0x0D, 0x9F, 0xF0, 0x30, 0x58, 0x39, 0xF6, 0xB5, 0x78,
+    0x10, 0x42, 0x65, 0xA9, 0x49, 0xE3, 0x58, 0x04, 0xF1, 0x27, 0xB8, 0xE6, 0x00, 0x24, 0x3B, 0x9C,
+    0xCE, 0x9D, 0x79, 0x5A, 0xF6, 0x5E, 0xA0, 0x7E, 0x74, 0x0F, 0x50, 0xD4, 0x2B, 0xBE, 0xFD, 0xB5,
+    0x91, 0x6B, 0x52, 0xA4, 0xF9, 0x03, 0xED, 0x3C, 0xA0, 0x71, 0x8A, 0x02, 0x0D, 0xB0, 0xE9, 0xB2,
+    0x4B, 0x19, 0xE1, 0x1C, 0x61, 0xD4, 0xA9, 0x72, 0x02, 0x30, 0x98, 0x92, 0x5E, 0xEE, 0x4D, 0x21,
+    0x0A, 0x64, 0x43, 0xA5, 0xF0, 0x0F, 0x97, 0x3D, 0x37, 0x66, 0xBD, 0x50, 0x7B, 0xC5, 0x85, 0x8B,
+    0xDC, 0xFE, 0xF5, 0x69, 0x7D, 0x2B, 0x69, 0xF7, 0x26, 0xB3, 0x46, 0x6E, 0xD3, 0xD4, 0xF7, 0xE3,
+    0x09, 0x0E, 0x1A, 0x6F, 0x31, 0x6C, 0x65, 0x6E, 0xB7, 0x58, 0xE6, 0x53, 0x73, 0x72, 0xD3, 0x1D,
+    0x59, 0x32, 0x51, 0x12, 0x77, 0x14, 0xA7, 0x7D, 0x6A, 0xC1, 0x96, 0x90, 0xB9, 0x77, 0x75, 0xD0,
+    0x49, 0xBF, 0x17, 0x60, 0xD6, 0x68, 0x1E, 0x8F, 0x65, 0xCE, 0x5E, 0xBA, 0x74, 0x6E, 0xAC, 0x81,
+    0xD2, 0xFB, 0x68, 0x96, 0x7C, 0x03, 0x84, 0x6B, 0x0B, 0x05, 0x12, 0xFC, 0x99, 0x83, 0x7C, 0x72,
+    0xB3, 0x14, 0xE0, 0xA2, 0x30, 0xCE, 0x6F, 0x4B, 0x4C, 0xBF, 0x15, 0xF8, 0x04, 0xFF, 0xDB, 0x46,
+    0x5D, 0xE7, 0x93, 0xDD, 0x6F, 0x00, 0x01, 0xEA, 0xF0, 0x00, 0x00, 0x10, 0x23, 0x80, 0x1A, 0xB7,
+    0xE0, 0xD7, 0xFF, 0x6F, 0xC0, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x6F,
+    0xA0, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x37, 0x20, 0xA4, 0x26, 0x11, 0xA5, 0x65, 0x04, 0x18,
+    0xC2, 0x1C, 0x53, 0x1A, 0x17, 0x5B, 0x22, 0x52, 0x30, 0xD6, 0x90, 0x6D, 0x8B, 0xC2, 0x49, 0x2B,
+    0x4C, 0x84, 0xBE, 0xA7, 0xD4, 0x14, 0xC4, 0x2F, 0xE3, 0x42, 0x0F, 0x2F, 0x93, 0xA1, 0x06, 0xC5,
+    0xD1, 0xE7, 0x19, 0xD5, 0x67, 0x65, 0x1E, 0x94, 0x65, 0x0A, 0x06, 0x15, 0x3B, 0x09, 0x4C, 0xC4,
+    0x15, 0x01, 0x22, 0x2D, 0xB2, 0x47, 0xB3, 0xD6, 0x69, 0x66, 0x47, 0x44, 0x9D, 0xD2, 0xBD, 0xAD,
+    0x3D, 0xF5, 0x93, 0xDA, 0xD7, 0x67, 0xBC, 0x9A, 0xF5, 0xDF, 0x13, 0x56, 0x95, 0xDA, 0x53, 0xF9,
+    0xE6, 0x60, 0xF0, 0x39, 0xD8, 0xAA, 0x5E, 0x36, 0x5B, 0x78, 0x36, 0xF0, 0xA8, 0xBC, 0x24, 0xCE,
+    0x40, 0xE0, 0x07, 0x5D, 0x39, 0xA4, 0x49, 0x5A, 0x12, 0x25, 0xE2, 0xB2, 0xEA, 0xBD, 0xC7, 0xEF,
+    0x71, 0x3D, 0xB2, 0x6E, 0xB2, 0xAB, 0x21, 0x31, 0xC7, 0x8A, 0x44, 0x82, 0x8F, 0x4F, 0x77, 0x93,
+    0xC6, 0x9D, 0x21, 0x72, 0xC1, 0xC5, 0xE2, 0xB3, 0xEC, 0x51, 0xCB, 0xB2, 0xF2, 0x40, 0x2F, 0x20,
+    0x37, 0xC2, 0xB6, 0xED, 0xEA, 0xE0, 0x09, 0x02, 0xC4, 0xCC, 0x6A, 0x23, 0x0E, 0xB5, 0xC7, 0xC7,
+    0x78, 0x13, 0x9B, 0x2F, 0xF6, 0x7E, 0xF5, 0x70, 0x00, 0x00, 0x00, 0x80, 0x00
+};
+// Decode the version 8 streams above (see generateData for the data)
+int testLegacyStreams()
+{
+    cout << endl
+         << "Correctness for the bitstream version 8" << endl;
+    struct { const uint8* cdata; int size; const char* name; int kind; } streams[] = {
+        { V8_TEXT_BWT_ANS0, int(sizeof(V8_TEXT_BWT_ANS0)), "TEXT+BWT+RANK+ZRLT & ANS0", 0 },
+        { V8_RUNS_RLT_FPAQ, int(sizeof(V8_RUNS_RLT_FPAQ)), "RLT & FPAQ", 1 },
+        { V8_TEXT_LZ_RANGE, int(sizeof(V8_TEXT_LZ_RANGE)), "TEXT+LZ & RANGE", 0 }
+    };
+    int res = 0;
+
+    for (int i = 0; i < 3; i++) {
+        vector<byte> data;
+        generateData(data, 2500, streams[i].kind, 8);
+        const string cdata(reinterpret_cast<const char*>(streams[i].cdata), streams[i].size);
+
+        for (int jobs = 1; jobs <= 3; jobs += 2) {
+            cout << streams[i].name << " with " << jobs << " job(s): ";
+            const bool ok = checkRoundTrip(cdata, data, jobs) == 0;
+            cout << ((ok == true) ? "OK" : "KO") << endl;
+
+            if (ok == false)
+                res = 1;
+        }
+    }
+
+    return res;
+}
+
+// The blocks are transformed and entropy coded concurrently in private
+// bitstreams: the output must not depend on the number of jobs.
+int testConcurrentBlocks()
+{
+    cout << endl
+         << "Correctness for the concurrent encoding of blocks" << endl;
+    const char* pipelines[][2] = {
+        { "NONE", "HUFFMAN" },
+        { "LZ", "ANS0" },
+        { "BWT+RANK+ZRLT", "ANS1" },
+        { "TEXT+ROLZ", "NONE" },
+        { "RLT", "FPAQ" }
+    };
+    const int jobs[] = { 1, 2, 3, 8 };
+    int res = 0;
+
+    for (int kind = 0; kind < 4; kind++) {
+        vector<byte> data;
+        // 12 blocks and a partial one
+        generateData(data, 12 * 65536 + 1234, kind, kind + 1);
+
+        for (int p = 0; p < 5; p++) {
+            cout << "Data " << kind << ", " << pipelines[p][0] << " & " << pipelines[p][1] << ": ";
+            string ref;
+
+            for (int j = 0; j < 4; j++) {
+                map<string, string> params;
+                initParameters(params, pipelines[p][0], pipelines[p][1], 65536, jobs[j]);
+                const string cdata = compress(data, params, 10000);
+
+                if (j == 0) {
+                    ref = cdata;
+                }
+                else if (cdata != ref) {
+                    cout << "Different output with " << jobs[j] << " jobs" << endl;
+                    res = 1;
+                }
+
+                if (checkRoundTrip(cdata, data, jobs[3 - j]) != 0)
+                    res = 1;
+            }
+
+            cout << ref.size() << " bytes" << endl;
+        }
+    }
+
+    return res;
+}
+
+#ifdef CONCURRENCY_ENABLED
+// Return its id once the previous task (if any) has started
+class OrderedTask : public Task<int> {
+public:
+    OrderedTask(int id, atomic_int* started, bool fail) : _id(id), _started(started), _fail(fail) {}
+
+    int run()
+    {
+        // Same pattern as the emission of the blocks: wait for the previous task
+        while (_started->load() != _id - 1)
+            this_thread::yield();
+
+        (*_started)++;
+
+        if (_fail == true)
+            throw runtime_error("Task failure");
+
+        return _id;
+    }
+
+private:
+    int _id;
+    atomic_int* _started;
+    bool _fail;
+};
+
+// Run a nested batch of ordered tasks and return the sum of their results
+class NestedTask : public Task<int> {
+public:
+    NestedTask(int nbTasks) : _nbTasks(nbTasks) {}
+
+    int run()
+    {
+        atomic_int started(-1);
+        vector<OrderedTask*> tasks;
+        vector<int> results;
+
+        for (int i = 0; i < _nbTasks; i++)
+            tasks.push_back(new OrderedTask(i, &started, false));
+
+        ThreadPool::instance().run(tasks, results);
+        int sum = 0;
+
+        for (int i = 0; i < _nbTasks; i++) {
+            sum += results[i];
+            delete tasks[i];
+        }
+
+        return sum;
+    }
+
+private:
+    int _nbTasks;
+};
+
+// Return 1 if all the tasks of the batch were running at the same time
+class ConcurrentTask : public Task<int> {
+public:
+    ConcurrentTask(int nbTasks, atomic_int* started) : _nbTasks(nbTasks), _started(started) {}
+
+    int run()
+    {
+        (*_started)++;
+        const clock_t end = clock() + 5 * CLOCKS_PER_SEC;
+
+        while ((_started->load() < _nbTasks) && (clock() < end))
+            this_thread::yield();
+
+        return (_started->load() >= _nbTasks) ? 1 : 0;
+    }
+
+private:
+    int _nbTasks;
+    atomic_int* _started;
+};
+#endif
+
+int testThreadPool()
+{
+    cout << endl
+         << "Correctness for the thread pool" << endl;
+    int res = 0;
+
+#ifdef CONCURRENCY_ENABLED
+    ThreadPool& pool = ThreadPool::instance();
+    cout << "Threads: " << pool.size() << endl;
+
+    // More ordered tasks than threads: the results are returned in task order
+    {
+        const int nbTasks = 4 * pool.size() + 3;
+        atomic_int started(-1);
+        vector<OrderedTask*> tasks;
+        vector<int> results;
+
+        for (int i = 0; i < nbTasks; i++)
+            tasks.push_back(new OrderedTask(i, &started, false));
+
+        pool.run(tasks, results);
+
+        for (int i = 0; i < nbTasks; i++) {
+            if (results[i] != i) {
+                cout << "Incorrect result for task " << i << ": " << results[i] << endl;
+                res = 1;
+            }
+
+            delete tasks[i];
+        }
+
+        cout << "Ordered tasks: " << ((res == 0) ? "OK" : "KO") << endl;
+    }
+
+    // The exception raised by a task is rethrown once all tasks have completed
+    {
+        const int nbTasks = 16;
+        atomic_int started(-1);
+        vector<OrderedTask*> tasks;
+        vector<int> results;
+        bool thrown = false;
+
+        for (int i = 0; i < nbTasks; i++)
+            tasks.push_back(new OrderedTask(i, &started, i == 5));
+
+        try {
+            pool.run(tasks, results);
+        }
+        catch (runtime_error&) {
+            thrown = true;
+        }
+
+        if ((thrown == false) || (started.load() != nbTasks - 1)) {
+            cout << "Incorrect handling of the task failure" << endl;
+            res = 1;
+        }
+
+        for (int i = 0; i < nbTasks; i++)
+            delete tasks[i];
+
+        cout << "Task failure: " << ((thrown == true) ? "OK" : "KO") << endl;
+    }
+
+    // Nested batches (EG. blocks then BWT chunks) cannot deadlock, even with
+    // all the threads of the pool running outer tasks
+    {
+        const int nbTasks = 2 * pool.size() + 1;
+        const int nbNested = 2 * pool.size() + 1;
+        vector<NestedTask*> tasks;
+        vector<int> results;
+
+        for (int i = 0; i < nbTasks; i++)
+            tasks.push_back(new NestedTask(nbNested));
+
+        pool.run(tasks, results);
+        bool ok = true;
+
+        for (int i = 0; i < nbTasks; i++) {
+            if (results[i] != nbNested * (nbNested - 1) / 2)
+                ok = false;
+
+            delete tasks[i];
+        }
+
+        if (ok == false)
+            res = 1;
+
+        cout << "Nested batches: " << ((ok == true) ? "OK" : "KO") << endl;
+    }
+
+    // Scheduled tasks start in scheduling order, the futures return the results
+    {
+        const int nbTasks = 3 * pool.size();
+        atomic_int started(-1);
+        vector<OrderedTask*> tasks;
+        vector<ThreadPool::Future<OrderedTask, int>*> futures;
+        bool ok = true;
+
+        for (int i = 0; i < nbTasks; i++) {
+            tasks.push_back(new OrderedTask(i, &started, false));
+            futures.push_back(pool.schedule<int>(tasks[i]));
+        }
+
+        for (int i = 0; i < nbTasks; i++) {
+            if (futures[i]->get() != i)
+                ok = false;
+
+            delete futures[i];
+            delete tasks[i];
+        }
+
+        if (ok == false)
+            res = 1;
+
+        cout << "Scheduled tasks: " << ((ok == true) ? "OK" : "KO") << endl;
+    }
+
+    // More jobs than threads: the pool grows (never shrinks) and all the jobs
+    // run at the same time
+    {
+        const int nbTasks = pool.size() + 3;
+        pool.reserve(nbTasks);
+        pool.reserve(1);
+        atomic_int started(0);
+        vector<ConcurrentTask*> tasks;
+        vector<int> results;
+        bool ok = pool.size() == nbTasks;
+
+        for (int i = 0; i < nbTasks; i++)
+            tasks.push_back(new ConcurrentTask(nbTasks, &started));
+
+        pool.run(tasks, results);
+
+        for (int i = 0; i < nbTasks; i++) {
+            ok &= results[i] == 1;
+            delete tasks[i];
+        }
+
+        if (ok == false)
+            res = 1;
+
+        cout << "Reserved threads (" << pool.size() << "): " << ((ok == true) ? "OK" : "KO") << endl;
+    }
+#else
+    cout << "Concurrency disabled, skip" << endl;
+#endif
+
+    return res;
+}
+
+#ifdef CONCURRENCY_ENABLED
+// Count the blocks emitted (events may come from several threads)
+class BlockCounter : public Listener {
+public:
+    BlockCounter() : _count(0), _sum(0) {}
+
+    void processEvent(const Event& evt)
+    {
+        if (evt.getType() != Event::AFTER_ENTROPY)
+            return;
+
+        lock_guard<mutex> lock(_mutex);
+        _count++;
+        _sum += evt.getId();
+    }
+
+    int _count;
+    int64 _sum;
+    mutex _mutex;
+};
+#endif
+
+// Blocks are encoded in a sliding window: the output must be the same as with
+// one job for any input size and any size of the writes.
+int testSlidingWindow()
+{
+    cout << endl
+         << "Correctness for the sliding window of blocks" << endl;
+    const int blockSize = 16384;
+    const int sizes[] = { 0, 10, blockSize, 3 * blockSize, 25 * blockSize + 777 };
+    const int steps[] = { 1, 1000, blockSize, 1 << 30 };
+    int res = 0;
+
+    for (int s = 0; s < 5; s++) {
+        vector<byte> data;
+        generateData(data, sizes[s], 0, s);
+        map<string, string> params;
+        initParameters(params, "LZ", "HUFFMAN", blockSize, 1);
+        const string ref = compress(data, params);
+        cout << "Size " << sizes[s] << ": " << ref.size() << " bytes" << endl;
+
+        if (checkRoundTrip(ref, data, 1) != 0)
+            res = 1;
+
+        for (int jobs = 2; jobs <= 6; jobs += 4) {
+            for (int t = 0; t < 4; t++) {
+                initParameters(params, "LZ", "HUFFMAN", blockSize, jobs);
+                const string cdata = compress(data, params, steps[t]);
+
+                if (cdata != ref) {
+                    cout << "Different output with " << jobs << " jobs and writes of " << steps[t] << " bytes" << endl;
+                    res = 1;
+                }
+            }
+        }
+    }
+
+    // Fewer blocks than jobs (the blocks get several jobs)
+    {
+        vector<byte> data;
+        generateData(data, 2 * 65536 + 100, 1, 7);
+        map<string, string> params;
+        initParameters(params, "BWT", "ANS0", 65536, 8);
+        params["fileSize"] = "131172";
+        const string cdata = compress(data, params, 4096);
+        cout << "Fewer blocks than jobs: " << cdata.size() << " bytes" << endl;
+
+        if (checkRoundTrip(cdata, data, 8) != 0)
+            res = 1;
+    }
+
+#ifdef CONCURRENCY_ENABLED
+    // Each block is reported once
+    {
+        vector<byte> data;
+        const int nbBlocks = 30;
+        generateData(data, nbBlocks * blockSize, 2, 9);
+        map<string, string> params;
+        initParameters(params, "RLT", "ANS0", blockSize, 4);
+        BlockCounter counter;
+        stringbuf buffer;
+        ostream os(&buffer);
+
+        {
+            Context ctx(params);
+            CompressedOutputStream cos(os, ctx);
+            cos.addListener(counter);
+            cos.write(reinterpret_cast<const char*>(&data[0]), streamsize(data.size()));
+            cos.close();
+        }
+
+        if ((counter._count != nbBlocks) || (counter._sum != int64(nbBlocks) * (nbBlocks + 1) / 2)) {
+            cout << "Incorrect block events: " << counter._count << " blocks" << endl;
+            res = 1;
+        }
+
+        if (checkRoundTrip(buffer.str(), data, 3) != 0)
+            res = 1;
+    }
+#endif
+
+    return res;
+}
+
+static bool checkRange(const vector<byte>& data, int64 offset, const char* buf, streamsize n, streamsize expected)
+{
+    if (n != expected) {
+        cout << "Incorrect number of bytes read at offset " << offset << ": " << n << " instead of " << expected << endl;
+        return false;
+    }
+
+    if ((n > 0) && (memcmp(&data[size_t(offset)], buf, size_t(n)) != 0)) {
+        cout << "Incorrect data read at offset " << offset << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Random access to the decompressed data with the block index
+int testBlockIndex()
+{
+    cout << endl
+         << "Correctness for the block index (random access)" << endl;
+    const int blockSize = 16384;
+    const int size = 20 * blockSize + 4321;
+    vector<byte> data;
+    generateData(data, size, 0, 11);
+    map<string, string> params;
+    initParameters(params, "TEXT+LZ", "ANS0", blockSize, 4);
+    params["index"] = "TRUE";
+    const string cdata = compress(data, params, 5000);
+    int res = 0;
+    srand(12345);
+
+    if (checkRoundTrip(cdata, data, 2) != 0)
+        res = 1;
+
+    for (int jobs = 1; jobs <= 4; jobs += 3) {
+        stringstream ss;
+        ss << jobs;
+        map<string, string> params2;
+        params2["jobs"] = ss.str();
+        stringbuf buffer(cdata);
+        istream is(&buffer);
+        Context ctx(params2);
+        CompressedInputStream cis(is, ctx);
+        vector<char> buf(3 * blockSize);
+        bool ok = true;
+
+        // Random reads, some across block boundaries
+        for (int i = 0; i < 200; i++) {
+            const int64 offset = rand() % size;
+            const int len = (i & 1) ? rand() % 100 : rand() % (3 * blockSize);
+            const streamsize n = cis.readAt(offset, &buf[0], len);
+            ok &= checkRange(data, offset, &buf[0], n, min(streamsize(len), streamsize(size - offset)));
+        }
+
+        // Reads across each block boundary
+        for (int b = 1; b <= size / blockSize; b++) {
+            const int64 offset = int64(b) * blockSize - 10;
+            const streamsize n = cis.readAt(offset, &buf[0], 20);
+            ok &= checkRange(data, offset, &buf[0], n, min(streamsize(20), streamsize(size - offset)));
+        }
+
+        // Read at the end and past the end of the data
+        ok &= checkRange(data, size - 5, &buf[0], cis.readAt(size - 5, &buf[0], 100), 5);
+        ok &= checkRange(data, size, &buf[0], cis.readAt(size, &buf[0], 100), 0);
+        ok &= checkRange(data, size + 1000, &buf[0], cis.readAt(size + 1000, &buf[0], 100), 0);
+
+        // Seek then read sequentially to the end
+        const int64 pos = 7 * blockSize + 123;
+        cis.seekg(std::streampos(pos));
+
+        if (int64(cis.tellg()) != pos) {
+            cout << "Incorrect position after seek: " << int64(cis.tellg()) << endl;
+            ok = false;
+        }
+
+        vector<byte> rest;
+
+        while (true) {
+            cis.read(&buf[0], 1000);
+
+            if (cis.gcount() <= 0)
+                break;
+
+            rest.insert(rest.end(), reinterpret_cast<byte*>(&buf[0]), reinterpret_cast<byte*>(&buf[size_t(cis.gcount())]));
+        }
+
+        ok &= checkRange(data, pos, reinterpret_cast<char*>(&rest[0]), streamsize(rest.size()), streamsize(size - pos));
+
+        // Seek back to the start
+        cis.seekg(std::streampos(0));
+        cis.read(&buf[0], 2 * blockSize);
+        ok &= checkRange(data, 0, &buf[0], cis.gcount(), 2 * blockSize);
+
+        if (ok == false)
+            res = 1;
+
+        cout << "Random access with " << jobs << " job(s): " << ((ok == true) ? "OK" : "KO") << endl;
+    }
+
+    // Stream without index
+    {
+        params["index"] = "FALSE";
+        const string cdata2 = compress(data, params);
+        stringbuf buffer(cdata2);
+        istream is(&buffer);
+        CompressedInputStream cis(is, 1);
+        char buf[16];
+        bool thrown = false;
+
+        try {
+            cis.readAt(blockSize, buf, 16);
+        }
+        catch (ios_base::failure&) {
+            thrown = true;
+        }
+
+        if (thrown == false)
+            res = 1;
+
+        cout << "No index: " << ((thrown == true) ? "OK" : "KO") << endl;
+    }
+
+    // Corrupted trailer: index type, index position and number of entries
+    for (int c = 0; c < 3; c++) {
+        string cdata2 = cdata;
+
+        if (c == 0)
+            cdata2[cdata2.size() - 1] ^= 0x01;
+        else if (c == 1)
+            cdata2[cdata2.size() - 5] ^= 0x40;
+        else
+            cdata2[cdata2.size() - BlockIndexEntry::TRAILER_SIZE
+                - BlockIndexEntry::ENTRY_SIZE * (size / blockSize + 2) - 4] ^= 0x10;
+
+        stringbuf buffer(cdata2);
+        istream is(&buffer);
+        CompressedInputStream cis(is, 1);
+        char buf[16];
+        bool thrown = false;
+
+        try {
+            cis.readAt(blockSize, buf, 16);
+        }
+        catch (ios_base::failure&) {
+            thrown = true;
+        }
+
+        if (thrown == false)
+            res = 1;
+
+        cout << "Corrupted trailer " << c << ": " << ((thrown == true) ? "OK" : "KO") << endl;
+    }
+
+    return res;
+}
+
+// Small blocks: the intermediate results of the inverse transforms may be
+// larger than the block (EG. the 1 KB header of SRT)
+int testSmallBlocks()
+{
+    cout << endl
+         << "Correctness for small blocks" << endl;
+    const char* pipelines[][2] = {
+        { "TEXT+BWT+SRT+ZRLT", "FPAQ" },
+        { "BWT+SRT+ZRLT", "ANS0" }
+    };
+    const int blockSizes[] = { 1024, 4096, 16384, 65536 };
+    int res = 0;
+
+    for (int p = 0; p < 2; p++) {
+        for (int b = 0; b < 4; b++) {
+            for (int kind = 0; kind <= 4; kind += 4) {
+                vector<byte> data;
+                generateData(data, 3 * blockSizes[b] + 100, kind, uint(b + 1));
+                map<string, string> params;
+                initParameters(params, pipelines[p][0], pipelines[p][1], blockSizes[b], 1);
+                const string cdata = compress(data, params);
+                bool ok = true;
+
+                try {
+                    ok = checkRoundTrip(cdata, data, 1) == 0;
+                }
+                catch (exception& e) {
+                    cout << e.what() << endl;
+                    ok = false;
+                }
+
+                cout << pipelines[p][0] << " & " << pipelines[p][1] << ", blocks of " << blockSizes[b]
+                     << ", data " << kind << ": " << ((ok == true) ? "OK" : "KO") << endl;
+
+                if (ok == false)
+                    res = 1;
+            }
+        }
+    }
+
+    return res;
+}
+
+// The transform and entropy buffers are kept from block to block: each block
+// must compress to the same bits as when it is alone in the stream
+int testBlockBuffers()
+{
+    cout << endl
+         << "Correctness for the buffers kept from block to block" << endl;
+    const char* pipelines[][2] = {
+        { "TEXT+BWT+SRT+ZRLT", "FPAQ" },
+        { "BWT+RANK+ZRLT", "ANS0" },
+        { "LZ", "HUFFMAN" },
+        { "X86+RLT+TEXT", "NONE" }
+    };
+    const int blockSize = 65536;
+    const int kinds[] = { 3, 3, 0, 3, 4, 1, 3 };
+    const int nbBlocks = int(sizeof(kinds) / sizeof(kinds[0]));
+    vector<byte> data;
+
+    for (int i = 0; i < nbBlocks; i++) {
+        vector<byte> block;
+        generateData(block, blockSize, kinds[i], uint(i + 1));
+        data.insert(data.end(), block.begin(), block.end());
+    }
+
+    int res = 0;
+
+    for (int p = 0; p < 4; p++) {
+        map<string, string> params;
+        initParameters(params, pipelines[p][0], pipelines[p][1], blockSize, 1);
+        const string cdata = compress(data, params);
+        vector<BlockInfo> blocks;
+        bool ok = (parseBlocks(cdata, blocks) == true) && (int(blocks.size()) == nbBlocks)
+            && (checkRoundTrip(cdata, data, 1) == 0);
+
+        for (int i = 0; (ok == true) && (i < nbBlocks); i++) {
+            vector<byte> block(data.begin() + i * blockSize, data.begin() + (i + 1) * blockSize);
+            vector<BlockInfo> blocks2;
+            parseBlocks(compress(block, params), blocks2);
+
+            if ((blocks2.size() != 1) || (blocks2[0]._bits != blocks[i]._bits)) {
+                cout << "Block " << i << " depends on the previous blocks" << endl;
+                ok = false;
+            }
+        }
+
+        cout << pipelines[p][0] << " & " << pipelines[p][1] << ": " << ((ok == true) ? "OK" : "KO") << endl;
+
+        if (ok == false)
+            res = 1;
+    }
+
+    return res;
+}
+
+// In auto mode, each block must run the pipeline selected for it (same output
+// as the pipeline given explicitly) and decompress to the original data.
+int testAutoPipeline()
+{
+    cout << endl
+         << "Correctness for the pipelines selected per block" << endl;
+    const int blockSize = 65536;
+    const int kinds[] = { 0, 2, 4, 1, 3, 0 };
+    const int nbBlocks = int(sizeof(kinds) / sizeof(kinds[0]));
+    vector<byte> data;
+
+    for (int i = 0; i < nbBlocks; i++) {
+        vector<byte> block;
+        generateData(block, blockSize, kinds[i], uint(i + 1));
+        data.insert(data.end(), block.begin(), block.end());
+    }
+
+    const int minSpeeds[] = { 1000, 150, 100, 75, 60, 40, 25, 16, 12, 8, 4, 1 };
+    map<string, int> selected;
+    int res = 0;
+
+    for (int s = 0; s < int(sizeof(minSpeeds) / sizeof(minSpeeds[0])); s++) {
+        map<string, string> params;
+        initParameters(params, "NONE", "NONE", blockSize, 1);
+        stringstream ss;
+        ss << minSpeeds[s];
+        params["autoPipeline"] = ss.str();
+        const string cdata = compress(data, params);
+        vector<BlockInfo> blocks;
+        parseBlocks(cdata, blocks);
+        bool ok = (checkRoundTrip(cdata, data, 1) == 0) && (int(blocks.size()) == nbBlocks);
+        PipelineSelector selector(minSpeeds[s]);
+
+        for (int i = 0; (ok == true) && (i < nbBlocks); i++) {
+            uint64 transformType;
+            uint32 entropyType;
+            const bool copy = selector.select(&data[i * blockSize], blockSize, transformType, entropyType) == false;
+
+            if (copy == true) {
+                ok = (blocks[i]._mode & byte(0x80)) != byte(0);
+                continue;
+            }
+
+            const string transform = FunctionFactory<byte>::getName(blocks[i]._transformType);
+            const string codec = EntropyCodecFactory::getName(short(blocks[i]._entropyType));
+
+            if ((blocks[i]._transformType != transformType) || (blocks[i]._entropyType != entropyType)) {
+                cout << "Block " << i << ": unexpected pipeline " << transform << "/" << codec << endl;
+                ok = false;
+                break;
+            }
+
+            selected[transform + "/" + codec]++;
+
+            // Same block with the same pipeline given explicitly
+            map<string, string> params2;
+            initParameters(params2, transform, codec, blockSize, 1);
+            vector<byte> block(data.begin() + i * blockSize, data.begin() + (i + 1) * blockSize);
+            vector<BlockInfo> blocks2;
+            parseBlocks(compress(block, params2), blocks2);
+
+            // The block in auto mode also contains the types (53 bits)
+            if ((blocks2.size() != 1) || (blocks2[0]._bits + 53 != blocks[i]._bits)) {
+                cout << "Block " << i << ": different output in auto mode for " << transform << "/" << codec << endl;
+                ok = false;
+            }
+        }
+
+        if (ok == false)
+            res = 1;
+
+        cout << "Minimum speed " << minSpeeds[s] << ": " << ((ok == true) ? "OK" : "KO") << endl;
+    }
+
+    cout << "Pipelines selected:";
+
+    for (map<string, int>::iterator it = selected.begin(); it != selected.end(); ++it)
+        cout << " " << it->first << " (" << it->second << ")";
+
+    cout << endl;
+
+    // The ROLZX pipelines must be covered
+    if ((selected.find("TEXT+ROLZX/NONE") == selected.end()) || (selected.find("ROLZX/NONE") == selected.end())) {
+        cout << "The ROLZX pipelines were not selected" << endl;
+        res = 1;
+    }
+
+    return res;
+}
+
+// Send the events of a block encoded in 'duration' clock ticks to 'controller'
+static void encodeEvents(SpeedController& controller, int blockId, int64 size, clock_t start, clock_t duration)
+{
+    controller.processEvent(Event(Event::BEFORE_TRANSFORM, blockId, size, start));
+    controller.processEvent(Event(Event::AFTER_TRANSFORM, blockId, size, start + duration / 2));
+    controller.processEvent(Event(Event::AFTER_ENTROPY, blockId, size / 2, start + duration));
+}
+
+// Minimum speed of the pipelines adjusted to the measured encoding speed
+int testSpeedController()
+{
+    cout << endl
+         << "Correctness for the speed controller" << endl;
+    const int64 mb = 1024 * 1024;
+    const clock_t second = CLOCKS_PER_SEC;
+    SpeedController controller(10);
+    clock_t t = 0;
+    int res = 0;
+
+    // Too slow (5 MB/s): the minimum speed goes up, window after window
+    int previous = controller.getMinSpeed();
+
+    for (int i = 0; i < 4; i++) {
+        encodeEvents(controller, i, mb, t, second / 5);
+        t += second / 5;
+
+        if (controller.getMinSpeed() <= previous) {
+            cout << "The minimum speed did not increase: " << controller.getMinSpeed() << endl;
+            res = 1;
+        }
+
+        previous = controller.getMinSpeed();
+    }
+
+    cout << "Minimum speed after slow blocks: " << previous << endl;
+
+    // A window shorter than the measure duration changes nothing
+    encodeEvents(controller, 4, 12 * mb / 100, t, second / 100);
+    t += second / 100;
+
+    // Within the target (12 MB/s): no change
+    for (int i = 5; i < 10; i++) {
+        encodeEvents(controller, i, 12 * mb / 10, t, second / 10);
+        t += second / 10;
+    }
+
+    if (controller.getMinSpeed() != previous) {
+        cout << "The minimum speed changed within the target: " << controller.getMinSpeed() << endl;
+        res = 1;
+    }
+
+    // Blocks in flight completed out of order, events of other stages and
+    // of unknown blocks are ignored
+    controller.processEvent(Event(Event::BEFORE_TRANSFORM, 10, mb, t));
+    controller.processEvent(Event(Event::BEFORE_TRANSFORM, 11, mb, t));
+    controller.processEvent(Event(Event::AFTER_ENTROPY, 99, 100 * mb, t + 1));
+    controller.processEvent(Event(Event::BEFORE_ENTROPY, 11, mb, t + second / 10));
+    controller.processEvent(Event(Event::AFTER_ENTROPY, 11, mb, t + second / 10));
+    controller.processEvent(Event(Event::AFTER_ENTROPY, 10, mb, t + second / 5));
+    t += second / 5;
+
+    if (controller.getMinSpeed() != previous) {
+        cout << "The minimum speed changed at 10 MB/s: " << controller.getMinSpeed() << endl;
+        res = 1;
+    }
+
+    // Much faster (100 MB/s): the minimum speed goes down to 1
+    for (int i = 12; i < 200; i++) {
+        encodeEvents(controller, i, 10 * mb, t, second / 10);
+        t += second / 10;
+    }
+
+    cout << "Minimum speed after fast blocks: " << controller.getMinSpeed() << endl;
+
+    if (controller.getMinSpeed() != 1)
+        res = 1;
+
+    // Far too slow: capped
+    for (int i = 200; i < 300; i++) {
+        encodeEvents(controller, i, mb / 100, t, second);
+        t += second;
+    }
+
+    cout << "Minimum speed after very slow blocks: " << controller.getMinSpeed() << endl;
+
+    if (controller.getMinSpeed() != 1024)
+        res = 1;
+
+    // Round trip with a target speed (the pipelines change during the stream)
+    vector<byte> data;
+
+    for (int i = 0; i < 12; i++) {
+        vector<byte> block;
+        generateData(block, 65536, i % 5, uint(i + 1));
+        data.insert(data.end(), block.begin(), block.end());
+    }
+
+    const int targets[] = { 1, 1000 };
+
+    for (int i = 0; i < 2; i++) {
+        map<string, string> params;
+        initParameters(params, "NONE", "NONE", 65536, 2);
+        stringstream ss;
+        ss << targets[i];
+        params["targetSpeed"] = ss.str();
+        const string cdata = compress(data, params);
+        const bool ok = checkRoundTrip(cdata, data, 2) == 0;
+        cout << "Target speed " << targets[i] << " MB/s: " << cdata.size() << " bytes "
+             << ((ok == true) ? "OK" : "KO") << endl;
+
+        if (ok == false)
+            res = 1;
+    }
+
+    return res;
+}
+
+// Number of blocks in flight and model shrink chosen for a memory limit, round
+// trip of a stream with smaller model tables
+int testMemoryBudget()
+{
+    cout << endl
+         << "Correctness for the memory budget" << endl;
+    const int blockSize = 1024 * 1024;
+    const int64 shared = blockSize + 256 * 1024;
+    const uint64 transformType = FunctionFactory<byte>::getType("X86+RLT+TEXT");
+    const uint32 entropyType = uint32(EntropyCodecFactory::getType("TPAQX"));
+    int64 footprints[MemoryBudget::MAX_MODEL_SHRINK + 1];
+    int res = 0;
+
+    for (int i = 0; i <= MemoryBudget::MAX_MODEL_SHRINK; i++) {
+        footprints[i] = MemoryBudget::getTaskFootprint(blockSize, transformType, entropyType, i);
+
+        // Each step must make the task smaller
+        if ((i > 0) && (footprints[i] >= footprints[i - 1])) {
+            cout << "The footprint does not decrease with the model shrink" << endl;
+            res = 1;
+        }
+    }
+
+    // Throttling: number of tasks for a memory limit
+    struct { int64 limit; int jobs; int expected; } tasks[] = {
+        { shared + 10 * footprints[0], 4, 4 },
+        { shared + 4 * footprints[0], 4, 4 },
+        { shared + 4 * footprints[0] - 1, 4, 3 },
+        { shared + 2 * footprints[0] + footprints[0] / 2, 4, 2 },
+        { shared + footprints[0], 4, 1 },
+        { shared + footprints[0] - 1, 4, 0 },
+        { shared, 1, 0 }
+    };
+
+    for (int i = 0; i < int(sizeof(tasks) / sizeof(tasks[0])); i++) {
+        const int n = MemoryBudget::getMaxTasks(tasks[i].limit, shared, blockSize, transformType,
+            entropyType, false, 0, tasks[i].jobs);
+
+        if (n != tasks[i].expected) {
+            cout << "getMaxTasks(" << tasks[i].limit << "): " << n << " instead of " << tasks[i].expected << endl;
+            res = 1;
+        }
+    }
+
+    // Auto mode assumes the most demanding pipeline (RLT+TPAQ at least)
+    const int64 rltTpaq = MemoryBudget::getTaskFootprint(blockSize, FunctionFactory<byte>::getType("X86+RLT"),
+        uint32(EntropyCodecFactory::getType("TPAQ")), 0);
+
+    if (MemoryBudget::getMinMemory(shared, blockSize, 0, 0, true, 0) < shared + rltTpaq) {
+        cout << "Incorrect footprint in auto mode" << endl;
+        res = 1;
+    }
+
+    // Shrinking: fewer tasks first, then smaller tables for one task
+    struct { int64 limit; int expectedTasks; int expectedShrink; } fits[] = {
+        { shared + 4 * footprints[0], 4, 0 },
+        { shared + 2 * footprints[0], 2, 0 },
+        { shared + footprints[0], 1, 0 },
+        { shared + footprints[1], 1, 1 },
+        { shared + footprints[2] + 1000, 1, 2 },
+        { shared + footprints[3], 1, 3 },
+        { shared + footprints[3] - 1, 0, 0 }
+    };
+
+    for (int i = 0; i < int(sizeof(fits) / sizeof(fits[0])); i++) {
+        int shrink = -1;
+        const int n = MemoryBudget::fit(fits[i].limit, shared, blockSize, transformType,
+            entropyType, false, 4, shrink);
+
+        if ((n != fits[i].expectedTasks) || (shrink != fits[i].expectedShrink)) {
+            cout << "fit(" << fits[i].limit << "): " << n << " task(s) and shrink " << shrink << " instead of "
+                 << fits[i].expectedTasks << " and " << fits[i].expectedShrink << endl;
+            res = 1;
+        }
+    }
+
+    cout << "Memory for one block: " << footprints[0] << " bytes, " << footprints[3] << " with the smallest tables" << endl;
+
+    // Round trip with smaller TPAQ tables (level 8 with a 64 MB limit)
+    vector<byte> data;
+    generateData(data, 3 * blockSize + 1000, 4, 5);
+
+    for (int i = 0; i < 2; i++) {
+        map<string, string> params;
+        initParameters(params, (i == 0) ? "TEXT" : "BWT", (i == 0) ? "TPAQX" : "TPAQ", blockSize, 4);
+        params["memoryLimit"] = "67108864";
+        const string cdata = compress(data, params);
+
+        // The model shrink is in the last 2 bits of the header (131 bits)
+        const int shrink = (uint8(cdata[16]) >> 5) & 0x03;
+        bool ok = (shrink > 0) && (checkRoundTrip(cdata, data, 4) == 0);
+        cout << params["transform"] << "/" << params["codec"] << " with a 64 MB limit: model shrink "
+             << shrink << ", " << cdata.size() << " bytes" << endl;
+
+        // Decoding with a limit too low for one block must fail
+        map<string, string> params2;
+        params2["jobs"] = "4";
+        params2["memoryLimit"] = "1048576";
+        vector<byte> output;
+
+        try {
+            decompress(cdata, params2, output);
+            ok = false;
+        }
+        catch (exception&) {
+        }
+
+        if (ok == false)
+            res = 1;
+
+        cout << ((ok == true) ? "OK" : "KO") << endl;
+    }
+
+    // A limit below the minimum is rejected when encoding
+    {
+        map<string, string> params;
+        initParameters(params, "X86+RLT+TEXT", "TPAQX", blockSize, 4);
+        params["memoryLimit"] = "20971520";
+        bool thrown = false;
+
+        try {
+            compress(data, params);
+        }
+        catch (invalid_argument& e) {
+            cout << e.what() << endl;
+            thrown = true;
+        }
+
+        if (thrown == false)
+            res = 1;
+    }
+
+    return res;
+}
+
+// Tables allocated with each page mode, same streams whatever the mode
+int testAllocator()
+{
+    cout << endl
+         << "Correctness for the page allocators" << endl;
+    const char* names[] = { "NORMAL", "THP", "HUGE" };
+    const size_t sizes[] = { 1000, size_t(2) << 20, (size_t(2) << 20) + 1, (size_t(9) << 20) + 123 };
+    int res = 0;
+
+    if ((Allocator::getType("normal") != Allocator::NORMAL_PAGES) || (Allocator::getType("Thp") != Allocator::TRANSPARENT_HUGE_PAGES)
+        || (Allocator::getType("HUGE") != Allocator::HUGE_PAGES) || (Allocator::getType("BIG") != -1)) {
+        cout << "Incorrect page mode names" << endl;
+        res = 1;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        map<string, string> params;
+        params["pages"] = names[i];
+        Context ctx(params);
+        Allocator& allocator = Allocator::getAllocator(&ctx);
+        bool ok = &allocator == &Allocator::getAllocator(Allocator::getType(names[i]));
+
+        for (int j = 0; j < 4; j++) {
+            uint8* p = allocator.newArray<uint8>(sizes[j]);
+
+#if defined(__linux__)
+            // Mappings are aligned on huge pages (2 MB)
+            if ((i > 0) && (sizes[j] >= (size_t(2) << 20)) && ((size_t(p) & ((size_t(2) << 20) - 1)) != 0))
+                ok = false;
+#endif
+
+            for (size_t k = 0; k < sizes[j]; k++)
+                p[k] = uint8(k * 31);
+
+            for (size_t k = 0; k < sizes[j]; k += 4093)
+                ok &= p[k] == uint8(k * 31);
+
+            ok &= p[sizes[j] - 1] == uint8((sizes[j] - 1) * 31);
+            allocator.deleteArray(p, sizes[j]);
+        }
+
+        cout << "Allocations with " << names[i] << " pages: " << ((ok == true) ? "OK" : "KO") << endl;
+
+        if (ok == false)
+            res = 1;
+    }
+
+    // Missing or unknown mode: heap
+    Context ctx;
+
+    if (&Allocator::getAllocator(&ctx) != &Allocator::getAllocator(Allocator::NORMAL_PAGES)) {
+        cout << "Incorrect default allocator" << endl;
+        res = 1;
+    }
+
+    // The big tables of BWT, ROLZ and TPAQ use the allocator
+    vector<byte> data;
+    generateData(data, 5 * 1024 * 1024 + 100, 4, 11);
+    const char* transforms[] = { "BWT", "ROLZX", "TEXT" };
+    const char* codecs[] = { "FPAQ", "NONE", "TPAQ" };
+
+    for (int i = 0; i < 3; i++) {
+        string cdata0;
+
+        for (int j = 0; j < 3; j++) {
+            map<string, string> params;
+            initParameters(params, transforms[i], codecs[i], 4 * 1024 * 1024, 2);
+            params["pages"] = names[j];
+            const string cdata = compress(data, params);
+
+            // Decode with the same page mode
+            map<string, string> params2;
+            params2["jobs"] = "2";
+            params2["pages"] = names[j];
+            vector<byte> data2;
+            decompress(cdata, params2, data2);
+            bool ok = data2 == data;
+
+            if (j == 0)
+                cdata0 = cdata;
+            else
+                ok &= cdata == cdata0;
+
+            cout << transforms[i] << "/" << codecs[i] << " with " << names[j] << " pages: "
+                 << ((ok == true) ? "OK" : "KO") << endl;
+
+            if (ok == false)
+                res = 1;
+        }
+    }
+
+    return res;
+}
+
+#ifdef __GNUG__
+int main(int argc, const char* argv[])
+#else
+int TestCompressedStream_main(int argc, const char* argv[])
+#endif
+{
+    string str;
+
+    if (argc == 1) {
+        str = "-TYPE=ALL";
+    }
+    else {
+        str = argv[1];
+    }
+
+    transform(str.begin(), str.end(), str.begin(), ::toupper);
+    int res = 0;
+
+    try {
+        if (str.compare(0, 6, "-TYPE=") == 0) {
+            str = str.substr(6);
+
+            if ((str == "ALL") || (str == "SIZES")) {
+                cout << endl
+                     << endl
+                     << "TestBlockSizes" << endl;
+                res |= testBlockSizes();
+            }
+
+            if ((str == "ALL") || (str == "LEGACY")) {
+                cout << endl
+                     << endl
+                     << "TestLegacyStreams" << endl;
+                res |= testLegacyStreams();
+            }
+
+            if ((str == "ALL") || (str == "BLOCKS")) {
+                cout << endl
+                     << endl
+                     << "TestConcurrentBlocks" << endl;
+                res |= testConcurrentBlocks();
+            }
+
+            if ((str == "ALL") || (str == "THREADPOOL")) {
+                cout << endl
+                     << endl
+                     << "TestThreadPool" << endl;
+                res |= testThreadPool();
+            }
+
+            if ((str == "ALL") || (str == "WINDOW")) {
+                cout << endl
+                     << endl
+                     << "TestSlidingWindow" << endl;
+                res |= testSlidingWindow();
+            }
+
+            if ((str == "ALL") || (str == "INDEX")) {
+                cout << endl
+                     << endl
+                     << "TestBlockIndex" << endl;
+                res |= testBlockIndex();
+            }
+
+            if ((str == "ALL") || (str == "SMALL")) {
+                cout << endl
+                     << endl
+                     << "TestSmallBlocks" << endl;
+                res |= testSmallBlocks();
+            }
+
+            if ((str == "ALL") || (str == "BUFFERS")) {
+                cout << endl
+                     << endl
+                     << "TestBlockBuffers" << endl;
+                res |= testBlockBuffers();
+            }
+
+            if ((str == "ALL") || (str == "AUTO")) {
+                cout << endl
+                     << endl
+                     << "TestAutoPipeline" << endl;
+                res |= testAutoPipeline();
+            }
+
+            if ((str == "ALL") || (str == "SPEED")) {
+                cout << endl
+                     << endl
+                     << "TestSpeedController" << endl;
+                res |= testSpeedController();
+            }
+
+            if ((str == "ALL") || (str == "MEMORY")) {
+                cout << endl
+                     << endl
+                     << "TestMemoryBudget" << endl;
+                res |= testMemoryBudget();
+            }
+
+            if ((str == "ALL") || (str == "PAGES")) {
+                cout << endl
+                     << endl
+                     << "TestAllocator" << endl;
+                res |= testAllocator();
+            }
+        }
+    }
+    catch (exception& e) {
+        cout << e.what() << endl;
+        res = 1;
+    }
+
+    cout << endl << ((res == 0) ? "Success" : "Failure") << endl;
+    return res;
+}
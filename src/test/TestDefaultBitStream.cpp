@@ -256,6 +256,50 @@ int testBitStreamCorrectnessMisaligned1()
     return res;
 }
 
+// Close a bitstream whose last bits fill the buffer (or leave it one word
+// short): the stream must contain exactly the bits written.
+int testBitStreamClose()
+{
+    cout << endl
+         << "Correctness Test - close with a full buffer" << endl;
+    const int bufferSize = 1024;
+    int res = 0;
+
+    for (int length = 8 * (bufferSize - 24); length <= 8 * (bufferSize + 24); length += 3) {
+        stringbuf buffer;
+        iostream ios(&buffer);
+        DefaultOutputBitStream obs(ios, bufferSize);
+
+        for (int i = 0; i < length; i += 13)
+            obs.writeBits(uint64(i * 0x9E3779B1U), min(13, length - i));
+
+        obs.close();
+
+        if (buffer.str().size() != size_t((length + 7) >> 3)) {
+            cout << "Incorrect size for " << length << " bits: " << buffer.str().size() << endl;
+            res = 1;
+            continue;
+        }
+
+        ios.rdbuf()->pubseekpos(0);
+        DefaultInputBitStream ibs(ios, bufferSize);
+        bool ok = true;
+
+        for (int i = 0; i < length; i += 13) {
+            const int n = min(13, length - i);
+            ok &= ibs.readBits(n) == (uint64(i * 0x9E3779B1U) & ((uint64(1) << n) - 1));
+        }
+
+        if (ok == false) {
+            cout << "Incorrect data for " << length << " bits" << endl;
+            res = 1;
+        }
+    }
+
+    cout << ((res == 0) ? "Success" : "Failure") << endl;
+    return res;
+}
+
 int testBitStreamSpeed1(const string& fileName)
 {
     // Test speed
@@ -555,6 +599,7 @@ int TestDefaultBitStream_main(int argc, const char* argv[])
     res |= testBitStreamCorrectnessAligned2();
     res |= testBitStreamCorrectnessMisaligned1();
     res |= testBitStreamCorrectnessMisaligned2();
+    res |= testBitStreamClose();
 
     string fileName;
     fileName = (argc > 1) ? argv[1] :  "r:\\output.bin";
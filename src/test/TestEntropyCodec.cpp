@@ -19,10 +19,13 @@ limitations under the License.
 #include <cstdio>
 #include <cstdlib>
 #include <algorithm>
+#include <sstream>
+#include <vector>
 #include "../types.hpp"
 #include "../entropy/HuffmanEncoder.hpp"
 #include "../entropy/RangeEncoder.hpp"
 #include "../entropy/ANSRangeEncoder.hpp"
+#include "../entropy/FSEEncoder.hpp"
 #include "../entropy/BinaryEntropyEncoder.hpp"
 #include "../entropy/ExpGolombEncoder.hpp"
 #include "../entropy/RiceGolombEncoder.hpp"
@@ -33,12 +36,16 @@ limitations under the License.
 #include "../entropy/HuffmanDecoder.hpp"
 #include "../entropy/RangeDecoder.hpp"
 #include "../entropy/ANSRangeDecoder.hpp"
+#include "../entropy/FSEDecoder.hpp"
 #include "../entropy/BinaryEntropyDecoder.hpp"
 #include "../entropy/ExpGolombDecoder.hpp"
 #include "../entropy/RiceGolombDecoder.hpp"
 #include "../entropy/FPAQPredictor.hpp"
 #include "../entropy/CMPredictor.hpp"
 #include "../entropy/TPAQPredictor.hpp"
+#include "../entropy/EntropyCodecFactory.hpp"
+#include "../entropy/EntropyUtils.hpp"
+#include "../util.hpp"
 
 using namespace kanzi;
 
@@ -64,15 +71,30 @@ static EntropyEncoder* getEncoder(string name, OutputBitStream& obs, Predictor*
     if (name.compare("HUFFMAN") == 0)
         return new HuffmanEncoder(obs);
 
+    if (name.compare("HUFFMANX") == 0)
+        return new HuffmanEncoder(obs, HuffmanCommon::MAX_CHUNK_SIZE, true);
+
     if (name.compare("ANS0") == 0)
         return new ANSRangeEncoder(obs, 0);
 
     if (name.compare("ANS1") == 0)
         return new ANSRangeEncoder(obs, 1);
 
+    if (name.compare("ANS0X") == 0)
+        return new ANSRangeEncoder(obs, 0, -1, ANSRangeEncoder::DEFAULT_LOG_RANGE, ANSRangeEncoder::DEFAULT_INTERLEAVED_STATES);
+
+    if (name.compare("ANS1X") == 0)
+        return new ANSRangeEncoder(obs, 1, -1, ANSRangeEncoder::DEFAULT_LOG_RANGE, ANSRangeEncoder::DEFAULT_INTERLEAVED_STATES);
+
     if (name.compare("RANGE") == 0)
         return new RangeEncoder(obs);
 
+    if (name.compare("RANGEX") == 0)
+        return new RangeEncoder(obs, RangeEncoder::DEFAULT_CHUNK_SIZE, RangeEncoder::DEFAULT_LOG_RANGE, true);
+
+    if (name.compare("FSE") == 0)
+        return new FSEEncoder(obs);
+
     if (name.compare("EXPGOLOMB") == 0)
         return new ExpGolombEncoder(obs);
 
@@ -99,15 +121,30 @@ static EntropyDecoder* getDecoder(string name, InputBitStream& ibs, Predictor* p
     if (name.compare("HUFFMAN") == 0)
         return new HuffmanDecoder(ibs);
 
+    if (name.compare("HUFFMANX") == 0)
+        return new HuffmanDecoder(ibs, HuffmanCommon::MAX_CHUNK_SIZE, true);
+
     if (name.compare("ANS0") == 0)
         return new ANSRangeDecoder(ibs, 0);
 
     if (name.compare("ANS1") == 0)
         return new ANSRangeDecoder(ibs, 1);
 
+    if (name.compare("ANS0X") == 0)
+        return new ANSRangeDecoder(ibs, 0, -1, true);
+
+    if (name.compare("ANS1X") == 0)
+        return new ANSRangeDecoder(ibs, 1, -1, true);
+
     if (name.compare("RANGE") == 0)
         return new RangeDecoder(ibs);
 
+    if (name.compare("RANGEX") == 0)
+        return new RangeDecoder(ibs, RangeDecoder::DEFAULT_CHUNK_SIZE, true);
+
+    if (name.compare("FSE") == 0)
+        return new FSEDecoder(ibs);
+
     if (name.compare("TPAQ") == 0)
         return new BinaryEntropyDecoder(ibs, predictor, false);
 
@@ -226,6 +263,471 @@ int testEntropyCodecCorrectness(const string& name)
     return res;
 }
 
+static string encodeBlock(Context& ctx, short type, byte* block, int size, Predictor** predictor)
+{
+    stringbuf buffer;
+    iostream ios(&buffer);
+    DefaultOutputBitStream obs(ios);
+    EntropyEncoder* ec = EntropyCodecFactory::newEncoder(obs, ctx, type, predictor);
+    ec->encode(block, 0, size);
+    ec->dispose();
+    delete ec;
+    obs.close();
+    return buffer.str();
+}
+
+// A predictor reused from block to block (after a reset) must produce the
+// same bitstream as a new predictor for each block
+int testPredictorReuse(const string& name)
+{
+    const short type = EntropyCodecFactory::getType(name.c_str());
+
+    if ((type != EntropyCodecFactory::FPAQ_TYPE) && (type != EntropyCodecFactory::CM_TYPE)
+        && (type != EntropyCodecFactory::TPAQ_TYPE) && (type != EntropyCodecFactory::TPAQX_TYPE))
+        return 0;
+
+    cout << endl
+         << "Predictor reuse test for " << name << endl;
+    const char* words[] = { "the ", "block ", "predictor ", "is ", "reused ", "for ", "each ", "new ", "data ", "0123 " };
+    const int maxSize = 40000;
+    vector<byte> data;
+    srand(54321);
+
+    while (data.size() < size_t(maxSize)) {
+        if ((rand() & 7) == 0) {
+            // Binary data with runs of 0 (as in the cleared model buffer)
+            data.insert(data.end(), size_t(1 + (rand() & 7)), byte(0));
+            data.push_back(byte(rand()));
+            continue;
+        }
+
+        const char* w = words[rand() % 10];
+        data.insert(data.end(), reinterpret_cast<const byte*>(w), reinterpret_cast<const byte*>(w) + strlen(w));
+    }
+
+    map<string, string> params;
+    params["blockSize"] = "65536";
+    Context ctx(params);
+    Predictor* reused = nullptr;
+    Predictor* decReused = nullptr;
+    vector<byte> output(maxSize);
+    int res = 0;
+
+    // More blocks than needed to wrap the TPAQ hash positions
+    for (int n = 0; n < 24; n++) {
+        const int size = 100 + (n * 7919) % (maxSize - 100);
+        const int start = (n * 104729) % (maxSize - size + 1);
+        ctx.putInt("size", size);
+        const string cdata1 = encodeBlock(ctx, type, &data[start], size, &reused);
+        const string cdata2 = encodeBlock(ctx, type, &data[start], size, nullptr);
+
+        if (cdata1 != cdata2) {
+            cout << "Block " << n << ": different output with a reused predictor" << endl;
+            res = 1;
+            continue;
+        }
+
+        stringbuf buffer(cdata1);
+        iostream ios(&buffer);
+        DefaultInputBitStream ibs(ios);
+        EntropyDecoder* ed = EntropyCodecFactory::newDecoder(ibs, ctx, type, &decReused);
+        ed->decode(&output[0], 0, size);
+        ed->dispose();
+        delete ed;
+
+        if (memcmp(&output[0], &data[start], size) != 0) {
+            cout << "Block " << n << ": incorrect data decoded with a reused predictor" << endl;
+            res = 1;
+        }
+    }
+
+    delete reused;
+    delete decReused;
+    cout << ((res == 0) ? "Identical" : "Different") << endl;
+    return res;
+}
+
+// Decode from memory (chunks decoded in place) or from a stringbuf (chunks
+// decoded from a copy)
+static bool decodeBlock(Context& ctx, short type, const string& cdata, byte* block, int size, bool inPlace = true)
+{
+    string copy(cdata);
+    istreambuf<char> mem(&copy[0], streamsize(copy.size()));
+    stringbuf buffer(cdata);
+    istream is((inPlace == true) ? static_cast<streambuf*>(&mem) : static_cast<streambuf*>(&buffer));
+    DefaultInputBitStream ibs(is);
+    vector<byte> output(size + 1);
+    EntropyDecoder* ed = EntropyCodecFactory::newDecoder(ibs, ctx, type);
+    bool res = false;
+
+    try {
+        res = (ed->decode(&output[0], 0, size) == size) && (memcmp(&output[0], block, size) == 0);
+    }
+    catch (exception& e) {
+        cout << e.what() << endl;
+    }
+
+    ed->dispose();
+    delete ed;
+
+    // All the block must have been read
+    if ((res == true) && (((ibs.read() + 7) >> 3) != cdata.size())) {
+        cout << "Incorrect number of bits read: " << ibs.read() << endl;
+        res = false;
+    }
+
+    return res;
+}
+
+// Blocks with several chunks use the chunked layout when encoded with several
+// jobs (whatever the number) and the sequential layout with a single job. The
+// sequential layout without flag (jobs = 0, bitstream version < 12) must still
+// decode
+int testChunkedLayout(const string& name)
+{
+    const short type = EntropyCodecFactory::getType(name.c_str());
+
+    if ((type == EntropyCodecFactory::NONE_TYPE) || (type == EntropyCodecFactory::FPAQ_TYPE)
+        || (type == EntropyCodecFactory::CM_TYPE) || (type == EntropyCodecFactory::TPAQ_TYPE)
+        || (type == EntropyCodecFactory::TPAQX_TYPE))
+        return 0;
+
+    cout << endl
+         << "Chunked layout test for " << name << endl;
+    const int maxSize = 9000000; // several chunks of 8 MB (ANS1)
+    vector<byte> data(maxSize);
+    srand(12345);
+
+    // Statistics changing from chunk to chunk
+    for (int i = 0; i < maxSize; i++)
+        data[i] = byte(((i >> 14) & 0x3F) + (rand() % (1 + ((i >> 12) & 0x7F))));
+
+    // A block smaller than one chunk, a few chunks, many chunks
+    const int sizes[] = { 1000, 200000, maxSize - 100000 };
+    int res = 0;
+
+    for (int n = 0; n < 3; n++) {
+        const int size = sizes[n];
+        byte* block = &data[maxSize - size];
+        map<string, string> params;
+        params["jobs"] = "1";
+        Context ctx(params);
+        const string cdata1 = encodeBlock(ctx, type, block, size, nullptr);
+        ctx.putInt("jobs", 2);
+        const string cdata2 = encodeBlock(ctx, type, block, size, nullptr);
+        ctx.putInt("jobs", 4);
+        const string cdata4 = encodeBlock(ctx, type, block, size, nullptr);
+        ctx.putInt("jobs", 0);
+        const string cdata0 = encodeBlock(ctx, type, block, size, nullptr);
+        bool ok = true;
+
+        if (cdata2 != cdata4) {
+            cout << "Different output with 2 and 4 jobs" << endl;
+            ok = false;
+        }
+
+        // A block smaller than one chunk has no layout flag
+        if ((n == 0) && ((cdata1 != cdata4) || (cdata1 != cdata0))) {
+            cout << "Different output for a single chunk" << endl;
+            ok = false;
+        }
+
+        // The biggest block has several chunks for all codecs
+        if ((n == 2) && ((cdata1 == cdata4) || (cdata1 == cdata0))) {
+            cout << "Incorrect layout for several chunks" << endl;
+            ok = false;
+        }
+
+        // Decode both layouts with 1 and 3 jobs, the chunked layout also from
+        // a copy of the chunks
+        ctx.putInt("bsVersion", 12);
+        ctx.putInt("jobs", 1);
+        ok &= decodeBlock(ctx, type, cdata4, block, size);
+        ok &= decodeBlock(ctx, type, cdata1, block, size);
+        ctx.putInt("jobs", 3);
+        ok &= decodeBlock(ctx, type, cdata4, block, size);
+        ok &= decodeBlock(ctx, type, cdata4, block, size, false);
+        ok &= decodeBlock(ctx, type, cdata1, block, size);
+
+        // Truncated chunks must be reported, not read out of bounds
+        if ((n == 2) && (decodeBlock(ctx, type, cdata4.substr(0, cdata4.size() / 2), block, size) == true)) {
+            cout << "Truncated chunks decoded" << endl;
+            ok = false;
+        }
+
+        // Decode the sequential layout as in a stream of version 11
+        ctx.putInt("bsVersion", 11);
+        ok &= decodeBlock(ctx, type, cdata0, block, size);
+
+        cout << size << " bytes: " << cdata4.size() << " bytes (chunked), " << cdata1.size()
+             << " bytes (sequential) => " << ((ok == true) ? "OK" : "KO") << endl;
+
+        if (ok == false)
+            res = 1;
+    }
+
+    return res;
+}
+
+// Interleaved ANS with all the numbers of states (the decoder has SIMD lanes
+// for order 0 from 8 states on)
+int testANSLanes()
+{
+    cout << endl
+         << "Interleaved states test for ANS" << endl;
+    const int maxSize = 300000;
+    vector<byte> data(maxSize);
+    vector<byte> output(maxSize);
+    srand(24680);
+
+    // Skewed statistics and a tail of symbols not multiple of the number of states
+    for (int i = 0; i < maxSize; i++)
+        data[i] = byte(((rand() & 7) == 0) ? rand() : (rand() & 3));
+
+    const int sizes[] = { 7, 1000, maxSize - 13 };
+    const int states[] = { 4, 8, 16, 32 };
+    int res = 0;
+
+    for (int order = 0; order < 2; order++) {
+        for (int s = 0; s < 4; s++) {
+            bool ok = true;
+
+            for (int n = 0; n < 3; n++) {
+                const int size = sizes[n];
+                stringbuf buffer;
+                iostream ios(&buffer);
+                DefaultOutputBitStream obs(ios);
+                ANSRangeEncoder enc(obs, order, -1, ANSRangeEncoder::DEFAULT_LOG_RANGE, states[s]);
+                enc.encode(&data[0], 0, size);
+                enc.dispose();
+                obs.close();
+                ios.rdbuf()->pubseekpos(0);
+                DefaultInputBitStream ibs(ios);
+                ANSRangeDecoder dec(ibs, order, -1, true);
+                memset(&output[0], 0, size);
+                ok &= dec.decode(&output[0], 0, size) == size;
+                dec.dispose();
+                ok &= memcmp(&output[0], &data[0], size) == 0;
+            }
+
+            cout << "Order " << order << ", " << states[s] << " states => "
+                 << ((ok == true) ? "OK" : "KO") << endl;
+
+            if (ok == false)
+                res = 1;
+        }
+    }
+
+    return res;
+}
+
+// Corrupted streams must be decoded (garbage) or rejected with an exception,
+// but never make the decoder hang or read outside of its tables
+int testCorruptedStream(const string& name)
+{
+    cout << endl
+         << "Corrupted stream test for " << name << endl;
+    const short type = EntropyCodecFactory::getType(name.c_str());
+    const int size = 200000;
+    vector<byte> data(size);
+    vector<byte> output(size);
+    srand(13579);
+
+    for (int i = 0; i < size; i++)
+        data[i] = byte(((rand() & 3) == 0) ? rand() : 64 + (rand() & 15));
+
+    map<string, string> params;
+    params["jobs"] = "1";
+    Context ctx(params);
+    const string cdata = encodeBlock(ctx, type, &data[0], size, nullptr);
+    int rejected = 0;
+
+    for (int n = 0; n < 200; n++) {
+        string corrupted(cdata);
+
+        // Keep the header of the first chunk, alter the code afterwards
+        for (int k = 0; k < 1 + (n & 7); k++)
+            corrupted[64 + rand() % (corrupted.size() - 64)] ^= char(1 + (rand() & 0xFE));
+
+        stringbuf buffer(corrupted);
+        iostream ios(&buffer);
+        DefaultInputBitStream ibs(ios);
+        EntropyDecoder* ed = EntropyCodecFactory::newDecoder(ibs, ctx, type);
+
+        try {
+            ed->decode(&output[0], 0, size);
+        }
+        catch (exception&) {
+            rejected++;
+        }
+
+        ed->dispose();
+        delete ed;
+    }
+
+    cout << "200 corrupted streams: " << rejected << " rejected, " << (200 - rejected) << " decoded => OK" << endl;
+    return 0;
+}
+
+// Order 0 and order 1 histograms (with and without totals) must match a
+// simple count, and the entropy estimation must match the histogram
+int testHistogram()
+{
+    cout << endl
+         << "Correctness for the histograms" << endl;
+    const int maxSize = 1 << 22;
+    vector<byte> data(maxSize);
+    vector<uint> freqs(256 * 257);
+    vector<uint> ref(256 * 257);
+    srand(2468);
+    int res = 0;
+
+    for (int n = 0; n < 4; n++) {
+        // Random, runs, text like, single symbol
+        for (int i = 0; i < maxSize; i++) {
+            if (n == 0)
+                data[i] = byte(rand());
+            else if (n == 1)
+                data[i] = ((rand() & 7) == 0) ? byte(rand() & 0x0F) : data[(i > 0) ? i - 1 : 0];
+            else if (n == 2)
+                data[i] = byte(32 + (rand() % (1 + (rand() % 95))));
+            else
+                data[i] = byte(0xAA);
+        }
+
+        // Sizes not multiple of 8 for the tails
+        const int sizes[] = { 0, 1, 7, 9, 1000, 65537, maxSize - 3 };
+
+        for (int s = 0; s < 7; s++) {
+            const int size = sizes[s];
+
+            for (int mode = 0; mode < 4; mode++) {
+                const bool isOrder0 = (mode & 1) == 0;
+                const bool withTotal = (mode & 2) != 0;
+                const int mult = (withTotal == true) ? 257 : 256;
+                std::fill(ref.begin(), ref.end(), 0);
+                std::fill(freqs.begin(), freqs.end(), 0xFFFFFFFF);
+                int prv = 0;
+
+                for (int i = 0; i < size; i++) {
+                    const int c = int(uint8(data[i]));
+
+                    if (isOrder0 == true) {
+                        ref[c]++;
+                    }
+                    else {
+                        ref[prv + c]++;
+                        ref[prv + 256] += (withTotal == true) ? 1 : 0;
+                        prv = mult * c;
+                    }
+                }
+
+                if ((isOrder0 == true) && (withTotal == true))
+                    ref[256] = size;
+
+                const int count = (isOrder0 == true) ? mult : 256 * mult;
+                Global::computeHistogram(&data[0], size, &freqs[0], isOrder0, withTotal);
+
+                if (memcmp(&freqs[0], &ref[0], count * sizeof(uint)) != 0) {
+                    cout << "Incorrect " << ((isOrder0 == true) ? "order 0" : "order 1")
+                         << " histogram " << ((withTotal == true) ? "with" : "without")
+                         << " totals for data " << n << " and size " << size << endl;
+                    res = 1;
+                }
+            }
+        }
+
+        uint histo[256];
+        const int entropy = EntropyUtils::computeFirstOrderEntropy1024(&data[0], maxSize, histo);
+        const bool ok = (n == 3) ? (entropy == 0) : ((n == 0) ? (entropy > 1010) : (entropy < 1000));
+        cout << "Data " << n << ": entropy " << entropy << "/1024 " << ((ok == true) ? "OK" : "KO") << endl;
+
+        if (ok == false)
+            res = 1;
+    }
+
+    // Speed (random data)
+    for (int i = 0; i < maxSize; i++)
+        data[i] = byte(rand());
+
+    for (int order = 0; order < 2; order++) {
+        const int iter = 50;
+        clock_t before = clock();
+
+        for (int ii = 0; ii < iter; ii++)
+            Global::computeHistogram(&data[0], maxSize, &freqs[0], order == 0, true);
+
+        clock_t after = clock();
+        const double delta = double(after - before) / CLOCKS_PER_SEC * 1000.0;
+
+        if (delta > 0)
+            cout << "Order " << order << " histogram: " << (int)((double)iter * maxSize / 1024 / 1024 / (delta / 1000)) << " MB/s" << endl;
+    }
+
+    return res;
+}
+
+// Classes of blocks from samples: incompressible (copy), entropy only (skip
+// the transforms) or compressible
+int testClassifyBlock()
+{
+    cout << endl
+         << "Correctness for the block classes" << endl;
+    const int maxSize = 4 * 1024 * 1024;
+    vector<byte> data(maxSize);
+    const char* names[] = { "text", "random", "random repeated", "169 symbols", "169 symbols repeated" };
+    const int expected[] = { EntropyUtils::BLOCK_COMPRESSIBLE, EntropyUtils::BLOCK_INCOMPRESSIBLE,
+        EntropyUtils::BLOCK_COMPRESSIBLE, EntropyUtils::BLOCK_ENTROPY_ONLY, EntropyUtils::BLOCK_COMPRESSIBLE };
+    const char* words[] = { "the ", "block ", "is ", "sampled ", "before ", "the ", "transforms ", "\n" };
+    srand(97);
+    int res = 0;
+
+    // Blocks sampled entirely (100 KB) or partially (4 MB)
+    for (int size = 100000; size <= maxSize; size = maxSize) {
+        for (int n = 0; n < 5; n++) {
+            for (int i = 0; i < size; ) {
+                if (n == 0) {
+                    for (const char* w = words[rand() & 7]; (*w != 0) && (i < size); w++)
+                        data[i++] = byte(*w);
+
+                    continue;
+                }
+
+                // Repeated: the same data again and again. The repeats of a
+                // block sampled entirely must be within the reach of the hash
+                // table (4096 positions).
+                const int period = (size < maxSize) ? 2048 : 32768;
+
+                if (((n == 2) || (n == 4)) && (i >= period))
+                    data[i] = data[i - period];
+                else
+                    data[i] = (n <= 2) ? byte(rand()) : byte(rand() % 169);
+
+                i++;
+            }
+
+            const int blockClass = EntropyUtils::classifyBlock(&data[0], size);
+            const bool ok = blockClass == expected[n];
+            cout << size << " bytes of " << names[n] << ": class " << blockClass << " "
+                 << ((ok == true) ? "OK" : "KO") << endl;
+
+            if (ok == false)
+                res = 1;
+        }
+
+        if (size == maxSize)
+            break;
+    }
+
+    // Blocks too small to classify
+    if (EntropyUtils::classifyBlock(&data[0], 3) != EntropyUtils::BLOCK_COMPRESSIBLE) {
+        cout << "Incorrect class for a block of 3 bytes" << endl;
+        res = 1;
+    }
+
+    return res;
+}
+
 int testEntropyCodecSpeed(const string& name)
 {
     // Test speed
@@ -365,39 +867,87 @@ int TestEntropyCodec_main(int argc, const char* argv[])
             str = str.substr(6);
 
             if (str.compare("ALL") == 0) {
+                cout << endl
+                     << endl
+                     << "TestHistogram" << endl;
+                res |= testHistogram();
+                cout << endl
+                     << endl
+                     << "TestClassifyBlock" << endl;
+                res |= testClassifyBlock();
                 cout << endl
                      << endl
                      << "TestHuffmanCodec" << endl;
                 res |= testEntropyCodecCorrectness("HUFFMAN");
+                res |= testChunkedLayout("HUFFMAN");
                 res |= testEntropyCodecSpeed("HUFFMAN");
+                cout << endl
+                     << endl
+                     << "TestHuffmanXCodec" << endl;
+                res |= testEntropyCodecCorrectness("HUFFMANX");
+                res |= testChunkedLayout("HUFFMANX");
+                res |= testEntropyCodecSpeed("HUFFMANX");
                 cout << endl
                      << endl
                      << "TestANS0Codec" << endl;
                 res |= testEntropyCodecCorrectness("ANS0");
+                res |= testChunkedLayout("ANS0");
                 res |= testEntropyCodecSpeed("ANS0");
                 cout << endl
                      << endl
                      << "TestANS1Codec" << endl;
                 res |= testEntropyCodecCorrectness("ANS1");
+                res |= testChunkedLayout("ANS1");
                 res |= testEntropyCodecSpeed("ANS1");
+                cout << endl
+                     << endl
+                     << "TestANS0XCodec" << endl;
+                res |= testEntropyCodecCorrectness("ANS0X");
+                res |= testChunkedLayout("ANS0X");
+                res |= testEntropyCodecSpeed("ANS0X");
+                cout << endl
+                     << endl
+                     << "TestANS1XCodec" << endl;
+                res |= testEntropyCodecCorrectness("ANS1X");
+                res |= testChunkedLayout("ANS1X");
+                res |= testEntropyCodecSpeed("ANS1X");
+                res |= testANSLanes();
                 cout << endl
                      << endl
                      << "TestRangeCodec" << endl;
                 res |= testEntropyCodecCorrectness("RANGE");
+                res |= testChunkedLayout("RANGE");
+                res |= testCorruptedStream("RANGE");
                 res |= testEntropyCodecSpeed("RANGE");
+                cout << endl
+                     << endl
+                     << "TestRangeXCodec" << endl;
+                res |= testEntropyCodecCorrectness("RANGEX");
+                res |= testChunkedLayout("RANGEX");
+                res |= testCorruptedStream("RANGEX");
+                res |= testEntropyCodecSpeed("RANGEX");
+                cout << endl
+                     << endl
+                     << "TestFSECodec" << endl;
+                res |= testEntropyCodecCorrectness("FSE");
+                res |= testChunkedLayout("FSE");
+                res |= testEntropyCodecSpeed("FSE");
                 cout << endl
                      << endl
                      << "TestFPAQCodec" << endl;
+                res |= testPredictorReuse("FPAQ");
                 res |= testEntropyCodecCorrectness("FPAQ");
                 res |= testEntropyCodecSpeed("FPAQ");
                 cout << endl
                      << endl
                      << "TestCMCodec" << endl;
+                res |= testPredictorReuse("CM");
                 res |= testEntropyCodecCorrectness("CM");
                 res |= testEntropyCodecSpeed("CM");
                 cout << endl
                      << endl
                      << "TestTPAQCodec" << endl;
+                res |= testPredictorReuse("TPAQ");
                 res |= testEntropyCodecCorrectness("TPAQ");
                 res |= testEntropyCodecSpeed("TPAQ");
                 cout << endl
@@ -411,10 +961,28 @@ int TestEntropyCodec_main(int argc, const char* argv[])
                 res |= testEntropyCodecCorrectness("RICEGOLOMB");
                 res |= testEntropyCodecSpeed("RICEGOLOMB");
             }
+            else if (str.compare("CLASSIFY") == 0) {
+                cout << "TestClassifyBlock" << endl;
+                res |= testClassifyBlock();
+            }
+            else if (str.compare("ANSLANES") == 0) {
+                cout << "TestANSLanes" << endl;
+                res |= testANSLanes();
+            }
+            else if (str.compare("HISTOGRAM") == 0) {
+                cout << "TestHistogram" << endl;
+                res |= testHistogram();
+            }
             else {
                 cout << endl
                      << endl
                      << "Test" << str << "EntropyCodec" << endl;
+                res |= testPredictorReuse(str);
+                res |= testChunkedLayout(str);
+
+                if ((str.compare("RANGE") == 0) || (str.compare("RANGEX") == 0))
+                    res |= testCorruptedStream(str);
+
                 res |= testEntropyCodecCorrectness(str);
                 res |= testEntropyCodecSpeed(str);
             }
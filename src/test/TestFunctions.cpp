@@ -26,6 +26,9 @@ limitations under the License.
 #include "../function/ZRLT.hpp"
 #include "../function/LZCodec.hpp"
 #include "../function/ROLZCodec.hpp"
+#include "../function/FunctionFactory.hpp"
+#include "../function/SBRTZRLT.hpp"
+#include "../transform/SBRT.hpp"
 
 using namespace std;
 using namespace kanzi;
@@ -377,6 +380,186 @@ int testFunctionsSpeed(const string& name)
 }
 
 #ifdef __GNUG__
+// Apply the forward transform sequence to 'data', return the output and the skip flags
+static string forwardSequence(TransformSequence<byte>* seq, const string& data)
+{
+    const int length = int(data.size());
+    const int requiredSize = seq->getMaxEncodedLength(length);
+    SliceArray<byte> input(new byte[requiredSize], requiredSize, 0);
+    SliceArray<byte> output(new byte[requiredSize], requiredSize, 0);
+    memcpy(&input._array[0], data.data(), length);
+    string res;
+
+    if (seq->forward(input, output, length) == true)
+        res = string(reinterpret_cast<char*>(&output._array[0]), output._index);
+
+    res += char(seq->getSkipFlags());
+    delete[] input._array;
+    delete[] output._array;
+    return res;
+}
+
+// The transforms kept from block to block must be the same as new transforms
+// when the entropy codec of the block changes
+int testFunctionCache()
+{
+    cout << endl
+         << "Correctness for the transform cache" << endl;
+    string data;
+    const char* words[] = { "compression ", "of ", "text ", "with ", "a ", "dictionary ", "The ", "words " };
+    srand(1234);
+
+    while (data.size() < 50000)
+        data += words[rand() & 7];
+
+    map<string, string> params;
+    params["jobs"] = "1";
+    params["blockSize"] = "65536";
+    Context ctx(params);
+    const uint64 type = FunctionFactory<byte>::getType("TEXT+LZ");
+    const char* codecs[] = { "HUFFMAN", "TPAQ", "ANS0", "CM", "CM" };
+    FunctionCache<byte> cache;
+    TransformSequence<byte>* previous = nullptr;
+    int res = 0;
+
+    for (int i = 0; i < 5; i++) {
+        const short entropyType = EntropyCodecFactory::getType(codecs[i]);
+        TransformSequence<byte>* seq1 = cache.get(ctx, type, entropyType);
+        const string output1 = forwardSequence(seq1, data);
+        TransformSequence<byte>* seq2 = FunctionFactory<byte>::newFunction(ctx, type, entropyType);
+        const string output2 = forwardSequence(seq2, data);
+        delete seq2;
+        bool ok = output1 == output2;
+
+        // Same type and parameters: the cached sequence is returned
+        if ((i == 4) && (seq1 != previous))
+            ok = false;
+
+        previous = seq1;
+        cout << "Cached transform after codec " << codecs[i] << ": " << ((ok == true) ? "OK" : "KO") << endl;
+
+        if (ok == false)
+            res = 1;
+    }
+
+    return res;
+}
+
+// Apply the inverse transform sequence to 'data' (output of forwardSequence())
+static string inverseSequence(TransformSequence<byte>* seq, const string& data, int length)
+{
+    const int size = int(data.size()) - 1;
+    const int requiredSize = seq->getMaxEncodedLength(length);
+    SliceArray<byte> input(new byte[requiredSize], requiredSize, 0);
+    SliceArray<byte> output(new byte[length], length, 0);
+    memcpy(&input._array[0], data.data(), size);
+    seq->setSkipFlags(byte(data[size]));
+    string res;
+
+    if (seq->inverse(input, output, size) == true)
+        res = string(reinterpret_cast<char*>(&output._array[0]), output._index);
+
+    delete[] input._array;
+    delete[] output._array;
+    return res;
+}
+
+// MTFT/RANK and ZRLT in one pass must give the same output as the 2
+// transforms applied in sequence, including when ZRLT does not apply
+int testFusedSBRTZRLT()
+{
+    cout << endl
+         << "Correctness for MTFT/RANK+ZRLT in one pass" << endl;
+    const char* names[] = { "runs", "text", "zeros", "random", "one byte" };
+    srand(4321);
+    int res = 0;
+
+    for (int m = 0; m < 2; m++) {
+        const int mode = (m == 0) ? SBRT::MODE_MTF : SBRT::MODE_RANK;
+        map<string, string> params;
+        Context ctx(params);
+        TransformSequence<byte>* fused = FunctionFactory<byte>::newFunction(ctx,
+            FunctionFactory<byte>::getType((m == 0) ? "MTFT+ZRLT" : "RANK+ZRLT"),
+            EntropyCodecFactory::ANS0_TYPE);
+        Transform<byte>* transforms[8] = { new SBRT(mode), new ZRLT(), nullptr, nullptr,
+            nullptr, nullptr, nullptr, nullptr };
+        TransformSequence<byte> sequence(transforms, true);
+
+        for (int n = 0; n < 5; n++) {
+            string data;
+
+            if (n == 0) {
+                // Runs of symbols as in the output of a BWT
+                while (data.size() < 100000)
+                    data += string(size_t(1 + (rand() & 31)), char(97 + (rand() % 20)));
+            }
+            else if (n == 1) {
+                while (data.size() < 100000)
+                    data += char(32 + (rand() % 96));
+            }
+            else if (n == 2) {
+                data = string(100000, char(0));
+            }
+            else if (n == 3) {
+                // Too many big ranks: ZRLT expands the data and does not apply
+                while (data.size() < 100000)
+                    data += char(rand());
+            }
+            else {
+                data = string(1, char(7));
+            }
+
+            const string output1 = forwardSequence(fused, data);
+            const string output2 = forwardSequence(&sequence, data);
+            const byte flags = byte(output1[output1.size() - 1]);
+            bool ok = output1 == output2;
+
+            // The random data must use the fallback (ZRLT skipped)
+            if ((n == 3) && ((flags & byte(0x40)) == byte(0)))
+                ok = false;
+
+            if ((ok == true) && (inverseSequence(fused, output1, int(data.size())) != data))
+                ok = false;
+
+            cout << ((m == 0) ? "MTFT" : "RANK") << "+ZRLT on " << names[n] << ": "
+                 << data.size() << " => " << output1.size() - 1 << " bytes "
+                 << ((ok == true) ? "OK" : "KO") << endl;
+
+            if (ok == false)
+                res = 1;
+        }
+
+        // Direct calls: the output must fit in the provided buffer
+        SBRTZRLT codec(mode);
+        const int size = 1000;
+        SliceArray<byte> input(new byte[size], size, 0);
+        SliceArray<byte> output(new byte[size], size, 0);
+
+        for (int i = 0; i < size; i++)
+            input._array[i] = byte(rand());
+
+        if (codec.forward(input, output, size) == true) {
+            cout << "No overflow of the output reported" << endl;
+            res = 1;
+        }
+
+        input._index = 0;
+        output._index = 0;
+        memset(&input._array[0], 0, size);
+
+        if ((codec.forward(input, output, size) == false) || (output._index != 9)) {
+            cout << "Incorrect output for a block of zeros" << endl;
+            res = 1;
+        }
+
+        delete[] input._array;
+        delete[] output._array;
+        delete fused;
+    }
+
+    return res;
+}
+
 int main(int argc, const char* argv[])
 #else
 int TestFunctions_main(int argc, const char* argv[])
@@ -423,6 +606,22 @@ int TestFunctions_main(int argc, const char* argv[])
                  << "TestZRLT" << endl;
             res |= testFunctionsCorrectness("ZRLT");
             res |= testFunctionsSpeed("ZRLT");
+            cout << endl
+                 << endl
+                 << "TestSBRTZRLT" << endl;
+            res |= testFusedSBRTZRLT();
+            cout << endl
+                 << endl
+                 << "TestFunctionCache" << endl;
+            res |= testFunctionCache();
+        }
+        else if (str.compare("SBRTZRLT") == 0) {
+            cout << "TestSBRTZRLT" << endl;
+            res |= testFusedSBRTZRLT();
+        }
+        else if (str.compare("CACHE") == 0) {
+            cout << "TestFunctionCache" << endl;
+            res |= testFunctionCache();
         }
         else {
             cout << "Test" << str << endl;
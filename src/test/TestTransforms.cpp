@@ -249,6 +249,95 @@ End:
     return res;
 }
 
+// Scalar SBRT, one rank at a time (reference for the vectorized searches)
+static void forwardSBRTReference(int mode, const byte* src, byte* dst, int count)
+{
+    const int mask1 = (mode == SBRT::MODE_TIMESTAMP) ? 0 : -1;
+    const int mask2 = (mode == SBRT::MODE_MTF) ? 0 : -1;
+    const int shift = (mode == SBRT::MODE_RANK) ? 1 : 0;
+    int p[256] = { 0 };
+    int q[256] = { 0 };
+    int s2r[256];
+    int r2s[256];
+
+    for (int i = 0; i < 256; i++) {
+        s2r[i] = i;
+        r2s[i] = i;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const uint8 c = uint8(src[i]);
+        int r = s2r[c];
+        dst[i] = byte(r);
+        const int qc = ((i & mask1) + (p[c] & mask2)) >> shift;
+        p[c] = i;
+        q[c] = qc;
+
+        while ((r > 0) && (q[r2s[r - 1]] <= qc)) {
+            r2s[r] = r2s[r - 1];
+            s2r[r2s[r]] = r;
+            r--;
+        }
+
+        r2s[r] = c;
+        s2r[c] = r;
+    }
+}
+
+// The rank searches of SBRT (16 symbols or 4 keys at a time) must give the
+// same ranks as the scalar search, for symbols moving up by a few ranks (runs)
+// or by many ranks (random data, all 256 symbols)
+int testSBRTRanks()
+{
+    cout << endl
+         << "Correctness of the SBRT rank searches" << endl;
+    const int modes[] = { SBRT::MODE_MTF, SBRT::MODE_RANK, SBRT::MODE_TIMESTAMP };
+    const char* names[] = { "MTFT", "RANK", "TIMESTAMP" };
+    const int size = 1 << 20;
+    byte* input = new byte[size];
+    byte* output1 = new byte[size];
+    byte* output2 = new byte[size];
+    byte* reverse = new byte[size];
+    srand(8642);
+    int res = 0;
+
+    for (int n = 0; n < 4; n++) {
+        for (int i = 0; i < size; i++) {
+            if (n == 0) // random
+                input[i] = byte(rand());
+            else if (n == 1) // runs (BWT output)
+                input[i] = ((i > 0) && ((rand() & 7) != 0)) ? input[i - 1] : byte(rand() % 40);
+            else if (n == 2) // cycle over all symbols (max ranks)
+                input[i] = byte(i);
+            else // mostly a few symbols with rare ones
+                input[i] = ((rand() & 63) == 0) ? byte(rand()) : byte(97 + (rand() & 3));
+        }
+
+        for (int m = 0; m < 3; m++) {
+            SBRT sbrt(modes[m]);
+            forwardSBRTReference(modes[m], input, output1, size);
+            SliceArray<byte> ia1(input, size, 0);
+            SliceArray<byte> ia2(output2, size, 0);
+            sbrt.forward(ia1, ia2, size);
+            bool ok = memcmp(output1, output2, size) == 0;
+            SliceArray<byte> ia3(output2, size, 0);
+            SliceArray<byte> ia4(reverse, size, 0);
+            sbrt.inverse(ia3, ia4, size);
+            ok &= memcmp(input, reverse, size) == 0;
+            cout << names[m] << " on data " << n << ": " << ((ok == true) ? "Identical" : "Different") << endl;
+
+            if (ok == false)
+                res = 1;
+        }
+    }
+
+    delete[] input;
+    delete[] output1;
+    delete[] output2;
+    delete[] reverse;
+    return res;
+}
+
 int testTransformsSpeed(const string& name)
 {
     // Test speed
@@ -391,12 +480,20 @@ int TestTransforms_main(int argc, const char* argv[])
                  << "TestMTFT" << endl;
             res |= testTransformsCorrectness("MTFT");
             res |= testTransformsSpeed("MTFT");
+            cout << endl
+                 << endl
+                 << "TestSBRTRanks" << endl;
+            res |= testSBRTRanks();
             cout << endl
                  << endl
                  << "TestBWTS" << endl;
             res |= testTransformsCorrectness("BWTS");
             res |= testTransformsSpeed("BWTS");            
         }
+        else if (str.compare("RANKS") == 0) {
+            cout << "TestSBRTRanks" << endl;
+            res |= testSBRTRanks();
+        }
         else {
             cout << "Test" << str << endl;
             res |= testTransformsCorrectness(str);
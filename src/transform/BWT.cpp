@@ -18,40 +18,47 @@ limitations under the License.
 #include <vector>
 #include "BWT.hpp"
 #include "../Global.hpp"
-
-#ifdef CONCURRENCY_ENABLED
-#include <future>
-#endif
+#include "../util.hpp"
 
 using namespace kanzi;
 
-BWT::BWT(int jobs) THROW
+BWT::BWT(int jobs, bool sais, int maxChunks, Allocator* allocator) THROW
+    : _saAlgo(jobs)
 {
+    _allocator = (allocator == nullptr) ? &Allocator::getAllocator(Allocator::NORMAL_PAGES) : allocator;
     _buffer = nullptr;
     _sa = nullptr;
     _bufferSize = 0;
+    _saSize = 0;
 
 #ifndef CONCURRENCY_ENABLED
     if (jobs > 1)
         throw invalid_argument("The number of jobs is limited to 1 in this version");
 #endif
 
+    if ((maxChunks < 1) || (maxChunks > MAX_CHUNKS)) {
+        stringstream ss;
+        ss << "The max number of BWT chunks must be in [1.." << MAX_CHUNKS << "], got " << maxChunks;
+        throw invalid_argument(ss.str());
+    }
+
     _jobs = jobs;
-    memset(_primaryIndexes, 0, sizeof(int) * 8);
+    _sais = sais;
+    _maxChunks = maxChunks;
+    _primaryIndexes = new int[_maxChunks];
+    memset(_primaryIndexes, 0, sizeof(int) * _maxChunks);
 }
 
 BWT::~BWT()
 {
-    if (_buffer != nullptr)
-        delete[] _buffer;
-
-    if (_sa != nullptr)
-        delete[] _sa;
+    _allocator->deleteArray(_buffer, _bufferSize);
+    _allocator->deleteArray(_sa, _saSize);
+    delete[] _primaryIndexes;
 }
 
 bool BWT::setPrimaryIndex(int n, int primaryIndex)
 {
-    if ((primaryIndex < 0) || (n < 0) || (n >= 8))
+    if ((primaryIndex < 0) || (n < 0) || (n >= _maxChunks))
         return false;
 
     _primaryIndexes[n] = primaryIndex;
@@ -88,65 +95,25 @@ bool BWT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     byte* dst = &output._array[output._index];
 
     // Lazy dynamic memory allocation
-    if ((_sa == nullptr) || (_bufferSize < count)) {
-        if (_sa != nullptr)
-            delete[] _sa;
-
-        _bufferSize = count;
-        _sa = new int[_bufferSize];
+    if ((_sa == nullptr) || (_saSize < count)) {
+        _allocator->deleteArray(_sa, _saSize);
+        _sa = nullptr;
+        _saSize = count;
+        _sa = _allocator->newArray<int>(_saSize);
     }
 
-    int* sa = _sa;
-    _saAlgo.computeSuffixArray(src, sa, 0, count);
-    const int chunks = getBWTChunks(count);
-    bool res = true;
-
-    if (chunks == 1) {
-        dst[0] = src[count - 1];
-        int n = 0;
-
-        for (; n < count; n++) {
-            if (sa[n] == 0)
-                break;
-
-            dst[n + 1] = src[sa[n] - 1];
-        }
-
-        n++;
-        res &= setPrimaryIndex(0, n);
-
-        for (; n < count; n++)
-            dst[n] = src[sa[n] - 1];
-    }
-    else {
-        const int st = count / chunks;
-        const int step = (chunks * st == count) ? st : st + 1;
-        dst[0] = src[count - 1];
-        int idx = 0;
-
-        for (int i = 0; i < count; i++) {
-            if ((sa[i] % step) != 0)
-                continue;
-
-            res &= setPrimaryIndex(sa[i] / step, i + 1);
-            idx++;
-
-            if (idx == chunks)
-                break;
-        }
-
-        const int pIdx0 = getPrimaryIndex(0);
-
-        for (int i = 0; i < pIdx0 - 1; i++)
-            dst[i + 1] = src[sa[i] - 1];
+    const int chunks = getBWTChunks(count, _maxChunks);
 
-        for (int i = pIdx0; i < count; i++)
-            dst[i] = src[sa[i] - 1];
-    }
+    // Direct construction: the BWT is written during the induction, no
+    // gather pass over the suffix array
+    if (_sais == false)
+        _saAlgo.computeBWT(src, dst, _sa, 0, count, _primaryIndexes, chunks);
+    else
+        _saisAlgo.computeBWT(src, dst, _sa, 0, count, _primaryIndexes, chunks);
 
     input._index += count;
     output._index += count;
-    return res;
+    return true;
 }
 
 bool BWT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count) THROW
@@ -187,11 +154,10 @@ bool BWT::inverseSmallBlock(SliceArray<byte>& input, SliceArray<byte>& output, i
 {
     // Lazy dynamic memory allocation
     if ((_buffer == nullptr) || (_bufferSize < count)) {
-        if (_buffer != nullptr)
-            delete[] _buffer;
-
+        _allocator->deleteArray(_buffer, _bufferSize);
+        _buffer = nullptr;
         _bufferSize = count;
-        _buffer = new uint[_bufferSize];
+        _buffer = _allocator->newArray<uint>(_bufferSize);
     }
 
     uint8* src = (uint8*)&input._array[input._index];
@@ -237,16 +203,18 @@ bool BWT::inverseSmallBlock(SliceArray<byte>& input, SliceArray<byte>& output, i
     return true;
 }
 
-// When count >= 4M, biPSIv2 algo, possibly several chunks
+// When count >= 4M, biPSIv2 algo, possibly several chunks. Each load of the
+// chain yields two symbols. The packed index + symbol layout of mergeTPSI
+// yields only one (and the index does not fit in 24 bits from 16MB): it is
+// slower here, even with the chunks interleaved.
 bool BWT::inverseBigBlock(SliceArray<byte>& input, SliceArray<byte>& output, int count)
 {
     // Lazy dynamic memory allocations
     if ((_buffer == nullptr) || (_bufferSize < count + 1)) {
-        if (_buffer != nullptr)
-            delete[] _buffer;
-
+        _allocator->deleteArray(_buffer, _bufferSize);
+        _buffer = nullptr;
         _bufferSize = count + 1;
-        _buffer = new uint[_bufferSize];
+        _buffer = _allocator->newArray<uint>(_bufferSize);
     }
 
     uint8* src = (uint8*)&input._array[input._index];
@@ -340,7 +308,7 @@ bool BWT::inverseBigBlock(SliceArray<byte>& input, SliceArray<byte>& output, int
         }
     }
 
-    const int chunks = getBWTChunks(count);
+    const int chunks = getBWTChunks(count, _maxChunks);
 
     // Build inverse
     if (chunks == 1) {
@@ -357,7 +325,6 @@ bool BWT::inverseBigBlock(SliceArray<byte>& input, SliceArray<byte>& output, int
             p = data[p];
         }
     }
-#ifdef CONCURRENCY_ENABLED
     else {
         // Several chunks may be decoded concurrently (depending on the availability
         // of jobs per block).
@@ -366,7 +333,6 @@ bool BWT::inverseBigBlock(SliceArray<byte>& input, SliceArray<byte>& output, int
         const int nbTasks = (_jobs < chunks) ? _jobs : chunks;
         int* jobsPerTask = new int[nbTasks];
         Global::computeJobsPerTask(jobsPerTask, chunks, nbTasks);
-        vector<future<int> > futures;
         vector<InverseBigChunkTask<int>*> tasks;
 
         // Create one task per job
@@ -377,13 +343,20 @@ bool BWT::inverseBigBlock(SliceArray<byte>& input, SliceArray<byte>& output, int
             InverseBigChunkTask<int>* task = new InverseBigChunkTask<int>(data, buckets, fastBits, dst, _primaryIndexes,
                 count, start, ckSize, c, c + jobsPerTask[j]);
             tasks.push_back(task);
-            futures.push_back(async(launch::async, &InverseBigChunkTask<int>::run, task));
             c += jobsPerTask[j];
         }
 
-        // Wait for completion of all concurrent tasks
-        for (int j = 0; j < nbTasks; j++)
-            futures[j].get();
+        if (tasks.size() == 1) {
+            // Synchronous call
+            tasks[0]->run();
+        }
+#ifdef CONCURRENCY_ENABLED
+        else {
+            // Run the tasks in parallel (in the shared thread pool)
+            vector<int> results;
+            ThreadPool::instance().run(tasks, results);
+        }
+#endif
 
         // Cleanup
         for (InverseBigChunkTask<int>* task : tasks)
@@ -392,7 +365,6 @@ bool BWT::inverseBigBlock(SliceArray<byte>& input, SliceArray<byte>& output, int
         tasks.clear();
         delete[] jobsPerTask;
     }
-#endif
 
     dst[count - 1] = byte(lastc);
     delete[] fastBits;
@@ -421,37 +393,71 @@ InverseBigChunkTask<T>::InverseBigChunkTask(uint* buf, uint* buckets, uint16* fa
 template <class T>
 T InverseBigChunkTask<T>::run() THROW
 {
-	int shift = 0;
+    int shift = 0;
 
-	while ((_total >> shift) > BWT::MASK_FASTBITS)
-		shift++;
+    while ((_total >> shift) > BWT::MASK_FASTBITS)
+        shift++;
 
-	for (int c = _firstChunk; c < _lastChunk; c++) {
-		int end = (_start + _ckSize) > _total - 1 ? _total - 1 : _start + _ckSize;
-		uint p = _primaryIndexes[c];
+    uint p[INTERLEAVE];
+    int pos[INTERLEAVE];
+    int end[INTERLEAVE];
+
+    for (int c = _firstChunk; c < _lastChunk; c += INTERLEAVE) {
+        const int n = (_lastChunk - c < INTERLEAVE) ? _lastChunk - c : INTERLEAVE;
+        int steps = _total;
+
+        // Each cursor decodes 2 symbols per step from position pos to end
+        for (int k = 0; k < n; k++) {
+            end[k] = (_start + _ckSize) > _total - 1 ? _total - 1 : _start + _ckSize;
+            pos[k] = _start + 1;
+            p[k] = _primaryIndexes[c + k];
+            const int s = (end[k] - _start + 1) >> 1;
+            steps = (s < steps) ? s : steps;
+            _start = end[k];
+        }
 
-        for (int i = _start+1; i <= end; i += 2) {
-            uint16 s = _fastBits[p >> shift];
+        // All the chunks but the last one have the same size: advance the
+        // cursors in lockstep
+        for (int i = 0; i < steps; i++) {
+            for (int k = 0; k < n; k++) {
+                uint16 s = _fastBits[p[k] >> shift];
 
-            while (_buckets[s] <= p)
-                s++;
+                while (_buckets[s] <= p[k])
+                    s++;
 
-            _dst[i - 1] = byte(s >> 8);
-            _dst[i] = byte(s);
-            p = _data[p];
+                _dst[pos[k] - 1] = byte(s >> 8);
+                _dst[pos[k]] = byte(s);
+                pos[k] += 2;
+                p[k] = _data[p[k]];
+                prefetchRead(&_data[p[k]]);
+            }
         }
 
-        _start = end;
-	}
+        // Finish the longer chunks
+        for (int k = 0; k < n; k++) {
+            uint pk = p[k];
+
+            for (int i = pos[k]; i <= end[k]; i += 2) {
+                uint16 s = _fastBits[pk >> shift];
+
+                while (_buckets[s] <= pk)
+                    s++;
+
+                _dst[i - 1] = byte(s >> 8);
+                _dst[i] = byte(s);
+                pk = _data[pk];
+            }
+        }
+    }
 
-	return T(0);
+    return T(0);
 }
 
-int BWT::getBWTChunks(int size)
+int BWT::getBWTChunks(int size, int maxChunks)
 {
     if (size < 4 * 1024 * 1024)
         return 1;
 
-    const int res = (size + (1 << 21)) >> 22;
-    return (res > BWT_MAX_CHUNKS) ? BWT_MAX_CHUNKS : res;
+    const int res = (maxChunks <= DEFAULT_MAX_CHUNKS) ? (size + (1 << 21)) >> 22 : (size + (1 << 19)) >> 20;
+    return (res > maxChunks) ? maxChunks : res;
 }
@@ -16,9 +16,11 @@ limitations under the License.
 #ifndef _BWT_
 #define _BWT_
 
+#include "../Allocator.hpp"
 #include "../Transform.hpp"
 #include "../concurrent.hpp"
 #include "DivSufSort.hpp"
+#include "SAIS.hpp"
 
 using namespace std;
 
@@ -55,12 +57,19 @@ namespace kanzi {
 // The suffix array and permutation vector are equal when the input is 0 terminated
 // The insertion of a guard is done internally and is entirely transparent.
 //
-// This implementation extends the canonical algorithm to use up to MAX_CHUNKS primary
+// This implementation extends the canonical algorithm to use several primary
 // indexes (based on input block size). Each primary index corresponds to a data chunk.
-// Chunks may be inverted concurrently.
+// Chunks may be inverted concurrently. By default, there is one chunk per 4MB and
+// at most DEFAULT_MAX_CHUNKS chunks. With a higher max number of chunks (up to
+// MAX_CHUNKS), there is one chunk per MB to let more jobs invert big blocks.
+// A task inverts its chunks in lockstep (up to INTERLEAVE at a time): each
+// chunk is a chain of dependent cache missing loads and interleaving chains
+// lets the misses overlap.
    template <class T>
    class InverseBigChunkTask : public Task<T> {
    private:
+       static const int INTERLEAVE = 8;
+
        uint* _data;
        uint* _buckets;
        uint16* _fastBits;
@@ -84,14 +93,18 @@ namespace kanzi {
 
    private:
        static const int MAX_BLOCK_SIZE = 1024 * 1024 * 1024; // 1024 MB
-       static const int BWT_MAX_CHUNKS = 8;
        static const int NB_FASTBITS = 17;
 
        uint* _buffer; 
        int* _sa; 
        int _bufferSize;
-       int _primaryIndexes[8];
+       int _saSize;
+       Allocator* _allocator;
+       int* _primaryIndexes;
+       int _maxChunks;
        DivSufSort _saAlgo;
+       SAIS _saisAlgo;
+       bool _sais; // use SA-IS instead of DivSufSort
        int _jobs;
 
        bool inverseBigBlock(SliceArray<byte>& input, SliceArray<byte>& output, int count);
@@ -100,8 +113,11 @@ namespace kanzi {
 
    public:
        static const int MASK_FASTBITS = (1 << NB_FASTBITS) - 1;
+       static const int DEFAULT_MAX_CHUNKS = 8;
+       static const int MAX_CHUNKS = 4096;
 
-       BWT(int jobs = 1);
+       // The big arrays are allocated with 'allocator' (heap if null)
+       BWT(int jobs = 1, bool sais = false, int maxChunks = DEFAULT_MAX_CHUNKS, Allocator* allocator = nullptr);
 
        virtual ~BWT();
 
@@ -115,7 +131,7 @@ namespace kanzi {
 
        static int maxBlockSize() { return MAX_BLOCK_SIZE; }
 
-       static int getBWTChunks(int size);
+       static int getBWTChunks(int size, int maxChunks = DEFAULT_MAX_CHUNKS);
    };
 }
 #endif
@@ -49,19 +49,29 @@ bool BWTS::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     byte* dst = &output._array[output._index];
 
     // Lazy dynamic memory allocation
-    if (_bufferSize < count) {
-        _bufferSize = count;
-        delete[] _buffer1;
-        _buffer1 = new int[_bufferSize];
-        delete[] _buffer2;
-        _buffer2 = new int[_bufferSize];
+    if (_bufferSize1 < count) {
+        _allocator->deleteArray(_buffer1, _bufferSize1);
+        _buffer1 = nullptr;
+        _bufferSize1 = count;
+        _buffer1 = _allocator->newArray<int>(_bufferSize1);
+    }
+
+    if (_bufferSize2 < count) {
+        _allocator->deleteArray(_buffer2, _bufferSize2);
+        _buffer2 = nullptr;
+        _bufferSize2 = count;
+        _buffer2 = _allocator->newArray<int>(_bufferSize2);
     }
 
     // Aliasing
     int* sa = _buffer1;
     int* isa = _buffer2;
 
-    _saAlgo.computeSuffixArray(src, sa, 0, count);
+    if (_sais == true)
+        _saisAlgo.computeSuffixArray(src, sa, 0, count);
+    else
+        _saAlgo.computeSuffixArray(src, sa, 0, count);
+
 
     for (int i = 0; i < count; i++)
         isa[sa[i]] = i;
@@ -188,10 +198,11 @@ bool BWTS::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     uint8* dst = (uint8*) &output._array[output._index];
 
     // Lazy dynamic memory allocation
-    if (_bufferSize < count) {
-        _bufferSize = count;
-        delete[] _buffer1;
-        _buffer1 = new int[_bufferSize];
+    if (_bufferSize1 < count) {
+        _allocator->deleteArray(_buffer1, _bufferSize1);
+        _buffer1 = nullptr;
+        _bufferSize1 = count;
+        _buffer1 = _allocator->newArray<int>(_bufferSize1);
     }
 
     // Initialize histogram
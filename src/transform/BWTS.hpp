@@ -16,8 +16,10 @@ limitations under the License.
 #ifndef _BWTS_
 #define _BWTS_
 
+#include "../Allocator.hpp"
 #include "../Transform.hpp"
 #include "DivSufSort.hpp"
+#include "SAIS.hpp"
 
 using namespace std;
 
@@ -37,23 +39,31 @@ namespace kanzi
 
        int* _buffer1;
        int* _buffer2;
-       int _bufferSize;
+       int _bufferSize1;
+       int _bufferSize2;
+       Allocator* _allocator;
        DivSufSort _saAlgo;
+       SAIS _saisAlgo;
+       bool _sais; // use SA-IS instead of DivSufSort
 
        int moveLyndonWordHead(int sa[], int isa[], byte data[], int count, int start, int size, int rank);
 
    public:
-       BWTS()
+       // The big arrays are allocated with 'allocator' (heap if null)
+       BWTS(bool sais = false, Allocator* allocator = nullptr)
        {
-           _buffer1 = new int[0];
-           _buffer2 = new int[0];
-           _bufferSize = 0;
+           _sais = sais;
+           _allocator = (allocator == nullptr) ? &Allocator::getAllocator(Allocator::NORMAL_PAGES) : allocator;
+           _buffer1 = nullptr;
+           _buffer2 = nullptr;
+           _bufferSize1 = 0;
+           _bufferSize2 = 0;
        }
 
        ~BWTS() 
        { 
-          delete[] _buffer1; 
-          delete[] _buffer2; 
+          _allocator->deleteArray(_buffer1, _bufferSize1); 
+          _allocator->deleteArray(_buffer2, _bufferSize2); 
        }
 
        bool forward(SliceArray<byte>& input, SliceArray<byte>& output, int length) THROW;
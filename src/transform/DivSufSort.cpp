@@ -15,7 +15,9 @@ limitations under the License.
 
 #include <algorithm>
 #include <cstring>
+#include <functional>
 #include <utility>
+#include <vector>
 #include <stddef.h>
 #include "DivSufSort.hpp"
 
@@ -53,9 +55,10 @@ const int DivSufSort::LOG_TABLE[] = {
     7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
 };
 
-DivSufSort::DivSufSort()
+DivSufSort::DivSufSort(int jobs)
 {
     _length = 0;
+    _jobs = jobs;
     _ssStack = new Stack(SS_MISORT_STACKSIZE);
     _trStack = new Stack(TR_STACKSIZE);
     _mergeStack = new Stack(SS_SMERGE_STACKSIZE);
@@ -154,7 +157,8 @@ void DivSufSort::constructSuffixArray(int bucketA[], int bucketB[], int n, int m
     }
 }
 
-int DivSufSort::computeBWT(byte input[], int sa[], int start, int length)
+int DivSufSort::computeBWT(byte input[], byte output[], int sa[], int start, int length,
+    int indexes[], int idxCount)
 {
     _buffer = (uint8*)&input[start];
     _sa = sa;
@@ -163,14 +167,35 @@ int DivSufSort::computeBWT(byte input[], int sa[], int start, int length)
     int* bucketB = new int[65536];
     memset(&bucketB[0], 0, sizeof(int) * 65536);
     const int m = sortTypeBstar(bucketA, bucketB, length);
-    const int res = constructBWT(bucketA, bucketB, length, m);
+    const int pIdx = constructBWT(bucketA, bucketB, length, m, indexes, idxCount);
     delete[] bucketB;
-    return res;
+
+    // The slot of suffix 0 holds no symbol (the last symbol goes first)
+    output[0] = input[start + length - 1];
+
+    for (int i = 0; i < pIdx; i++)
+        output[i + 1] = byte(_sa[i]);
+
+    for (int i = pIdx + 1; i < length; i++)
+        output[i] = byte(_sa[i]);
+
+    indexes[0] = pIdx + 1;
+    return pIdx + 1;
 }
 
-int DivSufSort::constructBWT(int bucketA[], int bucketB[], int n, int m)
+// Same as constructSuffixArray but the symbol preceding each suffix replaces
+// the suffix in the array. Since the suffix positions are lost, the rank of the
+// suffixes starting a chunk (positions multiple of the chunk size) is recorded
+// when these suffixes are placed or scanned.
+int DivSufSort::constructBWT(int bucketA[], int bucketB[], int n, int m, int indexes[], int idxCount)
 {
     int pIdx = -1;
+    const int st = n / idxCount;
+    const int step = (idxCount * st == n) ? st : st + 1;
+
+    // s is a multiple of step iff s * mod <= mod - 1 (modulo 2^64). Avoids a
+    // division per suffix. For a single chunk, no suffix in [1..n-1] matches.
+    const uint64 mod = uint64(-1) / uint64(step) + 1;
 
     if (m > 0) {
         for (int c1 = 254; c1 >= 0; c1--) {
@@ -189,6 +214,9 @@ int DivSufSort::constructBWT(int bucketA[], int bucketB[], int n, int m)
                     continue;
                 }
 
+                if (uint64(s) * mod <= mod - 1)
+                    indexes[s / step] = j + 1;
+
                 s--;
                 const int c0 = _buffer[s];
                 _sa[j] = ~c0;
@@ -211,7 +239,15 @@ int DivSufSort::constructBWT(int bucketA[], int bucketB[], int n, int m)
 
     int c2 = _buffer[n - 1];
     int k = bucketA[c2];
-    _sa[k++] = (_buffer[n - 2] < c2) ? ~_buffer[n - 2] : (n - 1);
+
+    if (_buffer[n - 2] < c2) {
+        if (uint64(n - 1) * mod <= mod - 1)
+            indexes[(n - 1) / step] = k + 1;
+
+        _sa[k++] = ~int(_buffer[n - 2]);
+    }
+    else
+        _sa[k++] = n - 1;
 
     // Scan the suffix array from left to right.
     for (int i = 0; i < n; i++) {
@@ -226,20 +262,27 @@ int DivSufSort::constructBWT(int bucketA[], int bucketB[], int n, int m)
             continue;
         }
 
+        if (uint64(s) * mod <= mod - 1)
+            indexes[s / step] = i + 1;
+
         s--;
         const int c0 = _buffer[s];
         _sa[i] = c0;
 
-        if ((s > 0) && (_buffer[s - 1] < c0))
-            s = ~_buffer[s - 1];
-
         if (c0 != c2) {
             bucketA[c2] = k;
             c2 = c0;
             k = bucketA[c2];
         }
 
-        _sa[k++] = s;
+        if ((s > 0) && (_buffer[s - 1] < c0)) {
+            if (uint64(s) * mod <= mod - 1)
+                indexes[s / step] = k + 1;
+
+            _sa[k++] = ~int(_buffer[s - 1]);
+        }
+        else
+            _sa[k++] = s;
     }
 
     return pIdx;
@@ -316,18 +359,27 @@ int DivSufSort::sortTypeBstar(int bucketA[], int bucketB[], int n)
 
         // Sort the type B* substrings using ssSort.
         const int bufSize = n - m - m;
-        c0 = 254;
 
-        for (int j = m; j > 0; c0--) {
-            const int idx = c0 << 8;
+#ifdef CONCURRENCY_ENABLED
+        if ((_jobs > 1) && (m >= SS_PARALLEL_THRESHOLD)) {
+            ssSortBuckets(bucketB, pab, m, n, bufSize);
+        }
+        else
+#endif
+        {
+            c0 = 254;
 
-            for (int c1 = 255; c1 > c0; c1--) {
-                const int i = bucketB[idx + c1];
+            for (int j = m; j > 0; c0--) {
+                const int idx = c0 << 8;
+
+                for (int c1 = 255; c1 > c0; c1--) {
+                    const int i = bucketB[idx + c1];
 
-                if (j > i + 1)
-                    ssSort(pab, i, j, m, bufSize, 2, n, _sa[i] == m - 1);
+                    if (j > i + 1)
+                        ssSort(pab, i, j, m, bufSize, 2, n, _sa[i] == m - 1);
 
-                j = i;
+                    j = i;
+                }
             }
         }
 
@@ -411,6 +463,106 @@ int DivSufSort::sortTypeBstar(int bucketA[], int bucketB[], int n)
     return m;
 }
 
+#ifdef CONCURRENCY_ENABLED
+// Sort the buckets of type B* substrings concurrently. The buckets are
+// independent: each job sorts whole buckets with its own stacks and its own
+// part of the work buffer. The result is the same as the sequential sort.
+void DivSufSort::ssSortBuckets(int32 bucketB[], int pa, int m, int n, int bufSize) THROW
+{
+    vector<pair<int, int> > ranges;
+    int c0 = 254;
+
+    for (int j = m; j > 0; c0--) {
+        const int idx = c0 << 8;
+
+        for (int c1 = 255; c1 > c0; c1--) {
+            const int i = bucketB[idx + c1];
+
+            if (j > i + 1)
+                ranges.push_back(make_pair(j - i, i));
+
+            j = i;
+        }
+    }
+
+    if (ranges.size() == 0)
+        return;
+
+    // Biggest buckets first to balance the load
+    sort(ranges.begin(), ranges.end(), greater<pair<int, int> >());
+    const int nbTasks = (_jobs < int(ranges.size())) ? _jobs : int(ranges.size());
+    const int jobBufSize = bufSize / nbTasks;
+    atomic_int index(0);
+    vector<SSSortTask<int>*> tasks;
+    vector<DivSufSort*> workers;
+
+    for (int t = 0; t < nbTasks; t++) {
+        DivSufSort* dss = this;
+
+        if (t > 0) {
+            dss = new DivSufSort();
+            dss->_sa = _sa;
+            dss->_buffer = _buffer;
+            workers.push_back(dss);
+        }
+
+        tasks.push_back(new SSSortTask<int>(dss, &ranges[0], int(ranges.size()), &index,
+            pa, m + t * jobBufSize, jobBufSize, n, m));
+    }
+
+    vector<int> results;
+
+    try {
+        ThreadPool::instance().run(tasks, results);
+    }
+    catch (exception&) {
+        for (int t = 0; t < nbTasks; t++)
+            delete tasks[t];
+
+        for (size_t t = 0; t < workers.size(); t++)
+            delete workers[t];
+
+        throw;
+    }
+
+    for (int t = 0; t < nbTasks; t++)
+        delete tasks[t];
+
+    for (size_t t = 0; t < workers.size(); t++)
+        delete workers[t];
+}
+#endif
+
+template <class T>
+SSSortTask<T>::SSSortTask(DivSufSort* dss, const pair<int, int>* ranges, int nbRanges,
+    atomic_int* index, int pa, int buf, int bufSize, int n, int m)
+{
+    _dss = dss;
+    _ranges = ranges;
+    _nbRanges = nbRanges;
+    _index = index;
+    _pa = pa;
+    _buf = buf;
+    _bufSize = bufSize;
+    _n = n;
+    _m = m;
+}
+
+template <class T>
+T SSSortTask<T>::run() THROW
+{
+    int* sa = _dss->_sa;
+    int r;
+
+    while ((r = _index->fetch_add(1)) < _nbRanges) {
+        const int first = _ranges[r].second;
+        const int last = first + _ranges[r].first;
+        _dss->ssSort(_pa, first, last, _buf, _bufSize, 2, _n, sa[first] == _m - 1);
+    }
+
+    return T(0);
+}
+
 // Sub String Sort
 void DivSufSort::ssSort(const int pa, int first, int last, int buf, int bufSize,
     int depth, int n, bool lastSuffix)
@@ -16,7 +16,9 @@ limitations under the License.
 #ifndef _DivSufSort_
 #define _DivSufSort_
 
+#include <utility>
 #include "../types.hpp"
+#include "../concurrent.hpp"
 
 using namespace std; // for C++17
 
@@ -81,8 +83,37 @@ namespace kanzi
        inline bool check(int size);
    };
 
+   class DivSufSort;
+
+   // A task sorting ranges of type B* substrings with ssSort. The ranges
+   // (buckets, biggest first) are claimed in turn from a shared list.
+   template <class T>
+   class SSSortTask : public Task<T>
+   {
+   private:
+       DivSufSort* _dss;
+       const pair<int, int>* _ranges; // (size, start) of each range
+       int _nbRanges;
+       atomic_int* _index; // next range to sort
+       int _pa;
+       int _buf;
+       int _bufSize;
+       int _n;
+       int _m;
+
+   public:
+       SSSortTask(DivSufSort* dss, const pair<int, int>* ranges, int nbRanges, atomic_int* index,
+           int pa, int buf, int bufSize, int n, int m);
+
+       ~SSSortTask() {}
+
+       T run() THROW;
+   };
+
    class DivSufSort
    {
+       template <class T> friend class SSSortTask;
+
    private:
        static const int SS_INSERTIONSORT_THRESHOLD = 8;
        static const int SS_BLOCKSIZE = 1024;
@@ -90,6 +121,7 @@ namespace kanzi
        static const int SS_SMERGE_STACKSIZE = 32;
        static const int TR_STACKSIZE = 64;
        static const int TR_INSERTIONSORT_THRESHOLD = 8;
+       static const int SS_PARALLEL_THRESHOLD = 65536; // min number of type B* suffixes
        static const int SQQ_TABLE[];
        static const int LOG_TABLE[];
 
@@ -99,16 +131,19 @@ namespace kanzi
        Stack* _ssStack;
        Stack* _trStack;
        Stack* _mergeStack;
+       int _jobs;
 
        void constructSuffixArray(int32 bucketA[], int32 bucketB[], int n, int m);
 
-       int constructBWT(int32 bucketA[], int32 bucketB[], int n, int m);
+       int constructBWT(int32 bucketA[], int32 bucketB[], int n, int m, int indexes[], int idxCount);
 
        int sortTypeBstar(int32 bucketA[], int32 bucketB[], int n);
 
        void ssSort(int pa, int first, int last, int buf, int bufSize,
            int depth, int n, bool lastSuffix);
 
+       void ssSortBuckets(int32 bucketB[], int pa, int m, int n, int bufSize) THROW;
+
        inline int ssCompare(int pa, int pb, int p2, int depth);
 
        inline int ssCompare(int p1, int p2, int depth);
@@ -179,13 +214,18 @@ namespace kanzi
        inline int trIlg(int n);
 
    public:
-       DivSufSort();
+       // The type B* substrings are sorted concurrently if jobs > 1
+       DivSufSort(int jobs = 1);
 
        ~DivSufSort();
 
        void computeSuffixArray(byte input[], int sa[], int start, int length);
 
-       int computeBWT(byte input[], int sa[], int start, int length);
+       // Write the BWT of the input to output (the suffix array is never fully
+       // built, sa is used as work buffer). The primary index of each of the
+       // idxCount chunks (see BWT) is stored in indexes. Return indexes[0].
+       int computeBWT(byte input[], byte output[], int sa[], int start, int length,
+           int indexes[], int idxCount = 1);
    };
 
 }
@@ -0,0 +1,606 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+#include "SAIS.hpp"
+#include "../util.hpp"
+
+using namespace kanzi;
+
+void SAIS::computeSuffixArray(byte input[], int sa[], int start, int length)
+{
+    if (length < 2) {
+        if (length == 1)
+            sa[0] = 0;
+
+        return;
+    }
+
+    computeSuffixArray((const uint8*)&input[start], sa, 0, length, 256, nullptr, 1);
+}
+
+int SAIS::computeBWT(byte input[], byte output[], int sa[], int start, int length,
+    int indexes[], int idxCount)
+{
+    if (length < 2) {
+        if (length == 1)
+            output[0] = input[start];
+
+        indexes[0] = length;
+        return length;
+    }
+
+    const int pIdx = computeSuffixArray((const uint8*)&input[start], sa, 0, length, 256, indexes, idxCount);
+
+    // The slot of suffix 0 holds no symbol (the last symbol goes first)
+    output[0] = input[start + length - 1];
+
+    for (int i = 0; i < pIdx; i++)
+        output[i + 1] = byte(sa[i]);
+
+    for (int i = pIdx + 1; i < length; i++)
+        output[i] = byte(sa[i]);
+
+    return pIdx + 1;
+}
+
+template <class T>
+void SAIS::getCounts(const T t[], int c[], int n, int k)
+{
+    memset(c, 0, sizeof(int) * k);
+
+    for (int i = 0; i < n; i++)
+        c[int(t[i])]++;
+}
+
+void SAIS::getBuckets(const int c[], int b[], int k, bool end)
+{
+    int sum = 0;
+
+    if (end == true) {
+        for (int i = 0; i < k; i++) {
+            sum += c[i];
+            b[i] = sum;
+        }
+    }
+    else {
+        for (int i = 0; i < k; i++) {
+            sum += c[i];
+            b[i] = sum - c[i];
+        }
+    }
+}
+
+// Sort all the LMS substrings (induced sorting restricted to LMS substrings)
+template <class T>
+void SAIS::lmsSort(const T t[], int sa[], int c[], int b[], int n, int k)
+{
+    // Compute SAl
+    if (c == b)
+        getCounts(t, c, n, k);
+
+    getBuckets(c, b, k, false);
+    int j = n - 1;
+    int c1 = int(t[j]);
+    int bi = b[c1];
+    j--;
+    sa[bi++] = (int(t[j]) < c1) ? ~j : j;
+
+    for (int i = 0; i < n; i++) {
+        j = sa[i];
+
+        if (j > 0) {
+            const int c0 = int(t[j]);
+
+            if (c0 != c1) {
+                b[c1] = bi;
+                c1 = c0;
+                bi = b[c1];
+            }
+
+            j--;
+            sa[bi++] = (int(t[j]) < c1) ? ~j : j;
+            sa[i] = 0;
+        }
+        else if (j < 0)
+            sa[i] = ~j;
+    }
+
+    // Compute SAs
+    if (c == b)
+        getCounts(t, c, n, k);
+
+    getBuckets(c, b, k, true);
+    c1 = 0;
+    bi = b[c1];
+
+    for (int i = n - 1; i >= 0; i--) {
+        j = sa[i];
+
+        if (j > 0) {
+            const int c0 = int(t[j]);
+
+            if (c0 != c1) {
+                b[c1] = bi;
+                c1 = c0;
+                bi = b[c1];
+            }
+
+            j--;
+            sa[--bi] = (int(t[j]) > c1) ? ~(j + 1) : j;
+            sa[i] = 0;
+        }
+    }
+}
+
+// Compact the sorted LMS substrings into the first m slots of the suffix
+// array and name them. Return the number of distinct names.
+template <class T>
+int SAIS::lmsPostProcess(const T t[], int sa[], int n, int m)
+{
+    int i = 0;
+    int j;
+    int p;
+
+    // 2*m is not larger than n
+    for (; (p = sa[i]) < 0; i++)
+        sa[i] = ~p;
+
+    if (i < m) {
+        for (j = i, i++;; i++) {
+            if ((p = sa[i]) < 0) {
+                sa[j++] = ~p;
+                sa[i] = 0;
+
+                if (j == m)
+                    break;
+            }
+        }
+    }
+
+    // Store the length of all substrings
+    int c0 = int(t[n - 1]);
+    int c1;
+    i = n - 1;
+    j = n - 1;
+
+    do {
+        c1 = c0;
+    } while ((--i >= 0) && ((c0 = int(t[i])) >= c1));
+
+    while (i >= 0) {
+        do {
+            c1 = c0;
+        } while ((--i >= 0) && ((c0 = int(t[i])) <= c1));
+
+        if (i >= 0) {
+            sa[m + ((i + 1) >> 1)] = j - i;
+            j = i + 1;
+
+            do {
+                c1 = c0;
+            } while ((--i >= 0) && ((c0 = int(t[i])) >= c1));
+        }
+    }
+
+    // Find the lexicographic names of all substrings
+    int name = 0;
+    int q = n;
+    int qlen = 0;
+
+    for (i = 0; i < m; i++) {
+        p = sa[i];
+        const int plen = sa[m + (p >> 1)];
+        bool diff = true;
+
+        if ((plen == qlen) && (q + plen < n)) {
+            for (j = 0; (j < plen) && (t[p + j] == t[q + j]); j++) {
+            }
+
+            if (j == plen)
+                diff = false;
+        }
+
+        if (diff == true) {
+            name++;
+            q = p;
+            qlen = plen;
+        }
+
+        sa[m + (p >> 1)] = name;
+    }
+
+    return name;
+}
+
+// Induce the order of all suffixes from the sorted LMS suffixes. The symbols
+// preceding the suffixes are read in suffix array order (random accesses to
+// the input), hence the prefetching.
+template <class T>
+void SAIS::induceSA(const T t[], int sa[], int c[], int b[], int n, int k)
+{
+    // Compute SAl
+    if (c == b)
+        getCounts(t, c, n, k);
+
+    getBuckets(c, b, k, false);
+    int j = n - 1;
+    int c1 = int(t[j]);
+    int bi = b[c1];
+    sa[bi++] = ((j > 0) && (int(t[j - 1]) < c1)) ? ~j : j;
+
+    for (int i = 0; i < n; i++) {
+        if (i + PREFETCH_DISTANCE < n) {
+            const int p = sa[i + PREFETCH_DISTANCE];
+
+            if (p > 1)
+                prefetchRead(&t[p - 2]);
+        }
+
+        j = sa[i];
+        sa[i] = ~j;
+
+        if (j > 0) {
+            j--;
+            const int c0 = int(t[j]);
+
+            if (c0 != c1) {
+                b[c1] = bi;
+                c1 = c0;
+                bi = b[c1];
+            }
+
+            sa[bi++] = ((j > 0) && (int(t[j - 1]) < c1)) ? ~j : j;
+        }
+    }
+
+    // Compute SAs
+    if (c == b)
+        getCounts(t, c, n, k);
+
+    getBuckets(c, b, k, true);
+    c1 = 0;
+    bi = b[c1];
+
+    for (int i = n - 1; i >= 0; i--) {
+        if (i >= PREFETCH_DISTANCE) {
+            const int p = sa[i - PREFETCH_DISTANCE];
+
+            if (p > 1)
+                prefetchRead(&t[p - 2]);
+        }
+
+        j = sa[i];
+
+        if (j > 0) {
+            j--;
+            const int c0 = int(t[j]);
+
+            if (c0 != c1) {
+                b[c1] = bi;
+                c1 = c0;
+                bi = b[c1];
+            }
+
+            sa[--bi] = ((j == 0) || (int(t[j - 1]) > c1)) ? ~j : j;
+        }
+        else
+            sa[i] = ~j;
+    }
+}
+
+// Same as induceSA but the symbol preceding each suffix replaces the suffix
+// once it has been scanned. Since the suffix positions are lost, the rank of
+// the suffixes starting a chunk (positions multiple of the chunk size) is
+// recorded when these suffixes are placed (at their final rank).
+// Return the rank of suffix 0.
+template <class T>
+int SAIS::induceBWT(const T t[], int sa[], int c[], int b[], int n, int k, int indexes[], int idxCount)
+{
+    int pIdx = -1;
+    const int st = n / idxCount;
+    const int step = (idxCount * st == n) ? st : st + 1;
+
+    // s is a multiple of step iff s * mod <= mod - 1 (modulo 2^64). Avoids a
+    // division per suffix. For a single chunk, only suffix 0 matches.
+    const uint64 mod = uint64(-1) / uint64(step) + 1;
+
+    // Compute SAl
+    if (c == b)
+        getCounts(t, c, n, k);
+
+    getBuckets(c, b, k, false);
+    int j = n - 1;
+    int c1 = int(t[j]);
+    int bi = b[c1];
+
+    if (uint64(j) * mod <= mod - 1)
+        indexes[j / step] = bi + 1;
+
+    sa[bi++] = ((j > 0) && (int(t[j - 1]) < c1)) ? ~j : j;
+
+    for (int i = 0; i < n; i++) {
+        if (i + PREFETCH_DISTANCE < n) {
+            const int p = sa[i + PREFETCH_DISTANCE];
+
+            if (p > 1)
+                prefetchRead(&t[p - 2]);
+        }
+
+        j = sa[i];
+
+        if (j > 0) {
+            j--;
+            const int c0 = int(t[j]);
+            sa[i] = ~c0;
+
+            if (c0 != c1) {
+                b[c1] = bi;
+                c1 = c0;
+                bi = b[c1];
+            }
+
+            if (uint64(j) * mod <= mod - 1)
+                indexes[j / step] = bi + 1;
+
+            sa[bi++] = ((j > 0) && (int(t[j - 1]) < c1)) ? ~j : j;
+        }
+        else if (j != 0)
+            sa[i] = ~j;
+    }
+
+    // Compute SAs
+    if (c == b)
+        getCounts(t, c, n, k);
+
+    getBuckets(c, b, k, true);
+    c1 = 0;
+    bi = b[c1];
+
+    for (int i = n - 1; i >= 0; i--) {
+        if (i >= PREFETCH_DISTANCE) {
+            const int p = sa[i - PREFETCH_DISTANCE];
+
+            if (p > 1)
+                prefetchRead(&t[p - 2]);
+        }
+
+        j = sa[i];
+
+        if (j > 0) {
+            j--;
+            const int c0 = int(t[j]);
+            sa[i] = c0;
+
+            if (c0 != c1) {
+                b[c1] = bi;
+                c1 = c0;
+                bi = b[c1];
+            }
+
+            bi--;
+
+            if (uint64(j) * mod <= mod - 1)
+                indexes[j / step] = bi + 1;
+
+            sa[bi] = ((j > 0) && (int(t[j - 1]) > c1)) ? ~int(t[j - 1]) : j;
+        }
+        else if (j != 0)
+            sa[i] = ~j;
+        else
+            pIdx = i;
+    }
+
+    return pIdx;
+}
+
+// Build the suffix array of t (n symbols in [0..k-1]) in sa. The fs slots
+// after sa[n-1] are free space used for the buckets and the recursion.
+// If indexes is not null, build the BWT instead (see induceBWT) and return
+// the rank of suffix 0.
+template <class T>
+int SAIS::computeSuffixArray(const T t[], int sa[], int fs, int n, int k, int indexes[], int idxCount)
+{
+    int* c;
+    int* b;
+    int flags;
+
+    // Allocate the bucket arrays in the free space of sa when possible
+    if (k <= MIN_BUCKET_SIZE) {
+        c = new int[k];
+
+        if (k <= fs) {
+            b = &sa[n + fs - k];
+            flags = 1;
+        }
+        else {
+            b = new int[k];
+            flags = 3;
+        }
+    }
+    else if (k <= fs) {
+        c = &sa[n + fs - k];
+
+        if (k <= fs - k) {
+            b = c - k;
+            flags = 0;
+        }
+        else if (k <= MIN_BUCKET_SIZE * 4) {
+            b = new int[k];
+            flags = 2;
+        }
+        else {
+            b = c;
+            flags = 8;
+        }
+    }
+    else {
+        c = b = new int[k];
+        flags = 4 | 8;
+    }
+
+    // Stage 1: reduce the problem by at least 1/2, sort all the LMS substrings
+    getCounts(t, c, n, k);
+    getBuckets(c, b, k, true);
+    memset(sa, 0, sizeof(int) * n);
+    int last = -1;
+    int i = n - 1;
+    int j = n;
+    int m = 0;
+    int c0 = int(t[n - 1]);
+    int c1;
+
+    do {
+        c1 = c0;
+    } while ((--i >= 0) && ((c0 = int(t[i])) >= c1));
+
+    while (i >= 0) {
+        do {
+            c1 = c0;
+        } while ((--i >= 0) && ((c0 = int(t[i])) <= c1));
+
+        if (i >= 0) {
+            if (last >= 0)
+                sa[last] = j;
+
+            last = --b[c1];
+            j = i;
+            m++;
+
+            do {
+                c1 = c0;
+            } while ((--i >= 0) && ((c0 = int(t[i])) >= c1));
+        }
+    }
+
+    int name;
+
+    if (m > 1) {
+        lmsSort(t, sa, c, b, n, k);
+        name = lmsPostProcess(t, sa, n, m);
+    }
+    else if (m == 1) {
+        sa[last] = j + 1;
+        name = 1;
+    }
+    else
+        name = 0;
+
+    // Stage 2: solve the reduced problem, recurse if names are not yet unique
+    if (name < m) {
+        if ((flags & 4) != 0)
+            delete[] c;
+
+        if ((flags & 2) != 0)
+            delete[] b;
+
+        int newfs = (n + fs) - (m * 2);
+
+        if ((flags & (1 | 4 | 8)) == 0) {
+            if (k + name <= newfs)
+                newfs -= k;
+            else
+                flags |= 8;
+        }
+
+        int* ra = &sa[m + newfs];
+
+        for (i = m + (n >> 1) - 1, j = m - 1; i >= m; i--) {
+            if (sa[i] != 0)
+                ra[j--] = sa[i] - 1;
+        }
+
+        computeSuffixArray((const int*)ra, sa, newfs, m, name, nullptr, 1);
+
+        i = n - 1;
+        j = m - 1;
+        c0 = int(t[n - 1]);
+
+        do {
+            c1 = c0;
+        } while ((--i >= 0) && ((c0 = int(t[i])) >= c1));
+
+        while (i >= 0) {
+            do {
+                c1 = c0;
+            } while ((--i >= 0) && ((c0 = int(t[i])) <= c1));
+
+            if (i >= 0) {
+                ra[j--] = i + 1;
+
+                do {
+                    c1 = c0;
+                } while ((--i >= 0) && ((c0 = int(t[i])) >= c1));
+            }
+        }
+
+        for (i = 0; i < m; i++)
+            sa[i] = ra[sa[i]];
+
+        if ((flags & 4) != 0)
+            c = b = new int[k];
+
+        if ((flags & 2) != 0)
+            b = new int[k];
+    }
+
+    // Stage 3: induce the result for the original problem
+    if ((flags & 8) != 0)
+        getCounts(t, c, n, k);
+
+    // Put all left-most S characters into their buckets
+    if (m > 1) {
+        getBuckets(c, b, k, true);
+        i = m - 1;
+        j = n;
+        int p = sa[m - 1];
+        c1 = int(t[p]);
+
+        do {
+            c0 = c1;
+            const int q = b[c0];
+
+            while (q < j)
+                sa[--j] = 0;
+
+            do {
+                sa[--j] = p;
+
+                if (--i < 0)
+                    break;
+
+                p = sa[i];
+            } while ((c1 = int(t[p])) == c0);
+        } while (i >= 0);
+
+        while (j > 0)
+            sa[--j] = 0;
+    }
+
+    int pIdx = 0;
+
+    if (indexes == nullptr)
+        induceSA(t, sa, c, b, n, k);
+    else
+        pIdx = induceBWT(t, sa, c, b, n, k, indexes, idxCount);
+
+    if ((flags & (1 | 4)) != 0)
+        delete[] c;
+
+    if ((flags & 2) != 0)
+        delete[] b;
+
+    return pIdx;
+}
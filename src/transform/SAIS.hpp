@@ -0,0 +1,73 @@
+/*
+Copyright 2011-2017 Frederic Langlet
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+you may obtain a copy of the License at
+
+                http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _SAIS_
+#define _SAIS_
+
+#include "../types.hpp"
+
+namespace kanzi
+{
+
+   // Suffix array construction by induced sorting (SA-IS) by Ge Nong, Sen Zhang
+   // and Wai Hong Chan, [Two Efficient Algorithms for Linear Time Suffix Array
+   // Construction], IEEE Transactions on Computers, 2011
+   // Port of sais-lite 2.4.1 by Yuta Mori (https://sites.google.com/site/yuta256/sais).
+   // Unlike DivSufSort, the running time is linear whatever the input: highly
+   // repetitive blocks (long runs, repeated records, ...) are not slower to sort.
+   // On regular data, DivSufSort is usually faster.
+   // The output is the same as DivSufSort::computeSuffixArray() and
+   // DivSufSort::computeBWT().
+   class SAIS
+   {
+   private:
+       static const int MIN_BUCKET_SIZE = 256;
+       static const int PREFETCH_DISTANCE = 16;
+
+       template <class T>
+       static void getCounts(const T t[], int c[], int n, int k);
+
+       static void getBuckets(const int c[], int b[], int k, bool end);
+
+       template <class T>
+       static void lmsSort(const T t[], int sa[], int c[], int b[], int n, int k);
+
+       template <class T>
+       static int lmsPostProcess(const T t[], int sa[], int n, int m);
+
+       template <class T>
+       static void induceSA(const T t[], int sa[], int c[], int b[], int n, int k);
+
+       template <class T>
+       static int induceBWT(const T t[], int sa[], int c[], int b[], int n, int k, int indexes[], int idxCount);
+
+       template <class T>
+       static int computeSuffixArray(const T t[], int sa[], int fs, int n, int k, int indexes[], int idxCount);
+
+   public:
+       SAIS() {}
+
+       ~SAIS() {}
+
+       void computeSuffixArray(byte input[], int sa[], int start, int length);
+
+       // Write the BWT of the input to output (the suffix array is never fully
+       // built, sa is used as work buffer). The primary index of each of the
+       // idxCount chunks (see BWT) is stored in indexes. Return indexes[0].
+       int computeBWT(byte input[], byte output[], int sa[], int start, int length,
+           int indexes[], int idxCount = 1);
+   };
+}
+#endif
@@ -43,32 +43,24 @@ bool SBRT::forward(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     uint8* src = (uint8*) &input._array[input._index];
     byte* dst = &output._array[output._index];
     int p[256] = { 0 };
-    int q[256] = { 0 };
-    int s2r[256];
-    int r2s[256];
+    SBRTRankList ranks;
 
-    for (int i = 0; i < 256; i++) {
-        s2r[i] = i;
-        r2s[i] = i;
-    }
+    // In MTF mode, the new key is always the greatest
+    const bool mtf = _mask2 == 0;
 
     for (int i = 0; i < count; i++) {
         const uint8 c = src[i];
-        int r = s2r[c];
+        const int r = ranks.rankOf(c);
         dst[i] = byte(r);
+
         const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
         p[c] = i;
-        q[c] = qc;
 
         // Move up symbol to correct rank
-        while ((r > 0) && (q[r2s[r - 1]] <= qc)) {
-            r2s[r] = r2s[r - 1];
-            s2r[r2s[r]] = r;
-            r--;
-        }
-
-        r2s[r] = c;
-        s2r[c] = r;
+        if (r == 0)
+            ranks.setFirstKey(qc);
+        else
+            ranks.move(r, (mtf == true) ? 0 : ranks.newRank(r, qc), qc);
     }
 
     input._index += count;
@@ -91,27 +83,24 @@ bool SBRT::inverse(SliceArray<byte>& input, SliceArray<byte>& output, int count)
     uint8* src = (uint8*) &input._array[input._index];
     byte* dst = &output._array[output._index];
     int p[256] = { 0 };
-    int q[256] = { 0 };
-    int r2s[256];
+    SBRTRankList ranks;
 
-    for (int i = 0; i < 256; i++)
-        r2s[i] = i;
+    // In MTF mode, the new key is always the greatest
+    const bool mtf = _mask2 == 0;
 
     for (int i = 0; i < count; i++) {
-        uint8 r = src[i];
-        const int c = r2s[r];
+        const int r = int(src[i]);
+        const uint8 c = ranks.symbolAt(r);
         dst[i] = byte(c);
+
         const int qc = ((i & _mask1) + (p[c] & _mask2)) >> _shift;
         p[c] = i;
-        q[c] = qc;
 
         // Move up symbol to correct rank
-        while ((r > 0) && (q[r2s[r - 1]] <= qc)) {
-            r2s[r] = r2s[r - 1];
-            r--;
-        }
-
-        r2s[r] = c;
+        if (r == 0)
+            ranks.setFirstKey(qc);
+        else
+            ranks.move(r, (mtf == true) ? 0 : ranks.newRank(r, qc), qc);
     }
 
     input._index += count;
@@ -16,8 +16,14 @@ limitations under the License.
 #ifndef _SBRT_
 #define _SBRT_
 
+#include <cstring>
+#include "../Global.hpp"
 #include "../Transform.hpp"
 
+#if defined(__SSE2__)
+   #include <emmintrin.h>
+#endif
+
 using namespace std;
 
 namespace kanzi 
@@ -53,5 +59,127 @@ namespace kanzi
        const int _shift;
    };
 
+
+   // List of the symbols in rank order with their keys (q in SBRT), shared by
+   // SBRT and SBRTZRLT. The keys never increase with the rank (a symbol only
+   // moves up past symbols with a key not greater than its new key, which is
+   // not less than its old key). Hence, the new rank of a symbol is found by
+   // scanning the contiguous array of keys several ranks at a time instead
+   // of one symbol at a time, and the rank of a symbol is found by comparing
+   // 16 symbols at a time (SSE2, scalar code otherwise).
+   class SBRTRankList
+   {
+   public:
+       SBRTRankList();
+
+       ~SBRTRankList() {}
+
+       // Return the rank of symbol c
+       int rankOf(uint8 c) const;
+
+       uint8 symbolAt(int r) const { return _r2s[r]; }
+
+       // Return the new rank of the symbol at rank r with new key qc
+       int newRank(int r, int qc) const;
+
+       // Move the symbol at rank r to rank j <= r and set its key to qc
+       void move(int r, int j, int qc);
+
+       // Set the key of the symbol at rank 0
+       void setFirstKey(int qc) { _q[0] = qc; }
+
+   private:
+       alignas(16) uint8 _r2s[256]; // symbols in rank order
+       int _q[256]; // keys in rank order
+   };
+
+
+   inline SBRTRankList::SBRTRankList()
+   {
+       for (int i = 0; i < 256; i++) {
+           _r2s[i] = uint8(i);
+           _q[i] = 0;
+       }
+   }
+
+   inline int SBRTRankList::rankOf(uint8 c) const
+   {
+       // Most frequent case after a BWT
+       if (_r2s[0] == c)
+           return 0;
+
+   #if defined(__SSE2__)
+       const __m128i vc = _mm_set1_epi8(char(c));
+
+       for (int r = 0; r < 256; r += 16) {
+           const __m128i v = _mm_load_si128((const __m128i*) &_r2s[r]);
+           const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vc));
+
+           if (mask != 0)
+               return r + Global::_log2(uint32(mask & -mask));
+       }
+
+       return -1;
+   #else
+       int r = 0;
+
+       while (_r2s[r] != c)
+           r++;
+
+       return r;
+   #endif
+   }
+
+   inline int SBRTRankList::newRank(int r, int qc) const
+   {
+       // Symbols usually move up by a few ranks only
+       const int end = (r > 8) ? r - 8 : 0;
+
+       while ((r > end) && (_q[r - 1] <= qc))
+           r--;
+
+       if ((r != end) || (r == 0))
+           return r;
+
+   #if defined(__SSE2__)
+       const __m128i vq = _mm_set1_epi32(qc);
+
+       while (r >= 4) {
+           // The lanes with a key greater than qc are the first ones
+           const __m128i v = _mm_loadu_si128((const __m128i*) &_q[r - 4]);
+           const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, vq)));
+
+           if (mask != 0)
+               return r - 4 + (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + (mask >> 3);
+
+           r -= 4;
+       }
+   #endif
+
+       while ((r > 0) && (_q[r - 1] <= qc))
+           r--;
+
+       return r;
+   }
+
+   inline void SBRTRankList::move(int r, int j, int qc)
+   {
+       const uint8 c = _r2s[r];
+
+       if (r - j > 16) {
+           memmove(&_r2s[j + 1], &_r2s[j], r - j);
+           memmove(&_q[j + 1], &_q[j], sizeof(int) * (r - j));
+       }
+       else {
+           for (; r > j; r--) {
+               _r2s[r] = _r2s[r - 1];
+               _q[r] = _q[r - 1];
+           }
+       }
+
+       _r2s[j] = c;
+       _q[j] = qc;
+   }
+
 }
 #endif
@@ -222,6 +222,47 @@ static inline void prefetchWrite(const void* ptr) {
 }
 
 
+// Stream buffers reading from or writing to a memory region (no copy, no allocation).
+// Used to give each concurrent task its own bitstream over a task private buffer.
+template <class T>
+class istreambuf : public streambuf
+{
+public:
+	istreambuf() {}
+
+	istreambuf(T* buf, streamsize sz) { this->setg(buf, buf, buf + sz); }
+
+	// Next unread character and number of characters left
+	T* current() const { return this->gptr(); }
+
+	streamsize available() const { return streamsize(this->egptr() - this->gptr()); }
+
+protected:
+	streambuf* setbuf(char_type* buf, streamsize sz)
+	{
+		this->setg(buf, buf, buf + sz);
+		return this;
+	}
+};
+
+
+template <class T>
+class ostreambuf : public streambuf
+{
+public:
+	ostreambuf() {}
+
+	ostreambuf(T* buf, streamsize sz) { this->setp(buf, buf + sz); }
+
+protected:
+	streambuf* setbuf(char_type* buf, streamsize sz)
+	{
+		this->setp(buf, buf + sz);
+		return this;
+	}
+};
+
+
 // Thread safe printer
 class Printer 
 {